@@ -2,10 +2,13 @@
 // S.P.Storck 07-20-2017
 
 #include "klt.hh"
+#include "klt_recon.hh"
+#include "klt_simd.hh"
+#include "klt_small.hh"
+#include "klt_window.hh"
 
-#if KLT_SUPPORT_WIN
+#include <algorithm>
 #include <cmath>
-#endif
 #include <complex>
 #include <cstdlib>
 #include <cstring>
@@ -14,340 +17,1318 @@
 #endif
 #include <sstream>
 #include <stdexcept>
+#include <mkl_cblas.h> // MKL
+#include <mkl_dfti.h> // MKL
 #include <mkl_lapacke.h> // MKL
-#if KLT_SUPPORT_WIN && (KLT_DEBUG & KLT_DEBUG_WIN)
+#if KLT_DEBUG & KLT_DEBUG_WIN
 #include <primitive.h>
 #endif
 
 static const size_t ALIGN = 128;
 
+// Time the enclosing scope into a stage, count an event
+#if KLT_SUPPORT_STATS
+#define KLT_STATS_SCOPE(stage) KLTStatsScope stats_scope(stats_ctr, stage)
+#define KLT_STATS_COUNT(counter) stats_ctr.count(counter)
+#else
+#define KLT_STATS_SCOPE(stage)
+#define KLT_STATS_COUNT(counter)
+#endif
+
+//---------------------------------------------------------------------------
+// Smallest 2^a * 3^b * 5^c >= len (lengths DFTI handles efficiently)
+//---------------------------------------------------------------------------
+static int fft_good_len(int len)
+{
+  for (;; len++) {
+    int rem = len;
+    while (rem % 2 == 0) rem /= 2;
+    while (rem % 3 == 0) rem /= 3;
+    while (rem % 5 == 0) rem /= 5;
+    if (rem == 1) {
+      return len;
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+// Auto-correlation cost model (approx. flops per frame)
+//   direct: one complex MAC (8 flops) per lag product.
+//   FFT: forward + backward transform (5 N log2(N) each), |X|^2 and copies.
+//---------------------------------------------------------------------------
+static double acorr_direct_cost(int in_len, int acm_order)
+{
+  const double num_prod = static_cast<double>(acm_order) * in_len -
+    0.5 * static_cast<double>(acm_order) * (acm_order - 1);
+  return 8.0 * num_prod;
+}
+
+static double acorr_fft_cost(int fft_len)
+{
+  return 10.0 * fft_len * log2(static_cast<double>(fft_len)) + 8.0 * fft_len;
+}
+
+//---------------------------------------------------------------------------
+// Sliding projection cost model (approx. flops per frame)
+//   direct: one complex MAC per eigenvector, start and tap.
+//   FFT: input transform, num_eig eigenvector transforms and inverses, and
+//   the spectra products.
+//---------------------------------------------------------------------------
+static double proj_direct_cost(int in_len, int acm_order, int num_eig)
+{
+  return 8.0 * num_eig * acm_order * (in_len - acm_order + 1);
+}
+
+static double proj_fft_cost(int fft_len, int num_eig)
+{
+  return 5.0 * (1 + 2 * num_eig) * fft_len * log2(static_cast<double>(fft_len)) +
+    8.0 * num_eig * fft_len;
+}
+
+//---------------------------------------------------------------------------
+// Eigensolver cost model (approx. flops per frame)
+//   LAPACK: packed Householder tridiagonalization dominates (16/3 n^3).
+//   Lanczos (worst case, num_steps iterations): one circulant matvec (two
+//   FFTs and a product) per step plus two-pass full reorthogonalization.
+//---------------------------------------------------------------------------
+static double eig_lapack_cost(int acm_order)
+{
+  const double n = acm_order;
+  return (16.0 / 3.0) * n * n * n;
+}
+
+static double eig_lanczos_cost(int acm_order, int num_steps, int fft_len)
+{
+  const double m = num_steps;
+  return m * acorr_fft_cost(fft_len) + 16.0 * acm_order * m * m;
+}
+
+//---------------------------------------------------------------------------
+// Information theoretic model order (Wax & Kailath)
+//   ev: all eigenvalues, ascending (size n).
+//   The k <= max_order (< n) signal components minimizing
+//     MDL: L(k) + k (2n - k) log(num_snap) / 2
+//     AIC: 2 L(k) + 2 k (2n - k)
+//   where L(k) = num_snap (n - k) log(arithmetic / geometric mean of the
+//   n - k smallest eigenvalues).
+//---------------------------------------------------------------------------
+static int order_info_criterion(const float* ev, int n, int num_snap, int max_order, bool aic)
+{
+  // Floor (relative to the largest) keeps the logs finite
+  const double floor = std::max(1.0e-12 * ev[n-1], 1.0e-30);
+  double sum = 0.0;
+  double log_sum = 0.0;
+  for (int eidx=0; eidx < n; eidx++) {
+    const double val = std::max(static_cast<double>(ev[eidx]), floor);
+    sum += val;
+    log_sum += log(val);
+  }
+  int best_order = 0;
+  double best_cost = 0.0;
+  for (int order=0; order <= max_order; order++) {
+    if (order > 0) {
+      // Largest remaining eigenvalue moves to the signal subspace
+      const double val = std::max(static_cast<double>(ev[n - order]), floor);
+      sum -= val;
+      log_sum -= log(val);
+    }
+    const int num_noise = n - order;
+    const double like = num_snap * (num_noise * log(std::max(sum, floor) / num_noise) - log_sum);
+    const double num_param = static_cast<double>(order) * (2 * n - order);
+    const double cost = aic ? 2.0 * like + 2.0 * num_param :
+      like + 0.5 * num_param * log(static_cast<double>(num_snap));
+    if (order == 0 || cost < best_cost) {
+      best_order = order;
+      best_cost = cost;
+    }
+  }
+  return best_order;
+}
+
+//---------------------------------------------------------------------------
+// Energy model order: fewest of the top eigenvalues ev (ascending, size num)
+// summing to energy_frac of trace (num if they never do)
+//---------------------------------------------------------------------------
+static int order_energy(const float* ev, int num, double trace, float energy_frac)
+{
+  double sum = 0.0;
+  for (int order=1; order <= num; order++) {
+    sum += ev[num - order];
+    if (sum >= energy_frac * trace) {
+      return order;
+    }
+  }
+  return num;
+}
+
+//---------------------------------------------------------------------------
+// Sort eigenvalues ev (size num) and their sstebz block indices ib
+// ascending, by value, or by block then value (by_block: the order cstein
+// takes them in).  The eigenvector columns vec (each of length len, col
+// major), if not NULL, move along.  Insertion sort: num is small, and
+// sstebz's output is already sorted within each block.
+//---------------------------------------------------------------------------
+static void sort_eigen(float* ev, int* ib, std::complex<float>* vec, int len, int num,
+                       bool by_block)
+{
+  for (int idx=1; idx < num; idx++) {
+    for (int jdx=idx; jdx > 0; jdx--) {
+      const bool swap = by_block ?
+        ib[jdx-1] > ib[jdx] || (ib[jdx-1] == ib[jdx] && ev[jdx-1] > ev[jdx]) :
+        ev[jdx-1] > ev[jdx];
+      if (!swap) {
+        break;
+      }
+      std::swap(ev[jdx-1], ev[jdx]);
+      std::swap(ib[jdx-1], ib[jdx]);
+      if (vec != NULL) {
+        std::swap_ranges(&vec[(jdx-1)*len], &vec[jdx*len], &vec[jdx*len]);
+      }
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+// Orthonormalize columns v[num_prev..num_prev+num_new) (each of length len,
+// col major) against v[0..num_prev) and each other, two-pass modified
+// Gram-Schmidt.  Numerically dependent columns are dropped and the rest
+// compacted; returns the number of new columns kept.
+//---------------------------------------------------------------------------
+static int orthonormalize(std::complex<float>* v, int len, int num_prev, int num_new)
+{
+  int num_kept = 0;
+  for (int nidx=0; nidx < num_new; nidx++) {
+    std::complex<float>* q = &v[(num_prev+num_kept)*len];
+    if (nidx != num_kept) {
+      memcpy(q, &v[(num_prev+nidx)*len], len*sizeof(std::complex<float>));
+    }
+    float nrm0 = 0.0f;
+    for (int tidx=0; tidx < len; tidx++) {
+      nrm0 += std::norm(q[tidx]);
+    }
+    for (int pass=0; pass < 2; pass++) {
+      for (int pidx=0; pidx < num_prev+num_kept; pidx++) {
+        const std::complex<float>* p = &v[pidx*len];
+        const std::complex<float> h = klt_cdotc(q, p, len);
+        for (int tidx=0; tidx < len; tidx++) {
+          q[tidx] -= h * p[tidx];
+        }
+      }
+    }
+    float nrm = 0.0f;
+    for (int tidx=0; tidx < len; tidx++) {
+      nrm += std::norm(q[tidx]);
+    }
+    if (nrm > 1.0e-8f * nrm0 && nrm > 0.0f) {
+      const float scale = 1.0f / std::sqrt(nrm);
+      for (int tidx=0; tidx < len; tidx++) {
+        q[tidx] *= scale;
+      }
+      num_kept++;
+    }
+  }
+  return num_kept;
+}
+
+//---------------------------------------------------------------------------
+// KLTBuffers release function for an FFT plan
+//---------------------------------------------------------------------------
+static void free_plan(void* ptr)
+{
+  DFTI_DESCRIPTOR_HANDLE hdl = static_cast<DFTI_DESCRIPTOR_HANDLE>(ptr);
+  DftiFreeDescriptor(&hdl);
+}
+
+// Lanczos Ritz pair convergence (residual relative to largest Ritz value)
+static const float LANCZOS_TOL = 1.0e-5f;
+// Lanczos steps between convergence checks
+static const int LANCZOS_CHECK = 8;
+// Canonical phase pivot: the first eigenvector component unless smaller
+static const float PHASE_TOL = 1.0e-3f;
+
 //---------------------------------------------------------------------------
 // Constructor
 //---------------------------------------------------------------------------
 KLT::KLT(int in_len,
-#if KLT_SUPPORT_WIN
-         int window,
-#endif
 #if KLT_SUPPORT_EVALN
          int eval_normalized,
 #endif
          int acm_order,
          int num_eig) :
+  in_buf(NULL),
+  eval_buf(NULL),
+  kltc_buf(NULL),
+  kltb_buf(NULL),
+  klts_buf(NULL),
+  recon_buf(NULL),
   in_len(in_len),
-#if KLT_SUPPORT_WIN
-  window(window),
-#endif
 #if KLT_SUPPORT_EVALN
   eval_normalized(eval_normalized),
 #endif
   acm_order(acm_order),
   num_eig(num_eig),
-  in_buf(NULL),
-#if KLT_SUPPORT_WIN
-  win_buf(NULL),
-#endif
+  acorr_sel(ACORR_AUTO),
+  eig_sel(EIG_AUTO),
+  out_mask(OUT_ALL),
+  kltb_off(0),
   ac_buf(NULL),
-  eval_buf(NULL),
-  kltc_buf(NULL),
-  kltb_buf(NULL),
+  ac_len(0),
   d_buf(NULL),
   e_buf(NULL),
   tau_buf(NULL),
   ib_buf(NULL),
   is_buf(NULL),
-  if_buf(NULL)
+  if_buf(NULL),
+  frame(NULL),
+  frame_win(NULL),
+  frame_head(NULL),
+  small_fn(klt_small_kernel(acm_order, num_eig)),
+  acfft_use(false),
+  acfft_len(0),
+  acfft_buf(NULL),
+  acfft_hdl(NULL),
+  stream_clen(0),
+  stream_resync(1),
+  stream_frame(0),
+  hist_len(0),
+  lag_buf(NULL),
+  hist_buf(NULL),
+  tp_len(0),
+  tp_c_buf(NULL),
+  tp_w_buf(NULL),
+  tp_hdl(NULL),
+  lz_use(false),
+  lz_max(0),
+  lz_q_buf(NULL),
+  lz_s_buf(NULL),
+  trk_use(0),
+  trk_tol(0.0f),
+  trk_max_iter(0),
+  trk_valid(false),
+  trk_hit(false),
+  trk_q_buf(NULL),
+  trk_z_buf(NULL),
+  trk_h_buf(NULL),
+  trk_y_buf(NULL),
+  sp_use(false),
+  sp_len(0),
+  sp_x_buf(NULL),
+  sp_v_buf(NULL),
+  sp_hdl(NULL),
+  sp_multi_hdl(NULL),
+  mo_rule(ORDER_FIXED),
+  mo_energy(1.0f),
+  mo_order(num_eig),
+  mo_buf(NULL),
+  win_type(WIN_NONE),
+  wf_buf(NULL),
+  sc_use(false),
+  sc_fb(false),
+  sc_forget(0.0f),
+  sc_valid(false),
+  sc_acc_buf(NULL),
+  sc_fb_buf(NULL),
+  sc_snap_buf(NULL),
+  mp_use(false),
+  mp_refine(false),
+  mp_ac_buf(NULL),
+  mp_lag_buf(NULL),
+  mp_fft_buf(NULL),
+  mp_fft_hdl(NULL),
+  ph_use(false),
+  recon(NULL)
 {
 #if KLT_DEBUG & KLT_DEBUG_FINE
   std::cout<<"in_len="<<in_len<<
     "  acm_order="<<acm_order<<
     "  num_eig="<<num_eig<<std::endl;
 #endif
-  // Allocate buffers...
+  // Allocate buffers (one arena, each buffer on its own cache lines)...
   // Input
-  if (posix_memalign(reinterpret_cast<void**>(&in_buf),
-                     ALIGN, in_len*sizeof(std::complex<float>))) {
-    std::ostringstream oss;
-    oss << "Failed to allocate in_buf (size " << in_len << ")";
-    throw std::runtime_error(oss.str());
-  }
-#if KLT_SUPPORT_WIN
-  // Window
-  if (posix_memalign(reinterpret_cast<void**>(&win_buf),
-                     ALIGN, in_len*sizeof(float))) {
-    std::ostringstream oss;
-    oss << "Failed to allocate win_buf (size " << in_len << ")";
-    throw std::runtime_error(oss.str());
-  }
-#endif
-  // Auto-correlation toeplitz matrix (lower triangular packed, col major order)
-  const size_t ac_size = ((acm_order + 1) * acm_order) / 2;
-  if (posix_memalign(reinterpret_cast<void**>(&ac_buf),
-                     ALIGN, ac_size*sizeof(std::complex<float>))) {
-    std::ostringstream oss;
-    oss << "Failed to allocate ac_buf (size " << ac_size << ")";
-    throw std::runtime_error(oss.str());
-  }
+  const size_t in_off = arena.reserve(in_len*sizeof(std::complex<float>));
+  // Auto-correlation lags (grown to the packed matrix only if the LAPACK
+  // path is needed, see init_packed())
+  const size_t ac_off = arena.reserve(acm_order*sizeof(std::complex<float>));
   // Eigenvalues
   // This vector must be allocated to size acm_order rather than
   // just num_eig because LAPACKE_cstein() requires an oversized
   // buffer.
-  if (posix_memalign(reinterpret_cast<void**>(&eval_buf),
-                     ALIGN, acm_order*sizeof(float))) {
-    std::ostringstream oss;
-    oss << "Failed to allocate eval_buf (size " << acm_order << ")";
-    throw std::runtime_error(oss.str());
-  }
-#if KLT_DEBUG & KLT_DEBUG_FINE
-  std::cout<<"eval_buf="<<eval_buf<<"["<<acm_order<<"]"<<std::endl;
-#endif
+  const size_t eval_off = arena.reserve(acm_order*sizeof(float));
   // KLT coeffs
-  if (posix_memalign(reinterpret_cast<void**>(&kltc_buf),
-                     ALIGN, num_eig*sizeof(std::complex<float>))) {
-    std::ostringstream oss;
-    oss << "Failed to allocate kltc_buf (size " << num_eig << ")";
-    throw std::runtime_error(oss.str());
-  }
+  const size_t kltc_off = arena.reserve(num_eig*sizeof(std::complex<float>));
   // KLT basis funcs (eigenvectors)
-  const size_t kltb_size = acm_order * num_eig;
-  if (posix_memalign(reinterpret_cast<void**>(&kltb_buf),
-                     ALIGN, kltb_size*sizeof(std::complex<float>))) {
-    std::ostringstream oss;
-    oss << "Failed to allocate kltb_buf (size " << kltb_size << ")";
-    throw std::runtime_error(oss.str());
-  }
+  kltb_off = arena.reserve(static_cast<size_t>(acm_order)*num_eig*sizeof(std::complex<float>));
   // Eigendecomp temp buffers
-  if (posix_memalign(reinterpret_cast<void**>(&d_buf),
-                     ALIGN, acm_order*sizeof(float))) {
-    std::ostringstream oss;
-    oss << "Failed to allocate d_buf (size " << acm_order << ")";
-    throw std::runtime_error(oss.str());
-  }
-  const size_t e_size = acm_order - 1;
-  if (posix_memalign(reinterpret_cast<void**>(&e_buf),
-                     ALIGN, e_size*sizeof(float))) {
-    std::ostringstream oss;
-    oss << "Failed to allocate e_buf (size " << e_size << ")";
-    throw std::runtime_error(oss.str());
-  }
-  const size_t tau_size = acm_order - 1;
-  if (posix_memalign(reinterpret_cast<void**>(&tau_buf),
-                     ALIGN, tau_size*sizeof(std::complex<float>))) {
-    std::ostringstream oss;
-    oss << "Failed to allocate tau_buf (size " << tau_size << ")";
-    throw std::runtime_error(oss.str());
-  }
-  if (posix_memalign(reinterpret_cast<void**>(&ib_buf),
-                     ALIGN, acm_order*sizeof(int))) {
-    std::ostringstream oss;
-    oss << "Failed to allocate ib_buf (size " << acm_order << ")";
-    throw std::runtime_error(oss.str());
-  }
-  if (posix_memalign(reinterpret_cast<void**>(&is_buf),
-                     ALIGN, acm_order*sizeof(int))) {
-    std::ostringstream oss;
-    oss << "Failed to allocate is_buf (size " << acm_order << ")";
-    throw std::runtime_error(oss.str());
+  const size_t d_off = arena.reserve(acm_order*sizeof(float));
+  const size_t e_off = arena.reserve((acm_order - 1)*sizeof(float));
+  const size_t tau_off = arena.reserve((acm_order - 1)*sizeof(std::complex<float>));
+  const size_t ib_off = arena.reserve(acm_order*sizeof(int));
+  const size_t is_off = arena.reserve(acm_order*sizeof(int));
+  const size_t if_off = arena.reserve(num_eig*sizeof(int));
+  arena.commit();
+  in_buf = arena.ptr<std::complex<float> >(in_off);
+  ac_buf = arena.ptr<std::complex<float> >(ac_off);
+  ac_len = acm_order;
+  eval_buf = arena.ptr<float>(eval_off);
+#if KLT_DEBUG & KLT_DEBUG_FINE
+  std::cout<<"eval_buf="<<eval_buf<<"["<<acm_order<<"]"<<std::endl;
+#endif
+  kltc_buf = arena.ptr<std::complex<float> >(kltc_off);
+  kltb_buf = arena.ptr<std::complex<float> >(kltb_off);
+  d_buf = arena.ptr<float>(d_off);
+  e_buf = arena.ptr<float>(e_off);
+  tau_buf = arena.ptr<std::complex<float> >(tau_off);
+  ib_buf = arena.ptr<int>(ib_off);
+  is_buf = arena.ptr<int>(is_off);
+  if_buf = arena.ptr<int>(if_off);
+  // Auto-correlation engine (plans FFT if the cost model favors it)
+  set_acorr_engine(ACORR_AUTO);
+  // Eigensolver engine (plans Lanczos if the cost model favors it)
+  set_eig_engine(EIG_AUTO);
+}
+
+
+//---------------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------------
+KLT::~KLT()
+{
+  // Arena buffers go back with the arena, the engine buffers and plans with
+  // bufs (ac_buf too, once grown out of the arena)
+  delete recon;
+}
+
+
+//---------------------------------------------------------------------------
+// Select window
+//   The scratch buffer is allocated here even when the FFT/snapshot paths
+//   window on the fly: the frame head, and any direct or small-kernel
+//   frame, is windowed into it (see window_frame()).
+//---------------------------------------------------------------------------
+void KLT::set_window(WindowType type, float param)
+{
+  if (type == WIN_USER) {
+    throw std::runtime_error("User window needs its taps");
   }
-  if (posix_memalign(reinterpret_cast<void**>(&if_buf),
-                     ALIGN, num_eig*sizeof(int))) {
-    std::ostringstream oss;
-    oss << "Failed to allocate if_buf (size " << num_eig << ")";
-    throw std::runtime_error(oss.str());
+  if (type != WIN_NONE && stream_clen > 0) {
+    throw std::runtime_error("Stream mode does not support windowing");
   }
-#if KLT_SUPPORT_WIN
-  // Create window
-  if (window) {
+  std::shared_ptr<const float> tab;
+  if (type != WIN_NONE) {
+    tab = klt_window_table(type, in_len, param);
     init_window();
+  }
+  win_tab = tab;
+  win_type = type;
 #if KLT_DEBUG & KLT_DEBUG_WIN
+  if (win_tab) {
     CPHEADER win_hcb;
     m_init(win_hcb, "klt_win", "1000", "SF", 0);
     win_hcb.xstart = 0;
     win_hcb.xdelta = 1;
     win_hcb.xunits = 1;
     m_open(win_hcb, HCBF_OUTPUT);
-    m_filad(win_hcb, win_buf, in_len);
+    m_filad(win_hcb, const_cast<float*>(win_tab.get()), in_len);
     m_close(win_hcb);
-#endif
   }
 #endif
 }
 
+void KLT::set_window(const float* taps)
+{
+  if (taps == NULL) {
+    throw std::runtime_error("User window needs its taps");
+  }
+  if (stream_clen > 0) {
+    throw std::runtime_error("Stream mode does not support windowing");
+  }
+  std::shared_ptr<const float> tab = klt_window_copy(taps, in_len);
+  init_window();
+  win_tab = tab;
+  win_type = WIN_USER;
+}
+
 
 //---------------------------------------------------------------------------
-// Destructor
+// Select auto-correlation engine
 //---------------------------------------------------------------------------
-KLT::~KLT()
+void KLT::set_acorr_engine(AcorrEngine engine)
 {
-  if (in_buf != NULL) {
-#if KLT_DEBUG & KLT_DEBUG_FINE
-    std::cout<<"Free in_buf"<<std::endl;
-#endif
-    free(in_buf);
+  bool use_fft;
+  switch (engine) {
+  case ACORR_DIRECT:
+    use_fft = false;
+    break;
+  case ACORR_FFT:
+    use_fft = true;
+    break;
+  default:
+    use_fft = acorr_fft_cost(fft_good_len(in_len + acm_order - 1)) <
+      acorr_direct_cost(in_len, acm_order);
+    break;
   }
-#if KLT_SUPPORT_WIN
-  if (win_buf != NULL) {
-#if KLT_DEBUG & KLT_DEBUG_FINE
-    std::cout<<"Free win_buf"<<std::endl;
-#endif
-    free(win_buf);
+  if (use_fft && acfft_hdl == NULL) {
+    init_acorr_fft();
   }
-#endif
-  if (ac_buf != NULL) {
-#if KLT_DEBUG & KLT_DEBUG_FINE
-    std::cout<<"Free ac_buf"<<std::endl;
-#endif
-    free(ac_buf);
+  if (use_fft && mp_use && mp_fft_hdl == NULL) {
+    init_mixed_fft();
   }
-  if (eval_buf != NULL) {
+  acfft_use = use_fft;
+  acorr_sel = engine;
 #if KLT_DEBUG & KLT_DEBUG_FINE
-    std::cout<<"Free eval_buf"<<std::endl;
+  std::cout<<"acorr engine: "<<(acfft_use ? "fft" : "direct")<<std::endl;
 #endif
-    free(eval_buf);
+}
+
+
+//---------------------------------------------------------------------------
+// Streaming auto-correlation
+//---------------------------------------------------------------------------
+void KLT::set_stream(int in_clen, int resync)
+{
+  if (in_clen < 0 || resync < 1) {
+    std::ostringstream oss;
+    oss << "Invalid stream config (in_clen " << in_clen << ", resync " << resync << ")";
+    throw std::runtime_error(oss.str());
   }
-  if (kltc_buf != NULL) {
-#if KLT_DEBUG & KLT_DEBUG_FINE
-    std::cout<<"Free kltc_buf"<<std::endl;
-#endif
-    free(kltc_buf);
+  if (win_type != WIN_NONE && in_clen > 0 && in_clen < in_len) {
+    throw std::runtime_error("Stream mode does not support windowing");
   }
-  if (kltb_buf != NULL) {
-#if KLT_DEBUG & KLT_DEBUG_FINE
-    std::cout<<"Free kltb_buf"<<std::endl;
-#endif
-    free(kltb_buf);
+  sc_valid = false;
+  if (in_clen == 0 || in_clen >= in_len) {
+    // No overlap, nothing to reuse
+    stream_clen = 0;
+    return;
   }
-  if (d_buf != NULL) {
-#if KLT_DEBUG & KLT_DEBUG_FINE
-    std::cout<<"Free d_buf"<<std::endl;
-#endif
-    free(d_buf);
+  if (lag_buf == NULL) {
+    bufs.alloc(lag_buf, acm_order, "lag_buf");
   }
-  if (e_buf != NULL) {
-#if KLT_DEBUG & KLT_DEBUG_FINE
-    std::cout<<"Free e_buf"<<std::endl;
-#endif
-    free(e_buf);
+  // Departing lag products reach at most acm_order-1 past the in_clen
+  // departing samples
+  const int len = std::min(in_len, in_clen + acm_order - 1);
+  if (len > hist_len) {
+    hist_len = 0;
+    bufs.alloc(hist_buf, len, "hist_buf");
   }
-  if (tau_buf != NULL) {
-#if KLT_DEBUG & KLT_DEBUG_FINE
-    std::cout<<"Free tau_buf"<<std::endl;
-#endif
-    free(tau_buf);
+  hist_len = len;
+  stream_clen = in_clen;
+  stream_resync = resync;
+  stream_frame = 0;
+}
+
+
+//---------------------------------------------------------------------------
+// Select covariance estimator
+//---------------------------------------------------------------------------
+void KLT::set_covariance(CovEstimator est, bool fwd_bwd, float forget)
+{
+  if (!(forget >= 0.0f && forget < 1.0f)) {
+    std::ostringstream oss;
+    oss << "Invalid covariance forget factor " << forget;
+    throw std::runtime_error(oss.str());
   }
-  if (ib_buf != NULL) {
-#if KLT_DEBUG & KLT_DEBUG_FINE
-    std::cout<<"Free ib_buf"<<std::endl;
-#endif
-    free(ib_buf);
+  const bool use = est == COV_SNAPSHOT;
+  if (use && mp_use) {
+    throw std::runtime_error("Mixed precision does not support snapshot covariance");
   }
-  if (is_buf != NULL) {
-#if KLT_DEBUG & KLT_DEBUG_FINE
-    std::cout<<"Free is_buf"<<std::endl;
-#endif
-    free(is_buf);
+  const size_t mat_size = static_cast<size_t>(acm_order) * acm_order;
+  if (use && sc_acc_buf == NULL) {
+    const size_t snap_size = static_cast<size_t>(acm_order) * COV_SNAP_BLOCK;
+    bufs.alloc(sc_acc_buf, mat_size, "sc_acc_buf");
+    bufs.alloc(sc_snap_buf, snap_size, "sc_snap_buf");
   }
-  if (if_buf != NULL) {
-#if KLT_DEBUG & KLT_DEBUG_FINE
-    std::cout<<"Free if_buf"<<std::endl;
-#endif
-    free(if_buf);
+  if (use && fwd_bwd && sc_fb_buf == NULL) {
+    bufs.alloc(sc_fb_buf, mat_size, "sc_fb_buf");
   }
+  sc_use = use;
+  sc_fb = use && fwd_bwd;
+  sc_forget = forget;
+  sc_valid = false;
+  // Tracked subspace belongs to the other estimator's matrix
+  trk_valid = false;
 }
 
 
 //---------------------------------------------------------------------------
-// Transform in_buf
-//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
-//   kltc_buf, and kltb_buf to 0.0f.
+// Select lag precision
 //---------------------------------------------------------------------------
-void KLT::transform()
+void KLT::set_precision(Precision prec, bool refine)
 {
-#if KLT_SUPPORT_WIN
-  // Apply window
-  if (window) {
-    apply_window();
-  }
-#endif
-  // Auto-corr matrix
-  acorr_matrix();
-  // Eigendecomp
-  eigendecomp();
-#if KLT_SUPPORT_EVALN
-  // Normalize eigenvalues?
-  if (eval_normalized) {
-    float max_eval = 0.0f;
-    for (int eidx=0; eidx<num_eig; eidx++) {
-      max_eval = std::max(eval_buf[eidx], max_eval);
-    }
-    const float inv_max_eval = 1.0f / max_eval;
-    for (int eidx=0; eidx<num_eig; eidx++) {
-      eval_buf[eidx] *= inv_max_eval;
-    }
+  const bool use = prec == PREC_MIXED;
+  if (use && sc_use) {
+    throw std::runtime_error("Mixed precision does not support snapshot covariance");
   }
-#endif
-  // Compute KLT coeffs
-  for (int cidx=0; cidx<num_eig; cidx++) {
-    kltc_buf[cidx] = std::complex<float>(0.0f, 0.0f);
-    for (int tidx=0; tidx<acm_order; tidx++) {
-      kltc_buf[cidx] += in_buf[tidx] * std::conj(kltb_buf[cidx*acm_order+tidx]);
-    }
+  if (use && mp_ac_buf == NULL) {
+    bufs.alloc(mp_ac_buf, acm_order, "mp_ac_buf");
+    bufs.alloc(mp_lag_buf, acm_order, "mp_lag_buf");
   }
-  // Apply coeffs to KLT basis funcions
-  for (int cidx=0; cidx<num_eig; cidx++) {
-    for (int tidx=0; tidx<acm_order; tidx++) {
-      kltb_buf[cidx*acm_order+tidx] *= kltc_buf[cidx];
-    }
+  if (use && acfft_use && mp_fft_hdl == NULL) {
+    init_mixed_fft();
   }
+  mp_use = use;
+  mp_refine = use && refine;
+  // Running sums are kept in the precision in use
+  stream_frame = 0;
+  init_outputs();
 }
 
 
-//-----------------------------------------------------------------------------
-// Auto-correlation Matrix
-//-----------------------------------------------------------------------------
-void KLT::acorr_matrix()
+//---------------------------------------------------------------------------
+// Select eigensolver engine
+//---------------------------------------------------------------------------
+void KLT::set_eig_engine(EigEngine engine)
 {
-  for (int aidx=0; aidx < acm_order; aidx++) {
-    ac_buf[aidx] = std::complex<float>(0.0f, 0.0f);
-    for (int w2idx=0; w2idx < in_len - aidx; w2idx++) {
-      const int w1idx = w2idx + aidx;
-      ac_buf[aidx] += in_buf[w1idx] * std::conj(in_buf[w2idx]);
+  bool use_lz;
+  switch (engine) {
+  case EIG_LAPACK:
+    use_lz = false;
+    break;
+  case EIG_LANCZOS:
+    use_lz = true;
+    break;
+  default:
+    {
+      const int num_steps = std::min(acm_order, 2 * num_eig + 64);
+      use_lz = eig_lanczos_cost(acm_order, num_steps, fft_good_len(2 * acm_order - 1)) <
+        eig_lapack_cost(acm_order);
     }
+    break;
   }
-#if KLT_DEBUG & KLT_DEBUG_VERBOSE
-  std::cout<<"ac: ";
-  for (int aidx=0; aidx < acm_order; aidx++) {
-    std::cout<<ac_buf[aidx]<<"  ";
+  if (use_lz && lz_q_buf == NULL) {
+    init_lanczos();
   }
-  std::cout<<std::endl;
+  if (!use_lz) {
+    init_packed();
+  }
+  lz_use = use_lz;
+  eig_sel = engine;
+#if KLT_DEBUG & KLT_DEBUG_FINE
+  std::cout<<"eig engine: "<<(lz_use ? "lanczos" : "lapack")<<std::endl;
 #endif
-  // Toeplitz (lower triangular packed)
-  int aoidx = acm_order;
-  for (int col_len = acm_order-1; col_len > 0; col_len--) {
-    for (int aiidx = 0; aiidx < col_len; aiidx++) {
-      ac_buf[aoidx++] = ac_buf[aiidx];
+}
+
+
+//---------------------------------------------------------------------------
+// Subspace tracking
+//---------------------------------------------------------------------------
+void KLT::set_track(int track, float tol, int max_iter)
+{
+  if (track && (!(tol > 0.0f) || max_iter < 1)) {
+    std::ostringstream oss;
+    oss << "Invalid track config (tol " << tol << ", max_iter " << max_iter << ")";
+    throw std::runtime_error(oss.str());
+  }
+  if (track && trk_q_buf == NULL) {
+    if (tp_hdl == NULL) {
+      init_toeplitz_fft();
     }
+    const size_t q_size = static_cast<size_t>(acm_order) * 2 * num_eig;
+    bufs.alloc(trk_q_buf, q_size, "trk_q_buf");
+    bufs.alloc(trk_z_buf, q_size, "trk_z_buf");
+    const size_t h_size = static_cast<size_t>(2 * num_eig) * 2 * num_eig;
+    bufs.alloc(trk_h_buf, h_size, "trk_h_buf");
+    const size_t y_size = static_cast<size_t>(acm_order) * num_eig;
+    bufs.alloc(trk_y_buf, y_size, "trk_y_buf");
   }
+  trk_use = track;
+  init_outputs();
+  trk_tol = tol;
+  trk_max_iter = max_iter;
+  trk_valid = false;
+  trk_hit = false;
 }
 
 
-//-----------------------------------------------------------------------------
-// Compute eigenvalues (eval_buf) & eigenvectors (kltb_buf) for ac_buf
-//   WARNING: ac_buf is modified in the process.
-//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
-//   kltc_buf, and kltb_buf to 0.0f.
-//-----------------------------------------------------------------------------
-void KLT::eigendecomp()
+//---------------------------------------------------------------------------
+// Select outputs
+//---------------------------------------------------------------------------
+void KLT::set_outputs(int outputs)
 {
-  static const int major_order = LAPACK_COL_MAJOR;
-  static const char uplo = 'L';
-  int info;
-  info = LAPACKE_chptrd(major_order, uplo, acm_order,
-                        reinterpret_cast<lapack_complex_float*>(ac_buf),
-                        d_buf, e_buf,
-                        reinterpret_cast<lapack_complex_float*>(tau_buf));
-  if (info) {
-    memset(eval_buf, 0, num_eig*sizeof(float));
-    memset(kltb_buf, 0, num_eig*acm_order*sizeof(std::complex<float>));
+  if (outputs == 0 || (outputs & ~(OUT_ALL | OUT_KLTS))) {
+    std::ostringstream oss;
+    oss << "Invalid output mask " << outputs;
+    throw std::runtime_error(oss.str());
+  }
+  out_mask = outputs;
+  init_outputs();
+}
+
+
+//---------------------------------------------------------------------------
+// Adaptive model order
+//---------------------------------------------------------------------------
+void KLT::set_model_order(OrderRule rule, float energy_frac)
+{
+  if (rule == ORDER_ENERGY && !(energy_frac > 0.0f && energy_frac <= 1.0f)) {
+    std::ostringstream oss;
+    oss << "Invalid model order energy fraction " << energy_frac;
+    throw std::runtime_error(oss.str());
+  }
+  if ((rule == ORDER_MDL || rule == ORDER_AIC) && mo_buf == NULL) {
+    bufs.alloc(mo_buf, acm_order, "mo_buf");
+  }
+  mo_rule = rule;
+  mo_energy = energy_frac;
+  // Tracked subspace (all num_eig vectors) is not kept by adaptive rules
+  trk_valid = false;
+}
+
+
+//---------------------------------------------------------------------------
+// Overlap-add reconstruction
+//---------------------------------------------------------------------------
+void KLT::set_recon(int out_len)
+{
+  KLTRecon* next = out_len ? new KLTRecon(acm_order, num_eig, out_len) : NULL;
+  delete recon;
+  recon = next;
+  recon_buf = recon ? recon->out_buf : NULL;
+  init_outputs();
+}
+
+int KLT::recon_len() const
+{
+  return recon ? recon->out_len : 0;
+}
+
+int KLT::recon_flush()
+{
+  return recon ? recon->flush() : 0;
+}
+
+
+//---------------------------------------------------------------------------
+// Size kltb_buf and klts_buf for the selected outputs (kltb_buf, always
+// reserved in the arena, is NULL unless eigenvectors are needed; klts_buf
+// is allocated only for OUT_KLTS)
+//   If an error occurrs, throws std::runtime_error.
+//---------------------------------------------------------------------------
+void KLT::init_outputs()
+{
+  if ((out_mask & OUT_KLTS) && klts_buf == NULL) {
+    const size_t klts_size = static_cast<size_t>(num_eig) * proj_len();
+    bufs.alloc(klts_buf, klts_size, "klts_buf");
+    sp_use = proj_fft_cost(fft_good_len(in_len), num_eig) <
+      proj_direct_cost(in_len, acm_order, num_eig);
+    if (sp_use && sp_hdl == NULL) {
+      init_proj_fft();
+    }
+  } else if (!(out_mask & OUT_KLTS) && klts_buf != NULL) {
+    bufs.release(klts_buf);
+  }
+  kltb_buf = vectors() ? arena.ptr<std::complex<float> >(kltb_off) : NULL;
+}
+
+
+//---------------------------------------------------------------------------
+// Set all of eval_buf, kltc_buf, and kltb_buf to 0.0f (error path)
+//---------------------------------------------------------------------------
+void KLT::clear_outputs()
+{
+  memset(eval_buf, 0, num_eig*sizeof(float));
+  memset(kltc_buf, 0, num_eig*sizeof(std::complex<float>));
+  if (kltb_buf != NULL) {
+    memset(kltb_buf, 0, num_eig*acm_order*sizeof(std::complex<float>));
+  }
+  if (klts_buf != NULL) {
+    memset(klts_buf, 0, num_eig*proj_len()*sizeof(std::complex<float>));
+  }
+  mo_order = 0;
+}
+
+
+//---------------------------------------------------------------------------
+// Transform in_buf
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//---------------------------------------------------------------------------
+void KLT::transform()
+{
+  transform(in_buf);
+}
+
+
+//---------------------------------------------------------------------------
+// Transform in (size in_len)
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//---------------------------------------------------------------------------
+void KLT::transform(const std::complex<float>* in)
+{
+  KLT_STATS_SCOPE(KLT_STAGE_TOTAL);
+  window_frame(in);
+  transform_staged();
+}
+
+
+//---------------------------------------------------------------------------
+// Transform complex integer in (in_len I/Q pairs) times scale
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//---------------------------------------------------------------------------
+void KLT::transform(const int16_t* in, float scale)
+{
+  KLT_STATS_SCOPE(KLT_STAGE_TOTAL);
+  convert_frame(in, scale);
+  transform_staged();
+}
+
+void KLT::transform(const int8_t* in, float scale)
+{
+  KLT_STATS_SCOPE(KLT_STAGE_TOTAL);
+  convert_frame(in, scale);
+  transform_staged();
+}
+
+
+//---------------------------------------------------------------------------
+// Transform the staged frame (see window_frame(), convert_frame())
+//---------------------------------------------------------------------------
+void KLT::transform_staged()
+{
+  KLT_STATS_COUNT(KLT_COUNT_FRAMES);
+  try {
+    transform_frame();
+  } catch (std::runtime_error&) {
+    KLT_STATS_COUNT(KLT_COUNT_FAILURES);
+    // Keep the reconstruction in step (kltb_buf was zeroed)
+    if (recon != NULL) {
+      recon->add(kltb_buf);
+    }
+    throw;
+  }
+  if (recon != NULL) {
+    KLT_STATS_SCOPE(KLT_STAGE_RECON);
+    recon->add(kltb_buf);
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Transform the staged frame, see transform()
+//---------------------------------------------------------------------------
+void KLT::transform_frame()
+{
+  mo_order = num_eig;
+  if (small_kernel()) {
+    // Specialized kernel (lags, eigendecomp, coeffs, weighting)
+    bool ok;
+    {
+      KLT_STATS_SCOPE(KLT_STAGE_SMALL);
+      ok = small_fn(frame, in_len, eval_buf, kltc_buf, vectors() ? kltb_buf : NULL,
+                    (out_mask & OUT_KLTB) || recon != NULL);
+    }
+    if (!ok) {
+      clear_outputs();
+      throw std::runtime_error("Small-order KLT kernel failed");
+    }
+  } else {
+    // Auto-corr (or snapshot covariance) matrix
+    {
+      KLT_STATS_SCOPE(KLT_STAGE_ACORR);
+      if (sc_use) {
+        snapshot_cov();
+      } else {
+        acorr_matrix();
+      }
+    }
+    // Eigendecomp
+    eigendecomp();
+    // Eigenvalues from the double lags
+    if (mp_refine) {
+      KLT_STATS_SCOPE(KLT_STAGE_REFINE);
+      refine_evals();
+    }
+    KLT_STATS_SCOPE(KLT_STAGE_PROJECT);
+    if (ph_use && vectors()) {
+      canonicalize_phase();
+    }
+    // Compute KLT coeffs
+    if ((out_mask & (OUT_KLTC | OUT_KLTB)) || recon != NULL) {
+      for (int cidx=0; cidx<num_eig; cidx++) {
+        kltc_buf[cidx] = klt_cdotc(frame_head, &kltb_buf[cidx*acm_order], acm_order);
+      }
+    }
+    // Sliding KLT coeffs (from the unweighted eigenvectors)
+    if (out_mask & OUT_KLTS) {
+      project_sliding();
+    }
+    // Apply coeffs to KLT basis funcions
+    if ((out_mask & OUT_KLTB) || recon != NULL) {
+      for (int cidx=0; cidx<num_eig; cidx++) {
+        klt_cscal(&kltb_buf[cidx*acm_order], kltc_buf[cidx], acm_order);
+      }
+    }
+  }
+#if KLT_SUPPORT_EVALN
+  // Normalize eigenvalues?
+  if (eval_normalized) {
+    float max_eval = 0.0f;
+    for (int eidx=0; eidx<num_eig; eidx++) {
+      max_eval = std::max(eval_buf[eidx], max_eval);
+    }
+    const float inv_max_eval = 1.0f / max_eval;
+    for (int eidx=0; eidx<num_eig; eidx++) {
+      eval_buf[eidx] *= inv_max_eval;
+    }
+  }
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Auto-correlation lags (ac_buf[0..acm_order))
+//-----------------------------------------------------------------------------
+void KLT::acorr_matrix()
+{
+  if (stream_clen > 0) {
+    acorr_lags_stream();
+  } else if (acfft_use) {
+    acorr_lags_fft();
+  } else {
+    acorr_lags_direct();
+  }
+  // Mixed precision: the eigensolve gets the double lags rounded once
+  if (mp_use) {
+    for (int aidx=0; aidx < acm_order; aidx++) {
+      ac_buf[aidx] = std::complex<float>(mp_ac_buf[aidx]);
+    }
+  }
+#if KLT_DEBUG & KLT_DEBUG_VERBOSE
+  std::cout<<"ac: ";
+  for (int aidx=0; aidx < acm_order; aidx++) {
+    std::cout<<ac_buf[aidx]<<"  ";
+  }
+  std::cout<<std::endl;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Expand lags (ac_buf[0..acm_order)) in-place into the Toeplitz matrix
+// (lower triangular packed, col major order)
+//-----------------------------------------------------------------------------
+void KLT::toeplitz_pack()
+{
+  int aoidx = acm_order;
+  for (int col_len = acm_order-1; col_len > 0; col_len--) {
+    for (int aiidx = 0; aiidx < col_len; aiidx++) {
+      ac_buf[aoidx++] = ac_buf[aiidx];
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Snapshot covariance (sc_acc_buf, and its forward-backward average in
+// sc_fb_buf)
+//   Snapshot s is frame[s..s+acm_order).  They overlap (stride 1 < lda), so
+//   each block is gathered (and windowed) into sc_snap_buf for one rank-k
+//   update.  The
+//   previous covariance decays by sc_forget; in stream mode only the
+//   snapshots new to the frame are added to it.
+//-----------------------------------------------------------------------------
+void KLT::snapshot_cov()
+{
+  const int num_snap = proj_len();
+  int first = 0;
+  float beta = 0.0f;
+  if (sc_valid && sc_forget > 0.0f) {
+    beta = sc_forget;
+    if (stream_clen > 0) {
+      first = std::max(num_snap - stream_clen, 0);
+    }
+  }
+  for (int sidx=first; sidx < num_snap; sidx += COV_SNAP_BLOCK) {
+    const int blk_len = std::min(COV_SNAP_BLOCK, num_snap - sidx);
+    for (int bidx=0; bidx < blk_len; bidx++) {
+      std::complex<float>* snap = &sc_snap_buf[bidx*acm_order];
+      const int tidx0 = sidx + bidx;
+      if (frame_win != NULL) {
+        for (int tidx=0; tidx < acm_order; tidx++) {
+          snap[tidx] = frame[tidx0 + tidx] * frame_win[tidx0 + tidx];
+        }
+      } else {
+        memcpy(snap, &frame[tidx0], acm_order*sizeof(std::complex<float>));
+      }
+    }
+    cblas_cherk(CblasColMajor, CblasLower, CblasNoTrans, acm_order, blk_len,
+                1.0f, sc_snap_buf, acm_order, beta, sc_acc_buf, acm_order);
+    beta = 1.0f;
+  }
+  sc_valid = true;
+  // R_fb(i,j) = (R(i,j) + conj(R(n-1-i,n-1-j))) / 2, and the conjugated
+  // upper element is R(n-1-j,n-1-i), also in the lower triangle
+  if (sc_fb) {
+    const int last = acm_order - 1;
+    for (int cidx=0; cidx < acm_order; cidx++) {
+      for (int ridx=cidx; ridx < acm_order; ridx++) {
+        sc_fb_buf[cidx*acm_order+ridx] = 0.5f * (sc_acc_buf[cidx*acm_order+ridx] +
+                                                 sc_acc_buf[(last-ridx)*acm_order+last-cidx]);
+      }
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Copy the snapshot covariance into ac_buf (lower triangular packed, col
+// major order, see init_packed())
+//-----------------------------------------------------------------------------
+void KLT::cov_pack()
+{
+  const std::complex<float>* mat = sc_fb ? sc_fb_buf : sc_acc_buf;
+  int aoidx = 0;
+  for (int cidx=0; cidx < acm_order; cidx++) {
+    memcpy(&ac_buf[aoidx], &mat[cidx*acm_order+cidx],
+           (acm_order-cidx)*sizeof(std::complex<float>));
+    aoidx += acm_order - cidx;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// y = R x for the covariance R the eigensolvers work on: the Toeplitz matrix
+// of the lags (see toeplitz_matvec()) or the full snapshot covariance
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//-----------------------------------------------------------------------------
+void KLT::cov_matvec(const std::complex<float>* x, std::complex<float>* y)
+{
+  if (!sc_use) {
+    toeplitz_matvec(x, y);
+    return;
+  }
+  static const std::complex<float> one(1.0f, 0.0f);
+  static const std::complex<float> zero(0.0f, 0.0f);
+  cblas_chemv(CblasColMajor, CblasLower, acm_order, &one, sc_fb ? sc_fb_buf : sc_acc_buf,
+              acm_order, x, 1, &zero, y, 1);
+}
+
+
+//-----------------------------------------------------------------------------
+// Trace of the covariance the eigensolvers work on (see cov_matvec())
+//-----------------------------------------------------------------------------
+double KLT::cov_trace() const
+{
+  if (!sc_use) {
+    return static_cast<double>(acm_order) * std::real(ac_buf[0]);
+  }
+  const std::complex<float>* cov = sc_fb ? sc_fb_buf : sc_acc_buf;
+  double trace = 0.0;
+  for (int tidx=0; tidx < acm_order; tidx++) {
+    trace += std::real(cov[tidx*acm_order + tidx]);
+  }
+  return trace;
+}
+
+
+//-----------------------------------------------------------------------------
+// Auto-correlation lags (ac_buf[0..acm_order), mp_ac_buf with PREC_MIXED),
+// direct sums
+//-----------------------------------------------------------------------------
+void KLT::acorr_lags_direct()
+{
+  if (mp_use) {
+    for (int aidx=0; aidx < acm_order; aidx++) {
+      mp_ac_buf[aidx] = klt_cdotc_d(&frame[aidx], frame, in_len - aidx);
+    }
+    return;
+  }
+  for (int aidx=0; aidx < acm_order; aidx++) {
+    ac_buf[aidx] = klt_cdotc(&frame[aidx], frame, in_len - aidx);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Auto-correlation lags (ac_buf[0..acm_order), mp_ac_buf with PREC_MIXED),
+// via FFT
+//   acfft_len >= in_len + acm_order - 1, so the circular correlation of the
+//   zero-padded input equals the linear one for all lags < acm_order.
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//-----------------------------------------------------------------------------
+void KLT::acorr_lags_fft()
+{
+  if (mp_use) {
+    for (int tidx=0; tidx < in_len; tidx++) {
+      mp_fft_buf[tidx] = std::complex<double>(frame_win != NULL ?
+                                              frame[tidx] * frame_win[tidx] : frame[tidx]);
+    }
+    memset(&mp_fft_buf[in_len], 0, (acfft_len - in_len)*sizeof(std::complex<double>));
+    MKL_LONG status = DftiComputeForward(mp_fft_hdl, mp_fft_buf);
+    if (status == DFTI_NO_ERROR) {
+      for (int fidx=0; fidx < acfft_len; fidx++) {
+        mp_fft_buf[fidx] = std::complex<double>(std::norm(mp_fft_buf[fidx]), 0.0);
+      }
+      status = DftiComputeBackward(mp_fft_hdl, mp_fft_buf);
+    }
+    if (status != DFTI_NO_ERROR) {
+      clear_outputs();
+      std::ostringstream oss;
+      oss << "acorr FFT failed: " << DftiErrorMessage(status);
+      throw std::runtime_error(oss.str());
+    }
+    memcpy(mp_ac_buf, mp_fft_buf, acm_order*sizeof(std::complex<double>));
+    return;
+  }
+  if (frame_win != NULL) {
+    for (int tidx=0; tidx < in_len; tidx++) {
+      acfft_buf[tidx] = frame[tidx] * frame_win[tidx];
+    }
+  } else {
+    memcpy(acfft_buf, frame, in_len*sizeof(std::complex<float>));
+  }
+  memset(&acfft_buf[in_len], 0, (acfft_len - in_len)*sizeof(std::complex<float>));
+  MKL_LONG status = DftiComputeForward(acfft_hdl, acfft_buf);
+  if (status == DFTI_NO_ERROR) {
+    // Power spectrum
+    for (int fidx=0; fidx < acfft_len; fidx++) {
+      acfft_buf[fidx] = std::complex<float>(std::norm(acfft_buf[fidx]), 0.0f);
+    }
+    status = DftiComputeBackward(acfft_hdl, acfft_buf);
+  }
+  if (status != DFTI_NO_ERROR) {
+    clear_outputs();
+    std::ostringstream oss;
+    oss << "acorr FFT failed: " << DftiErrorMessage(status);
+    throw std::runtime_error(oss.str());
+  }
+  memcpy(ac_buf, acfft_buf, acm_order*sizeof(std::complex<float>));
+}
+
+
+//-----------------------------------------------------------------------------
+// Auto-correlation lags (ac_buf[0..acm_order)), streaming update
+//   frame[0..in_len-in_clen) is the previous frame (hist_buf) shifted left by
+//   in_clen.  Lag products whose earlier sample left the frame are
+//   subtracted, those whose later sample entered it are added.  Every
+//   stream_resync frames the lags are recomputed from scratch.
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//-----------------------------------------------------------------------------
+void KLT::acorr_lags_stream()
+{
+  if (stream_frame == 0) {
+    if (acfft_use) {
+      acorr_lags_fft();
+    } else {
+      acorr_lags_direct();
+    }
+    if (mp_use) {
+      memcpy(mp_lag_buf, mp_ac_buf, acm_order*sizeof(std::complex<double>));
+    } else {
+      memcpy(lag_buf, ac_buf, acm_order*sizeof(std::complex<float>));
+    }
+  } else if (mp_use) {
+    const int new_idx = in_len - stream_clen;
+    for (int aidx=0; aidx < acm_order; aidx++) {
+      const int num_old = std::min(stream_clen, in_len - aidx);
+      const int w1idx = std::max(new_idx, aidx);
+      mp_lag_buf[aidx] += klt_cdotc_d(&frame[w1idx], &frame[w1idx - aidx], in_len - w1idx) -
+        klt_cdotc_d(&hist_buf[aidx], hist_buf, num_old);
+    }
+    memcpy(mp_ac_buf, mp_lag_buf, acm_order*sizeof(std::complex<double>));
+  } else {
+    const int new_idx = in_len - stream_clen;
+    for (int aidx=0; aidx < acm_order; aidx++) {
+      // Departed: earlier sample in hist_buf[0..in_clen)
+      const int num_old = std::min(stream_clen, in_len - aidx);
+      const std::complex<float> old_sum = klt_cdotc(&hist_buf[aidx], hist_buf, num_old);
+      // Entered: later sample in frame[in_len-in_clen..in_len)
+      const int w1idx = std::max(new_idx, aidx);
+      const std::complex<float> new_sum =
+        klt_cdotc(&frame[w1idx], &frame[w1idx - aidx], in_len - w1idx);
+      lag_buf[aidx] += new_sum - old_sum;
+    }
+    memcpy(ac_buf, lag_buf, acm_order*sizeof(std::complex<float>));
+  }
+  memcpy(hist_buf, frame, hist_len*sizeof(std::complex<float>));
+  if (++stream_frame >= stream_resync) {
+    stream_frame = 0;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Plan FFT auto-correlation (acfft_buf, acfft_hdl)
+//   If an error occurrs, throws std::runtime_error.
+//-----------------------------------------------------------------------------
+void KLT::init_acorr_fft()
+{
+  acfft_len = fft_good_len(in_len + acm_order - 1);
+  bufs.alloc(acfft_buf, acfft_len, "acfft_buf");
+  MKL_LONG status = DftiCreateDescriptor(&acfft_hdl, DFTI_SINGLE, DFTI_COMPLEX, 1,
+                                         static_cast<MKL_LONG>(acfft_len));
+  bufs.adopt(acfft_hdl, free_plan);
+  if (status == DFTI_NO_ERROR) {
+    status = DftiSetValue(acfft_hdl, DFTI_BACKWARD_SCALE, 1.0f / acfft_len);
+  }
+  if (status == DFTI_NO_ERROR) {
+    status = DftiCommitDescriptor(acfft_hdl);
+  }
+  if (status != DFTI_NO_ERROR) {
+    bufs.release(acfft_hdl);
+    std::ostringstream oss;
+    oss << "Failed to plan acorr FFT (size " << acfft_len << "): "
+        << DftiErrorMessage(status);
+    throw std::runtime_error(oss.str());
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Plan PREC_MIXED FFT auto-correlation (mp_fft_buf, mp_fft_hdl), same length
+// as the single-precision one
+//   If an error occurrs, throws std::runtime_error.
+//-----------------------------------------------------------------------------
+void KLT::init_mixed_fft()
+{
+  bufs.alloc(mp_fft_buf, acfft_len, "mp_fft_buf");
+  MKL_LONG status = DftiCreateDescriptor(&mp_fft_hdl, DFTI_DOUBLE, DFTI_COMPLEX, 1,
+                                         static_cast<MKL_LONG>(acfft_len));
+  bufs.adopt(mp_fft_hdl, free_plan);
+  if (status == DFTI_NO_ERROR) {
+    status = DftiSetValue(mp_fft_hdl, DFTI_BACKWARD_SCALE, 1.0 / acfft_len);
+  }
+  if (status == DFTI_NO_ERROR) {
+    status = DftiCommitDescriptor(mp_fft_hdl);
+  }
+  if (status != DFTI_NO_ERROR) {
+    bufs.release(mp_fft_hdl);
+    std::ostringstream oss;
+    oss << "Failed to plan mixed precision acorr FFT (size " << acfft_len << "): "
+        << DftiErrorMessage(status);
+    throw std::runtime_error(oss.str());
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Refine eval_buf to the Rayleigh quotients of the eigenvectors (kltb_buf,
+// unweighted) on the Toeplitz matrix T of the double lags (mp_ac_buf):
+//   v^H T v = r[0] |v|^2 + 2 Re(sum_k r[k] a[k]),
+//   a[k] = sum_i v[i] conj(v[i+k]), k = 1..acm_order-1
+// Components left out by the model order (zero columns) keep their eigenvalue.
+//-----------------------------------------------------------------------------
+void KLT::refine_evals()
+{
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    const std::complex<float>* vec = &kltb_buf[eidx*acm_order];
+    const double norm = klt_cdotc_d(vec, vec, acm_order).real();
+    if (!(norm > 0.0)) {
+      continue;
+    }
+    double quad = mp_ac_buf[0].real() * norm;
+    for (int aidx=1; aidx < acm_order; aidx++) {
+      quad += 2.0 * (mp_ac_buf[aidx] * klt_cdotc_d(vec, &vec[aidx], acm_order - aidx)).real();
+    }
+    eval_buf[eidx] = static_cast<float>(quad / norm);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Rotate each eigenvector (kltb_buf, unweighted) so that its pivot is real
+// and positive: the first component, or the largest if the first is below
+// PHASE_TOL (the vectors have unit norm).  Zero columns (left out by the
+// model order) stay zero.
+//-----------------------------------------------------------------------------
+void KLT::canonicalize_phase()
+{
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    std::complex<float>* vec = &kltb_buf[eidx*acm_order];
+    int pivot = 0;
+    if (std::norm(vec[0]) < PHASE_TOL * PHASE_TOL) {
+      for (int vidx=1; vidx < acm_order; vidx++) {
+        if (std::norm(vec[vidx]) > std::norm(vec[pivot])) {
+          pivot = vidx;
+        }
+      }
+    }
+    const float mag = std::abs(vec[pivot]);
+    if (!(mag > 0.0f)) {
+      continue;
+    }
+    klt_cscal(vec, std::conj(vec[pivot]) / mag, acm_order);
+    vec[pivot] = std::complex<float>(mag, 0.0f);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Compute eigenvalues (eval_buf) & eigenvectors (kltb_buf) for the Toeplitz
+// matrix of the lags in ac_buf (or the snapshot covariance, see
+// set_covariance())
+//   WARNING: ac_buf is modified in the process.
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//-----------------------------------------------------------------------------
+void KLT::eigendecomp()
+{
+  // Warm start from the previous frame, else cold solve (adaptive order
+  // needs the LAPACK path's spectrum)
+  const bool fixed = mo_rule == ORDER_FIXED;
+  trk_hit = fixed && trk_use && trk_valid && eigendecomp_track();
+  trk_valid = false;
+  if (trk_hit) {
+    KLT_STATS_COUNT(KLT_COUNT_TRACK_HITS);
+  }
+  if (!trk_hit && (!fixed || !lz_use || !eigendecomp_lanczos())) {
+    if (fixed && lz_use) {
+      KLT_STATS_COUNT(KLT_COUNT_LAPACK_FALLBACKS);
+    }
+    // Lanczos did not converge: the packed matrix is allocated on first use
+    init_packed();
+    if (sc_use) {
+      cov_pack();
+    } else {
+      toeplitz_pack();
+    }
+    eigendecomp_lapack();
+  }
+  if (fixed && trk_use) {
+    memcpy(trk_q_buf, kltb_buf, num_eig*acm_order*sizeof(std::complex<float>));
+    trk_valid = true;
+  }
+#if KLT_DEBUG & KLT_DEBUG_VERBOSE
+  std::cout<<"eval: ";
+  for (int eidx=0; eidx<num_eig; eidx++) {
+    std::cout<<eval_buf[eidx]<<",  ";
+  }
+  std::cout<<std::endl;
+  for (int vidx=0; vidx<num_eig && vectors(); vidx++) {
+    std::cout<<"evec["<<vidx<<"]: ";
+    for (int tidx=0; tidx<acm_order; tidx++) {
+      std::cout<<kltb_buf[vidx*acm_order+tidx]<<",  ";
+    }
+    std::cout<<std::endl;
+  }
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// LAPACK eigendecomp of the packed Toeplitz matrix in ac_buf
+//   WARNING: ac_buf is modified in the process.
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//-----------------------------------------------------------------------------
+void KLT::eigendecomp_lapack()
+{
+  static const int major_order = LAPACK_COL_MAJOR;
+  static const char uplo = 'L';
+  int info;
+  {
+    KLT_STATS_SCOPE(KLT_STAGE_CHPTRD);
+    info = LAPACKE_chptrd(major_order, uplo, acm_order,
+                          reinterpret_cast<lapack_complex_float*>(ac_buf),
+                          d_buf, e_buf,
+                          reinterpret_cast<lapack_complex_float*>(tau_buf));
+  }
+  if (info) {
+    clear_outputs();
     std::ostringstream oss;
     oss << "LAPACKE_chptrd() failed, info=" << info;
     throw std::runtime_error(oss.str());
@@ -361,9 +1342,68 @@ void KLT::eigendecomp()
     const int iu = acm_order;
     int num_eig_found;
     int nsplit;
-    info = LAPACKE_sstebz(range, order, acm_order, vl, vu, il, iu, abstol,
-                          d_buf, e_buf, &num_eig_found, &nsplit, eval_buf,
-                          ib_buf, is_buf);
+    // Model order from the full spectrum (ascending)
+    if (mo_rule == ORDER_MDL || mo_rule == ORDER_AIC) {
+      {
+        KLT_STATS_SCOPE(KLT_STAGE_STEBZ);
+        info = LAPACKE_sstebz('A', 'E', acm_order, vl, vu, 0, 0, abstol,
+                              d_buf, e_buf, &num_eig_found, &nsplit, mo_buf,
+                              ib_buf, is_buf);
+      }
+      if (info) {
+        clear_outputs();
+        std::ostringstream oss;
+        oss << "LAPACKE_sstebz() failed, info=" << info;
+        throw std::runtime_error(oss.str());
+      }
+      // Samples behind the estimate: the frame for the Toeplitz lags, the
+      // overlapping snapshots for the sample covariance
+      const int num_snap = sc_use ? proj_len() : in_len;
+      mo_order = order_info_criterion(mo_buf, num_eig_found, num_snap,
+                                      std::min(num_eig, num_eig_found - 1),
+                                      mo_rule == ORDER_AIC);
+    }
+    {
+      KLT_STATS_SCOPE(KLT_STAGE_STEBZ);
+      info = LAPACKE_sstebz(range, order, acm_order, vl, vu, il, iu, abstol,
+                            d_buf, e_buf, &num_eig_found, &nsplit, eval_buf,
+                            ib_buf, is_buf);
+      // Not all of il..iu found: a cluster of nearly equal eigenvalues (an
+      // impulse's, with FFT lags, say) can defeat the Sturm counts at the
+      // boundary.  LAPACK's cure: solve them all and pick the top ones.
+      if (info == 2 || info == 3) {
+        info = LAPACKE_sstebz('A', order, acm_order, vl, vu, 0, 0, abstol,
+                              d_buf, e_buf, &num_eig_found, &nsplit, eval_buf,
+                              ib_buf, is_buf);
+        if (!info) {
+          sort_eigen(eval_buf, ib_buf, NULL, acm_order, num_eig_found, false);
+          const int num_drop = std::max(num_eig_found - num_eig, 0);
+          num_eig_found -= num_drop;
+          memmove(eval_buf, &eval_buf[num_drop], num_eig_found*sizeof(float));
+          memmove(ib_buf, &ib_buf[num_drop], num_eig_found*sizeof(int));
+        }
+      }
+    }
+    // sstebz only sorts within each split-off block: sort them all, so the
+    // top eigenvalues are the last ones
+    if (!info && nsplit != 1) {
+      sort_eigen(eval_buf, ib_buf, NULL, acm_order, num_eig_found, false);
+    }
+    if (!info && mo_rule == ORDER_ENERGY) {
+      double trace = 0.0;
+      for (int didx=0; didx < acm_order; didx++) {
+        trace += d_buf[didx];
+      }
+      mo_order = order_energy(eval_buf, num_eig_found, trace, mo_energy);
+    }
+#if KLT_SUPPORT_STATS
+    if (!info && nsplit != 1) {
+      KLT_STATS_COUNT(KLT_COUNT_NSPLIT);
+    }
+    if (!info && num_eig_found != num_eig) {
+      KLT_STATS_COUNT(KLT_COUNT_EIG_MISSING);
+    }
+#endif
 #if KLT_DEBUG & KLT_DEBUG_FINE
     if (nsplit != 1) {
       std::cout<<" WARNING: nsplit="<<nsplit<<std::endl;
@@ -373,102 +1413,680 @@ void KLT::eigendecomp()
     }
 #endif
     if (info) {
-      memset(eval_buf, 0, num_eig*sizeof(float));
-      memset(kltb_buf, 0, num_eig*acm_order*sizeof(std::complex<float>));
+      clear_outputs();
       std::ostringstream oss;
       oss << "LAPACKE_sstebz() failed, info=" << info;
       throw std::runtime_error(oss.str());
-    } else {
-      info = LAPACKE_cstein(major_order, acm_order, d_buf, e_buf, num_eig_found, eval_buf,
-                            ib_buf, is_buf,
-                            reinterpret_cast<lapack_complex_float*>(kltb_buf),
-                            acm_order, if_buf);
+    } else if (vectors()) {
+      // Eigenvectors of the top num_vec only (the last ones), the columns
+      // of the components left out are 0.0f
+      const int num_vec = std::min(mo_order, num_eig_found);
+      const int vec_idx = num_eig_found - num_vec;
+      std::complex<float>* vec_buf = &kltb_buf[vec_idx*acm_order];
+      memset(kltb_buf, 0, vec_idx*acm_order*sizeof(std::complex<float>));
+      if (num_vec == 0) {
+        return;
+      }
+      // cstein takes them grouped by block (ascending in each), the
+      // eigenvectors are put back in ascending order below
+      if (nsplit != 1) {
+        sort_eigen(&eval_buf[vec_idx], &ib_buf[vec_idx], NULL, acm_order, num_vec, true);
+      }
+      {
+        KLT_STATS_SCOPE(KLT_STAGE_STEIN);
+        info = LAPACKE_cstein(major_order, acm_order, d_buf, e_buf, num_vec,
+                              &eval_buf[vec_idx], &ib_buf[vec_idx], is_buf,
+                              reinterpret_cast<lapack_complex_float*>(vec_buf),
+                              acm_order, if_buf);
+      }
       if (info) {
-        memset(eval_buf, 0, num_eig*sizeof(float));
-        memset(kltb_buf, 0, num_eig*acm_order*sizeof(std::complex<float>));
+        clear_outputs();
         std::ostringstream oss;
         oss << "LAPACKE_cstein() failed, info=" << info;
         throw std::runtime_error(oss.str());
       } else {
         static const char side = 'L';
         static const char trans = 'N';
-        info = LAPACKE_cupmtr(major_order, side, uplo, trans, acm_order, num_eig_found,
-                              reinterpret_cast<lapack_complex_float*>(ac_buf),
-                              reinterpret_cast<lapack_complex_float*>(tau_buf),
-                              reinterpret_cast<lapack_complex_float*>(kltb_buf),
-                              acm_order);
+        {
+          KLT_STATS_SCOPE(KLT_STAGE_UPMTR);
+          info = LAPACKE_cupmtr(major_order, side, uplo, trans, acm_order, num_vec,
+                                reinterpret_cast<lapack_complex_float*>(ac_buf),
+                                reinterpret_cast<lapack_complex_float*>(tau_buf),
+                                reinterpret_cast<lapack_complex_float*>(vec_buf),
+                                acm_order);
+        }
         if (info) {
-          memset(eval_buf, 0, num_eig*sizeof(float));
-          memset(kltb_buf, 0, num_eig*acm_order*sizeof(std::complex<float>));
+          clear_outputs();
           std::ostringstream oss;
           oss << "LAPACKE_cupmtr() failed, info=" << info;
           throw std::runtime_error(oss.str());
         }
+        if (nsplit != 1) {
+          sort_eigen(&eval_buf[vec_idx], &ib_buf[vec_idx], vec_buf, acm_order, num_vec, false);
+        }
       }
     }
   }
-#if KLT_DEBUG & KLT_DEBUG_VERBOSE
-  std::cout<<"eval: ";
-  for (int eidx=0; eidx<num_eig; eidx++) {
-    std::cout<<eval_buf[eidx]<<",  ";
+}
+
+
+//-----------------------------------------------------------------------------
+// Circulant embedding spectrum (tp_c_buf) of the Toeplitz matrix of the lags
+// in ac_buf: first column r[0..n), 0..., conj(r[n-1..1])
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//-----------------------------------------------------------------------------
+void KLT::toeplitz_spectrum()
+{
+  tp_c_buf[0] = ac_buf[0];
+  for (int aidx=1; aidx < acm_order; aidx++) {
+    tp_c_buf[aidx] = ac_buf[aidx];
+    tp_c_buf[tp_len - aidx] = std::conj(ac_buf[aidx]);
   }
-  std::cout<<std::endl;
-  for (int vidx=0; vidx<num_eig; vidx++) {
-    std::cout<<"evec["<<vidx<<"]: ";
-    for (int tidx=0; tidx<acm_order; tidx++) {
-      std::cout<<kltb_buf[vidx*acm_order+tidx]<<",  ";
+  memset(&tp_c_buf[acm_order], 0, (tp_len - 2*acm_order + 1)*sizeof(std::complex<float>));
+  MKL_LONG status = DftiComputeForward(tp_hdl, tp_c_buf);
+  if (status != DFTI_NO_ERROR) {
+    clear_outputs();
+    std::ostringstream oss;
+    oss << "Toeplitz spectrum FFT failed: " << DftiErrorMessage(status);
+    throw std::runtime_error(oss.str());
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// y = T x for the Hermitian Toeplitz matrix T of the lags, via its circulant
+// embedding (tp_c_buf holds the embedding spectrum)
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//-----------------------------------------------------------------------------
+void KLT::toeplitz_matvec(const std::complex<float>* x, std::complex<float>* y)
+{
+  memcpy(tp_w_buf, x, acm_order*sizeof(std::complex<float>));
+  memset(&tp_w_buf[acm_order], 0, (tp_len - acm_order)*sizeof(std::complex<float>));
+  MKL_LONG status = DftiComputeForward(tp_hdl, tp_w_buf);
+  if (status == DFTI_NO_ERROR) {
+    for (int fidx=0; fidx < tp_len; fidx++) {
+      tp_w_buf[fidx] *= tp_c_buf[fidx];
     }
-    std::cout<<std::endl;
+    status = DftiComputeBackward(tp_hdl, tp_w_buf);
+  }
+  if (status != DFTI_NO_ERROR) {
+    clear_outputs();
+    std::ostringstream oss;
+    oss << "Toeplitz matvec FFT failed: " << DftiErrorMessage(status);
+    throw std::runtime_error(oss.str());
+  }
+  memcpy(y, tp_w_buf, acm_order*sizeof(std::complex<float>));
+}
+
+
+//-----------------------------------------------------------------------------
+// Lanczos eigendecomp of the Toeplitz matrix of the lags in ac_buf (or of
+// the snapshot covariance)
+//   Only the top num_eig eigenpairs are computed, ac_buf is left untouched.
+//   The tridiagonal projection is kept in d_buf/e_buf and its Ritz pairs are
+//   found with sstebz/sstein.  Returns false (outputs undefined) when the
+//   Ritz pairs do not converge within lz_max steps, or when a breakdown
+//   leaves them unverified (see below).
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//-----------------------------------------------------------------------------
+bool KLT::eigendecomp_lanczos()
+{
+  KLT_STATS_SCOPE(KLT_STAGE_LANCZOS);
+  if (!sc_use) {
+    toeplitz_spectrum();
+  }
+
+  // Start vector: the frame head projects well onto the signal subspace,
+  // but a structured head (a constant frame's, say) can lie in an invariant
+  // subspace that misses top eigenvectors altogether, so as much again of
+  // a fixed pseudo-random vector (the same every frame) is mixed in
+  std::complex<float>* q0 = lz_q_buf;
+  float nrm = 0.0f;
+  uint32_t seed = 1;
+  for (int tidx=0; tidx < acm_order; tidx++) {
+    float re_im[2];
+    for (int ridx=0; ridx < 2; ridx++) {
+      seed = seed * 1664525u + 1013904223u;
+      re_im[ridx] = (seed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+    }
+    q0[tidx] = std::complex<float>(re_im[0], re_im[1]);
+    nrm += std::norm(q0[tidx]);
+  }
+  float head_nrm = 0.0f;
+  for (int tidx=0; tidx < acm_order; tidx++) {
+    head_nrm += std::norm(frame_head[tidx]);
+  }
+  if (head_nrm > 0.0f) {
+    const float head_scale = std::sqrt(nrm / head_nrm);
+    nrm = 0.0f;
+    for (int tidx=0; tidx < acm_order; tidx++) {
+      q0[tidx] += head_scale * frame_head[tidx];
+      nrm += std::norm(q0[tidx]);
+    }
+  }
+  float scale = 1.0f / std::sqrt(nrm);
+  for (int tidx=0; tidx < acm_order; tidx++) {
+    q0[tidx] *= scale;
+  }
+
+  static const char range = 'I';
+  static const char order = 'B';
+  static const float vl = 0.0f;
+  static const float vu = 0.0f;
+  static const float abstol = 0.0f;
+  const float tiny = (sc_use ? std::abs((sc_fb ? sc_fb_buf : sc_acc_buf)[0]) :
+                      std::abs(ac_buf[0])) * 1.0e-7f;
+  int num_steps = 0;
+  bool converged = false;
+  bool invariant = false;
+  float tol = 0.0f;
+  for (int sidx=0; sidx < lz_max && !converged; sidx++) {
+    const std::complex<float>* qj = &lz_q_buf[sidx*acm_order];
+    std::complex<float>* w = &lz_q_buf[(sidx+1)*acm_order];
+    cov_matvec(qj, w);
+    float alpha = 0.0f;
+    for (int tidx=0; tidx < acm_order; tidx++) {
+      alpha += std::real(std::conj(qj[tidx]) * w[tidx]);
+    }
+    d_buf[sidx] = alpha;
+    // Full reorthogonalization against q_0..q_j ("twice is enough"), this
+    // also removes the alpha q_j and beta q_j-1 terms
+    for (int pass=0; pass < 2; pass++) {
+      for (int qidx=0; qidx <= sidx; qidx++) {
+        const std::complex<float>* qi = &lz_q_buf[qidx*acm_order];
+        const std::complex<float> h = klt_cdotc(w, qi, acm_order);
+        for (int tidx=0; tidx < acm_order; tidx++) {
+          w[tidx] -= h * qi[tidx];
+        }
+      }
+    }
+    float beta = 0.0f;
+    for (int tidx=0; tidx < acm_order; tidx++) {
+      beta += std::norm(w[tidx]);
+    }
+    beta = std::sqrt(beta);
+    num_steps = sidx + 1;
+    invariant = !(beta > tiny) && num_steps < acm_order;
+    const bool breakdown = invariant || num_steps == acm_order;
+
+    // Ritz pairs of the projection
+    if (num_steps >= num_eig &&
+        (breakdown || num_steps == lz_max || num_steps % LANCZOS_CHECK == 0)) {
+      const int il = num_steps - num_eig + 1;
+      const int iu = num_steps;
+      int num_eig_found;
+      int nsplit;
+      int info = LAPACKE_sstebz(range, order, num_steps, vl, vu, il, iu, abstol,
+                                d_buf, e_buf, &num_eig_found, &nsplit, eval_buf,
+                                ib_buf, is_buf);
+      if (!info && num_eig_found == num_eig) {
+        info = LAPACKE_sstein(LAPACK_COL_MAJOR, num_steps, d_buf, e_buf,
+                              num_eig_found, eval_buf, ib_buf, is_buf,
+                              lz_s_buf, num_steps, if_buf);
+      }
+      if (!info && num_eig_found == num_eig) {
+        tol = LANCZOS_TOL * std::abs(eval_buf[num_eig-1]);
+        converged = true;
+        for (int eidx=0; eidx < num_eig && converged; eidx++) {
+          const float resid = beta * std::abs(lz_s_buf[eidx*num_steps + num_steps-1]);
+          converged = resid <= tol;
+        }
+      }
+    }
+    if (breakdown) {
+      break;
+    }
+    e_buf[sidx] = beta;
+    scale = 1.0f / beta;
+    for (int tidx=0; tidx < acm_order; tidx++) {
+      w[tidx] *= scale;
+    }
+  }
+#if KLT_DEBUG & KLT_DEBUG_FINE
+  std::cout<<"lanczos: steps="<<num_steps<<" converged="<<converged<<std::endl;
+#endif
+  if (!converged) {
+    return false;
+  }
+
+  // A breakdown before acm_order steps means the start vector lies in an
+  // invariant subspace: its Ritz pairs are exact, but need not be the top
+  // ones (the start vector may miss a top eigenvector altogether).  The
+  // matrix is positive semidefinite, so no eigenvalue outside the subspace
+  // exceeds the trace left over once the subspace's (the sum of d_buf) is
+  // taken out; unless that rules out one above the smallest Ritz value,
+  // LAPACK decides.
+  if (invariant) {
+    double trace = cov_trace();
+    for (int sidx=0; sidx < num_steps; sidx++) {
+      trace -= d_buf[sidx];
+    }
+#if KLT_DEBUG & KLT_DEBUG_FINE
+    std::cout<<"lanczos: invariant subspace, trace left="<<trace<<std::endl;
+#endif
+    if (trace > eval_buf[0] + tol) {
+      return false;
+    }
+  }
+  if (!vectors()) {
+    return true;
   }
+
+  // Ritz vectors (basis x projection eigenvectors)
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    std::complex<float>* v = &kltb_buf[eidx*acm_order];
+    const float* s = &lz_s_buf[eidx*num_steps];
+    for (int tidx=0; tidx < acm_order; tidx++) {
+      v[tidx] = std::complex<float>(0.0f, 0.0f);
+    }
+    for (int qidx=0; qidx < num_steps; qidx++) {
+      const std::complex<float>* qi = &lz_q_buf[qidx*acm_order];
+      for (int tidx=0; tidx < acm_order; tidx++) {
+        v[tidx] += s[qidx] * qi[tidx];
+      }
+    }
+  }
+
+  // After a breakdown, check the Ritz pairs' true residuals ||T v - theta v||
+  // too (the estimate above assumes an orthogonal basis); the basis column
+  // past the last step is free for T v
+  if (invariant) {
+    std::complex<float>* w = &lz_q_buf[num_steps*acm_order];
+    for (int eidx=0; eidx < num_eig; eidx++) {
+      const std::complex<float>* v = &kltb_buf[eidx*acm_order];
+      cov_matvec(v, w);
+      float resid = 0.0f;
+      for (int tidx=0; tidx < acm_order; tidx++) {
+        resid += std::norm(w[tidx] - eval_buf[eidx] * v[tidx]);
+      }
+      if (std::sqrt(resid) > tol) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Warm-started eigendecomp, seeded with the previous frame's eigenvectors
+// (trk_q_buf[0..num_eig))
+//   Block Rayleigh-Ritz on span[V, T V]: each step appends the part of T V
+//   orthogonal to V (num_eig matvecs), projects T onto the combined
+//   basis and keeps its top num_eig Ritz pairs as the next V.  Since T V is
+//   carried along, the Ritz residuals T v - theta v come for free; when all
+//   are within trk_tol the Ritz pairs are the result.  Returns false (outputs
+//   undefined) when not converged within trk_max_iter steps.
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//-----------------------------------------------------------------------------
+bool KLT::eigendecomp_track()
+{
+  KLT_STATS_SCOPE(KLT_STAGE_TRACK);
+  if (!sc_use) {
+    toeplitz_spectrum();
+  }
+  // V = orth(previous eigenvectors), Z = T V
+  if (orthonormalize(trk_q_buf, acm_order, 0, num_eig) < num_eig) {
+    return false;
+  }
+  for (int qidx=0; qidx < num_eig; qidx++) {
+    cov_matvec(&trk_q_buf[qidx*acm_order], &trk_z_buf[qidx*acm_order]);
+  }
+  for (int iter=0; iter < trk_max_iter; iter++) {
+    // Expand basis with T V (orthonormalized against V), Z = T Q
+    memcpy(&trk_q_buf[num_eig*acm_order], trk_z_buf,
+           num_eig*acm_order*sizeof(std::complex<float>));
+    const int num_vec = num_eig +
+      orthonormalize(trk_q_buf, acm_order, num_eig, num_eig);
+    for (int qidx=num_eig; qidx < num_vec; qidx++) {
+      cov_matvec(&trk_q_buf[qidx*acm_order], &trk_z_buf[qidx*acm_order]);
+    }
+    // H = Q^H Z (lower triangle, col major)
+    for (int cidx=0; cidx < num_vec; cidx++) {
+      const std::complex<float>* z = &trk_z_buf[cidx*acm_order];
+      for (int ridx=cidx; ridx < num_vec; ridx++) {
+        const std::complex<float>* q = &trk_q_buf[ridx*acm_order];
+        trk_h_buf[cidx*num_vec+ridx] = klt_cdotc(z, q, acm_order);
+      }
+    }
+    // Ritz values ascending, the top num_eig are last (as from sstebz)
+    const int info = LAPACKE_cheev(LAPACK_COL_MAJOR, 'V', 'L', num_vec,
+                                   reinterpret_cast<lapack_complex_float*>(trk_h_buf),
+                                   num_vec, eval_buf);
+    if (info) {
+      return false;
+    }
+    const int first = num_vec - num_eig;
+    memmove(eval_buf, &eval_buf[first], num_eig*sizeof(float));
+    // Ritz vectors V = Q S, T V = Z S, residuals T V - V theta
+    const float tol = trk_tol * std::abs(eval_buf[num_eig-1]);
+    bool converged = true;
+    for (int eidx=0; eidx < num_eig; eidx++) {
+      const std::complex<float>* s = &trk_h_buf[(first+eidx)*num_vec];
+      std::complex<float>* v = &kltb_buf[eidx*acm_order];
+      std::complex<float>* tv = &trk_y_buf[eidx*acm_order];
+      float resid = 0.0f;
+      for (int tidx=0; tidx < acm_order; tidx++) {
+        std::complex<float> vt(0.0f, 0.0f);
+        std::complex<float> zt(0.0f, 0.0f);
+        for (int qidx=0; qidx < num_vec; qidx++) {
+          vt += trk_q_buf[qidx*acm_order+tidx] * s[qidx];
+          zt += trk_z_buf[qidx*acm_order+tidx] * s[qidx];
+        }
+        v[tidx] = vt;
+        tv[tidx] = zt;
+        resid += std::norm(zt - eval_buf[eidx] * vt);
+      }
+      converged = converged && std::sqrt(resid) <= tol;
+    }
+#if KLT_DEBUG & KLT_DEBUG_FINE
+    std::cout<<"track: iter="<<iter<<" converged="<<converged<<std::endl;
+#endif
+    if (converged) {
+      // Converged Ritz pairs span an invariant subspace, but not necessarily
+      // the top one: a component the previous frame lacked is orthogonal
+      // to V and never enters the basis.  As in eigendecomp_lanczos(), no
+      // eigenvalue outside the subspace exceeds the trace left over; unless
+      // that rules out one above the smallest Ritz value, the cold solve
+      // decides.
+      double trace = cov_trace();
+      for (int eidx=0; eidx < num_eig; eidx++) {
+        trace -= eval_buf[eidx];
+      }
+#if KLT_DEBUG & KLT_DEBUG_FINE
+      std::cout<<"track: trace left="<<trace<<std::endl;
+#endif
+      return trace <= eval_buf[0] + tol;
+    }
+    memcpy(trk_q_buf, kltb_buf, num_eig*acm_order*sizeof(std::complex<float>));
+    memcpy(trk_z_buf, trk_y_buf, num_eig*acm_order*sizeof(std::complex<float>));
+  }
+  return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Plan Toeplitz matvec FFT (tp_* buffers, tp_hdl)
+//   If an error occurrs, throws std::runtime_error.
+//-----------------------------------------------------------------------------
+void KLT::init_toeplitz_fft()
+{
+  tp_len = fft_good_len(2 * acm_order - 1);
+  bufs.alloc(tp_c_buf, tp_len, "tp_c_buf");
+  bufs.alloc(tp_w_buf, tp_len, "tp_w_buf");
+  MKL_LONG status = DftiCreateDescriptor(&tp_hdl, DFTI_SINGLE, DFTI_COMPLEX, 1,
+                                         static_cast<MKL_LONG>(tp_len));
+  bufs.adopt(tp_hdl, free_plan);
+  if (status == DFTI_NO_ERROR) {
+    status = DftiSetValue(tp_hdl, DFTI_BACKWARD_SCALE, 1.0f / tp_len);
+  }
+  if (status == DFTI_NO_ERROR) {
+    status = DftiCommitDescriptor(tp_hdl);
+  }
+  if (status != DFTI_NO_ERROR) {
+    bufs.release(tp_hdl);
+    std::ostringstream oss;
+    oss << "Failed to plan Toeplitz FFT (size " << tp_len << "): "
+        << DftiErrorMessage(status);
+    throw std::runtime_error(oss.str());
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Sliding KLT coeffs (klts_buf): each eigenvector correlated with the whole
+// frame.  By FFT, as a filter bank sharing the input spectrum: sp_len >=
+// in_len, so the circular correlation equals the linear one for all starts.
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//-----------------------------------------------------------------------------
+void KLT::project_sliding()
+{
+  const int num_pos = proj_len();
+  if (!sp_use) {
+    for (int eidx=0; eidx < num_eig; eidx++) {
+      const std::complex<float>* v = &kltb_buf[eidx*acm_order];
+      std::complex<float>* c = &klts_buf[static_cast<size_t>(eidx) * num_pos];
+      for (int pidx=0; pidx < num_pos; pidx++) {
+        c[pidx] = klt_cdotc(&frame[pidx], v, acm_order);
+      }
+    }
+    return;
+  }
+  if (frame_win != NULL) {
+    for (int tidx=0; tidx < in_len; tidx++) {
+      sp_x_buf[tidx] = frame[tidx] * frame_win[tidx];
+    }
+  } else {
+    memcpy(sp_x_buf, frame, in_len*sizeof(std::complex<float>));
+  }
+  memset(&sp_x_buf[in_len], 0, (sp_len - in_len)*sizeof(std::complex<float>));
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    std::complex<float>* v = &sp_v_buf[static_cast<size_t>(eidx) * sp_len];
+    memcpy(v, &kltb_buf[eidx*acm_order], acm_order*sizeof(std::complex<float>));
+    memset(&v[acm_order], 0, (sp_len - acm_order)*sizeof(std::complex<float>));
+  }
+  MKL_LONG status = DftiComputeForward(sp_hdl, sp_x_buf);
+  if (status == DFTI_NO_ERROR) {
+    status = DftiComputeForward(sp_multi_hdl, sp_v_buf);
+  }
+  if (status == DFTI_NO_ERROR) {
+    // Cross spectra
+    for (int eidx=0; eidx < num_eig; eidx++) {
+      std::complex<float>* v = &sp_v_buf[static_cast<size_t>(eidx) * sp_len];
+      for (int fidx=0; fidx < sp_len; fidx++) {
+        v[fidx] = sp_x_buf[fidx] * std::conj(v[fidx]);
+      }
+    }
+    status = DftiComputeBackward(sp_multi_hdl, sp_v_buf);
+  }
+  if (status != DFTI_NO_ERROR) {
+    clear_outputs();
+    std::ostringstream oss;
+    oss << "Sliding projection FFT failed: " << DftiErrorMessage(status);
+    throw std::runtime_error(oss.str());
+  }
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    memcpy(&klts_buf[static_cast<size_t>(eidx) * num_pos],
+           &sp_v_buf[static_cast<size_t>(eidx) * sp_len], num_pos*sizeof(std::complex<float>));
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Plan sliding projection FFTs (sp_x_buf, sp_v_buf, sp_hdl, sp_multi_hdl)
+//   If an error occurrs, throws std::runtime_error.
+//-----------------------------------------------------------------------------
+void KLT::init_proj_fft()
+{
+  sp_len = fft_good_len(in_len);
+  bufs.alloc(sp_x_buf, sp_len, "sp_x_buf");
+  const size_t v_size = static_cast<size_t>(sp_len) * num_eig;
+  bufs.alloc(sp_v_buf, v_size, "sp_v_buf");
+  MKL_LONG status = DftiCreateDescriptor(&sp_hdl, DFTI_SINGLE, DFTI_COMPLEX, 1,
+                                         static_cast<MKL_LONG>(sp_len));
+  bufs.adopt(sp_hdl, free_plan);
+  if (status == DFTI_NO_ERROR) {
+    status = DftiCommitDescriptor(sp_hdl);
+  }
+  if (status == DFTI_NO_ERROR) {
+    status = DftiCreateDescriptor(&sp_multi_hdl, DFTI_SINGLE, DFTI_COMPLEX, 1,
+                                  static_cast<MKL_LONG>(sp_len));
+    bufs.adopt(sp_multi_hdl, free_plan);
+  }
+  if (status == DFTI_NO_ERROR) {
+    status = DftiSetValue(sp_multi_hdl, DFTI_NUMBER_OF_TRANSFORMS,
+                          static_cast<MKL_LONG>(num_eig));
+  }
+  if (status == DFTI_NO_ERROR) {
+    status = DftiSetValue(sp_multi_hdl, DFTI_INPUT_DISTANCE, static_cast<MKL_LONG>(sp_len));
+  }
+  if (status == DFTI_NO_ERROR) {
+    status = DftiSetValue(sp_multi_hdl, DFTI_OUTPUT_DISTANCE, static_cast<MKL_LONG>(sp_len));
+  }
+  if (status == DFTI_NO_ERROR) {
+    status = DftiSetValue(sp_multi_hdl, DFTI_BACKWARD_SCALE, 1.0f / sp_len);
+  }
+  if (status == DFTI_NO_ERROR) {
+    status = DftiCommitDescriptor(sp_multi_hdl);
+  }
+  if (status != DFTI_NO_ERROR) {
+    bufs.release(sp_hdl);
+    bufs.release(sp_multi_hdl);
+    std::ostringstream oss;
+    oss << "Failed to plan sliding projection FFT (size " << sp_len << "): "
+        << DftiErrorMessage(status);
+    throw std::runtime_error(oss.str());
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Grow ac_buf from the lags to the packed Toeplitz matrix LAPACK needs
+// (size ((acm_order+1)*acm_order)/2), keeping the lags.  Does nothing if it
+// already is.
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//-----------------------------------------------------------------------------
+void KLT::init_packed()
+{
+  const int ac_size = ((acm_order + 1) * acm_order) / 2;
+  if (ac_len >= ac_size) {
+    return;
+  }
+  std::complex<float>* packed_buf = NULL;
+  try {
+    bufs.alloc(packed_buf, ac_size, "ac_buf");
+  } catch (std::runtime_error&) {
+    clear_outputs();
+    throw;
+  }
+  memcpy(packed_buf, ac_buf, ac_len*sizeof(std::complex<float>));
+  // The lags buffer stays in the arena
+  ac_buf = packed_buf;
+  ac_len = ac_size;
+#if KLT_DEBUG & KLT_DEBUG_FINE
+  std::cout<<"Grow ac_buf (size "<<ac_size<<")"<<std::endl;
 #endif
 }
 
 
-#if KLT_SUPPORT_WIN
 //-----------------------------------------------------------------------------
-// Create window
+// Plan Lanczos eigensolver (lz_* buffers)
+//   If an error occurrs, throws std::runtime_error.
+//-----------------------------------------------------------------------------
+void KLT::init_lanczos()
+{
+  if (tp_hdl == NULL) {
+    init_toeplitz_fft();
+  }
+  lz_max = std::min(acm_order, 2 * num_eig + 64);
+  const size_t q_size = static_cast<size_t>(acm_order) * (lz_max + 1);
+  bufs.alloc(lz_q_buf, q_size, "lz_q_buf");
+  const size_t s_size = static_cast<size_t>(lz_max) * num_eig;
+  bufs.alloc(lz_s_buf, s_size, "lz_s_buf");
+}
+
+
+//-----------------------------------------------------------------------------
+// Allocate the windowed frame buffer (wf_buf)
+//   If an error occurrs, throws std::runtime_error.
 //-----------------------------------------------------------------------------
 void KLT::init_window()
 {
-  static const bool PERIODIC = false;
-  static const double TWO_PI = 2.0 * M_PI;
-  const int num_out = in_len;
-  const int win_len = in_len + static_cast<int>(PERIODIC);
-  const double z1 = TWO_PI / win_len;
-  for (int oidx=0; oidx<num_out; oidx++) {
-    const double z = z1 * oidx;
-    // HFT90D Flat-top Window
-    win_buf[oidx] =
-      1.0 -
-      1.942604 * cos(z) +
-      1.340318 * cos(2.0 * z) -
-      0.440811 * cos(3.0 * z) +
-      0.043097 * cos(4.0 * z);
+  if (wf_buf == NULL) {
+    bufs.alloc(wf_buf, in_len, "wf_buf");
   }
 }
 
 
 //-----------------------------------------------------------------------------
-// Apply window to in_buf in-place
+// Set frame, frame_win and frame_head for in (size in_len)
+//   When every kernel reading the whole frame can window it on the fly
+//   (window_fused()), only the head is windowed here; otherwise the whole
+//   frame is, once, into wf_buf.
 //-----------------------------------------------------------------------------
-void KLT::apply_window()
+void KLT::window_frame(const std::complex<float>* in)
 {
+  frame = in;
+  frame_win = NULL;
+  frame_head = in;
+  if (win_type == WIN_NONE) {
+    return;
+  }
+  KLT_STATS_SCOPE(KLT_STAGE_WINDOW);
+  const float* win = win_tab.get();
+  const bool fused = window_fused();
+  const int len = fused ? acm_order : in_len;
 #if KLT_DEBUG & KLT_DEBUG_VERBOSE
   std::cout<<"in: ";
   for (int widx=0; widx < in_len; widx++) {
-    std::cout<<in_buf[widx]<<"  ";
+    std::cout<<in[widx]<<"  ";
   }
   std::cout<<std::endl;
 #endif
-  for (int widx=0; widx < in_len; widx++) {
-    in_buf[widx] *= win_buf[widx];
+  for (int widx=0; widx < len; widx++) {
+    wf_buf[widx] = in[widx] * win[widx];
+  }
+  frame_head = wf_buf;
+  if (fused) {
+    frame_win = win;
+  } else {
+    frame = wf_buf;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Complex integer conversion by sample type
+//-----------------------------------------------------------------------------
+static void convert_ci(const int16_t* in, const float* win, float scale,
+                       std::complex<float>* out, int len)
+{
+  klt_cvt_ci16(in, win, scale, out, len);
+}
+
+static void convert_ci(const int8_t* in, const float* win, float scale,
+                       std::complex<float>* out, int len)
+{
+  klt_cvt_ci8(in, win, scale, out, len);
+}
+
+
+//-----------------------------------------------------------------------------
+// Set frame, frame_win and frame_head for complex integer in (in_len I/Q
+// pairs) times scale
+//   Converting needs the whole frame in floats anyway, so the window is never
+//   fused here: one pass converts, scales and windows the frame into wf_buf
+//   (allocated on first use).
+//   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+//   kltc_buf, and kltb_buf to 0.0f.
+//-----------------------------------------------------------------------------
+template <typename T>
+void KLT::convert_frame(const T* in, float scale)
+{
+  if (wf_buf == NULL) {
+    try {
+      init_window();
+    } catch (std::runtime_error&) {
+      clear_outputs();
+      throw;
+    }
   }
+  KLT_STATS_SCOPE(KLT_STAGE_WINDOW);
+  convert_ci(in, win_tab.get(), scale, wf_buf, in_len);
 #if KLT_DEBUG & KLT_DEBUG_VERBOSE
-  std::cout<<"iw: ";
+  std::cout<<"in: ";
   for (int widx=0; widx < in_len; widx++) {
-    std::cout<<in_buf[widx]<<"  ";
+    std::cout<<wf_buf[widx]<<"  ";
   }
   std::cout<<std::endl;
 #endif
+  frame = wf_buf;
+  frame_win = NULL;
+  frame_head = wf_buf;
 }
-#endif // KLT_SUPPORT_WIN
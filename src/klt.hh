@@ -2,6 +2,7 @@
 // S.P.Storck 07-20-2017
 
 #ifndef __KLT_HH__
+#define __KLT_HH__
 
 // DEBUG bitmask values
 #define KLT_DEBUG_NONE 0
@@ -11,20 +12,143 @@
 
 // DEBUG bitmask
 #define KLT_DEBUG (KLT_DEBUG_NONE)
-// Compile KLT window code?
-#define KLT_SUPPORT_WIN 0
-// Support normalized eigenvalue output
+// Support normalized eigenvalue output; may be set on the command line
+#ifndef KLT_SUPPORT_EVALN
 #define KLT_SUPPORT_EVALN 0
+#endif
+// Per-stage timers, counters and latency histograms (see klt_stats.hh);
+// may be set on the command line (make bench does)
+#ifndef KLT_SUPPORT_STATS
+#define KLT_SUPPORT_STATS 0
+#endif
 
 #include <complex>
+#include <cstdint>
+#include <memory>
+#include "klt_arena.hh"
+#if KLT_SUPPORT_STATS
+#include "klt_stats.hh"
+#endif
+
+class KLTRecon;
+
+// MKL DFTI descriptor (opaque, see mkl_dfti.h)
+struct DFTI_DESCRIPTOR;
 
 class KLT
 {
 public:
+  //---------------------------------------------------------------------------
+  // Auto-correlation engines
+  //   ACORR_AUTO: pick direct or FFT per frame shape (cost model).
+  //   ACORR_DIRECT: direct O(in_len x acm_order) lag sums.
+  //   ACORR_FFT: zero-padded FFT (Wiener-Khinchin), O(N log N).
+  //---------------------------------------------------------------------------
+  enum AcorrEngine {
+    ACORR_AUTO,
+    ACORR_DIRECT,
+    ACORR_FFT
+  };
+
+  //---------------------------------------------------------------------------
+  // Eigensolver engines
+  //   EIG_AUTO: pick LAPACK or Lanczos per matrix shape (cost model).
+  //   EIG_LAPACK: packed Householder tridiagonalization (chptrd), sstebz,
+  //               cstein, cupmtr.  O(acm_order^3) time, O(acm_order^2)
+  //               memory (the packed matrix).
+  //   EIG_LANCZOS: top-num_eig Lanczos with full reorthogonalization, using
+  //                FFT Toeplitz matvecs on the lags only, so memory stays
+  //                O(acm_order x num_eig).  Falls back to EIG_LAPACK (and
+  //                then allocates the packed matrix) when it does not
+  //                converge.
+  //---------------------------------------------------------------------------
+  enum EigEngine {
+    EIG_AUTO,
+    EIG_LAPACK,
+    EIG_LANCZOS
+  };
+
+  //---------------------------------------------------------------------------
+  // Model order rules (components solved per frame, at most num_eig)
+  //   ORDER_FIXED: num_eig every frame.
+  //   ORDER_MDL: minimum description length (Wax & Kailath) over the full
+  //              eigenvalue spectrum, in_len snapshots (proj_len() under
+  //              COV_SNAPSHOT).
+  //   ORDER_AIC: Akaike information criterion, same spectrum.
+  //   ORDER_ENERGY: fewest components holding energy_frac of the trace.
+  //---------------------------------------------------------------------------
+  enum OrderRule {
+    ORDER_FIXED,
+    ORDER_MDL,
+    ORDER_AIC,
+    ORDER_ENERGY
+  };
+
+  //---------------------------------------------------------------------------
+  // Covariance estimators
+  //   COV_TOEPLITZ: biased Toeplitz auto-correlation matrix of the lags (see
+  //                 AcorrEngine).
+  //   COV_SNAPSHOT: sample covariance of the proj_len() overlapping
+  //                 acm_order-sample snapshots of the frame, COV_SNAP_BLOCK
+  //                 snapshots per rank-k update (cherk).  Better resolution
+  //                 from short frames, O(acm_order^2) memory.
+  //---------------------------------------------------------------------------
+  enum CovEstimator {
+    COV_TOEPLITZ,
+    COV_SNAPSHOT
+  };
+
+  //---------------------------------------------------------------------------
+  // Lag precision
+  //   PREC_SINGLE: lags summed in complex<float>.
+  //   PREC_MIXED: lags summed in double (double accumulators for the direct
+  //               sums and the streaming running sums, a double-precision
+  //               FFT), then rounded once to float for the single-precision
+  //               eigensolve.
+  //---------------------------------------------------------------------------
+  enum Precision {
+    PREC_SINGLE,
+    PREC_MIXED
+  };
+
+  //---------------------------------------------------------------------------
+  // Window families (tables are DFT-even, period in_len)
+  //   WIN_NONE: no window.
+  //   WIN_HANN: Hann.
+  //   WIN_BLACKMAN_HARRIS: 4-term Blackman-Harris.
+  //   WIN_FLATTOP: HFT90D flat-top.
+  //   WIN_KAISER: Kaiser, shape parameter beta.
+  //   WIN_USER: caller-supplied taps.
+  //---------------------------------------------------------------------------
+  enum WindowType {
+    WIN_NONE,
+    WIN_HANN,
+    WIN_BLACKMAN_HARRIS,
+    WIN_FLATTOP,
+    WIN_KAISER,
+    WIN_USER
+  };
+
+  //---------------------------------------------------------------------------
+  // Outputs (bitmask) transform() computes
+  //   OUT_EVAL: eigenvalues (eval_buf).
+  //   OUT_KLTC: KLT coeffs (kltc_buf).
+  //   OUT_KLTB: weighted KLT basis functions (kltb_buf).
+  //   OUT_ALL: the above (the X-Midas primitive's outputs).
+  //   OUT_KLTS: sliding KLT coeffs over the whole frame (klts_buf).
+  //   Eigenvalues are always computed, as every other output needs them.
+  //---------------------------------------------------------------------------
+  enum OutputMask {
+    OUT_EVAL = 1,
+    OUT_KLTC = 2,
+    OUT_KLTB = 4,
+    OUT_ALL = OUT_EVAL | OUT_KLTC | OUT_KLTB,
+    OUT_KLTS = 8
+  };
+
   //---------------------------------------------------------------------------
   // Constructor
   //   in_len: in_buf size.
-  //   window:  apply window? (support may be compiled out)
   //   eval_normalized: normalize eigenvalues? (support may be compiled out)
   //   acm_order: auto-correlation matrix order.
   //   num_eig: number (from largest eigenvalue down) of eigenvalues/vectors to
@@ -32,9 +156,6 @@ public:
   //   If an error occurrs, throws std::runtime_error.
   //---------------------------------------------------------------------------
   KLT(int in_len,
-#if KLT_SUPPORT_WIN
-      int window,
-#endif
 #if KLT_SUPPORT_EVALN
       int eval_normalized,
 #endif
@@ -53,6 +174,262 @@ public:
   //---------------------------------------------------------------------------
   void transform();
 
+  //---------------------------------------------------------------------------
+  // Transform contents of in (size in_len) rather than in_buf, without
+  // copying it.  Same outputs and error behavior as transform().
+  //---------------------------------------------------------------------------
+  void transform(const std::complex<float>* in);
+
+  //---------------------------------------------------------------------------
+  // Transform complex integer in (in_len interleaved I/Q pairs: BLUE "CI"
+  // int16 or "CB" int8), each sample times scale.  The conversion is done by
+  // the window stage, in the same vectorized pass that windows the frame, so
+  // only the integers are read.  Same outputs and error behavior as
+  // transform().
+  //---------------------------------------------------------------------------
+  void transform(const int16_t* in, float scale);
+  void transform(const int8_t* in, float scale);
+
+  //---------------------------------------------------------------------------
+  // Select window (default WIN_NONE)
+  //   param: WIN_KAISER beta, ignored by the other families.
+  //   Tables are shared by all instances with the same window and in_len
+  //   (see klt_window.hh).  Only the FFT auto-correlation, snapshot
+  //   covariance and FFT sliding projection window the frame in the pass
+  //   that copies it in.  The direct engines and the small-order kernels
+  //   read the frame repeatedly, so for them it is first windowed into a
+  //   scratch buffer, an extra pass over the frame.  The caller's input is
+  //   never written.  Not with set_stream() (lags of a moving window cannot
+  //   be updated).
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_window(WindowType type, float param = 0.0f);
+
+  //---------------------------------------------------------------------------
+  // Select user-supplied window (WIN_USER), taps: in_len weights (copied)
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_window(const float* taps);
+
+  //---------------------------------------------------------------------------
+  // Window in use
+  //---------------------------------------------------------------------------
+  WindowType window() const { return win_type; }
+
+  //---------------------------------------------------------------------------
+  // Select auto-correlation engine (default ACORR_AUTO).
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_acorr_engine(AcorrEngine engine);
+
+  //---------------------------------------------------------------------------
+  // Is the FFT auto-correlation engine in use?
+  //---------------------------------------------------------------------------
+  bool acorr_fft() const { return acfft_use; }
+
+  //---------------------------------------------------------------------------
+  // Streaming (sliding-window) auto-correlation for overlapped frames.
+  //   in_clen: samples consumed per frame, i.e. each in_buf holds the previous
+  //            frame shifted left by in_clen samples plus in_clen new ones.
+  //            0 (or >= in_len) disables streaming.
+  //   resync: recompute all lags from scratch every resync frames to bound
+  //           the running-sum drift.
+  //   Lags are then updated in O(acm_order x in_clen) per frame.  Call again
+  //   to restart after a discontinuity in the input.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_stream(int in_clen, int resync);
+
+  //---------------------------------------------------------------------------
+  // Select covariance estimator (default COV_TOEPLITZ).
+  //   fwd_bwd: average COV_SNAPSHOT with its conjugate reversal J conj(R) J
+  //            (forward-backward, persymmetric estimate)?
+  //   forget: weight [0..1) of the previous frames' COV_SNAPSHOT covariance
+  //           in the current one; 0 rebuilds it every frame.  With
+  //           set_stream() on, only the in_clen snapshots new to the frame
+  //           are added, so each snapshot enters once and the update costs
+  //           O(acm_order^2 x in_clen) rather than O(acm_order^2 x in_len).
+  //   The LAPACK path gets the matrix packed, Lanczos and tracking use it in
+  //   full (chemv matvecs).  COV_SNAPSHOT bypasses the specialized
+  //   small-order kernels.  Calling again (or set_stream()) restarts the
+  //   accumulation.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_covariance(CovEstimator est, bool fwd_bwd, float forget);
+
+  //---------------------------------------------------------------------------
+  // Covariance estimator in use
+  //---------------------------------------------------------------------------
+  CovEstimator covariance() const { return sc_use ? COV_SNAPSHOT : COV_TOEPLITZ; }
+
+  //---------------------------------------------------------------------------
+  // Snapshots per COV_SNAPSHOT rank-k update
+  //---------------------------------------------------------------------------
+  static const int COV_SNAP_BLOCK = 128;
+
+  //---------------------------------------------------------------------------
+  // Select lag precision (default PREC_SINGLE)
+  //   refine: with PREC_MIXED, replace each eigenvalue by the Rayleigh
+  //           quotient of its (float) eigenvector on the double lags'
+  //           Toeplitz matrix.  Its error is quadratic in the eigenvector's,
+  //           so eval_buf is good to float rounding, for O(acm_order^2)
+  //           double work per eigenvector; eigenvectors are solved even for
+  //           OUT_EVAL alone.
+  //   Long frames keep small eigenvalues (and sstebz's splits) clean at a
+  //   fraction of a double build's cost.  Toeplitz lags only (not with
+  //   COV_SNAPSHOT); PREC_MIXED bypasses the specialized small-order
+  //   kernels.  Streaming running sums restart.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_precision(Precision prec, bool refine);
+
+  //---------------------------------------------------------------------------
+  // Lag precision in use
+  //---------------------------------------------------------------------------
+  Precision precision() const { return mp_use ? PREC_MIXED : PREC_SINGLE; }
+
+  //---------------------------------------------------------------------------
+  // Select eigensolver engine (default EIG_AUTO).
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_eig_engine(EigEngine engine);
+
+  //---------------------------------------------------------------------------
+  // Is the Lanczos eigensolver in use?
+  //---------------------------------------------------------------------------
+  bool eig_lanczos() const { return lz_use; }
+
+  //---------------------------------------------------------------------------
+  // Subspace tracking across consecutive frames.
+  //   track: seed the eigensolver with the previous frame's eigenvectors?
+  //   tol: Ritz residual bound (relative to the largest eigenvalue) for
+  //        accepting the tracked solution (which also needs the trace left
+  //        over to rule out a larger eigenvalue outside the subspace).
+  //   max_iter: subspace iteration/Rayleigh-Ritz steps before falling back
+  //             to the full (cold) solve.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_track(int track, float tol, int max_iter);
+
+  //---------------------------------------------------------------------------
+  // Did the last transform() take the tracking fast path?
+  //---------------------------------------------------------------------------
+  bool tracked() const { return trk_hit; }
+
+  //---------------------------------------------------------------------------
+  // Canonical eigenvector phase (default off)
+  //   Eigenvectors come out of the solvers with arbitrary phase.  With this
+  //   on, each is rotated so that its first component is real and positive
+  //   (its largest one instead, if the first is negligible), before the
+  //   coeffs are computed.  kltc_buf rotates the other way and the weighted
+  //   kltb_buf is unchanged, but the unweighted eigenvectors of consecutive
+  //   frames then only differ as much as the subspace does (see
+  //   klt_compact.hh).  Bypasses the specialized small-order kernels.
+  //---------------------------------------------------------------------------
+  void set_canonical_phase(bool canonical) { ph_use = canonical; }
+
+  //---------------------------------------------------------------------------
+  // Is the eigenvector phase canonical?
+  //---------------------------------------------------------------------------
+  bool canonical_phase() const { return ph_use; }
+
+  //---------------------------------------------------------------------------
+  // Select outputs (OutputMask bits, default OUT_ALL); may be changed between
+  // transform() calls.  Stages nobody reads are skipped:
+  //   OUT_EVAL only: no eigenvectors (sstebz without cstein/cupmtr, Lanczos
+  //                  without Ritz vectors, small kernels without inverse
+  //                  iteration), no coeffs, and kltb_buf is freed (NULL)
+  //                  unless tracking needs the eigenvectors.
+  //   No OUT_KLTB: kltb_buf holds the unweighted eigenvectors (weighted
+  //                if reconstructing, see set_recon()).
+  //   OUT_KLTS: klts_buf is allocated (freed without it) and the specialized
+  //             small-order kernels are bypassed.
+  //   Buffers of outputs not selected are left undefined.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_outputs(int outputs);
+
+  //---------------------------------------------------------------------------
+  // Selected outputs
+  //---------------------------------------------------------------------------
+  int outputs() const { return out_mask; }
+
+  //---------------------------------------------------------------------------
+  // Adaptive model order (default ORDER_FIXED)
+  //   Each frame the rule picks order <= num_eig components from the
+  //   eigenvalues (bisection only), and eigenvectors are solved for those
+  //   alone; eval_buf still holds all num_eig eigenvalues, the kltc_buf and
+  //   kltb_buf entries of the components left out are 0.0f.  Adaptive rules
+  //   need the LAPACK path, so they bypass the specialized small-order
+  //   kernels, Lanczos and tracking.
+  //   energy_frac: ORDER_ENERGY fraction (0..1].
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_model_order(OrderRule rule, float energy_frac);
+
+  //---------------------------------------------------------------------------
+  // Components in the last transform() (num_eig unless adaptive, 0 if it
+  // failed)
+  //---------------------------------------------------------------------------
+  int model_order() const { return mo_order; }
+
+  //---------------------------------------------------------------------------
+  // Sliding KLT coeffs per eigenvector (OUT_KLTS): in_len - acm_order + 1,
+  // one per sub-window start
+  //---------------------------------------------------------------------------
+  int proj_len() const { return in_len - acm_order + 1; }
+
+  //---------------------------------------------------------------------------
+  // Are the sliding KLT coeffs computed by FFT (cost model, see set_outputs())?
+  //---------------------------------------------------------------------------
+  bool proj_fft() const { return sp_use; }
+
+  //---------------------------------------------------------------------------
+  // Overlap-add reconstruction (see klt_recon.hh)
+  //   out_len: output samples per frame, acm_order * (1 - out_olap_factor);
+  //            0 disables.  Equal to the caller's frame advance, the output
+  //            is the rank-reduced input at the input rate.
+  //   After each transform(), recon_buf[0..out_len) holds the next samples
+  //   (a failed frame contributes zeros, so the output stays in step).
+  //   Calling again restarts the output.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_recon(int out_len);
+
+  //---------------------------------------------------------------------------
+  // Reconstruction output samples per frame (0 if disabled)
+  //---------------------------------------------------------------------------
+  int recon_len() const;
+
+  //---------------------------------------------------------------------------
+  // End of stream: move the reconstruction tail (acm_order - out_len
+  // samples) to recon_buf and restart; returns its length.
+  //---------------------------------------------------------------------------
+  int recon_flush();
+
+  //---------------------------------------------------------------------------
+  // Does transform() dispatch to a compile-time specialized kernel?
+  //   Kernels exist for acm_order 8, 16, 32, 64 with num_eig 1..4 (see
+  //   klt_small.hh) and are used unless an engine is forced or the stream,
+  //   track, snapshot covariance, mixed precision or canonical phase modes
+  //   are on.
+  //---------------------------------------------------------------------------
+  bool small_kernel() const
+  {
+    return small_fn != NULL && acorr_sel == ACORR_AUTO && eig_sel == EIG_AUTO &&
+      stream_clen == 0 && !trk_use && !(out_mask & OUT_KLTS) && mo_rule == ORDER_FIXED &&
+      !sc_use && !mp_use && !ph_use;
+  }
+
+#if KLT_SUPPORT_STATS
+  //---------------------------------------------------------------------------
+  // Per-stage timers and counters since construction or reset_stats().
+  //   May be called from any thread while another one transforms.
+  //---------------------------------------------------------------------------
+  KLTStats stats() const { return stats_ctr.snapshot(); }
+  void reset_stats() { stats_ctr.reset(); }
+
+#endif
   //---------------------------------------------------------------------------
   // Input/Output Buffers
   //   in_buf: input buffer (size in_len).
@@ -61,56 +438,208 @@ public:
   //   kltb_buf: output KLT basis functions matrix (size acm_order x num_eig)
   //             (already weighted by the KLT coeffs).  The basis functions are
   //             output as column vectors in column-major order (equivalent to
-  //             row vectors in row-major order).
+  //             row vectors in row-major order).  NULL if no selected
+  //             output needs eigenvectors (see set_outputs()).
+  //   klts_buf: output sliding KLT coeffs matrix (size num_eig x proj_len()),
+  //             row e holding sum conj(v_e[t]) * in[s + t], t < acm_order,
+  //             for every start s (so klts_buf[e*proj_len()] is kltc_buf[e]).
+  //             NULL unless OUT_KLTS is selected.
+  //   recon_buf: output reconstruction (size acm_order), NULL unless
+  //              set_recon() is on.
   //---------------------------------------------------------------------------
   std::complex<float>* in_buf;
   float* eval_buf;
   std::complex<float>* kltc_buf;
   std::complex<float>* kltb_buf;
+  std::complex<float>* klts_buf;
+  std::complex<float>* recon_buf;
 
 
 private:
-#if KLT_SUPPORT_WIN
   void init_window();
-  void apply_window();
-#endif
+  void window_frame(const std::complex<float>* in);
+  template <typename T>
+  void convert_frame(const T* in, float scale);
+  void transform_staged();
+  bool window_fused() const
+  {
+    return !small_kernel() && (sc_use || acfft_use) && (!(out_mask & OUT_KLTS) || sp_use);
+  }
+  void transform_frame();
   void acorr_matrix();
+  void acorr_lags_direct();
+  void acorr_lags_fft();
+  void acorr_lags_stream();
+  void init_acorr_fft();
+  void init_mixed_fft();
+  void refine_evals();
+  void canonicalize_phase();
+  void toeplitz_pack();
+  void snapshot_cov();
+  void cov_pack();
+  void cov_matvec(const std::complex<float>* x, std::complex<float>* y);
+  double cov_trace() const;
+  void toeplitz_matvec(const std::complex<float>* x, std::complex<float>* y);
   void eigendecomp();
+  void eigendecomp_lapack();
+  bool eigendecomp_lanczos();
+  bool eigendecomp_track();
+  void toeplitz_spectrum();
+  void init_toeplitz_fft();
+  void init_lanczos();
+  void init_packed();
+  void project_sliding();
+  void init_proj_fft();
+  void init_outputs();
+  void clear_outputs();
+  bool vectors() const
+  {
+    return (out_mask & (OUT_KLTC | OUT_KLTB | OUT_KLTS)) || trk_use || recon || mp_refine;
+  }
 
   //---------------------------------------------------------------------------
   // Config
   //---------------------------------------------------------------------------
   const int in_len;
-#if KLT_SUPPORT_WIN
-  const int window;
-#endif
 #if KLT_SUPPORT_EVALN
   const int eval_normalized;
 #endif
   const int acm_order;
   const int num_eig;
+  AcorrEngine acorr_sel;
+  EigEngine eig_sel;
+  int out_mask;
 
   //---------------------------------------------------------------------------
   // Internal/temp buffers
-  //   win_buf: window buffer (size in_len).
-  //   ac_buf: temp buffer (size ((acm_order+1)*acm_order)/2).
+  //   arena: block holding in_buf, the initial ac_buf, eval_buf,
+  //          kltc_buf, kltb_buf (kltb_off, always reserved) and the
+  //          eigendecomp temp buffers.
+  //   bufs: owner of the engine and mode buffers below (and their FFT
+  //         plans), allocated on their own when planned.
+  //   ac_buf: lags (size ac_len: acm_order, or ((acm_order+1)*acm_order)/2
+  //           once grown to the packed matrix for the LAPACK path, which
+  //           moves it out of the arena into bufs).
   //   d_buf: temp buffer (size acm_order).
   //   e_buf: temp buffer (size (acm_order-1)).
   //   tau_buf: temp buffer (size (acm_order-1)).
   //   ib_buf: temp buffer (size acm_order).
   //   is_buf: temp buffer (size acm_order).
   //   if_buf: temp buffer (size num_eig).
+  //   frame: input being transformed (in_buf, caller's or wf_buf, size
+  //          in_len).  Integer input is always converted into wf_buf.
+  //   frame_win: window the kernels apply as they read frame, NULL if frame
+  //              is already windowed (or no window).
+  //   frame_head: windowed frame[0..acm_order) (coeffs, Lanczos start).
+  //   small_fn: specialized kernel for (acm_order, num_eig), or NULL.
+  //   acfft_buf: FFT auto-correlation temp buffer (size acfft_len).
+  //   acfft_hdl: FFT auto-correlation plan (length acfft_len).
+  //   lag_buf: streaming running lag sums (size acm_order).
+  //   hist_buf: streaming head of the previous frame (size hist_len).
+  //   tp_c_buf: Toeplitz circulant embedding spectrum (size tp_len).
+  //   tp_w_buf: Toeplitz matvec temp buffer (size tp_len).
+  //   tp_hdl: Toeplitz matvec FFT plan (length tp_len).
+  //   lz_q_buf: Lanczos basis (size acm_order x (lz_max+1)).
+  //   lz_s_buf: Lanczos Ritz vectors (size lz_max x num_eig).
+  //   trk_q_buf: tracked subspace basis Q (size acm_order x 2*num_eig).
+  //   trk_z_buf: tracked subspace image T*Q (size acm_order x 2*num_eig).
+  //   trk_h_buf: Rayleigh-Ritz projection (size 2*num_eig x 2*num_eig).
+  //   trk_y_buf: tracked Ritz vector image T*V (size acm_order x num_eig).
+  //   sp_x_buf: sliding projection input spectrum (size sp_len).
+  //   sp_v_buf: sliding projection eigenvector spectra, then correlations
+  //             (size sp_len x num_eig).
+  //   sp_hdl: sliding projection input FFT plan (length sp_len).
+  //   sp_multi_hdl: sliding projection plan, num_eig transforms of sp_len.
+  //   mo_buf: adaptive order full eigenvalue spectrum (size acm_order).
+  //   win_tab: window table (size in_len, shared), empty without window.
+  //   wf_buf: windowed frame (size in_len), or its head when fused; the
+  //           converted frame for integer input.
+  //   sc_acc_buf: snapshot covariance, accumulated across frames (lower
+  //               triangle, col major, size acm_order x acm_order).
+  //   sc_fb_buf: forward-backward average of sc_acc_buf (same layout), or
+  //              NULL without fwd_bwd.
+  //   sc_snap_buf: gathered snapshots (size acm_order x COV_SNAP_BLOCK).
+  //   mp_ac_buf: PREC_MIXED lags (size acm_order).
+  //   mp_lag_buf: PREC_MIXED streaming running lag sums (size acm_order).
+  //   mp_fft_buf: PREC_MIXED FFT auto-correlation temp buffer (size
+  //               acfft_len), or NULL without the FFT engine.
+  //   mp_fft_hdl: PREC_MIXED FFT auto-correlation plan (length acfft_len).
+  //   recon: overlap-add reconstruction, or NULL.
   //---------------------------------------------------------------------------
-#if KLT_SUPPORT_WIN
-  float* win_buf;
-#endif
+  KLTArena arena;
+  KLTBuffers bufs;
+  size_t kltb_off;
   std::complex<float>* ac_buf;
+  int ac_len;
   float* d_buf;
   float* e_buf;
   std::complex<float>* tau_buf;
   int* ib_buf;
   int* is_buf;
   int* if_buf;
+  const std::complex<float>* frame;
+  const float* frame_win;
+  const std::complex<float>* frame_head;
+  bool (*small_fn)(const std::complex<float>* in, int in_len, float* eval,
+                   std::complex<float>* kltc, std::complex<float>* kltb, bool weight);
+  bool acfft_use;
+  int acfft_len;
+  std::complex<float>* acfft_buf;
+  DFTI_DESCRIPTOR* acfft_hdl;
+  int stream_clen;
+  int stream_resync;
+  int stream_frame;
+  int hist_len;
+  std::complex<float>* lag_buf;
+  std::complex<float>* hist_buf;
+  int tp_len;
+  std::complex<float>* tp_c_buf;
+  std::complex<float>* tp_w_buf;
+  DFTI_DESCRIPTOR* tp_hdl;
+  bool lz_use;
+  int lz_max;
+  std::complex<float>* lz_q_buf;
+  float* lz_s_buf;
+  int trk_use;
+  float trk_tol;
+  int trk_max_iter;
+  bool trk_valid;
+  bool trk_hit;
+  std::complex<float>* trk_q_buf;
+  std::complex<float>* trk_z_buf;
+  std::complex<float>* trk_h_buf;
+  std::complex<float>* trk_y_buf;
+  bool sp_use;
+  int sp_len;
+  std::complex<float>* sp_x_buf;
+  std::complex<float>* sp_v_buf;
+  DFTI_DESCRIPTOR* sp_hdl;
+  DFTI_DESCRIPTOR* sp_multi_hdl;
+  OrderRule mo_rule;
+  float mo_energy;
+  int mo_order;
+  float* mo_buf;
+  WindowType win_type;
+  std::shared_ptr<const float> win_tab;
+  std::complex<float>* wf_buf;
+  bool sc_use;
+  bool sc_fb;
+  float sc_forget;
+  bool sc_valid;
+  std::complex<float>* sc_acc_buf;
+  std::complex<float>* sc_fb_buf;
+  std::complex<float>* sc_snap_buf;
+  bool mp_use;
+  bool mp_refine;
+  std::complex<double>* mp_ac_buf;
+  std::complex<double>* mp_lag_buf;
+  std::complex<double>* mp_fft_buf;
+  DFTI_DESCRIPTOR* mp_fft_hdl;
+  bool ph_use;
+  KLTRecon* recon;
+#if KLT_SUPPORT_STATS
+  KLTStatsCounters stats_ctr;
+#endif
 };
 
 #endif // __KLT_HH__
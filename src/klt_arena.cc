@@ -0,0 +1,256 @@
+// Karhunen-Loève Transform Library
+// Single-block buffer arena with hugepage backing and a shape pool
+
+#include "klt_arena.hh"
+
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <sys/mman.h>
+
+static const size_t HUGEPAGE = static_cast<size_t>(2) << 20;
+
+//---------------------------------------------------------------------------
+// Process-wide block pool
+//   free_blocks: released blocks by size, with their slab flag.
+//   free_bytes: bytes of the blocks in free_blocks.
+//   slab_next, slab_left: unused tail of the current hugepage slab.
+//---------------------------------------------------------------------------
+namespace {
+
+struct Block {
+  char* base;
+  bool slab;
+};
+
+struct Pool {
+  std::mutex mtx;
+  std::map<size_t, std::vector<Block> > free_blocks;
+  size_t free_bytes;
+  size_t limit;
+  bool hugepages;
+  char* slab_next;
+  size_t slab_left;
+
+  Pool() :
+    free_bytes(0),
+    limit(static_cast<size_t>(64) << 20),
+    hugepages(false),
+    slab_next(NULL),
+    slab_left(0)
+  {
+  }
+};
+
+Pool& pool()
+{
+  static Pool the_pool;
+  return the_pool;
+}
+
+//---------------------------------------------------------------------------
+// New hugepage slab of at least len bytes (explicit hugepages, else a
+// 2 MB aligned block marked for transparent hugepages), or NULL
+//---------------------------------------------------------------------------
+char* new_slab(size_t len)
+{
+  void* base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (base != MAP_FAILED) {
+    return static_cast<char*>(base);
+  }
+  if (posix_memalign(&base, HUGEPAGE, len)) {
+    return NULL;
+  }
+#ifdef MADV_HUGEPAGE
+  madvise(base, len, MADV_HUGEPAGE);
+#endif
+  return static_cast<char*>(base);
+}
+
+} // namespace
+
+
+//---------------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------------
+KLTArena::KLTArena() :
+  base(NULL),
+  len(0),
+  slab(false)
+{
+}
+
+
+//---------------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------------
+KLTArena::~KLTArena()
+{
+  if (base == NULL) {
+    return;
+  }
+  Pool& p = pool();
+  std::lock_guard<std::mutex> lock(p.mtx);
+  // Slab blocks cannot go back to the system, over the limit or not
+  if (!slab && p.free_bytes + len > p.limit) {
+    free(base);
+    return;
+  }
+  Block blk = {base, slab};
+  p.free_blocks[len].push_back(blk);
+  p.free_bytes += len;
+}
+
+
+//---------------------------------------------------------------------------
+// Reserve a buffer
+//---------------------------------------------------------------------------
+size_t KLTArena::reserve(size_t bytes)
+{
+  const size_t offset = len;
+  len += (bytes + ALIGN - 1) / ALIGN * ALIGN;
+  return offset;
+}
+
+
+//---------------------------------------------------------------------------
+// Allocate the block
+//---------------------------------------------------------------------------
+void KLTArena::commit()
+{
+  Pool& p = pool();
+  std::lock_guard<std::mutex> lock(p.mtx);
+  // Same shape released earlier?
+  std::map<size_t, std::vector<Block> >::iterator fit = p.free_blocks.find(len);
+  if (fit != p.free_blocks.end() && !fit->second.empty()) {
+    base = fit->second.back().base;
+    slab = fit->second.back().slab;
+    fit->second.pop_back();
+    p.free_bytes -= len;
+    return;
+  }
+  // Slab blocks are pooled for good once released: only while that keeps
+  // the pool within its limit
+  if (p.hugepages && p.free_bytes + len <= p.limit) {
+    if (p.slab_left >= len) {
+      base = p.slab_next;
+      slab = true;
+      p.slab_next += len;
+      p.slab_left -= len;
+      return;
+    }
+    // New slab; the current one stays if its tail is the longer
+    const size_t slab_len = (len + HUGEPAGE - 1) / HUGEPAGE * HUGEPAGE;
+    char* slab_base = new_slab(slab_len);
+    if (slab_base != NULL) {
+      base = slab_base;
+      slab = true;
+      if (slab_len - len > p.slab_left) {
+        p.slab_next = slab_base + len;
+        p.slab_left = slab_len - len;
+      }
+      return;
+    }
+  }
+  void* blk;
+  if (posix_memalign(&blk, ALIGN, len)) {
+    std::ostringstream oss;
+    oss << "Failed to allocate KLT arena (size " << len << ")";
+    throw std::runtime_error(oss.str());
+  }
+  base = static_cast<char*>(blk);
+  slab = false;
+}
+
+
+//---------------------------------------------------------------------------
+// Process-wide settings
+//---------------------------------------------------------------------------
+void KLTArena::set_hugepages(bool use)
+{
+  Pool& p = pool();
+  std::lock_guard<std::mutex> lock(p.mtx);
+  p.hugepages = use;
+}
+
+void KLTArena::set_pool_limit(size_t bytes)
+{
+  Pool& p = pool();
+  std::lock_guard<std::mutex> lock(p.mtx);
+  p.limit = bytes;
+  // Free system-allocated blocks over the new limit (slab ones stay)
+  std::map<size_t, std::vector<Block> >::iterator fit = p.free_blocks.begin();
+  for (; fit != p.free_blocks.end() && p.free_bytes > p.limit; ++fit) {
+    std::vector<Block>& blks = fit->second;
+    for (size_t bidx=blks.size(); bidx-- > 0 && p.free_bytes > p.limit; ) {
+      if (!blks[bidx].slab) {
+        free(blks[bidx].base);
+        p.free_bytes -= fit->first;
+        blks.erase(blks.begin() + bidx);
+      }
+    }
+  }
+}
+
+size_t KLTArena::pool_bytes()
+{
+  Pool& p = pool();
+  std::lock_guard<std::mutex> lock(p.mtx);
+  return p.free_bytes;
+}
+
+
+//---------------------------------------------------------------------------
+// Separately allocated buffers
+//---------------------------------------------------------------------------
+KLTBuffers::~KLTBuffers()
+{
+  for (size_t hidx=0; hidx < held.size(); hidx++) {
+    held[hidx].fn(held[hidx].ptr);
+  }
+}
+
+void* KLTBuffers::alloc_bytes(size_t count, size_t size, const char* name)
+{
+  void* buf;
+  if (posix_memalign(&buf, KLTArena::ALIGN, count*size)) {
+    std::ostringstream oss;
+    oss << "Failed to allocate " << name << " (size " << count << ")";
+    throw std::runtime_error(oss.str());
+  }
+  adopt(buf, free);
+  return buf;
+}
+
+void KLTBuffers::adopt(void* ptr, Release fn)
+{
+  if (ptr == NULL) {
+    return;
+  }
+  Held h = {ptr, fn};
+  try {
+    held.push_back(h);
+  } catch (...) {
+    fn(ptr);
+    throw;
+  }
+}
+
+void KLTBuffers::release_ptr(void* ptr)
+{
+  if (ptr == NULL) {
+    return;
+  }
+  for (size_t hidx=0; hidx < held.size(); hidx++) {
+    if (held[hidx].ptr == ptr) {
+      held[hidx].fn(ptr);
+      held[hidx] = held.back();
+      held.pop_back();
+      return;
+    }
+  }
+}
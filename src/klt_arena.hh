@@ -0,0 +1,143 @@
+// Karhunen-Loève Transform Library
+// Single-block buffer arena with hugepage backing and a shape pool
+
+#ifndef __KLT_ARENA_HH__
+#define __KLT_ARENA_HH__
+
+#include <cstddef>
+#include <vector>
+
+//---------------------------------------------------------------------------
+// One allocation carved into cache-line partitioned buffers
+//   Lay out first (reserve() each buffer, in bytes), then commit() allocates
+//   the block and ptr() turns offsets into buffers.  Every buffer starts on
+//   its own ALIGN boundary, so no two share a cache line.
+//   Released blocks go to a process-wide pool keyed by size: an instance of
+//   the same shape takes its block back without the system allocator.
+//   With hugepages on, blocks are carved from 2 MB hugepage slabs
+//   (MAP_HUGETLB, else transparent hugepages via madvise), so many small
+//   instances share a few TLB entries.  Slab memory is only recycled, never
+//   returned to the system: released slab blocks stay pooled (and count to
+//   the pool limit), and a block too long for the rest of the current slab
+//   starts a new one, abandoning the shorter of the two unused tails.  So
+//   that pooled slab memory stays bounded, blocks are carved from slabs
+//   only while the pool is within its limit.
+//---------------------------------------------------------------------------
+class KLTArena
+{
+public:
+  //---------------------------------------------------------------------------
+  // Buffer alignment (bytes)
+  //---------------------------------------------------------------------------
+  static const size_t ALIGN = 128;
+
+  //---------------------------------------------------------------------------
+  // Constructor, destructor (returns the block to the pool)
+  //---------------------------------------------------------------------------
+  KLTArena();
+  ~KLTArena();
+
+  //---------------------------------------------------------------------------
+  // Reserve a buffer of bytes; returns its offset.  Only before commit().
+  //---------------------------------------------------------------------------
+  size_t reserve(size_t bytes);
+
+  //---------------------------------------------------------------------------
+  // Allocate the block (from the pool if one of the same size is free)
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void commit();
+
+  //---------------------------------------------------------------------------
+  // Buffer at offset (after commit())
+  //---------------------------------------------------------------------------
+  template <typename T>
+  T* ptr(size_t offset) const { return reinterpret_cast<T*>(base + offset); }
+
+  //---------------------------------------------------------------------------
+  // Block size (bytes)
+  //---------------------------------------------------------------------------
+  size_t size() const { return len; }
+
+  //---------------------------------------------------------------------------
+  // Process-wide settings
+  //   set_hugepages: carve new blocks from hugepage slabs? (default off)
+  //   set_pool_limit: bytes of released blocks kept for reuse (default
+  //                   64 MB, 0 frees system-allocated ones at once).
+  //   pool_bytes: bytes of released blocks held for reuse, slab ones
+  //               included.
+  //---------------------------------------------------------------------------
+  static void set_hugepages(bool use);
+  static void set_pool_limit(size_t bytes);
+  static size_t pool_bytes();
+
+private:
+  KLTArena(const KLTArena&);
+  KLTArena& operator=(const KLTArena&);
+
+  char* base;
+  size_t len;
+  bool slab;
+};
+
+//---------------------------------------------------------------------------
+// Owner of the buffers allocated one by one after construction (engine and
+// mode buffers sized by the settings), and of other resources handed over
+//   alloc() gives an ALIGN aligned buffer, adopt() takes anything with its
+//   own release function (an FFT plan), release() frees one early.  The
+//   rest go with the owner, so a class holding one leaks none of them when
+//   its constructor throws part way.
+//---------------------------------------------------------------------------
+class KLTBuffers
+{
+public:
+  typedef void (*Release)(void* ptr);
+
+  //---------------------------------------------------------------------------
+  // Constructor, destructor (releases everything held)
+  //---------------------------------------------------------------------------
+  KLTBuffers() {}
+  ~KLTBuffers();
+
+  //---------------------------------------------------------------------------
+  // Allocate count elements of T into buf, releasing its previous buffer
+  //   name labels the error.  If an error occurrs, throws std::runtime_error
+  //   (buf is then NULL).
+  //---------------------------------------------------------------------------
+  template <typename T>
+  void alloc(T*& buf, size_t count, const char* name)
+  {
+    release(buf);
+    buf = static_cast<T*>(alloc_bytes(count, sizeof(T), name));
+  }
+
+  //---------------------------------------------------------------------------
+  // Hold ptr (if not NULL) until released with fn
+  //---------------------------------------------------------------------------
+  void adopt(void* ptr, Release fn);
+
+  //---------------------------------------------------------------------------
+  // Release ptr now (if held) and set it to NULL
+  //---------------------------------------------------------------------------
+  template <typename T>
+  void release(T*& ptr)
+  {
+    release_ptr(ptr);
+    ptr = NULL;
+  }
+
+private:
+  KLTBuffers(const KLTBuffers&);
+  KLTBuffers& operator=(const KLTBuffers&);
+
+  void* alloc_bytes(size_t count, size_t size, const char* name);
+  void release_ptr(void* ptr);
+
+  struct Held {
+    void* ptr;
+    Release fn;
+  };
+  std::vector<Held> held;
+};
+
+#endif // __KLT_ARENA_HH__
@@ -0,0 +1,159 @@
+// Karhunen-Loève Transform Library
+// Multi-channel (space x lag) transform of array inputs
+
+#include "klt_array.hh"
+#include "klt_simd.hh"
+
+#include <algorithm>
+#include <complex>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <mkl_cblas.h> // MKL
+#include <mkl_lapacke.h> // MKL
+
+
+//---------------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------------
+KLTArray::KLTArray(int in_len, int num_chan, int num_lags, int num_eig) :
+  in_buf(NULL),
+  eval_buf(NULL),
+  kltc_buf(NULL),
+  kltb_buf(NULL),
+  in_len(in_len),
+  num_chan(num_chan),
+  num_lags(num_lags),
+  num_eig(num_eig),
+  snap_step(1),
+  snap_buf(NULL),
+  cov_buf(NULL),
+  w_buf(NULL),
+  isuppz_buf(NULL),
+  work_buf(NULL),
+  rwork_buf(NULL),
+  iwork_buf(NULL),
+  work_len(0),
+  rwork_len(0),
+  iwork_len(0)
+{
+  if (num_chan < 1 || num_lags < 1 || num_lags > in_len ||
+      num_eig < 1 || num_eig > num_chan * num_lags) {
+    std::ostringstream oss;
+    oss << "Invalid array KLT shape (in_len " << in_len << ", num_chan " << num_chan
+        << ", num_lags " << num_lags << ", num_eig " << num_eig << ")";
+    throw std::runtime_error(oss.str());
+  }
+  const int n = dim();
+  // cheevr workspace query
+  std::complex<float> work_opt;
+  float rwork_opt;
+  int iwork_opt;
+  int found;
+  lapack_int info = LAPACKE_cheevr_work(LAPACK_COL_MAJOR, 'V', 'I', 'L', n, NULL, n,
+                                        0.0f, 0.0f, n - num_eig + 1, n, 0.0f, &found,
+                                        NULL, NULL, n, NULL, &work_opt, -1,
+                                        &rwork_opt, -1, &iwork_opt, -1);
+  if (info) {
+    std::ostringstream oss;
+    oss << "cheevr workspace query failed: info " << info;
+    throw std::runtime_error(oss.str());
+  }
+  work_len = static_cast<int>(work_opt.real());
+  rwork_len = static_cast<int>(rwork_opt);
+  iwork_len = iwork_opt;
+  // One arena for all buffers
+  const size_t cf = sizeof(std::complex<float>);
+  const size_t in_off = arena.reserve(static_cast<size_t>(in_len) * num_chan * cf);
+  const size_t eval_off = arena.reserve(num_eig * sizeof(float));
+  const size_t kltc_off = arena.reserve(num_eig * cf);
+  const size_t kltb_off = arena.reserve(static_cast<size_t>(n) * num_eig * cf);
+  const size_t snap_off = arena.reserve(static_cast<size_t>(n) * SNAP_BLOCK * cf);
+  const size_t cov_off = arena.reserve(static_cast<size_t>(n) * n * cf);
+  const size_t w_off = arena.reserve(n * sizeof(float));
+  const size_t isuppz_off = arena.reserve(2 * n * sizeof(int));
+  const size_t work_off = arena.reserve(work_len * cf);
+  const size_t rwork_off = arena.reserve(rwork_len * sizeof(float));
+  const size_t iwork_off = arena.reserve(iwork_len * sizeof(int));
+  arena.commit();
+  in_buf = arena.ptr<std::complex<float> >(in_off);
+  eval_buf = arena.ptr<float>(eval_off);
+  kltc_buf = arena.ptr<std::complex<float> >(kltc_off);
+  kltb_buf = arena.ptr<std::complex<float> >(kltb_off);
+  snap_buf = arena.ptr<std::complex<float> >(snap_off);
+  cov_buf = arena.ptr<std::complex<float> >(cov_off);
+  w_buf = arena.ptr<float>(w_off);
+  isuppz_buf = arena.ptr<int>(isuppz_off);
+  work_buf = arena.ptr<std::complex<float> >(work_off);
+  rwork_buf = arena.ptr<float>(rwork_off);
+  iwork_buf = arena.ptr<int>(iwork_off);
+  memset(in_buf, 0, static_cast<size_t>(in_len) * num_chan * cf);
+  clear_outputs();
+}
+
+
+//---------------------------------------------------------------------------
+// Covariance snapshot step
+//---------------------------------------------------------------------------
+void KLTArray::set_snapshot_step(int step)
+{
+  if (step < 1 || step > in_len - num_lags + 1) {
+    std::ostringstream oss;
+    oss << "Invalid snapshot step " << step;
+    throw std::runtime_error(oss.str());
+  }
+  snap_step = step;
+}
+
+
+//---------------------------------------------------------------------------
+// Transform in
+//---------------------------------------------------------------------------
+void KLTArray::transform(const std::complex<float>* in)
+{
+  const int n = dim();
+  const int num_snap = (in_len - num_lags) / snap_step + 1;
+  // Block covariance, SNAP_BLOCK snapshots per rank-k update.  Snapshots
+  // overlap in the input (stride num_chan < n), so they are gathered first.
+  for (int sidx=0; sidx < num_snap; sidx += SNAP_BLOCK) {
+    const int blk_len = std::min(SNAP_BLOCK, num_snap - sidx);
+    for (int bidx=0; bidx < blk_len; bidx++) {
+      memcpy(&snap_buf[static_cast<size_t>(bidx) * n],
+             &in[static_cast<size_t>(sidx + bidx) * snap_step * num_chan],
+             n*sizeof(std::complex<float>));
+    }
+    cblas_cherk(CblasColMajor, CblasLower, CblasNoTrans, n, blk_len,
+                1.0f, snap_buf, n, sidx ? 1.0f : 0.0f, cov_buf, n);
+  }
+  // Top num_eig eigenpairs
+  int found = 0;
+  lapack_int info = LAPACKE_cheevr_work(LAPACK_COL_MAJOR, 'V', 'I', 'L', n, cov_buf, n,
+                                        0.0f, 0.0f, n - num_eig + 1, n, 0.0f, &found,
+                                        w_buf, kltb_buf, n, isuppz_buf,
+                                        work_buf, work_len, rwork_buf, rwork_len,
+                                        iwork_buf, iwork_len);
+  if (info || found != num_eig) {
+    clear_outputs();
+    std::ostringstream oss;
+    oss << "cheevr failed: info " << info << ", " << found << " of " << num_eig
+        << " eigenpairs";
+    throw std::runtime_error(oss.str());
+  }
+  memcpy(eval_buf, w_buf, num_eig*sizeof(float));
+  // Compute KLT coeffs, apply them to KLT basis functions
+  for (int cidx=0; cidx<num_eig; cidx++) {
+    kltc_buf[cidx] = klt_cdotc(in, &kltb_buf[static_cast<size_t>(cidx) * n], n);
+    klt_cscal(&kltb_buf[static_cast<size_t>(cidx) * n], kltc_buf[cidx], n);
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Set outputs to 0.0f
+//---------------------------------------------------------------------------
+void KLTArray::clear_outputs()
+{
+  memset(eval_buf, 0, num_eig*sizeof(float));
+  memset(kltc_buf, 0, num_eig*sizeof(std::complex<float>));
+  memset(kltb_buf, 0, static_cast<size_t>(dim()) * num_eig * sizeof(std::complex<float>));
+}
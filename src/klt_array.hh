@@ -0,0 +1,113 @@
+// Karhunen-Loève Transform Library
+// Multi-channel (space x lag) transform of array inputs
+
+#ifndef __KLT_ARRAY_HH__
+#define __KLT_ARRAY_HH__
+
+#include <complex>
+#include <cstddef>
+#include "klt_arena.hh"
+
+//---------------------------------------------------------------------------
+// Joint space-time KLT of num_chan channels
+//   Snapshot s stacks num_lags consecutive samples of every channel,
+//   element lidx*num_chan + cidx = channel cidx at time s + lidx, which is
+//   in[s*num_chan .. s*num_chan + dim()) of the interleaved input.  The block
+//   covariance (dim() x dim(), unnormalized like KLT's lags) is the sum of the
+//   snapshot outer products, built SNAP_BLOCK snapshots at a time with one
+//   rank-k Hermitian update (cherk) each; the top num_eig eigenpairs are then
+//   solved for jointly (cheevr, eigenvalues only in the wanted index range).
+//   Unlike the single-channel KLT, the covariance is not Toeplitz, so none of
+//   KLT's lag engines apply.
+//---------------------------------------------------------------------------
+class KLTArray
+{
+public:
+  //---------------------------------------------------------------------------
+  // Constructor
+  //   in_len: samples per channel.
+  //   num_chan: number of channels.
+  //   num_lags: lags per channel.
+  //   num_eig: number of eigenvalues / basis functions.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  KLTArray(int in_len, int num_chan, int num_lags, int num_eig);
+
+  //---------------------------------------------------------------------------
+  // Transform in (size in_len x num_chan, channel-interleaved)
+  //   Outputs are put in eval_buf, kltc_buf, and kltb_buf.
+  //   If an error occurrs, throws std::runtime_error and sets all of eval_buf,
+  //   kltc_buf, and kltb_buf to 0.0f.
+  //---------------------------------------------------------------------------
+  void transform(const std::complex<float>* in);
+
+  //---------------------------------------------------------------------------
+  // Covariance from every step-th snapshot (default 1)
+  //   Trades estimate variance for a proportionally cheaper update.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_snapshot_step(int step);
+
+  //---------------------------------------------------------------------------
+  // Snapshot length (num_chan x num_lags)
+  //---------------------------------------------------------------------------
+  int dim() const { return num_chan * num_lags; }
+
+  //---------------------------------------------------------------------------
+  // Snapshots per covariance update
+  //---------------------------------------------------------------------------
+  static const int SNAP_BLOCK = 128;
+
+  //---------------------------------------------------------------------------
+  // Input and output buffers
+  //   in_buf: input buffer (size in_len x num_chan).  It is optional to use
+  //           this, but may provide a performance benefit due to alignment.
+  //   eval_buf: eigenvalues, ascending (size num_eig).
+  //   kltc_buf: KLT coeffs of the first snapshot (size num_eig).
+  //   kltb_buf: weighted KLT basis functions (size dim() x num_eig), laid
+  //             out as the snapshots.
+  //---------------------------------------------------------------------------
+  std::complex<float>* in_buf;
+  float* eval_buf;
+  std::complex<float>* kltc_buf;
+  std::complex<float>* kltb_buf;
+
+private:
+  KLTArray(const KLTArray&);
+  KLTArray& operator=(const KLTArray&);
+
+  //---------------------------------------------------------------------------
+  // Set outputs to 0.0f
+  //---------------------------------------------------------------------------
+  void clear_outputs();
+
+  //---------------------------------------------------------------------------
+  // Config
+  //---------------------------------------------------------------------------
+  const int in_len;
+  const int num_chan;
+  const int num_lags;
+  const int num_eig;
+  int snap_step;
+
+  //---------------------------------------------------------------------------
+  // Scratch buffers (one arena)
+  //   snap_buf: gathered snapshots (size dim() x SNAP_BLOCK).
+  //   cov_buf: block covariance, lower triangle (size dim() x dim()).
+  //   w_buf: eigenvalues found (size dim()).
+  //   isuppz_buf, work_buf, rwork_buf, iwork_buf: cheevr workspace.
+  //---------------------------------------------------------------------------
+  KLTArena arena;
+  std::complex<float>* snap_buf;
+  std::complex<float>* cov_buf;
+  float* w_buf;
+  int* isuppz_buf;
+  std::complex<float>* work_buf;
+  float* rwork_buf;
+  int* iwork_buf;
+  int work_len;
+  int rwork_len;
+  int iwork_len;
+};
+
+#endif // __KLT_ARRAY_HH__
@@ -0,0 +1,316 @@
+// Karhunen-Loève Transform Library
+// Batched multi-frame transform
+
+#include "klt_batch.hh"
+
+#include <algorithm>
+#include <complex>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <omp.h>
+#include <mkl_service.h> // MKL
+
+//---------------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------------
+KLTBatch::KLTBatch(int in_len,
+#if KLT_SUPPORT_EVALN
+                   int eval_normalized,
+#endif
+                   int acm_order,
+                   int num_eig,
+                   int num_threads) :
+  in_len(in_len),
+#if KLT_SUPPORT_EVALN
+  eval_normalized(eval_normalized),
+#endif
+  acm_order(acm_order),
+  num_eig(num_eig),
+  num_threads(num_threads > 0 ? num_threads : omp_get_max_threads()),
+  acorr_sel(KLT::ACORR_AUTO),
+  eig_sel(KLT::EIG_AUTO),
+  out_mask(KLT::OUT_ALL),
+  mo_rule(KLT::ORDER_FIXED),
+  cov_sel(KLT::COV_TOEPLITZ),
+  win_sel(KLT::WIN_NONE),
+  prec_sel(KLT::PREC_SINGLE),
+  prec_refine(false),
+  klts(this->num_threads, static_cast<KLT*>(NULL))
+{
+  const bool use_lanes = acm_order <= LANES_MAX_ORDER;
+  if (use_lanes) {
+    lanes_klts.resize(this->num_threads, NULL);
+  }
+  // Build each worker's KLT on that worker (first-touch page placement)
+  std::string err_msg;
+#pragma omp parallel num_threads(this->num_threads)
+  {
+    const int tidx = omp_get_thread_num();
+    try {
+      klts[tidx] = new KLT(in_len,
+#if KLT_SUPPORT_EVALN
+                           eval_normalized,
+#endif
+                           acm_order, num_eig);
+      if (use_lanes) {
+        lanes_klts[tidx] = new KLTLanes(in_len, acm_order, num_eig);
+      }
+    } catch (std::runtime_error& err) {
+#pragma omp critical (klt_batch_err)
+      err_msg = err.what();
+    }
+  }
+  // The runtime may have granted fewer threads than asked for
+  int num_built = 0;
+  while (num_built < this->num_threads && klts[num_built] != NULL) {
+    num_built++;
+  }
+  if (!err_msg.empty() || num_built == 0) {
+    for (size_t tidx=0; tidx < klts.size(); tidx++) {
+      delete klts[tidx];
+    }
+    for (size_t tidx=0; tidx < lanes_klts.size(); tidx++) {
+      delete lanes_klts[tidx];
+    }
+    std::ostringstream oss;
+    oss << "Failed to create KLT workers: " << err_msg;
+    throw std::runtime_error(oss.str());
+  }
+  this->num_threads = num_built;
+  klts.resize(num_built);
+  if (use_lanes) {
+    lanes_klts.resize(num_built);
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------------
+KLTBatch::~KLTBatch()
+{
+  for (size_t tidx=0; tidx < klts.size(); tidx++) {
+    delete klts[tidx];
+  }
+  for (size_t tidx=0; tidx < lanes_klts.size(); tidx++) {
+    delete lanes_klts[tidx];
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Transform a batch of frames
+//   If any frame fails, its outputs are set to 0.0f and std::runtime_error is
+//   thrown once the whole batch is done.
+//---------------------------------------------------------------------------
+void KLTBatch::transform(const std::complex<float>* in, int num_frames,
+                         float* eval, std::complex<float>* kltc,
+                         std::complex<float>* kltb, int* order)
+{
+  const size_t kltb_size = static_cast<size_t>(acm_order) * num_eig;
+  const bool use_lanes = lanes();
+  int num_failed = 0;
+  std::string err_msg;
+#pragma omp parallel num_threads(num_threads)
+  {
+    const int tidx = omp_get_thread_num();
+    // One MKL thread per worker, the workers already fill the cores
+    const int mkl_threads = mkl_set_num_threads_local(1);
+    if (use_lanes) {
+      // KLTLanes::LANES frames per task
+      KLTLanes& klt = *lanes_klts[tidx];
+#pragma omp for schedule(dynamic, 1)
+      for (int fidx=0; fidx < num_frames; fidx += KLTLanes::LANES) {
+        const int num_lanes = std::min(KLTLanes::LANES, num_frames - fidx);
+        try {
+          klt.transform(&in[static_cast<size_t>(fidx) * in_len], num_lanes,
+                        &eval[static_cast<size_t>(fidx) * num_eig],
+                        &kltc[static_cast<size_t>(fidx) * num_eig],
+                        &kltb[fidx * kltb_size]);
+        } catch (std::runtime_error& err) {
+#pragma omp critical (klt_batch_err)
+          {
+            if (num_failed == 0) {
+              err_msg = err.what();
+            }
+            num_failed += klt.failed();
+          }
+        }
+        // Fixed order, 0 for failed frames
+        if (order != NULL) {
+          for (int lidx=0; lidx < num_lanes; lidx++) {
+            order[fidx + lidx] = klt.frame_ok(lidx) ? num_eig : 0;
+          }
+        }
+      }
+    } else {
+      KLT& klt = *klts[tidx];
+#pragma omp for schedule(dynamic, 1)
+      for (int fidx=0; fidx < num_frames; fidx++) {
+        // Only the selected outputs are copied (the others may be NULL)
+        float* f_eval = (out_mask & KLT::OUT_EVAL) ?
+          &eval[static_cast<size_t>(fidx) * num_eig] : NULL;
+        std::complex<float>* f_kltc = (out_mask & KLT::OUT_KLTC) ?
+          &kltc[static_cast<size_t>(fidx) * num_eig] : NULL;
+        std::complex<float>* f_kltb = (out_mask & KLT::OUT_KLTB) ?
+          &kltb[fidx * kltb_size] : NULL;
+        try {
+          klt.transform(&in[static_cast<size_t>(fidx) * in_len]);
+          if (f_eval != NULL) {
+            memcpy(f_eval, klt.eval_buf, num_eig*sizeof(float));
+          }
+          if (f_kltc != NULL) {
+            memcpy(f_kltc, klt.kltc_buf, num_eig*sizeof(std::complex<float>));
+          }
+          if (f_kltb != NULL) {
+            memcpy(f_kltb, klt.kltb_buf, kltb_size*sizeof(std::complex<float>));
+          }
+          if (order != NULL) {
+            order[fidx] = klt.model_order();
+          }
+        } catch (std::runtime_error& err) {
+          if (f_eval != NULL) {
+            memset(f_eval, 0, num_eig*sizeof(float));
+          }
+          if (f_kltc != NULL) {
+            memset(f_kltc, 0, num_eig*sizeof(std::complex<float>));
+          }
+          if (f_kltb != NULL) {
+            memset(f_kltb, 0, kltb_size*sizeof(std::complex<float>));
+          }
+          if (order != NULL) {
+            order[fidx] = 0;
+          }
+#pragma omp critical (klt_batch_err)
+          {
+            if (num_failed++ == 0) {
+              err_msg = err.what();
+            }
+          }
+        }
+      }
+    }
+    mkl_set_num_threads_local(mkl_threads);
+  }
+  if (num_failed) {
+    std::ostringstream oss;
+    oss << num_failed << " of " << num_frames << " frames failed, first: " << err_msg;
+    throw std::runtime_error(oss.str());
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Select engines of all workers
+//---------------------------------------------------------------------------
+void KLTBatch::set_acorr_engine(KLT::AcorrEngine engine)
+{
+  acorr_sel = engine;
+  for (size_t tidx=0; tidx < klts.size(); tidx++) {
+    klts[tidx]->set_acorr_engine(engine);
+  }
+}
+
+void KLTBatch::set_eig_engine(KLT::EigEngine engine)
+{
+  eig_sel = engine;
+  for (size_t tidx=0; tidx < klts.size(); tidx++) {
+    klts[tidx]->set_eig_engine(engine);
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Select model order rule of all workers
+//---------------------------------------------------------------------------
+void KLTBatch::set_model_order(KLT::OrderRule rule, float energy_frac)
+{
+  for (size_t tidx=0; tidx < klts.size(); tidx++) {
+    klts[tidx]->set_model_order(rule, energy_frac);
+  }
+  mo_rule = rule;
+}
+
+
+//---------------------------------------------------------------------------
+// Select covariance estimator of all workers
+//---------------------------------------------------------------------------
+void KLTBatch::set_covariance(KLT::CovEstimator est, bool fwd_bwd)
+{
+  for (size_t tidx=0; tidx < klts.size(); tidx++) {
+    klts[tidx]->set_covariance(est, fwd_bwd, 0.0f);
+  }
+  cov_sel = est;
+}
+
+
+//---------------------------------------------------------------------------
+// Select lag precision of all workers
+//---------------------------------------------------------------------------
+void KLTBatch::set_precision(KLT::Precision prec, bool refine)
+{
+  for (size_t tidx=0; tidx < klts.size(); tidx++) {
+    klts[tidx]->set_precision(prec, refine);
+  }
+  prec_sel = prec;
+  prec_refine = refine;
+}
+
+
+//---------------------------------------------------------------------------
+// Select window of all workers
+//---------------------------------------------------------------------------
+void KLTBatch::set_window(KLT::WindowType type, float param)
+{
+  for (size_t tidx=0; tidx < klts.size(); tidx++) {
+    klts[tidx]->set_window(type, param);
+  }
+  win_sel = type;
+}
+
+void KLTBatch::set_window(const float* taps)
+{
+  for (size_t tidx=0; tidx < klts.size(); tidx++) {
+    klts[tidx]->set_window(taps);
+  }
+  win_sel = KLT::WIN_USER;
+}
+
+
+//---------------------------------------------------------------------------
+// Select outputs of all workers
+//---------------------------------------------------------------------------
+void KLTBatch::set_outputs(int outputs)
+{
+  if (outputs & KLT::OUT_KLTS) {
+    throw std::runtime_error("Sliding KLT coeffs are not a batch output");
+  }
+  for (size_t tidx=0; tidx < klts.size(); tidx++) {
+    klts[tidx]->set_outputs(outputs);
+  }
+  out_mask = outputs;
+}
+
+
+#if KLT_SUPPORT_STATS
+//---------------------------------------------------------------------------
+// Stats summed over the workers, reset
+//---------------------------------------------------------------------------
+KLTStats KLTBatch::stats() const
+{
+  KLTStats sum;
+  for (size_t tidx=0; tidx < klts.size(); tidx++) {
+    sum += klts[tidx]->stats();
+  }
+  return sum;
+}
+
+void KLTBatch::reset_stats()
+{
+  for (size_t tidx=0; tidx < klts.size(); tidx++) {
+    klts[tidx]->reset_stats();
+  }
+}
+#endif
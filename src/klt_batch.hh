@@ -0,0 +1,164 @@
+// Karhunen-Loève Transform Library
+// Batched multi-frame transform
+
+#ifndef __KLT_BATCH_HH__
+#define __KLT_BATCH_HH__
+
+#include <complex>
+#include <vector>
+#include "klt.hh"
+#include "klt_lanes.hh"
+
+class KLTBatch
+{
+public:
+  //---------------------------------------------------------------------------
+  // Constructor
+  //   in_len, eval_normalized, acm_order, num_eig: see KLT.
+  //   num_threads: worker threads (0: OpenMP default).  Each worker owns a
+  //                KLT (and so its scratch buffers), built on that worker.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  KLTBatch(int in_len,
+#if KLT_SUPPORT_EVALN
+           int eval_normalized,
+#endif
+           int acm_order,
+           int num_eig,
+           int num_threads);
+
+  //---------------------------------------------------------------------------
+  // Destructor
+  //---------------------------------------------------------------------------
+  ~KLTBatch();
+
+  //---------------------------------------------------------------------------
+  // Transform num_frames independent frames spread across the workers.  MKL
+  // runs sequentially inside each worker.
+  //   in: input frames (size num_frames x in_len).
+  //   eval: output eigenvalues (size num_frames x num_eig).
+  //   kltc: output KLT coeffs (size num_frames x num_eig).
+  //   kltb: output weighted KLT basis functions
+  //         (size num_frames x acm_order x num_eig).
+  //   order: output model orders (size num_frames, see KLT::model_order()),
+  //          or NULL.
+  //   Each frame's outputs are laid out as KLT's eval_buf, kltc_buf and
+  //   kltb_buf; outputs not selected (see set_outputs()) are not written and
+  //   may be NULL.  For acm_order <= LANES_MAX_ORDER with both engines on
+  //   AUTO, all outputs selected, a fixed model order, the Toeplitz
+  //   covariance, no window and no eigenvalue normalization, frames go
+  //   KLTLanes::LANES at a time through the lane-parallel solver.
+  //   If any frame fails, its outputs are set to 0.0f, the rest of the batch
+  //   still completes, and then std::runtime_error is thrown.
+  //---------------------------------------------------------------------------
+  void transform(const std::complex<float>* in, int num_frames,
+                 float* eval, std::complex<float>* kltc, std::complex<float>* kltb,
+                 int* order = NULL);
+
+  //---------------------------------------------------------------------------
+  // Select engines of all workers (see KLT).
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_acorr_engine(KLT::AcorrEngine engine);
+  void set_eig_engine(KLT::EigEngine engine);
+
+  //---------------------------------------------------------------------------
+  // Select model order rule of all workers (see KLT::set_model_order()).
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_model_order(KLT::OrderRule rule, float energy_frac);
+
+  //---------------------------------------------------------------------------
+  // Select covariance estimator of all workers (see KLT::set_covariance();
+  // frames are independent, so nothing is accumulated across them).
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_covariance(KLT::CovEstimator est, bool fwd_bwd);
+
+  //---------------------------------------------------------------------------
+  // Select lag precision of all workers (see KLT::set_precision()).
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_precision(KLT::Precision prec, bool refine);
+
+  //---------------------------------------------------------------------------
+  // Select window of all workers (see KLT::set_window(); the workers share
+  // the table).
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_window(KLT::WindowType type, float param = 0.0f);
+  void set_window(const float* taps);
+
+  //---------------------------------------------------------------------------
+  // Select outputs of all workers (see KLT::set_outputs(); OUT_KLTS is not
+  // a batch output).
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void set_outputs(int outputs);
+
+  //---------------------------------------------------------------------------
+  // Number of worker threads
+  //---------------------------------------------------------------------------
+  int threads() const { return num_threads; }
+
+#if KLT_SUPPORT_STATS
+  //---------------------------------------------------------------------------
+  // Sum of the workers' KLT stats (frames through KLTLanes are not timed),
+  // and reset them
+  //---------------------------------------------------------------------------
+  KLTStats stats() const;
+  void reset_stats();
+
+#endif
+
+  //---------------------------------------------------------------------------
+  // Does transform() use the lane-parallel solver (KLTLanes)?
+  //---------------------------------------------------------------------------
+  bool lanes() const
+  {
+#if KLT_SUPPORT_EVALN
+    // KLTLanes does not normalize the eigenvalues
+    if (eval_normalized) {
+      return false;
+    }
+#endif
+    return !lanes_klts.empty() && acorr_sel == KLT::ACORR_AUTO && eig_sel == KLT::EIG_AUTO &&
+      out_mask == KLT::OUT_ALL && mo_rule == KLT::ORDER_FIXED &&
+      cov_sel == KLT::COV_TOEPLITZ && win_sel == KLT::WIN_NONE && prec_sel == KLT::PREC_SINGLE &&
+      !prec_refine;
+  }
+
+  //---------------------------------------------------------------------------
+  // Largest acm_order sent through KLTLanes
+  //---------------------------------------------------------------------------
+  static const int LANES_MAX_ORDER = 32;
+
+private:
+  //---------------------------------------------------------------------------
+  // Config
+  //---------------------------------------------------------------------------
+  const int in_len;
+#if KLT_SUPPORT_EVALN
+  const int eval_normalized;
+#endif
+  const int acm_order;
+  const int num_eig;
+  int num_threads;
+  KLT::AcorrEngine acorr_sel;
+  KLT::EigEngine eig_sel;
+  int out_mask;
+  KLT::OrderRule mo_rule;
+  KLT::CovEstimator cov_sel;
+  KLT::WindowType win_sel;
+  KLT::Precision prec_sel;
+  bool prec_refine;
+
+  //---------------------------------------------------------------------------
+  // Per-worker transforms (index: OpenMP thread number)
+  //   lanes_klts: lane-parallel transforms (empty if acm_order is too large).
+  //---------------------------------------------------------------------------
+  std::vector<KLT*> klts;
+  std::vector<KLTLanes*> lanes_klts;
+};
+
+#endif // __KLT_BATCH_HH__
@@ -0,0 +1,299 @@
+// Karhunen-Loève Transform Library
+// Compact output stream: separate, delta-coded eigenvectors
+
+#include "klt_compact.hh"
+#include "klt_simd.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+static const char MAGIC[4] = {'K', 'L', 'T', 'Z'};
+static const size_t REC_HDR_LEN = 8;
+static const int MAX_QUANT_BITS = 24;
+
+// Record bytes before the basis payload
+static size_t rec_fixed_len(int num_eig)
+{
+  return REC_HDR_LEN + num_eig * (sizeof(float) + sizeof(std::complex<float>));
+}
+
+template <typename T>
+static void append(std::vector<uint8_t>& out, const T* vals, size_t num)
+{
+  const size_t pos = out.size();
+  out.resize(pos + num * sizeof(T));
+  memcpy(&out[pos], vals, num * sizeof(T));
+}
+
+static int32_t read_i32(const uint8_t* ptr)
+{
+  int32_t val;
+  memcpy(&val, ptr, sizeof(val));
+  return val;
+}
+
+static void corrupt(long fidx)
+{
+  std::ostringstream oss;
+  oss << "Corrupt compact KLT record (frame " << fidx << ")";
+  throw std::runtime_error(oss.str());
+}
+
+
+//---------------------------------------------------------------------------
+// Weighted basis functions
+//---------------------------------------------------------------------------
+void klt_weight_basis(const std::complex<float>* basis, const std::complex<float>* kltc,
+                      int acm_order, int num_eig, std::complex<float>* kltb)
+{
+  memcpy(kltb, basis, static_cast<size_t>(acm_order) * num_eig * sizeof(std::complex<float>));
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    klt_cscal(&kltb[static_cast<size_t>(eidx) * acm_order], kltc[eidx], acm_order);
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Encoder
+//---------------------------------------------------------------------------
+KLTCompactWriter::KLTCompactWriter(int acm_order, int num_eig, int quant_bits,
+                                   int key_interval) :
+  acm_order(acm_order),
+  num_eig(num_eig),
+  quant_bits(quant_bits),
+  key_interval(key_interval),
+  num_frames(0),
+  prev(2 * static_cast<size_t>(std::max(acm_order, 0)) * std::max(num_eig, 0), 0)
+{
+  if (acm_order < 1 || num_eig < 1 || num_eig > acm_order ||
+      quant_bits < 0 || quant_bits > MAX_QUANT_BITS || key_interval < 0) {
+    std::ostringstream oss;
+    oss << "Invalid compact KLT stream (acm_order " << acm_order << ", num_eig " << num_eig
+        << ", quant_bits " << quant_bits << ", key_interval " << key_interval << ")";
+    throw std::runtime_error(oss.str());
+  }
+}
+
+void KLTCompactWriter::encode(const float* eval, const std::complex<float>* kltc,
+                              const std::complex<float>* basis)
+{
+  out.clear();
+  if (num_frames == 0) {
+    const int32_t hdr[5] = {KLT_COMPACT_VERSION, acm_order, num_eig, quant_bits, key_interval};
+    append(out, MAGIC, sizeof(MAGIC));
+    append(out, hdr, 5);
+  }
+  const bool key = num_frames == 0 || (key_interval > 0 && num_frames % key_interval == 0);
+  if (key) {
+    std::fill(prev.begin(), prev.end(), 0);
+  }
+  const size_t rec = out.size();
+  out.resize(rec + REC_HDR_LEN, 0);
+  out[rec] = key ? 1 : 0;
+  append(out, eval, num_eig);
+  append(out, kltc, num_eig);
+
+  // Basis payload
+  const size_t payload = out.size();
+  const float* vals = reinterpret_cast<const float*>(basis);
+  const size_t num_vals = prev.size();
+  if (quant_bits == 0) {
+    for (size_t gidx=0; gidx < num_vals; gidx += 4) {
+      const size_t ctl = out.size();
+      out.push_back(0);
+      const size_t grp_len = std::min<size_t>(4, num_vals - gidx);
+      for (size_t vidx=0; vidx < grp_len; vidx++) {
+        uint32_t bits;
+        memcpy(&bits, &vals[gidx + vidx], sizeof(bits));
+        const uint32_t x = bits ^ prev[gidx + vidx];
+        prev[gidx + vidx] = bits;
+        const int num_bytes = x < (1u << 8) ? 1 : x < (1u << 16) ? 2 : x < (1u << 24) ? 3 : 4;
+        out[ctl] |= static_cast<uint8_t>((num_bytes - 1) << (2 * vidx));
+        for (int bidx=0; bidx < num_bytes; bidx++) {
+          out.push_back(static_cast<uint8_t>(x >> (8 * bidx)));
+        }
+      }
+    }
+  } else {
+    const float scale = std::ldexp(1.0f, quant_bits);
+    const float lim = std::ldexp(1.0f, 30);
+    for (size_t vidx=0; vidx < num_vals; vidx++) {
+      const float x = vals[vidx] * scale;
+      const int32_t q = x >= lim ? static_cast<int32_t>(lim) :
+        x <= -lim ? -static_cast<int32_t>(lim) :
+        x == x ? static_cast<int32_t>(std::lrint(x)) : 0;
+      // Zigzag: small changes of either sign take few varint bytes
+      const uint32_t dif = static_cast<uint32_t>(q) - prev[vidx];
+      uint32_t zz = (dif << 1) ^ (0u - (dif >> 31));
+      prev[vidx] = static_cast<uint32_t>(q);
+      while (zz >= 0x80) {
+        out.push_back(static_cast<uint8_t>(zz | 0x80));
+        zz >>= 7;
+      }
+      out.push_back(static_cast<uint8_t>(zz));
+    }
+  }
+  const uint32_t payload_len = static_cast<uint32_t>(out.size() - payload);
+  memcpy(&out[rec + 4], &payload_len, sizeof(payload_len));
+  num_frames++;
+}
+
+
+//---------------------------------------------------------------------------
+// Decoder
+//---------------------------------------------------------------------------
+KLTCompactReader::KLTCompactReader(const void* data, size_t len) :
+  base(static_cast<const uint8_t*>(data)),
+  len(len),
+  order(0),
+  neig(0),
+  qbits(0),
+  cur(-1),
+  kltb_frame(-1)
+{
+  if (len < KLT_COMPACT_HDR_LEN || memcmp(base, MAGIC, sizeof(MAGIC)) != 0) {
+    throw std::runtime_error("Not a compact KLT stream");
+  }
+  const int version = read_i32(&base[4]);
+  order = read_i32(&base[8]);
+  neig = read_i32(&base[12]);
+  qbits = read_i32(&base[16]);
+  if (version != KLT_COMPACT_VERSION || order < 1 || neig < 1 || neig > order ||
+      qbits < 0 || qbits > MAX_QUANT_BITS || read_i32(&base[20]) < 0) {
+    std::ostringstream oss;
+    oss << "Unsupported compact KLT stream (version " << version << ", acm_order " << order
+        << ", num_eig " << neig << ", quant_bits " << qbits << ")";
+    throw std::runtime_error(oss.str());
+  }
+  // Index the records
+  const size_t fixed_len = rec_fixed_len(neig);
+  for (size_t off=KLT_COMPACT_HDR_LEN; off < len; ) {
+    const long fidx = static_cast<long>(rec_off.size());
+    if (len - off < fixed_len || (fidx == 0 && base[off] != 1)) {
+      corrupt(fidx);
+    }
+    uint32_t payload_len;
+    memcpy(&payload_len, &base[off + 4], sizeof(payload_len));
+    if (len - off - fixed_len < payload_len) {
+      corrupt(fidx);
+    }
+    rec_off.push_back(off);
+    off += fixed_len + payload_len;
+  }
+  const size_t basis_len = static_cast<size_t>(order) * neig;
+  eval_buf.resize(neig);
+  kltc_buf.resize(neig);
+  basis_buf.resize(basis_len);
+  prev.resize(2 * basis_len);
+  kltb_buf.resize(basis_len);
+}
+
+bool KLTCompactReader::next()
+{
+  if (cur + 1 >= frames()) {
+    return false;
+  }
+  decode(cur + 1);
+  return true;
+}
+
+void KLTCompactReader::seek(long fidx)
+{
+  if (fidx < 0 || fidx > frames()) {
+    std::ostringstream oss;
+    oss << "Compact KLT seek to frame " << fidx << " of " << frames();
+    throw std::runtime_error(oss.str());
+  }
+  if (fidx == cur + 1) {
+    return;
+  }
+  // Decode up to the frame before, from its key frame unless the frames
+  // since are already decoded
+  long kidx = std::min(fidx, frames() - 1);
+  while (kidx > 0 && base[rec_off[kidx]] != 1) {
+    kidx--;
+  }
+  if (cur >= kidx && cur < fidx) {
+    kidx = cur + 1;
+  }
+  cur = kidx - 1;
+  while (cur + 1 < fidx) {
+    decode(cur + 1);
+  }
+}
+
+const std::complex<float>* KLTCompactReader::kltb()
+{
+  if (kltb_frame != cur && cur >= 0) {
+    klt_weight_basis(&basis_buf[0], &kltc_buf[0], order, neig, &kltb_buf[0]);
+    kltb_frame = cur;
+  }
+  return &kltb_buf[0];
+}
+
+//---------------------------------------------------------------------------
+// Decode record fidx (a key frame, or the one after the last decoded)
+//---------------------------------------------------------------------------
+void KLTCompactReader::decode(long fidx)
+{
+  const uint8_t* rec = &base[rec_off[fidx]];
+  uint32_t payload_len;
+  memcpy(&payload_len, &rec[4], sizeof(payload_len));
+  if (rec[0] == 1) {
+    std::fill(prev.begin(), prev.end(), 0);
+  }
+  const uint8_t* ptr = &rec[REC_HDR_LEN];
+  memcpy(&eval_buf[0], ptr, neig * sizeof(float));
+  ptr += neig * sizeof(float);
+  memcpy(&kltc_buf[0], ptr, neig * sizeof(std::complex<float>));
+  ptr += neig * sizeof(std::complex<float>);
+
+  // Basis payload
+  const uint8_t* end = ptr + payload_len;
+  float* vals = reinterpret_cast<float*>(&basis_buf[0]);
+  const size_t num_vals = prev.size();
+  if (qbits == 0) {
+    for (size_t gidx=0; gidx < num_vals; gidx += 4) {
+      if (ptr >= end) {
+        corrupt(fidx);
+      }
+      const uint8_t ctl = *ptr++;
+      const size_t grp_len = std::min<size_t>(4, num_vals - gidx);
+      for (size_t vidx=0; vidx < grp_len; vidx++) {
+        const int num_bytes = ((ctl >> (2 * vidx)) & 3) + 1;
+        if (end - ptr < num_bytes) {
+          corrupt(fidx);
+        }
+        uint32_t x = 0;
+        for (int bidx=0; bidx < num_bytes; bidx++) {
+          x |= static_cast<uint32_t>(*ptr++) << (8 * bidx);
+        }
+        const uint32_t bits = x ^ prev[gidx + vidx];
+        prev[gidx + vidx] = bits;
+        memcpy(&vals[gidx + vidx], &bits, sizeof(bits));
+      }
+    }
+  } else {
+    const float step = std::ldexp(1.0f, -qbits);
+    for (size_t vidx=0; vidx < num_vals; vidx++) {
+      uint32_t zz = 0;
+      for (int shift=0; ; shift += 7) {
+        if (ptr >= end || shift > 28) {
+          corrupt(fidx);
+        }
+        const uint8_t byte = *ptr++;
+        zz |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+          break;
+        }
+      }
+      const uint32_t dif = (zz >> 1) ^ (0u - (zz & 1));
+      prev[vidx] += dif;
+      vals[vidx] = static_cast<float>(static_cast<int32_t>(prev[vidx])) * step;
+    }
+  }
+  cur = fidx;
+}
@@ -0,0 +1,176 @@
+// Karhunen-Loève Transform Library
+// Compact output stream: separate, delta-coded eigenvectors
+
+#ifndef __KLT_COMPACT_HH__
+#define __KLT_COMPACT_HH__
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//---------------------------------------------------------------------------
+// Stream format (little-endian)
+//   Stream header (KLT_COMPACT_HDR_LEN bytes): magic "KLTZ", int32 version,
+//   acm_order, num_eig, quant_bits, key_interval.
+//   Frame record: uint8 key (1 key frame, 0 delta), 3 bytes 0, uint32
+//   basis payload bytes, then eigenvalues (float x num_eig), KLT coeffs
+//   (complex float x num_eig) and the basis payload: the unweighted
+//   eigenvectors (acm_order x num_eig complex, as KLT's kltb_buf without
+//   OUT_KLTB), 2 x acm_order x num_eig floats, each coded against the same
+//   float of the previous frame (of 0.0f in a key frame):
+//     quant_bits 0 (lossless): bit patterns XORed with the previous one,
+//       4 per group: a control byte (2 bits each, low first: bytes - 1)
+//       then each XOR's low 1..4 bytes.  Values that agree in sign,
+//       exponent and leading mantissa bits cost 1 or 2 bytes.
+//     quant_bits b (1..24): rounded to multiples of 2^-b (components of
+//       unit vectors are in [-1, 1]), the integer's change from the previous
+//       one zigzag varint coded.  The previous frame is the decoded one, so
+//       errors do not build up.
+//   Key frames every key_interval frames (0: only the first) bound the
+//   decoding work of a seek.  Eigenvectors delta-code well only if their
+//   phase is stable from frame to frame: see KLT::set_canonical_phase().
+//---------------------------------------------------------------------------
+static const size_t KLT_COMPACT_HDR_LEN = 24;
+static const int KLT_COMPACT_VERSION = 1;
+
+//---------------------------------------------------------------------------
+// Weighted basis functions from the unweighted ones (KLT's kltb_buf with
+// and without OUT_KLTB): kltb column e = basis column e x kltc[e]
+//---------------------------------------------------------------------------
+void klt_weight_basis(const std::complex<float>* basis, const std::complex<float>* kltc,
+                      int acm_order, int num_eig, std::complex<float>* kltb);
+
+//---------------------------------------------------------------------------
+// Encoder
+//---------------------------------------------------------------------------
+class KLTCompactWriter
+{
+public:
+  //---------------------------------------------------------------------------
+  // Constructor
+  //   acm_order, num_eig: see KLT.
+  //   quant_bits: 0 lossless, else eigenvector quantization step 2^-bits
+  //               (1..24).
+  //   key_interval: frames per key frame (0: only the first).
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  KLTCompactWriter(int acm_order, int num_eig, int quant_bits, int key_interval);
+
+  //---------------------------------------------------------------------------
+  // Encode the next frame
+  //   eval, kltc: eigenvalues and KLT coeffs (size num_eig).
+  //   basis: unweighted eigenvectors (size acm_order x num_eig).
+  //   The record (after the stream header, for the first frame) is in
+  //   data()[0..size()) until the next call.
+  //---------------------------------------------------------------------------
+  void encode(const float* eval, const std::complex<float>* kltc,
+              const std::complex<float>* basis);
+
+  //---------------------------------------------------------------------------
+  // Last encoded bytes
+  //---------------------------------------------------------------------------
+  const uint8_t* data() const { return &out[0]; }
+  size_t size() const { return out.size(); }
+
+  //---------------------------------------------------------------------------
+  // Frames encoded
+  //---------------------------------------------------------------------------
+  long frames() const { return num_frames; }
+
+private:
+  const int acm_order;
+  const int num_eig;
+  const int quant_bits;
+  const int key_interval;
+  long num_frames;
+
+  //---------------------------------------------------------------------------
+  // prev: previous frame's basis floats, as bit patterns (lossless) or
+  //       quantized integers.
+  // out: encoded record.
+  //---------------------------------------------------------------------------
+  std::vector<uint32_t> prev;
+  std::vector<uint8_t> out;
+};
+
+//---------------------------------------------------------------------------
+// Decoder of a whole stream in memory (e.g. a mapped file, see KLTInFile)
+//   The constructor indexes the records (headers only), so frames() and
+//   seek() are available up front; next() decodes a frame and kltb() weights
+//   its basis only when asked for.
+//---------------------------------------------------------------------------
+class KLTCompactReader
+{
+public:
+  //---------------------------------------------------------------------------
+  // Constructor
+  //   data: the stream (size len bytes), kept by the caller while in use.
+  //   If an error occurrs (bad header, truncated record), throws
+  //   std::runtime_error.
+  //---------------------------------------------------------------------------
+  KLTCompactReader(const void* data, size_t len);
+
+  //---------------------------------------------------------------------------
+  // Decode the next frame into eval_buf, kltc_buf and basis_buf; false at
+  // the end of the stream
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  bool next();
+
+  //---------------------------------------------------------------------------
+  // Position so that next() decodes frame fidx (decodes from the key frame
+  // at or before it)
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void seek(long fidx);
+
+  //---------------------------------------------------------------------------
+  // Weighted basis functions of the last decoded frame, laid out as KLT's
+  // kltb_buf with OUT_KLTB (size acm_order x num_eig), computed on first
+  // call per frame
+  //---------------------------------------------------------------------------
+  const std::complex<float>* kltb();
+
+  //---------------------------------------------------------------------------
+  // Stream shape and coding
+  //---------------------------------------------------------------------------
+  int acm_order() const { return order; }
+  int num_eig() const { return neig; }
+  int quant_bits() const { return qbits; }
+  long frames() const { return static_cast<long>(rec_off.size()); }
+
+  //---------------------------------------------------------------------------
+  // Last decoded frame (-1 before the first)
+  //   eval_buf: eigenvalues (size num_eig).
+  //   kltc_buf: KLT coeffs (size num_eig).
+  //   basis_buf: unweighted eigenvectors (size acm_order x num_eig).
+  //---------------------------------------------------------------------------
+  long frame() const { return cur; }
+  std::vector<float> eval_buf;
+  std::vector<std::complex<float> > kltc_buf;
+  std::vector<std::complex<float> > basis_buf;
+
+private:
+  void decode(long fidx);
+
+  const uint8_t* base;
+  const size_t len;
+  int order;
+  int neig;
+  int qbits;
+
+  //---------------------------------------------------------------------------
+  // rec_off: byte offset of each frame record.
+  // cur: last decoded frame.
+  // prev: its basis floats, as bit patterns or quantized integers.
+  // kltb_buf, kltb_frame: weighted basis and the frame it belongs to.
+  //---------------------------------------------------------------------------
+  std::vector<size_t> rec_off;
+  long cur;
+  std::vector<uint32_t> prev;
+  std::vector<std::complex<float> > kltb_buf;
+  long kltb_frame;
+};
+
+#endif // __KLT_COMPACT_HH__
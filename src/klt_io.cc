@@ -0,0 +1,276 @@
+// Karhunen-Loève Transform Library
+// Raw and BLUE file I/O for standalone drivers
+
+#include "klt_io.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <complex>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// BLUE header layout (bytes)
+static const size_t BLUE_HDR_LEN = 512;
+static const size_t BLUE_HEAD_REP = 4;
+static const size_t BLUE_DATA_REP = 8;
+static const size_t BLUE_DATA_START = 32;
+static const size_t BLUE_DATA_SIZE = 40;
+static const size_t BLUE_TYPE = 48;
+static const size_t BLUE_FORMAT = 52;
+static const size_t BLUE_XSTART = 256;
+static const size_t BLUE_XDELTA = 264;
+static const size_t BLUE_XUNITS = 272;
+static const size_t BLUE_SUBSIZE = 276;
+static const size_t BLUE_YSTART = 280;
+static const size_t BLUE_YDELTA = 288;
+static const size_t BLUE_YUNITS = 296;
+
+template <typename T>
+static T get_field(const char* hdr, size_t offset)
+{
+  T val;
+  memcpy(&val, &hdr[offset], sizeof(T));
+  return val;
+}
+
+template <typename T>
+static void put_field(char* hdr, size_t offset, T val)
+{
+  memcpy(&hdr[offset], &val, sizeof(T));
+}
+
+
+//---------------------------------------------------------------------------
+// BLUE header defaults (raw complex float samples)
+//---------------------------------------------------------------------------
+KLTBlueHeader::KLTBlueHeader() :
+  type(1000),
+  format("CF"),
+  xstart(0.0),
+  xdelta(1.0),
+  xunits(0),
+  subsize(0),
+  ystart(0.0),
+  ydelta(1.0),
+  yunits(0)
+{
+}
+
+
+//---------------------------------------------------------------------------
+// Input file
+//---------------------------------------------------------------------------
+KLTInFile::KLTInFile(const std::string& fname) :
+  data(NULL),
+  data_len(0),
+  blue(false),
+  map_addr(NULL),
+  map_len(0)
+{
+  const int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::ostringstream oss;
+    oss << "Failed to open " << fname << ": " << strerror(errno);
+    throw std::runtime_error(oss.str());
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    std::ostringstream oss;
+    oss << "Failed to stat " << fname << ": " << strerror(errno);
+    throw std::runtime_error(oss.str());
+  }
+  map_len = st.st_size;
+  if (map_len > 0) {
+    map_addr = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map_addr == MAP_FAILED) {
+      map_addr = NULL;
+      ::close(fd);
+      std::ostringstream oss;
+      oss << "Failed to map " << fname << ": " << strerror(errno);
+      throw std::runtime_error(oss.str());
+    }
+    madvise(map_addr, map_len, MADV_SEQUENTIAL);
+  }
+  ::close(fd);
+
+  const char* base = static_cast<const char*>(map_addr);
+  data = base;
+  data_len = map_len;
+  if (map_len >= BLUE_HDR_LEN && memcmp(base, "BLUE", 4) == 0) {
+    if (memcmp(&base[BLUE_HEAD_REP], "EEEI", 4) != 0 ||
+        memcmp(&base[BLUE_DATA_REP], "EEEI", 4) != 0) {
+      munmap(map_addr, map_len);
+      std::ostringstream oss;
+      oss << fname << ": only EEEI (little-endian) BLUE files are supported";
+      throw std::runtime_error(oss.str());
+    }
+    blue = true;
+    const double data_start = get_field<double>(base, BLUE_DATA_START);
+    const double data_size = get_field<double>(base, BLUE_DATA_SIZE);
+    if (!(data_start >= 0.0) || !(data_size >= 0.0) ||
+        data_start + data_size > static_cast<double>(map_len)) {
+      munmap(map_addr, map_len);
+      std::ostringstream oss;
+      oss << fname << ": data_start " << data_start << " + data_size " << data_size <<
+        " exceeds the file size " << map_len;
+      throw std::runtime_error(oss.str());
+    }
+    data = &base[static_cast<size_t>(data_start)];
+    data_len = static_cast<size_t>(data_size);
+    hdr.type = get_field<int>(base, BLUE_TYPE);
+    hdr.format = std::string(&base[BLUE_FORMAT], 2);
+    hdr.xstart = get_field<double>(base, BLUE_XSTART);
+    hdr.xdelta = get_field<double>(base, BLUE_XDELTA);
+    hdr.xunits = get_field<int>(base, BLUE_XUNITS);
+    if (hdr.type / 1000 == 2) {
+      hdr.subsize = get_field<int>(base, BLUE_SUBSIZE);
+      hdr.ystart = get_field<double>(base, BLUE_YSTART);
+      hdr.ydelta = get_field<double>(base, BLUE_YDELTA);
+      hdr.yunits = get_field<int>(base, BLUE_YUNITS);
+    }
+  }
+}
+
+KLTInFile::~KLTInFile()
+{
+  if (map_addr != NULL) {
+    munmap(map_addr, map_len);
+  }
+}
+
+const std::complex<float>* KLTInFile::cf_data() const
+{
+  if (hdr.format != "CF") {
+    std::ostringstream oss;
+    oss << "Unsupported input format " << hdr.format << " (expected CF)";
+    throw std::runtime_error(oss.str());
+  }
+  return static_cast<const std::complex<float>*>(data);
+}
+
+const int16_t* KLTInFile::ci_data() const
+{
+  if (hdr.format != "CI") {
+    std::ostringstream oss;
+    oss << "Unsupported input format " << hdr.format << " (expected CI)";
+    throw std::runtime_error(oss.str());
+  }
+  return static_cast<const int16_t*>(data);
+}
+
+const int8_t* KLTInFile::cb_data() const
+{
+  if (hdr.format != "CB") {
+    std::ostringstream oss;
+    oss << "Unsupported input format " << hdr.format << " (expected CB)";
+    throw std::runtime_error(oss.str());
+  }
+  return static_cast<const int8_t*>(data);
+}
+
+size_t KLTInFile::samples() const
+{
+  if (hdr.format == "CF") {
+    return data_len / sizeof(std::complex<float>);
+  } else if (hdr.format == "CI") {
+    return data_len / (2 * sizeof(int16_t));
+  } else if (hdr.format == "CB") {
+    return data_len / (2 * sizeof(int8_t));
+  }
+  std::ostringstream oss;
+  oss << "Unsupported input format " << hdr.format << " (expected CF, CI or CB)";
+  throw std::runtime_error(oss.str());
+}
+
+
+//---------------------------------------------------------------------------
+// Output file
+//---------------------------------------------------------------------------
+KLTOutFile::KLTOutFile(const std::string& fname, bool blue, const KLTBlueHeader& hdr) :
+  fname(fname),
+  blue(blue),
+  fp(NULL),
+  data_len(0)
+{
+  if (fname.empty()) {
+    return;
+  }
+  fp = fopen(fname.c_str(), "wb");
+  if (fp == NULL) {
+    std::ostringstream oss;
+    oss << "Failed to create " << fname << ": " << strerror(errno);
+    throw std::runtime_error(oss.str());
+  }
+  if (blue) {
+    char buf[BLUE_HDR_LEN];
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, "BLUE", 4);
+    memcpy(&buf[BLUE_HEAD_REP], "EEEI", 4);
+    memcpy(&buf[BLUE_DATA_REP], "EEEI", 4);
+    put_field<double>(buf, BLUE_DATA_START, static_cast<double>(BLUE_HDR_LEN));
+    put_field<double>(buf, BLUE_DATA_SIZE, 0.0);
+    put_field<int>(buf, BLUE_TYPE, hdr.type);
+    memcpy(&buf[BLUE_FORMAT], hdr.format.c_str(), std::min<size_t>(hdr.format.size(), 2));
+    put_field<double>(buf, BLUE_XSTART, hdr.xstart);
+    put_field<double>(buf, BLUE_XDELTA, hdr.xdelta);
+    put_field<int>(buf, BLUE_XUNITS, hdr.xunits);
+    if (hdr.type / 1000 == 2) {
+      put_field<int>(buf, BLUE_SUBSIZE, hdr.subsize);
+      put_field<double>(buf, BLUE_YSTART, hdr.ystart);
+      put_field<double>(buf, BLUE_YDELTA, hdr.ydelta);
+      put_field<int>(buf, BLUE_YUNITS, hdr.yunits);
+    }
+    write(buf, sizeof(buf));
+    data_len = 0;
+  }
+}
+
+KLTOutFile::~KLTOutFile()
+{
+  if (fp != NULL) {
+    try {
+      close();
+    } catch (std::runtime_error&) {
+    }
+  }
+}
+
+void KLTOutFile::write(const void* buf, size_t len)
+{
+  if (fp == NULL) {
+    return;
+  }
+  if (fwrite(buf, 1, len, fp) != len) {
+    std::ostringstream oss;
+    oss << "Failed to write " << fname << ": " << strerror(errno);
+    throw std::runtime_error(oss.str());
+  }
+  data_len += len;
+}
+
+void KLTOutFile::close()
+{
+  if (fp == NULL) {
+    return;
+  }
+  FILE* cfp = fp;
+  fp = NULL;
+  bool ok = true;
+  if (blue) {
+    const double data_size = static_cast<double>(data_len);
+    ok = fseek(cfp, BLUE_DATA_SIZE, SEEK_SET) == 0 &&
+      fwrite(&data_size, sizeof(data_size), 1, cfp) == 1;
+  }
+  ok = (fclose(cfp) == 0) && ok;
+  if (!ok) {
+    std::ostringstream oss;
+    oss << "Failed to close " << fname << ": " << strerror(errno);
+    throw std::runtime_error(oss.str());
+  }
+}
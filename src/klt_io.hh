@@ -0,0 +1,139 @@
+// Karhunen-Loève Transform Library
+// Raw and BLUE file I/O for standalone drivers
+
+#ifndef __KLT_IO_HH__
+#define __KLT_IO_HH__
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+//---------------------------------------------------------------------------
+// BLUE header fields the drivers use (little-endian "EEEI" files only)
+//   type: 1000 (one-dimensional) or 2000 (framed, subsize elements).
+//   format: two-character data format, e.g. "CF" (complex float).
+//---------------------------------------------------------------------------
+struct KLTBlueHeader
+{
+  int type;
+  std::string format;
+  double xstart;
+  double xdelta;
+  int xunits;
+  int subsize;
+  double ystart;
+  double ydelta;
+  int yunits;
+
+  KLTBlueHeader();
+};
+
+//---------------------------------------------------------------------------
+// Read-only memory mapped input file
+//   A file starting with "BLUE" is parsed as a BLUE file (data between
+//   data_start and data_start+data_size), anything else is taken as raw
+//   samples with a default header.
+//---------------------------------------------------------------------------
+class KLTInFile
+{
+public:
+  //---------------------------------------------------------------------------
+  // Constructor
+  //   fname: file to map.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  explicit KLTInFile(const std::string& fname);
+
+  //---------------------------------------------------------------------------
+  // Destructor (unmaps the file)
+  //---------------------------------------------------------------------------
+  ~KLTInFile();
+
+  //---------------------------------------------------------------------------
+  // Mapped data as complex float samples (BLUE format "CF" or raw).
+  //   If the data is in another format, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  const std::complex<float>* cf_data() const;
+
+  //---------------------------------------------------------------------------
+  // Mapped data as complex int16 (format "CI") or int8 (format "CB") I/Q
+  // pairs.  A raw file is taken as CF unless hdr.format is set first.
+  //   If the data is in another format, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  const int16_t* ci_data() const;
+  const int8_t* cb_data() const;
+
+  //---------------------------------------------------------------------------
+  // Number of complex samples in the data (CF, CI or CB)
+  //   If the data is in another format, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  size_t samples() const;
+
+  //---------------------------------------------------------------------------
+  // Mapped data (size data_len bytes), header, and BLUE-ness
+  //---------------------------------------------------------------------------
+  const void* data;
+  size_t data_len;
+  KLTBlueHeader hdr;
+  bool blue;
+
+private:
+  KLTInFile(const KLTInFile&);
+  KLTInFile& operator=(const KLTInFile&);
+
+  void* map_addr;
+  size_t map_len;
+};
+
+//---------------------------------------------------------------------------
+// Sequentially written output file
+//   BLUE files get their header up front and data_size patched in by
+//   close().  An empty file name gives a closed (no-op) file, as an unused
+//   optional output.
+//---------------------------------------------------------------------------
+class KLTOutFile
+{
+public:
+  //---------------------------------------------------------------------------
+  // Constructor
+  //   fname: file to create ("" for none).
+  //   blue: write a BLUE header (hdr) before the data?
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  KLTOutFile(const std::string& fname, bool blue, const KLTBlueHeader& hdr);
+
+  //---------------------------------------------------------------------------
+  // Destructor (closes the file if still open)
+  //---------------------------------------------------------------------------
+  ~KLTOutFile();
+
+  //---------------------------------------------------------------------------
+  // Append len bytes.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void write(const void* buf, size_t len);
+
+  //---------------------------------------------------------------------------
+  // Finish the header and close.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void close();
+
+  //---------------------------------------------------------------------------
+  // Is the file open?
+  //---------------------------------------------------------------------------
+  bool open() const { return fp != NULL; }
+
+private:
+  KLTOutFile(const KLTOutFile&);
+  KLTOutFile& operator=(const KLTOutFile&);
+
+  const std::string fname;
+  const bool blue;
+  FILE* fp;
+  size_t data_len;
+};
+
+#endif // __KLT_IO_HH__
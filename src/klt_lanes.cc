@@ -0,0 +1,575 @@
+// Karhunen-Loève Transform Library
+// Lane-parallel (structure-of-arrays) transform of small frames
+
+#include "klt_lanes.hh"
+#include "klt_simd.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+static const size_t ALIGN = 128;
+static const int L = KLTLanes::LANES;
+
+// Fixed bisection steps, 2^-40 of the Gershgorin interval is well below
+// single precision
+static const int BISECT_STEPS = 40;
+static const int INVIT_STEPS = 3;
+static const float EPS = 6.0e-8f;
+
+//---------------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------------
+KLTLanes::KLTLanes(int in_len, int acm_order, int num_eig) :
+  in_len(in_len),
+  acm_order(acm_order),
+  num_eig(num_eig),
+  num_failed(0),
+  work_buf(NULL)
+{
+  const size_t n = acm_order;
+  const size_t ne = num_eig;
+  const size_t work_len = (2*n*n + 12*n + ne + ne*n + 6) * L;
+  if (posix_memalign(reinterpret_cast<void**>(&work_buf),
+                     ALIGN, work_len*sizeof(float))) {
+    std::ostringstream oss;
+    oss << "Failed to allocate work_buf (size " << work_len << ")";
+    throw std::runtime_error(oss.str());
+  }
+  float* p = work_buf;
+  a_re = p; p += n*n*L;
+  a_im = p; p += n*n*L;
+  d = p; p += n*L;
+  e_re = p; p += n*L;
+  e_im = p; p += n*L;
+  ee = p; p += n*L;
+  ph_re = p; p += n*L;
+  ph_im = p; p += n*L;
+  tau = p; p += n*L;
+  w_re = p; p += n*L;
+  w_im = p; p += n*L;
+  dl = p; p += n*L;
+  dd = p; p += n*L;
+  du = p; p += n*L;
+  ev = p; p += ne*L;
+  y = p; p += ne*n*L;
+  lo = p; p += L;
+  hi = p; p += L;
+  tnrm = p; p += L;
+  pivmin = p; p += L;
+  tiny = p; p += L;
+  ok = p;
+}
+
+
+//---------------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------------
+KLTLanes::~KLTLanes()
+{
+  if (work_buf != NULL) {
+    free(work_buf);
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Transform up to LANES frames
+//---------------------------------------------------------------------------
+void KLTLanes::transform(const std::complex<float>* in, int num_frames,
+                         float* eval, std::complex<float>* kltc,
+                         std::complex<float>* kltb)
+{
+  const int n = acm_order;
+  // Lags of each frame (unused lanes repeat the last frame) into w
+  for (int lidx=0; lidx < L; lidx++) {
+    const std::complex<float>* x = &in[static_cast<size_t>(std::min(lidx, num_frames-1)) * in_len];
+    for (int aidx=0; aidx < n; aidx++) {
+      const std::complex<float> lag = klt_cdotc(&x[aidx], x, in_len - aidx);
+      w_re[aidx*L+lidx] = lag.real();
+      w_im[aidx*L+lidx] = lag.imag();
+    }
+  }
+  // Full Hermitian Toeplitz matrix
+  for (int cidx=0; cidx < n; cidx++) {
+    for (int ridx=0; ridx < n; ridx++) {
+      const int aidx = ridx >= cidx ? ridx - cidx : cidx - ridx;
+      const float sgn = ridx >= cidx ? 1.0f : -1.0f;
+      float* ar = &a_re[(cidx*n+ridx)*L];
+      float* ai = &a_im[(cidx*n+ridx)*L];
+#pragma omp simd
+      for (int lidx=0; lidx < L; lidx++) {
+        ar[lidx] = w_re[aidx*L+lidx];
+        ai[lidx] = sgn * w_im[aidx*L+lidx];
+      }
+    }
+  }
+
+  tridiagonalize();
+  bisect();
+  inverse_iterate();
+
+  // Per-frame outputs (AoS, as KLT)
+  const size_t kltb_size = static_cast<size_t>(n) * num_eig;
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    back_transform(eidx, w_re, w_im);
+    for (int fidx=0; fidx < num_frames; fidx++) {
+      std::complex<float>* v = &kltb[fidx*kltb_size + eidx*n];
+      for (int tidx=0; tidx < n; tidx++) {
+        v[tidx] = std::complex<float>(w_re[tidx*L+fidx], w_im[tidx*L+fidx]);
+      }
+    }
+  }
+  num_failed = 0;
+  for (int fidx=0; fidx < num_frames; fidx++) {
+    float* f_eval = &eval[static_cast<size_t>(fidx) * num_eig];
+    std::complex<float>* f_kltc = &kltc[static_cast<size_t>(fidx) * num_eig];
+    std::complex<float>* f_kltb = &kltb[fidx * kltb_size];
+    if (ok[fidx] == 0.0f) {
+      memset(f_eval, 0, num_eig*sizeof(float));
+      memset(f_kltc, 0, num_eig*sizeof(std::complex<float>));
+      memset(f_kltb, 0, kltb_size*sizeof(std::complex<float>));
+      num_failed++;
+      continue;
+    }
+    const std::complex<float>* x = &in[static_cast<size_t>(fidx) * in_len];
+    for (int eidx=0; eidx < num_eig; eidx++) {
+      f_eval[eidx] = ev[eidx*L+fidx];
+      f_kltc[eidx] = klt_cdotc(x, &f_kltb[eidx*n], n);
+      klt_cscal(&f_kltb[eidx*n], f_kltc[eidx], n);
+    }
+  }
+  if (num_failed) {
+    std::ostringstream oss;
+    oss << num_failed << " of " << num_frames << " lane eigensolves failed";
+    throw std::runtime_error(oss.str());
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Householder tridiagonalization of all lanes, then the phases making the
+// off-diagonal real (T = D T' D^H, D = diag(ph))
+//   Reflector k (I - tau v v^H) acts on rows/cols k+1..n-1 and is kept in
+//   a's column k below the diagonal.  Lanes whose column is already reduced
+//   get tau = 0, which makes the update a no-op rather than a branch.
+//---------------------------------------------------------------------------
+void KLTLanes::tridiagonalize()
+{
+  const int n = acm_order;
+  for (int kidx=0; kidx < n-1; kidx++) {
+    float* vr = &a_re[kidx*n*L];
+    float* vi = &a_im[kidx*n*L];
+    float rest[L];
+    float t[L];
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      d[kidx*L+lidx] = vr[kidx*L+lidx];
+      rest[lidx] = 0.0f;
+    }
+    for (int ridx=kidx+2; ridx < n; ridx++) {
+#pragma omp simd
+      for (int lidx=0; lidx < L; lidx++) {
+        rest[lidx] += vr[ridx*L+lidx] * vr[ridx*L+lidx] + vi[ridx*L+lidx] * vi[ridx*L+lidx];
+      }
+    }
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      const float x0r = vr[(kidx+1)*L+lidx];
+      const float x0i = vi[(kidx+1)*L+lidx];
+      const float x0_abs = std::sqrt(x0r * x0r + x0i * x0i);
+      const float xnrm = std::sqrt(rest[lidx] + x0_abs * x0_abs);
+      const bool active = rest[lidx] > 0.0f;
+      const float inv_abs = x0_abs > 0.0f ? 1.0f / x0_abs : 0.0f;
+      const float phr = x0_abs > 0.0f ? x0r * inv_abs : 1.0f;
+      const float phi = x0i * inv_abs;
+      const float alr = -phr * xnrm;
+      const float ali = -phi * xnrm;
+      const float v1r = x0r - alr;
+      const float v1i = x0i - ali;
+      const float vnrm = v1r * v1r + v1i * v1i + rest[lidx];
+      t[lidx] = active ? 2.0f / (active ? vnrm : 1.0f) : 0.0f;
+      tau[kidx*L+lidx] = t[lidx];
+      e_re[kidx*L+lidx] = active ? alr : x0r;
+      e_im[kidx*L+lidx] = active ? ali : x0i;
+      vr[(kidx+1)*L+lidx] = active ? v1r : x0r;
+      vi[(kidx+1)*L+lidx] = active ? v1i : x0i;
+    }
+    // w = t A v
+    for (int ridx=kidx+1; ridx < n; ridx++) {
+#pragma omp simd
+      for (int lidx=0; lidx < L; lidx++) {
+        w_re[ridx*L+lidx] = 0.0f;
+        w_im[ridx*L+lidx] = 0.0f;
+      }
+    }
+    for (int cidx=kidx+1; cidx < n; cidx++) {
+      const float* acr = &a_re[cidx*n*L];
+      const float* aci = &a_im[cidx*n*L];
+      for (int ridx=kidx+1; ridx < n; ridx++) {
+#pragma omp simd
+        for (int lidx=0; lidx < L; lidx++) {
+          const float ar = acr[ridx*L+lidx];
+          const float ai = aci[ridx*L+lidx];
+          w_re[ridx*L+lidx] += ar * vr[cidx*L+lidx] - ai * vi[cidx*L+lidx];
+          w_im[ridx*L+lidx] += ar * vi[cidx*L+lidx] + ai * vr[cidx*L+lidx];
+        }
+      }
+    }
+    // w -= (t/2 v^H w) v
+    float vhw_re[L];
+    float vhw_im[L];
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      vhw_re[lidx] = 0.0f;
+      vhw_im[lidx] = 0.0f;
+    }
+    for (int ridx=kidx+1; ridx < n; ridx++) {
+#pragma omp simd
+      for (int lidx=0; lidx < L; lidx++) {
+        const float wr = t[lidx] * w_re[ridx*L+lidx];
+        const float wi = t[lidx] * w_im[ridx*L+lidx];
+        w_re[ridx*L+lidx] = wr;
+        w_im[ridx*L+lidx] = wi;
+        vhw_re[lidx] += vr[ridx*L+lidx] * wr + vi[ridx*L+lidx] * wi;
+        vhw_im[lidx] += vr[ridx*L+lidx] * wi - vi[ridx*L+lidx] * wr;
+      }
+    }
+    for (int ridx=kidx+1; ridx < n; ridx++) {
+#pragma omp simd
+      for (int lidx=0; lidx < L; lidx++) {
+        const float kr = 0.5f * t[lidx] * vhw_re[lidx];
+        const float ki = 0.5f * t[lidx] * vhw_im[lidx];
+        w_re[ridx*L+lidx] -= kr * vr[ridx*L+lidx] - ki * vi[ridx*L+lidx];
+        w_im[ridx*L+lidx] -= kr * vi[ridx*L+lidx] + ki * vr[ridx*L+lidx];
+      }
+    }
+    // A -= v w^H + w v^H
+    for (int cidx=kidx+1; cidx < n; cidx++) {
+      float* acr = &a_re[cidx*n*L];
+      float* aci = &a_im[cidx*n*L];
+      for (int ridx=kidx+1; ridx < n; ridx++) {
+#pragma omp simd
+        for (int lidx=0; lidx < L; lidx++) {
+          const float vrr = vr[ridx*L+lidx];
+          const float vri = vi[ridx*L+lidx];
+          const float vcr = vr[cidx*L+lidx];
+          const float vci = vi[cidx*L+lidx];
+          const float wrr = w_re[ridx*L+lidx];
+          const float wri = w_im[ridx*L+lidx];
+          const float wcr = w_re[cidx*L+lidx];
+          const float wci = w_im[cidx*L+lidx];
+          acr[ridx*L+lidx] -= vrr * wcr + vri * wci + wrr * vcr + wri * vci;
+          aci[ridx*L+lidx] -= vri * wcr - vrr * wci + wri * vcr - wrr * vci;
+        }
+      }
+    }
+  }
+#pragma omp simd
+  for (int lidx=0; lidx < L; lidx++) {
+    d[(n-1)*L+lidx] = a_re[((n-1)*n+(n-1))*L+lidx];
+    ph_re[lidx] = 1.0f;
+    ph_im[lidx] = 0.0f;
+    ee[(n-1)*L+lidx] = 0.0f;
+  }
+  for (int kidx=0; kidx < n-1; kidx++) {
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      const float er = e_re[kidx*L+lidx];
+      const float ei = e_im[kidx*L+lidx];
+      const float e_abs = std::sqrt(er * er + ei * ei);
+      const float inv_abs = e_abs > 0.0f ? 1.0f / e_abs : 0.0f;
+      const float ur = e_abs > 0.0f ? er * inv_abs : 1.0f;
+      const float ui = ei * inv_abs;
+      const float pr = ph_re[kidx*L+lidx];
+      const float pi = ph_im[kidx*L+lidx];
+      ee[kidx*L+lidx] = e_abs;
+      ph_re[(kidx+1)*L+lidx] = pr * ur - pi * ui;
+      ph_im[(kidx+1)*L+lidx] = pr * ui + pi * ur;
+    }
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Top num_eig eigenvalues of all lanes by bisection (Sturm counts), ascending
+//   A fixed number of steps keeps every lane in lock step; lanes that have
+//   converged just keep halving an interval that no longer moves.
+//---------------------------------------------------------------------------
+void KLTLanes::bisect()
+{
+  const int n = acm_order;
+  // Gershgorin bounds
+#pragma omp simd
+  for (int lidx=0; lidx < L; lidx++) {
+    lo[lidx] = d[lidx];
+    hi[lidx] = d[lidx];
+    tnrm[lidx] = 0.0f;
+  }
+  for (int kidx=0; kidx < n; kidx++) {
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      const float rad = (kidx > 0 ? ee[(kidx-1)*L+lidx] : 0.0f) + ee[kidx*L+lidx];
+      const float dk = d[kidx*L+lidx];
+      lo[lidx] = std::min(lo[lidx], dk - rad);
+      hi[lidx] = std::max(hi[lidx], dk + rad);
+      tnrm[lidx] = std::max(tnrm[lidx], std::abs(dk) + rad);
+    }
+  }
+#pragma omp simd
+  for (int lidx=0; lidx < L; lidx++) {
+    const float tn = tnrm[lidx];
+    ok[lidx] = (tn == tn && tn <= 3.0e38f) ? 1.0f : 0.0f;
+    pivmin[lidx] = std::max(tn * 1.0e-30f, 1.0e-30f);
+    tiny[lidx] = std::max(tn * EPS, pivmin[lidx]);
+  }
+
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    const float target = static_cast<float>(n - num_eig + eidx);
+    float l[L];
+    float h[L];
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      l[lidx] = lo[lidx];
+      h[lidx] = hi[lidx];
+    }
+    for (int iter=0; iter < BISECT_STEPS; iter++) {
+      float mid[L];
+      float q[L];
+      float count[L];
+#pragma omp simd
+      for (int lidx=0; lidx < L; lidx++) {
+        mid[lidx] = 0.5f * (l[lidx] + h[lidx]);
+        float qv = d[lidx] - mid[lidx];
+        qv = std::abs(qv) < pivmin[lidx] ? -pivmin[lidx] : qv;
+        q[lidx] = qv;
+        count[lidx] = qv < 0.0f ? 1.0f : 0.0f;
+      }
+      for (int kidx=1; kidx < n; kidx++) {
+#pragma omp simd
+        for (int lidx=0; lidx < L; lidx++) {
+          const float ek = ee[(kidx-1)*L+lidx];
+          float qv = d[kidx*L+lidx] - mid[lidx] - ek * ek / q[lidx];
+          qv = std::abs(qv) < pivmin[lidx] ? -pivmin[lidx] : qv;
+          q[lidx] = qv;
+          count[lidx] += qv < 0.0f ? 1.0f : 0.0f;
+        }
+      }
+#pragma omp simd
+      for (int lidx=0; lidx < L; lidx++) {
+        const bool below = count[lidx] <= target;
+        l[lidx] = below ? mid[lidx] : l[lidx];
+        h[lidx] = below ? h[lidx] : mid[lidx];
+      }
+    }
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      ev[eidx*L+lidx] = 0.5f * (l[lidx] + h[lidx]);
+    }
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Eigenvectors of T' for all lanes by inverse iteration, orthogonalized
+// against already found vectors of (nearly) equal eigenvalues
+//   The right-hand side is scaled by tiny before each solve so that the
+//   result stays O(1) even when a pivot had to be replaced by tiny.
+//---------------------------------------------------------------------------
+void KLTLanes::inverse_iterate()
+{
+  const int n = acm_order;
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    float* yv = &y[eidx*n*L];
+    for (int kidx=0; kidx < n; kidx++) {
+      // Deterministic start with components in all directions
+      const float start = 1.0f + 0.1f * static_cast<float>((kidx * 7 + eidx * 3) % 11) / 11.0f;
+#pragma omp simd
+      for (int lidx=0; lidx < L; lidx++) {
+        yv[kidx*L+lidx] = start;
+      }
+    }
+    for (int iter=0; iter < INVIT_STEPS; iter++) {
+      for (int kidx=0; kidx < n; kidx++) {
+#pragma omp simd
+        for (int lidx=0; lidx < L; lidx++) {
+          yv[kidx*L+lidx] *= tiny[lidx];
+        }
+      }
+      tridiag_solve(&ev[eidx*L], yv);
+      for (int pidx=0; pidx < eidx; pidx++) {
+        const float* yp = &y[pidx*n*L];
+        float dot[L];
+#pragma omp simd
+        for (int lidx=0; lidx < L; lidx++) {
+          dot[lidx] = 0.0f;
+        }
+        for (int kidx=0; kidx < n; kidx++) {
+#pragma omp simd
+          for (int lidx=0; lidx < L; lidx++) {
+            dot[lidx] += yp[kidx*L+lidx] * yv[kidx*L+lidx];
+          }
+        }
+#pragma omp simd
+        for (int lidx=0; lidx < L; lidx++) {
+          const bool close = std::abs(ev[pidx*L+lidx] - ev[eidx*L+lidx]) <= 1.0e-3f * tnrm[lidx];
+          dot[lidx] = close ? dot[lidx] : 0.0f;
+        }
+        for (int kidx=0; kidx < n; kidx++) {
+#pragma omp simd
+          for (int lidx=0; lidx < L; lidx++) {
+            yv[kidx*L+lidx] -= dot[lidx] * yp[kidx*L+lidx];
+          }
+        }
+      }
+      float scale[L];
+#pragma omp simd
+      for (int lidx=0; lidx < L; lidx++) {
+        scale[lidx] = 0.0f;
+      }
+      for (int kidx=0; kidx < n; kidx++) {
+#pragma omp simd
+        for (int lidx=0; lidx < L; lidx++) {
+          scale[lidx] += yv[kidx*L+lidx] * yv[kidx*L+lidx];
+        }
+      }
+#pragma omp simd
+      for (int lidx=0; lidx < L; lidx++) {
+        const float nrm = scale[lidx];
+        const bool good = nrm > 0.0f && nrm <= 3.0e38f;
+        ok[lidx] = good ? ok[lidx] : 0.0f;
+        scale[lidx] = good ? 1.0f / std::sqrt(good ? nrm : 1.0f) : 0.0f;
+      }
+      for (int kidx=0; kidx < n; kidx++) {
+#pragma omp simd
+        for (int lidx=0; lidx < L; lidx++) {
+          yv[kidx*L+lidx] *= scale[lidx];
+        }
+      }
+    }
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Solve (T' - lambda I) y = b in-place for all lanes, Gaussian elimination
+// with partial pivoting (as sgtsv); both pivot outcomes are computed and the
+// lane's one selected.  Zero pivots are replaced by tiny, as inverse
+// iteration expects a nearly singular system.
+//---------------------------------------------------------------------------
+void KLTLanes::tridiag_solve(const float* lambda, float* b)
+{
+  const int n = acm_order;
+  for (int kidx=0; kidx < n; kidx++) {
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      dl[kidx*L+lidx] = ee[kidx*L+lidx];
+      dd[kidx*L+lidx] = d[kidx*L+lidx] - lambda[lidx];
+      du[kidx*L+lidx] = ee[kidx*L+lidx];
+    }
+  }
+  for (int kidx=0; kidx < n-1; kidx++) {
+    const bool fill = kidx < n-2;
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      const float d0 = dd[kidx*L+lidx];
+      const float d1 = dd[(kidx+1)*L+lidx];
+      const float l0 = dl[kidx*L+lidx];
+      const float u0 = du[kidx*L+lidx];
+      const float u1 = fill ? du[(kidx+1)*L+lidx] : 0.0f;
+      const float b0 = b[kidx*L+lidx];
+      const float b1 = b[(kidx+1)*L+lidx];
+      const bool keep = std::abs(d0) >= std::abs(l0);
+      // No interchange
+      const float d0_k = d0 == 0.0f ? tiny[lidx] : d0;
+      const float fact_k = l0 / d0_k;
+      // Interchange rows k, k+1 (l0 != 0 here)
+      const float fact_s = d0 / (keep ? 1.0f : l0);
+      const float l0_s = fill ? u1 : 0.0f;
+      dd[kidx*L+lidx] = keep ? d0_k : l0;
+      dd[(kidx+1)*L+lidx] = keep ? d1 - fact_k * u0 : u0 - fact_s * d1;
+      dl[kidx*L+lidx] = keep ? 0.0f : l0_s;
+      du[kidx*L+lidx] = keep ? u0 : d1;
+      if (fill) {
+        du[(kidx+1)*L+lidx] = keep ? u1 : -fact_s * l0_s;
+      }
+      b[kidx*L+lidx] = keep ? b0 : b1;
+      b[(kidx+1)*L+lidx] = keep ? b1 - fact_k * b0 : b0 - fact_s * b1;
+    }
+  }
+#pragma omp simd
+  for (int lidx=0; lidx < L; lidx++) {
+    const float dn = dd[(n-1)*L+lidx];
+    b[(n-1)*L+lidx] /= dn == 0.0f ? tiny[lidx] : dn;
+  }
+  if (n > 1) {
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      b[(n-2)*L+lidx] = (b[(n-2)*L+lidx] - du[(n-2)*L+lidx] * b[(n-1)*L+lidx]) /
+        dd[(n-2)*L+lidx];
+    }
+  }
+  for (int kidx=n-3; kidx >= 0; kidx--) {
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      b[kidx*L+lidx] = (b[kidx*L+lidx] - du[kidx*L+lidx] * b[(kidx+1)*L+lidx] -
+                        dl[kidx*L+lidx] * b[(kidx+2)*L+lidx]) / dd[kidx*L+lidx];
+    }
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Eigenvector eidx of all lanes back to the Toeplitz matrix:
+// x = H_0 ... H_{n-2} D y
+//---------------------------------------------------------------------------
+void KLTLanes::back_transform(int eidx, float* x_re, float* x_im)
+{
+  const int n = acm_order;
+  const float* yv = &y[eidx*n*L];
+  for (int kidx=0; kidx < n; kidx++) {
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      x_re[kidx*L+lidx] = ph_re[kidx*L+lidx] * yv[kidx*L+lidx];
+      x_im[kidx*L+lidx] = ph_im[kidx*L+lidx] * yv[kidx*L+lidx];
+    }
+  }
+  for (int kidx=n-2; kidx >= 0; kidx--) {
+    const float* vr = &a_re[kidx*n*L];
+    const float* vi = &a_im[kidx*n*L];
+    float h_re[L];
+    float h_im[L];
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      h_re[lidx] = 0.0f;
+      h_im[lidx] = 0.0f;
+    }
+    for (int ridx=kidx+1; ridx < n; ridx++) {
+#pragma omp simd
+      for (int lidx=0; lidx < L; lidx++) {
+        const float xr = x_re[ridx*L+lidx];
+        const float xi = x_im[ridx*L+lidx];
+        h_re[lidx] += vr[ridx*L+lidx] * xr + vi[ridx*L+lidx] * xi;
+        h_im[lidx] += vr[ridx*L+lidx] * xi - vi[ridx*L+lidx] * xr;
+      }
+    }
+#pragma omp simd
+    for (int lidx=0; lidx < L; lidx++) {
+      h_re[lidx] *= tau[kidx*L+lidx];
+      h_im[lidx] *= tau[kidx*L+lidx];
+    }
+    for (int ridx=kidx+1; ridx < n; ridx++) {
+#pragma omp simd
+      for (int lidx=0; lidx < L; lidx++) {
+        const float vrr = vr[ridx*L+lidx];
+        const float vri = vi[ridx*L+lidx];
+        x_re[ridx*L+lidx] -= h_re[lidx] * vrr - h_im[lidx] * vri;
+        x_im[ridx*L+lidx] -= h_re[lidx] * vri + h_im[lidx] * vrr;
+      }
+    }
+  }
+}
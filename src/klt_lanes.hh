@@ -0,0 +1,110 @@
+// Karhunen-Loève Transform Library
+// Lane-parallel (structure-of-arrays) transform of small frames
+
+#ifndef __KLT_LANES_HH__
+#define __KLT_LANES_HH__
+
+#include <complex>
+
+class KLTLanes
+{
+public:
+  //---------------------------------------------------------------------------
+  // Frames per pass, one per SIMD lane (16 floats fill an AVX-512 register,
+  // two AVX2 registers)
+  //---------------------------------------------------------------------------
+  static const int LANES = 16;
+
+  //---------------------------------------------------------------------------
+  // Constructor
+  //   in_len, acm_order, num_eig: see KLT.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  KLTLanes(int in_len, int acm_order, int num_eig);
+
+  //---------------------------------------------------------------------------
+  // Destructor
+  //---------------------------------------------------------------------------
+  ~KLTLanes();
+
+  //---------------------------------------------------------------------------
+  // Transform up to LANES independent frames in one pass.  The Toeplitz
+  // matrices are held element-major, lane-minor, so every step of the
+  // eigensolver (Householder tridiagonalization, Sturm bisection, inverse
+  // iteration, back-transform) runs branch-free across all lanes at once.
+  //   in: input frames (size num_frames x in_len).
+  //   num_frames: frames in this pass (1..LANES).
+  //   eval, kltc, kltb: outputs laid out as KLTBatch::transform().
+  //   If any frame fails, its outputs are set to 0.0f, the others are still
+  //   valid, and then std::runtime_error is thrown (see failed()).
+  //---------------------------------------------------------------------------
+  void transform(const std::complex<float>* in, int num_frames,
+                 float* eval, std::complex<float>* kltc, std::complex<float>* kltb);
+
+  //---------------------------------------------------------------------------
+  // Number of frames that failed in the last transform()
+  //---------------------------------------------------------------------------
+  int failed() const { return num_failed; }
+
+  //---------------------------------------------------------------------------
+  // Did frame fidx of the last transform() succeed?
+  //---------------------------------------------------------------------------
+  bool frame_ok(int fidx) const { return ok[fidx] != 0.0f; }
+
+private:
+  void tridiagonalize();
+  void bisect();
+  void inverse_iterate();
+  void tridiag_solve(const float* lambda, float* b);
+  void back_transform(int eidx, float* x_re, float* x_im);
+
+  //---------------------------------------------------------------------------
+  // Config
+  //---------------------------------------------------------------------------
+  const int in_len;
+  const int acm_order;
+  const int num_eig;
+  int num_failed;
+
+  //---------------------------------------------------------------------------
+  // Lane buffers, element i of lane l at [i*LANES+l] (all carved from
+  // work_buf)
+  //   a_re, a_im: Toeplitz matrix, then the Householder vectors below the
+  //               diagonal (size acm_order x acm_order, col major).
+  //   d: tridiagonal diagonal (size acm_order).
+  //   e_re, e_im: complex off-diagonal (size acm_order).
+  //   ee: real off-diagonal |e| (size acm_order).
+  //   ph_re, ph_im: phases making the off-diagonal real (size acm_order).
+  //   tau: Householder scales (size acm_order).
+  //   w_re, w_im: Householder update temp (size acm_order).
+  //   dl, dd, du: tridiagonal solve temps (size acm_order).
+  //   ev: eigenvalues, ascending (size num_eig).
+  //   y: eigenvectors of the real tridiagonal (size num_eig x acm_order).
+  //   lo, hi, tnrm, pivmin, tiny, ok: per-lane scalars (size 1).
+  //---------------------------------------------------------------------------
+  float* work_buf;
+  float* a_re;
+  float* a_im;
+  float* d;
+  float* e_re;
+  float* e_im;
+  float* ee;
+  float* ph_re;
+  float* ph_im;
+  float* tau;
+  float* w_re;
+  float* w_im;
+  float* dl;
+  float* dd;
+  float* du;
+  float* ev;
+  float* y;
+  float* lo;
+  float* hi;
+  float* tnrm;
+  float* pivmin;
+  float* tiny;
+  float* ok;
+};
+
+#endif // __KLT_LANES_HH__
@@ -0,0 +1,441 @@
+// Karhunen-Loève Transform Library
+// Pipelined reader / compute / writer execution
+
+#include "klt_pipeline.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <mkl_service.h> // MKL
+
+static const size_t ALIGN = 128;
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds(Clock::time_point t0, Clock::time_point t1)
+{
+  return std::chrono::duration<double>(t1 - t0).count();
+}
+
+// Elements of T per ALIGN-rounded slot of len elements
+template <typename T>
+static size_t slot_stride(size_t len)
+{
+  const size_t per_align = ALIGN / sizeof(T);
+  return ((len + per_align - 1) / per_align) * per_align;
+}
+
+// Spin briefly, then yield (stages may outnumber cores)
+static void backoff(int& spins)
+{
+  if (++spins > 64) {
+    std::this_thread::yield();
+  }
+}
+
+static size_t pow2_at_least(size_t len)
+{
+  size_t pow2 = 1;
+  while (pow2 < len) {
+    pow2 <<= 1;
+  }
+  return pow2;
+}
+
+
+//---------------------------------------------------------------------------
+// Ring
+//---------------------------------------------------------------------------
+KLTRing::KLTRing(size_t capacity) :
+  cells(pow2_at_least(capacity)),
+  mask(cells.size() - 1),
+  enq_pos(0),
+  deq_pos(0)
+{
+  for (size_t cidx=0; cidx < cells.size(); cidx++) {
+    cells[cidx].seq.store(cidx, std::memory_order_relaxed);
+    cells[cidx].val = 0;
+  }
+}
+
+bool KLTRing::push(int val)
+{
+  size_t pos = enq_pos.load(std::memory_order_relaxed);
+  Cell* cell;
+  for (;;) {
+    cell = &cells[pos & mask];
+    const size_t cseq = cell->seq.load(std::memory_order_acquire);
+    const intptr_t dif = static_cast<intptr_t>(cseq) - static_cast<intptr_t>(pos);
+    if (dif == 0) {
+      if (enq_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (dif < 0) {
+      return false;
+    } else {
+      pos = enq_pos.load(std::memory_order_relaxed);
+    }
+  }
+  cell->val = val;
+  cell->seq.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool KLTRing::pop(int& val)
+{
+  size_t pos = deq_pos.load(std::memory_order_relaxed);
+  Cell* cell;
+  for (;;) {
+    cell = &cells[pos & mask];
+    const size_t cseq = cell->seq.load(std::memory_order_acquire);
+    const intptr_t dif = static_cast<intptr_t>(cseq) - static_cast<intptr_t>(pos + 1);
+    if (dif == 0) {
+      if (deq_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (dif < 0) {
+      return false;
+    } else {
+      pos = deq_pos.load(std::memory_order_relaxed);
+    }
+  }
+  val = cell->val;
+  cell->seq.store(pos + mask + 1, std::memory_order_release);
+  return true;
+}
+
+size_t KLTRing::size() const
+{
+  const size_t enq = enq_pos.load(std::memory_order_relaxed);
+  const size_t deq = deq_pos.load(std::memory_order_relaxed);
+  return enq > deq ? enq - deq : 0;
+}
+
+
+//---------------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------------
+KLTPipeline::KLTPipeline(int in_len,
+#if KLT_SUPPORT_EVALN
+                         int eval_normalized,
+#endif
+                         int acm_order,
+                         int num_eig,
+                         int num_workers,
+                         int num_slots) :
+  in_len(in_len),
+  acm_order(acm_order),
+  num_eig(num_eig),
+  num_workers(std::max(num_workers, 1)),
+  num_slots(num_slots > 0 ? num_slots : 4 * std::max(num_workers, 1) + 4),
+  in_buf(NULL),
+  in_ptr(this->num_slots, static_cast<const std::complex<float>*>(NULL)),
+  seq(this->num_slots, 0),
+  eval_buf(NULL),
+  kltc_buf(NULL),
+  kltb_buf(NULL),
+  err(this->num_slots),
+  klts(this->num_workers, static_cast<KLT*>(NULL)),
+  free_ring(this->num_slots),
+  work_ring(this->num_slots + this->num_workers),
+  done_ring(this->num_slots + this->num_workers),
+  stats(this->num_workers + 2),
+  abort(false)
+{
+  // On failure the slots and KLTs built so far are released before
+  // rethrowing (the destructor does not run)
+  try {
+    // Slots
+    const size_t in_size = this->num_slots * slot_stride<std::complex<float> >(in_len);
+    if (posix_memalign(reinterpret_cast<void**>(&in_buf),
+                       ALIGN, in_size*sizeof(std::complex<float>))) {
+      std::ostringstream oss;
+      oss << "Failed to allocate in_buf (size " << in_size << ")";
+      throw std::runtime_error(oss.str());
+    }
+    const size_t eval_size = this->num_slots * slot_stride<float>(num_eig);
+    if (posix_memalign(reinterpret_cast<void**>(&eval_buf),
+                       ALIGN, eval_size*sizeof(float))) {
+      std::ostringstream oss;
+      oss << "Failed to allocate eval_buf (size " << eval_size << ")";
+      throw std::runtime_error(oss.str());
+    }
+    const size_t kltc_size = this->num_slots * slot_stride<std::complex<float> >(num_eig);
+    if (posix_memalign(reinterpret_cast<void**>(&kltc_buf),
+                       ALIGN, kltc_size*sizeof(std::complex<float>))) {
+      std::ostringstream oss;
+      oss << "Failed to allocate kltc_buf (size " << kltc_size << ")";
+      throw std::runtime_error(oss.str());
+    }
+    const size_t kltb_size = this->num_slots *
+      slot_stride<std::complex<float> >(static_cast<size_t>(acm_order) * num_eig);
+    if (posix_memalign(reinterpret_cast<void**>(&kltb_buf),
+                       ALIGN, kltb_size*sizeof(std::complex<float>))) {
+      std::ostringstream oss;
+      oss << "Failed to allocate kltb_buf (size " << kltb_size << ")";
+      throw std::runtime_error(oss.str());
+    }
+    // Compute stages
+    for (int widx=0; widx < this->num_workers; widx++) {
+      klts[widx] = new KLT(in_len,
+#if KLT_SUPPORT_EVALN
+                           eval_normalized,
+#endif
+                           acm_order, num_eig);
+    }
+  } catch (...) {
+    release();
+    throw;
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------------
+KLTPipeline::~KLTPipeline()
+{
+  release();
+}
+
+
+//---------------------------------------------------------------------------
+// Free the slots and delete the KLTs (NULL entries are skipped)
+//---------------------------------------------------------------------------
+void KLTPipeline::release()
+{
+  for (size_t widx=0; widx < klts.size(); widx++) {
+    delete klts[widx];
+    klts[widx] = NULL;
+  }
+  free(in_buf);
+  free(eval_buf);
+  free(kltc_buf);
+  free(kltb_buf);
+  in_buf = NULL;
+  eval_buf = NULL;
+  kltc_buf = NULL;
+  kltb_buf = NULL;
+}
+
+
+//---------------------------------------------------------------------------
+// Run to the end of input
+//---------------------------------------------------------------------------
+void KLTPipeline::run(const ReadFn& read, const WriteFn& write)
+{
+  for (size_t sidx=0; sidx < stats.size(); sidx++) {
+    memset(&stats[sidx], 0, sizeof(KLTStageStats));
+  }
+  abort.store(false);
+  abort_msg.clear();
+  int slot;
+  while (free_ring.pop(slot) || work_ring.pop(slot) || done_ring.pop(slot)) {
+  }
+  for (int sidx=0; sidx < num_slots; sidx++) {
+    free_ring.push(sidx);
+  }
+
+  std::vector<std::thread> threads;
+  threads.push_back(std::thread(&KLTPipeline::read_stage, this, std::cref(read)));
+  for (int widx=0; widx < num_workers; widx++) {
+    threads.push_back(std::thread(&KLTPipeline::compute_stage, this, widx));
+  }
+  write_stage(write);
+  for (size_t tidx=0; tidx < threads.size(); tidx++) {
+    threads[tidx].join();
+  }
+
+  for (size_t sidx=0; sidx < stats.size(); sidx++) {
+    if (stats[sidx].frames > 0) {
+      stats[sidx].depth /= stats[sidx].frames;
+    }
+  }
+  if (abort.load()) {
+    throw std::runtime_error(abort_msg);
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Stop all stages (first message wins)
+//---------------------------------------------------------------------------
+void KLTPipeline::fail(const std::string& msg)
+{
+  if (!abort.exchange(true)) {
+    abort_msg = msg;
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Reader stage: fill free slots in frame order
+//---------------------------------------------------------------------------
+void KLTPipeline::read_stage(const ReadFn& read)
+{
+  KLTStageStats& st = stats[0];
+  const size_t in_stride = slot_stride<std::complex<float> >(in_len);
+  for (long fseq=0; !abort.load(std::memory_order_relaxed); fseq++) {
+    Clock::time_point t0 = Clock::now();
+    int slot;
+    for (int spins=0; !free_ring.pop(slot); backoff(spins)) {
+      if (abort.load(std::memory_order_relaxed)) {
+        return;
+      }
+    }
+    Clock::time_point t1 = Clock::now();
+    st.depth += free_ring.size();
+    const std::complex<float>* frame;
+    try {
+      frame = read(fseq, &in_buf[slot * in_stride]);
+    } catch (std::runtime_error& err) {
+      fail(err.what());
+      return;
+    }
+    Clock::time_point t2 = Clock::now();
+    st.wait_s += seconds(t0, t1);
+    st.busy_s += seconds(t1, t2);
+    if (frame == NULL) {
+      break;
+    }
+    in_ptr[slot] = frame;
+    seq[slot] = fseq;
+    for (int spins=0; !work_ring.push(slot); backoff(spins)) {
+      if (abort.load(std::memory_order_relaxed)) {
+        return;
+      }
+    }
+    st.wait_s += seconds(t2, Clock::now());
+    st.frames++;
+  }
+  // End each worker
+  for (int widx=0; widx < num_workers; widx++) {
+    for (int spins=0; !work_ring.push(-1); backoff(spins)) {
+      if (abort.load(std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Compute stage: transform slots from the work ring
+//---------------------------------------------------------------------------
+void KLTPipeline::compute_stage(int widx)
+{
+  KLTStageStats& st = stats[1 + widx];
+  KLT& klt = *klts[widx];
+  const size_t eval_stride = slot_stride<float>(num_eig);
+  const size_t kltc_stride = slot_stride<std::complex<float> >(num_eig);
+  const size_t kltb_len = static_cast<size_t>(acm_order) * num_eig;
+  const size_t kltb_stride = slot_stride<std::complex<float> >(kltb_len);
+  // One MKL thread per worker, the workers already fill the cores
+  const int mkl_threads = mkl_set_num_threads_local(1);
+  for (;;) {
+    Clock::time_point t0 = Clock::now();
+    int slot;
+    for (int spins=0; !work_ring.pop(slot); backoff(spins)) {
+      if (abort.load(std::memory_order_relaxed)) {
+        mkl_set_num_threads_local(mkl_threads);
+        return;
+      }
+    }
+    Clock::time_point t1 = Clock::now();
+    st.wait_s += seconds(t0, t1);
+    if (slot < 0) {
+      break;
+    }
+    st.depth += work_ring.size();
+    try {
+      klt.transform(in_ptr[slot]);
+      err[slot].clear();
+    } catch (std::runtime_error& e) {
+      err[slot] = e.what();
+    }
+    // Selected outputs only (kltb_buf may not even exist)
+    const int outputs = klt.outputs();
+    if (outputs & KLT::OUT_EVAL) {
+      memcpy(&eval_buf[slot * eval_stride], klt.eval_buf, num_eig*sizeof(float));
+    }
+    if (outputs & KLT::OUT_KLTC) {
+      memcpy(&kltc_buf[slot * kltc_stride], klt.kltc_buf, num_eig*sizeof(std::complex<float>));
+    }
+    if (outputs & KLT::OUT_KLTB) {
+      memcpy(&kltb_buf[slot * kltb_stride], klt.kltb_buf, kltb_len*sizeof(std::complex<float>));
+    }
+    Clock::time_point t2 = Clock::now();
+    st.busy_s += seconds(t1, t2);
+    for (int spins=0; !done_ring.push(slot); backoff(spins)) {
+      if (abort.load(std::memory_order_relaxed)) {
+        mkl_set_num_threads_local(mkl_threads);
+        return;
+      }
+    }
+    st.wait_s += seconds(t2, Clock::now());
+    st.frames++;
+  }
+  for (int spins=0; !done_ring.push(-1); backoff(spins)) {
+    if (abort.load(std::memory_order_relaxed)) {
+      break;
+    }
+  }
+  mkl_set_num_threads_local(mkl_threads);
+}
+
+
+//---------------------------------------------------------------------------
+// Writer stage: emit transformed slots in frame order, recycle them
+//   At most num_slots frames are in flight, so the pending frames' seqs are
+//   distinct modulo num_slots.
+//---------------------------------------------------------------------------
+void KLTPipeline::write_stage(const WriteFn& write)
+{
+  KLTStageStats& st = stats[1 + num_workers];
+  const size_t eval_stride = slot_stride<float>(num_eig);
+  const size_t kltc_stride = slot_stride<std::complex<float> >(num_eig);
+  const size_t kltb_stride = slot_stride<std::complex<float> >(static_cast<size_t>(acm_order) * num_eig);
+  std::vector<int> pending(num_slots, -1);
+  long next_seq = 0;
+  int num_ended = 0;
+  while (num_ended < num_workers) {
+    Clock::time_point t0 = Clock::now();
+    int slot;
+    for (int spins=0; !done_ring.pop(slot); backoff(spins)) {
+      if (abort.load(std::memory_order_relaxed)) {
+        return;
+      }
+    }
+    Clock::time_point t1 = Clock::now();
+    st.wait_s += seconds(t0, t1);
+    if (slot < 0) {
+      num_ended++;
+      continue;
+    }
+    st.depth += done_ring.size();
+    pending[seq[slot] % num_slots] = slot;
+    int* next = &pending[next_seq % num_slots];
+    while (*next >= 0) {
+      const int wslot = *next;
+      *next = -1;
+      try {
+        write(next_seq, &eval_buf[wslot * eval_stride], &kltc_buf[wslot * kltc_stride],
+              &kltb_buf[wslot * kltb_stride], err[wslot].empty() ? NULL : err[wslot].c_str());
+      } catch (std::runtime_error& e) {
+        fail(e.what());
+        return;
+      }
+      free_ring.push(wslot);
+      st.frames++;
+      next_seq++;
+      next = &pending[next_seq % num_slots];
+    }
+    st.busy_s += seconds(t1, Clock::now());
+  }
+}
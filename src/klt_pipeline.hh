@@ -0,0 +1,184 @@
+// Karhunen-Loève Transform Library
+// Pipelined reader / compute / writer execution
+
+#ifndef __KLT_PIPELINE_HH__
+#define __KLT_PIPELINE_HH__
+
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include "klt.hh"
+
+//---------------------------------------------------------------------------
+// Bounded lock-free ring of slot indices (Vyukov MPMC queue; serves the
+// SPSC, SPMC and MPSC links alike)
+//---------------------------------------------------------------------------
+class KLTRing
+{
+public:
+  //---------------------------------------------------------------------------
+  // Constructor
+  //   capacity: ring size (rounded up to a power of two).
+  //---------------------------------------------------------------------------
+  explicit KLTRing(size_t capacity);
+
+  //---------------------------------------------------------------------------
+  // Non-blocking push/pop, false if full/empty
+  //---------------------------------------------------------------------------
+  bool push(int val);
+  bool pop(int& val);
+
+  //---------------------------------------------------------------------------
+  // Approximate number of queued entries
+  //---------------------------------------------------------------------------
+  size_t size() const;
+
+private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    int val;
+  };
+  std::vector<Cell> cells;
+  const size_t mask;
+  alignas(64) std::atomic<size_t> enq_pos;
+  alignas(64) std::atomic<size_t> deq_pos;
+};
+
+//---------------------------------------------------------------------------
+// Per-stage counters
+//   frames: frames handled.
+//   busy_s: time spent working (reading, transforming, writing).
+//   wait_s: time spent waiting on an empty input or full output ring.
+//   depth: mean depth of the stage's input ring, sampled per frame.
+//   A stage with low wait_s and a full input ring is the bottleneck.
+//---------------------------------------------------------------------------
+struct KLTStageStats
+{
+  long frames;
+  double busy_s;
+  double wait_s;
+  double depth;
+};
+
+class KLTPipeline
+{
+public:
+  //---------------------------------------------------------------------------
+  // Reader: return frame seq (size in_len), either a pointer that stays
+  // valid until the frame has been written (e.g. into a mapped file) or
+  // buf (size in_len, aligned) after filling it; NULL at end of input.
+  //---------------------------------------------------------------------------
+  typedef std::function<const std::complex<float>*(long seq, std::complex<float>* buf)> ReadFn;
+
+  //---------------------------------------------------------------------------
+  // Writer: outputs of frame seq, called in seq order, laid out as KLT's
+  // eval_buf, kltc_buf and kltb_buf (those not selected with
+  // KLT::set_outputs() are undefined).  err is the transform's error message
+  // (outputs are 0.0f) or NULL.
+  //---------------------------------------------------------------------------
+  typedef std::function<void(long seq, const float* eval, const std::complex<float>* kltc,
+                             const std::complex<float>* kltb, const char* err)> WriteFn;
+
+  //---------------------------------------------------------------------------
+  // Constructor
+  //   in_len, eval_normalized, acm_order, num_eig: see KLT.
+  //   num_workers: compute stages, each owning a KLT.
+  //   num_slots: frames in flight (preallocated aligned slots, 0: default).
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  KLTPipeline(int in_len,
+#if KLT_SUPPORT_EVALN
+              int eval_normalized,
+#endif
+              int acm_order,
+              int num_eig,
+              int num_workers,
+              int num_slots);
+
+  //---------------------------------------------------------------------------
+  // Destructor
+  //---------------------------------------------------------------------------
+  ~KLTPipeline();
+
+  //---------------------------------------------------------------------------
+  // Compute stage widx's transform, to configure before run().  The stream
+  // and track modes carry state from frame to frame, so they need
+  // num_workers == 1 (frames are otherwise spread across the workers).
+  //---------------------------------------------------------------------------
+  KLT& klt(int widx) { return *klts[widx]; }
+
+  //---------------------------------------------------------------------------
+  // Run reader, compute and writer stages (one thread each) to the end of
+  // input.  Frames go to whichever worker is free and the writer restores
+  // their order.
+  //   If reader or writer throws std::runtime_error, the pipeline stops and
+  //   run() rethrows it.
+  //---------------------------------------------------------------------------
+  void run(const ReadFn& read, const WriteFn& write);
+
+  //---------------------------------------------------------------------------
+  // Counters of the last run()
+  //   reader: input ring is the free-slot ring.
+  //   workers: one per compute stage, input ring is the work ring.
+  //   writer: input ring is the done ring.
+  //---------------------------------------------------------------------------
+  KLTStageStats reader_stats() const { return stats[0]; }
+  KLTStageStats worker_stats(int widx) const { return stats[1 + widx]; }
+  KLTStageStats writer_stats() const { return stats[1 + num_workers]; }
+  int workers() const { return num_workers; }
+
+private:
+  KLTPipeline(const KLTPipeline&);
+  KLTPipeline& operator=(const KLTPipeline&);
+
+  void read_stage(const ReadFn& read);
+  void compute_stage(int widx);
+  void write_stage(const WriteFn& write);
+  void fail(const std::string& msg);
+  void release();
+
+  //---------------------------------------------------------------------------
+  // Config
+  //---------------------------------------------------------------------------
+  const int in_len;
+  const int acm_order;
+  const int num_eig;
+  const int num_workers;
+  const int num_slots;
+
+  //---------------------------------------------------------------------------
+  // Slots (index s of each buffer belongs to slot s)
+  //   in_buf: reader staging (size num_slots x in_len).
+  //   in_ptr: frame to transform (in_buf slot or the reader's pointer).
+  //   seq: frame number.
+  //   eval_buf, kltc_buf, kltb_buf: outputs (sizes num_slots x KLT's).
+  //   err: transform error message, empty if none.
+  //---------------------------------------------------------------------------
+  std::complex<float>* in_buf;
+  std::vector<const std::complex<float>*> in_ptr;
+  std::vector<long> seq;
+  float* eval_buf;
+  std::complex<float>* kltc_buf;
+  std::complex<float>* kltb_buf;
+  std::vector<std::string> err;
+
+  //---------------------------------------------------------------------------
+  // Stages
+  //   free_ring: writer -> reader (empty slots).
+  //   work_ring: reader -> workers (full slots, -1 ends a worker).
+  //   done_ring: workers -> writer (transformed slots, -1 per ended worker).
+  //   stats: reader, workers, writer.
+  //---------------------------------------------------------------------------
+  std::vector<KLT*> klts;
+  KLTRing free_ring;
+  KLTRing work_ring;
+  KLTRing done_ring;
+  std::vector<KLTStageStats> stats;
+  std::atomic<bool> abort;
+  std::string abort_msg;
+};
+
+#endif // __KLT_PIPELINE_HH__
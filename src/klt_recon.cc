@@ -0,0 +1,118 @@
+// Karhunen-Loève Transform Library
+// Overlap-add reconstruction of the rank-reduced signal
+
+#include "klt_recon.hh"
+
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+static const size_t ALIGN = 128;
+
+
+//---------------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------------
+KLTRecon::KLTRecon(int acm_order, int num_eig, int out_len) :
+  out_buf(NULL),
+  out_len(out_len),
+  acm_order(acm_order),
+  num_eig(num_eig),
+  win_buf(NULL),
+  acc_buf(NULL),
+  wsum_buf(NULL)
+{
+  if (out_len < 1 || out_len > acm_order) {
+    std::ostringstream oss;
+    oss << "Invalid reconstruction out_len " << out_len << " (acm_order " << acm_order << ")";
+    throw std::runtime_error(oss.str());
+  }
+  if (posix_memalign(reinterpret_cast<void**>(&out_buf),
+                     ALIGN, acm_order*sizeof(std::complex<float>)) ||
+      posix_memalign(reinterpret_cast<void**>(&acc_buf),
+                     ALIGN, acm_order*sizeof(std::complex<float>)) ||
+      posix_memalign(reinterpret_cast<void**>(&win_buf),
+                     ALIGN, acm_order*sizeof(float)) ||
+      posix_memalign(reinterpret_cast<void**>(&wsum_buf),
+                     ALIGN, acm_order*sizeof(float))) {
+    free(out_buf);
+    free(acc_buf);
+    free(win_buf);
+    free(wsum_buf);
+    std::ostringstream oss;
+    oss << "Failed to allocate reconstruction buffers (size " << acm_order << ")";
+    throw std::runtime_error(oss.str());
+  }
+  // Hann taper, sampled at half-sample offsets so no weight is 0; without
+  // overlap the normalization cancels it
+  for (int tidx=0; tidx < acm_order; tidx++) {
+    win_buf[tidx] = 0.5f - 0.5f * std::cos(6.283185307f * (tidx + 0.5f) / acm_order);
+  }
+  memset(out_buf, 0, acm_order*sizeof(std::complex<float>));
+  reset();
+}
+
+
+//---------------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------------
+KLTRecon::~KLTRecon()
+{
+  free(out_buf);
+  free(acc_buf);
+  free(win_buf);
+  free(wsum_buf);
+}
+
+
+//---------------------------------------------------------------------------
+// Overlap-add a frame
+//---------------------------------------------------------------------------
+void KLTRecon::add(const std::complex<float>* kltb)
+{
+  for (int tidx=0; tidx < acm_order; tidx++) {
+    std::complex<float> seg = kltb[tidx];
+    for (int eidx=1; eidx < num_eig; eidx++) {
+      seg += kltb[eidx*acm_order + tidx];
+    }
+    acc_buf[tidx] += win_buf[tidx] * seg;
+    wsum_buf[tidx] += win_buf[tidx];
+  }
+  // Head is final: no later segment reaches back before out_len
+  for (int tidx=0; tidx < out_len; tidx++) {
+    out_buf[tidx] = acc_buf[tidx] / wsum_buf[tidx];
+  }
+  const int tail_len = acm_order - out_len;
+  memmove(acc_buf, &acc_buf[out_len], tail_len*sizeof(std::complex<float>));
+  memmove(wsum_buf, &wsum_buf[out_len], tail_len*sizeof(float));
+  memset(&acc_buf[tail_len], 0, out_len*sizeof(std::complex<float>));
+  memset(&wsum_buf[tail_len], 0, out_len*sizeof(float));
+}
+
+
+//---------------------------------------------------------------------------
+// End of stream
+//---------------------------------------------------------------------------
+int KLTRecon::flush()
+{
+  const int tail_len = acm_order - out_len;
+  for (int tidx=0; tidx < tail_len; tidx++) {
+    out_buf[tidx] = wsum_buf[tidx] > 0.0f ? acc_buf[tidx] / wsum_buf[tidx] :
+      std::complex<float>(0.0f, 0.0f);
+  }
+  reset();
+  return tail_len;
+}
+
+
+//---------------------------------------------------------------------------
+// Restart
+//---------------------------------------------------------------------------
+void KLTRecon::reset()
+{
+  memset(acc_buf, 0, acm_order*sizeof(std::complex<float>));
+  memset(wsum_buf, 0, acm_order*sizeof(float));
+}
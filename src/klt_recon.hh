@@ -0,0 +1,76 @@
+// Karhunen-Loève Transform Library
+// Overlap-add reconstruction of the rank-reduced signal
+
+#ifndef __KLT_RECON_HH__
+#define __KLT_RECON_HH__
+
+#include <complex>
+
+//---------------------------------------------------------------------------
+// Rank-reduced time series from successive frames' weighted basis functions
+//   Each frame's segment (size acm_order) is the sum of its num_eig weighted
+//   basis functions, i.e. the projection of the frame head onto the signal
+//   subspace.  Segments start out_len samples apart and are overlap-added
+//   with a Hann taper, normalized by the summed taper so any overlap gives
+//   unit gain.  With out_len equal to the input frame advance (in_clen) the
+//   output runs at the input rate and sample-aligned with it.
+//---------------------------------------------------------------------------
+class KLTRecon
+{
+public:
+  //---------------------------------------------------------------------------
+  // Constructor
+  //   acm_order, num_eig: see KLT.
+  //   out_len: output samples per frame (segment advance, 1..acm_order), as
+  //            acm_order * (1 - out_olap_factor).
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  KLTRecon(int acm_order, int num_eig, int out_len);
+
+  //---------------------------------------------------------------------------
+  // Destructor
+  //---------------------------------------------------------------------------
+  ~KLTRecon();
+
+  //---------------------------------------------------------------------------
+  // Overlap-add a frame's weighted basis functions (layout of KLT's
+  // kltb_buf), out_buf[0..out_len) then holds the next finished samples.
+  //---------------------------------------------------------------------------
+  void add(const std::complex<float>* kltb);
+
+  //---------------------------------------------------------------------------
+  // End of stream: move the unfinished tail (acm_order - out_len samples)
+  // to out_buf and restart; returns its length.
+  //---------------------------------------------------------------------------
+  int flush();
+
+  //---------------------------------------------------------------------------
+  // Restart (e.g. after a discontinuity), dropping the unfinished tail
+  //---------------------------------------------------------------------------
+  void reset();
+
+  //---------------------------------------------------------------------------
+  // Output samples (size acm_order)
+  //---------------------------------------------------------------------------
+  std::complex<float>* out_buf;
+
+  const int out_len;
+
+private:
+  KLTRecon(const KLTRecon&);
+  KLTRecon& operator=(const KLTRecon&);
+
+  //---------------------------------------------------------------------------
+  // Config and state
+  //   win_buf: segment taper (size acm_order).
+  //   acc_buf: tapered segment sums (size acm_order).
+  //   wsum_buf: taper sums (size acm_order).
+  //---------------------------------------------------------------------------
+  const int acm_order;
+  const int num_eig;
+  float* win_buf;
+  std::complex<float>* acc_buf;
+  float* wsum_buf;
+};
+
+#endif // __KLT_RECON_HH__
@@ -0,0 +1,106 @@
+// Karhunen-Loève Transform Library
+// Synthetic complex test signals (benchmarks, standalone testing)
+
+#include "klt_siggen.hh"
+
+#include <algorithm>
+#include <cmath>
+
+static const double TWO_PI = 6.283185307179586;
+
+
+//---------------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------------
+KLTSigGen::KLTSigGen(unsigned seed) :
+  noise_sigma(0.0f),
+  sample(0),
+  rng(seed),
+  normal(0.0f, 1.0f)
+{
+}
+
+
+//---------------------------------------------------------------------------
+// Components
+//---------------------------------------------------------------------------
+void KLTSigGen::add_tone(double freq, float amp)
+{
+  Component comp = {TONE, freq, freq, amp, 0, 0};
+  comps.push_back(comp);
+}
+
+void KLTSigGen::add_chirp(double freq0, double freq1, long period, float amp)
+{
+  Component comp = {CHIRP, freq0, freq1, amp, 0, std::max(period, 1L)};
+  comps.push_back(comp);
+}
+
+void KLTSigGen::add_interferer(double freq, float amp, long on_len, long period)
+{
+  Component comp = {INTERFERER, freq, freq, amp, on_len, std::max(period, 1L)};
+  comps.push_back(comp);
+}
+
+void KLTSigGen::add_noise(float power)
+{
+  // Power split evenly between I and Q
+  noise_sigma = std::sqrt(power / 2.0f);
+}
+
+bool KLTSigGen::add_preset(const std::string& name)
+{
+  if (name == "tone") {
+    add_tone(0.0625, 1.0f);
+  } else if (name == "chirp") {
+    add_chirp(-0.25, 0.25, 8192, 1.0f);
+  } else if (name == "interferer") {
+    add_interferer(0.3125, 2.0f, 1024, 4096);
+  } else if (name == "mix") {
+    add_tone(0.0625, 1.0f);
+    add_tone(-0.171875, 0.5f);
+    add_chirp(-0.25, 0.25, 8192, 0.5f);
+    add_interferer(0.3125, 2.0f, 1024, 4096);
+  } else if (name != "noise") {
+    return false;
+  }
+  add_noise(name == "noise" ? 1.0f : 0.1f);
+  return true;
+}
+
+
+//---------------------------------------------------------------------------
+// Next len samples
+//   Phases are evaluated from the absolute sample index (in double), so the
+//   signal does not depend on how it is split into generate() calls.
+//---------------------------------------------------------------------------
+void KLTSigGen::generate(std::complex<float>* out, size_t len)
+{
+  for (size_t sidx=0; sidx < len; sidx++, sample++) {
+    std::complex<double> acc(0.0, 0.0);
+    for (size_t cidx=0; cidx < comps.size(); cidx++) {
+      const Component& comp = comps[cidx];
+      double cycles;
+      if (comp.kind == CHIRP) {
+        // Phase of a linear sweep restarting every period samples
+        const double tidx = static_cast<double>(sample % comp.period);
+        const double rate = (comp.freq1 - comp.freq0) / comp.period;
+        cycles = comp.freq0 * tidx + 0.5 * rate * tidx * tidx;
+      } else {
+        if (comp.kind == INTERFERER && sample % comp.period >= comp.on_len) {
+          continue;
+        }
+        // Wrap before the float conversion to keep precision on long runs
+        cycles = std::fmod(comp.freq0 * static_cast<double>(sample), 1.0);
+      }
+      acc += std::polar(static_cast<double>(comp.amp), TWO_PI * cycles);
+    }
+    std::complex<float> val(static_cast<float>(acc.real()), static_cast<float>(acc.imag()));
+    if (noise_sigma > 0.0f) {
+      const float re = normal(rng);
+      const float im = normal(rng);
+      val += noise_sigma * std::complex<float>(re, im);
+    }
+    out[sidx] = val;
+  }
+}
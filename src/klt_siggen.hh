@@ -0,0 +1,72 @@
+// Karhunen-Loève Transform Library
+// Synthetic complex test signals (benchmarks, standalone testing)
+
+#ifndef __KLT_SIGGEN_HH__
+#define __KLT_SIGGEN_HH__
+
+#include <complex>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+//---------------------------------------------------------------------------
+// Sum of tones, linear chirps, pulsed interferers and complex white noise.
+// Frequencies are normalized (cycles/sample, -0.5..0.5).  Output is a
+// deterministic function of the seed and the components, and successive
+// generate() calls continue the same signal.
+//---------------------------------------------------------------------------
+class KLTSigGen
+{
+public:
+  //---------------------------------------------------------------------------
+  // Constructor
+  //   seed: noise generator seed.
+  //---------------------------------------------------------------------------
+  explicit KLTSigGen(unsigned seed);
+
+  //---------------------------------------------------------------------------
+  // Components
+  //   add_tone: constant tone.
+  //   add_chirp: sweeps freq0 to freq1 over period samples, then restarts.
+  //   add_interferer: tone keyed on for on_len samples every period samples.
+  //   add_noise: complex white Gaussian noise of the given total power.
+  //---------------------------------------------------------------------------
+  void add_tone(double freq, float amp);
+  void add_chirp(double freq0, double freq1, long period, float amp);
+  void add_interferer(double freq, float amp, long on_len, long period);
+  void add_noise(float power);
+
+  //---------------------------------------------------------------------------
+  // Named mixes: "tone", "chirp", "noise", "interferer" (one component plus
+  // noise), or "mix" (all of them).  Returns false for an unknown name.
+  //---------------------------------------------------------------------------
+  bool add_preset(const std::string& name);
+
+  //---------------------------------------------------------------------------
+  // Next len samples
+  //---------------------------------------------------------------------------
+  void generate(std::complex<float>* out, size_t len);
+
+private:
+  enum Kind {
+    TONE,
+    CHIRP,
+    INTERFERER
+  };
+  struct Component {
+    Kind kind;
+    double freq0;
+    double freq1;
+    float amp;
+    long on_len;
+    long period;
+  };
+  std::vector<Component> comps;
+  float noise_sigma;
+  long sample;
+  std::mt19937 rng;
+  std::normal_distribution<float> normal;
+};
+
+#endif // __KLT_SIGGEN_HH__
@@ -0,0 +1,477 @@
+// Karhunen-Loève Transform Library
+// Complex float vector kernels (runtime CPU dispatch)
+
+#include "klt_simd.hh"
+
+#include <complex>
+#include <cstdint>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KLT_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define KLT_SIMD_X86 0
+#endif
+
+//---------------------------------------------------------------------------
+// Scalar kernels (fallback and vector tails)
+//---------------------------------------------------------------------------
+static std::complex<float> cdotc_scalar(const std::complex<float>* x,
+                                        const std::complex<float>* y, int len)
+{
+  float re = 0.0f;
+  float im = 0.0f;
+  const float* xf = reinterpret_cast<const float*>(x);
+  const float* yf = reinterpret_cast<const float*>(y);
+  for (int idx=0; idx < 2*len; idx += 2) {
+    re += xf[idx] * yf[idx] + xf[idx+1] * yf[idx+1];
+    im += xf[idx+1] * yf[idx] - xf[idx] * yf[idx+1];
+  }
+  return std::complex<float>(re, im);
+}
+
+static std::complex<double> cdotc_d_scalar(const std::complex<float>* x,
+                                           const std::complex<float>* y, int len)
+{
+  double re = 0.0;
+  double im = 0.0;
+  const float* xf = reinterpret_cast<const float*>(x);
+  const float* yf = reinterpret_cast<const float*>(y);
+  for (int idx=0; idx < 2*len; idx += 2) {
+    const double xr = xf[idx];
+    const double xi = xf[idx+1];
+    const double yr = yf[idx];
+    const double yi = yf[idx+1];
+    re += xr * yr + xi * yi;
+    im += xi * yr - xr * yi;
+  }
+  return std::complex<double>(re, im);
+}
+
+static void cscal_scalar(std::complex<float>* x, std::complex<float> a, int len)
+{
+  const float ar = a.real();
+  const float ai = a.imag();
+  float* xf = reinterpret_cast<float*>(x);
+  for (int idx=0; idx < 2*len; idx += 2) {
+    const float xr = xf[idx];
+    const float xi = xf[idx+1];
+    xf[idx] = xr * ar - xi * ai;
+    xf[idx+1] = xi * ar + xr * ai;
+  }
+}
+
+template <typename T>
+static void cvt_scalar(const T* x, const float* win, float scale,
+                       std::complex<float>* y, int len)
+{
+  float* yf = reinterpret_cast<float*>(y);
+  for (int idx=0; idx < len; idx++) {
+    const float w = win != NULL ? scale * win[idx] : scale;
+    yf[2*idx] = w * x[2*idx];
+    yf[2*idx+1] = w * x[2*idx+1];
+  }
+}
+
+static void cvt_ci16_scalar(const int16_t* x, const float* win, float scale,
+                            std::complex<float>* y, int len)
+{
+  cvt_scalar(x, win, scale, y, len);
+}
+
+static void cvt_ci8_scalar(const int8_t* x, const float* win, float scale,
+                           std::complex<float>* y, int len)
+{
+  cvt_scalar(x, win, scale, y, len);
+}
+
+#if KLT_SIMD_X86
+//---------------------------------------------------------------------------
+// AVX2/FMA kernels (4 complex per vector)
+//   Loads are unaligned so lag offsets work, they cost the same as aligned
+//   loads when the (ALIGN'd) buffers happen to be aligned.
+//   cdotc: acc_p += x*y gives (xr*yr, xi*yi) pairs, acc_q += x*swap(y) gives
+//   (xr*yi, xi*yr) pairs; re = sum(acc_p), im = sum(odd - even of acc_q).
+//---------------------------------------------------------------------------
+__attribute__((target("avx2,fma")))
+static std::complex<float> cdotc_avx2(const std::complex<float>* x,
+                                      const std::complex<float>* y, int len)
+{
+  const float* xf = reinterpret_cast<const float*>(x);
+  const float* yf = reinterpret_cast<const float*>(y);
+  __m256 acc_p0 = _mm256_setzero_ps();
+  __m256 acc_q0 = _mm256_setzero_ps();
+  __m256 acc_p1 = _mm256_setzero_ps();
+  __m256 acc_q1 = _mm256_setzero_ps();
+  int idx = 0;
+  for (; idx + 8 <= len; idx += 8) {
+    const __m256 x0 = _mm256_loadu_ps(&xf[2*idx]);
+    const __m256 y0 = _mm256_loadu_ps(&yf[2*idx]);
+    const __m256 x1 = _mm256_loadu_ps(&xf[2*idx+8]);
+    const __m256 y1 = _mm256_loadu_ps(&yf[2*idx+8]);
+    acc_p0 = _mm256_fmadd_ps(x0, y0, acc_p0);
+    acc_q0 = _mm256_fmadd_ps(x0, _mm256_permute_ps(y0, 0xB1), acc_q0);
+    acc_p1 = _mm256_fmadd_ps(x1, y1, acc_p1);
+    acc_q1 = _mm256_fmadd_ps(x1, _mm256_permute_ps(y1, 0xB1), acc_q1);
+  }
+  for (; idx + 4 <= len; idx += 4) {
+    const __m256 x0 = _mm256_loadu_ps(&xf[2*idx]);
+    const __m256 y0 = _mm256_loadu_ps(&yf[2*idx]);
+    acc_p0 = _mm256_fmadd_ps(x0, y0, acc_p0);
+    acc_q0 = _mm256_fmadd_ps(x0, _mm256_permute_ps(y0, 0xB1), acc_q0);
+  }
+  const __m256 acc_p = _mm256_add_ps(acc_p0, acc_p1);
+  // Negate the even (xr*yi) lanes so a plain sum gives the imaginary part
+  const __m256 sign = _mm256_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
+  const __m256 acc_q = _mm256_mul_ps(_mm256_add_ps(acc_q0, acc_q1), sign);
+  // Horizontal sums: lane 0 of the hadd tree gets re, lane 1 gets im
+  __m256 sum = _mm256_hadd_ps(acc_p, acc_q);
+  sum = _mm256_hadd_ps(sum, sum);
+  const __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+  float part[4];
+  _mm_storeu_ps(part, sum4);
+  return std::complex<float>(part[0], part[1]) + cdotc_scalar(&x[idx], &y[idx], len - idx);
+}
+
+// cdotc_avx2 on 2 complex (4 doubles) per vector, widened from float
+__attribute__((target("avx2,fma")))
+static std::complex<double> cdotc_d_avx2(const std::complex<float>* x,
+                                         const std::complex<float>* y, int len)
+{
+  const float* xf = reinterpret_cast<const float*>(x);
+  const float* yf = reinterpret_cast<const float*>(y);
+  __m256d acc_p0 = _mm256_setzero_pd();
+  __m256d acc_q0 = _mm256_setzero_pd();
+  __m256d acc_p1 = _mm256_setzero_pd();
+  __m256d acc_q1 = _mm256_setzero_pd();
+  int idx = 0;
+  for (; idx + 4 <= len; idx += 4) {
+    const __m256d x0 = _mm256_cvtps_pd(_mm_loadu_ps(&xf[2*idx]));
+    const __m256d y0 = _mm256_cvtps_pd(_mm_loadu_ps(&yf[2*idx]));
+    const __m256d x1 = _mm256_cvtps_pd(_mm_loadu_ps(&xf[2*idx+4]));
+    const __m256d y1 = _mm256_cvtps_pd(_mm_loadu_ps(&yf[2*idx+4]));
+    acc_p0 = _mm256_fmadd_pd(x0, y0, acc_p0);
+    acc_q0 = _mm256_fmadd_pd(x0, _mm256_permute_pd(y0, 0x5), acc_q0);
+    acc_p1 = _mm256_fmadd_pd(x1, y1, acc_p1);
+    acc_q1 = _mm256_fmadd_pd(x1, _mm256_permute_pd(y1, 0x5), acc_q1);
+  }
+  const __m256d sign = _mm256_setr_pd(-1.0, 1.0, -1.0, 1.0);
+  const __m256d acc_p = _mm256_add_pd(acc_p0, acc_p1);
+  const __m256d acc_q = _mm256_mul_pd(_mm256_add_pd(acc_q0, acc_q1), sign);
+  // Lane 0 of the hadd gets re, lane 1 gets im (per 128-bit half)
+  const __m256d sum = _mm256_hadd_pd(acc_p, acc_q);
+  const __m128d sum2 = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+  double part[2];
+  _mm_storeu_pd(part, sum2);
+  return std::complex<double>(part[0], part[1]) +
+    cdotc_d_scalar(&x[idx], &y[idx], len - idx);
+}
+
+__attribute__((target("avx2,fma")))
+static void cscal_avx2(std::complex<float>* x, std::complex<float> a, int len)
+{
+  float* xf = reinterpret_cast<float*>(x);
+  const __m256 ar = _mm256_set1_ps(a.real());
+  // swap(x) * (-ai, ai) = (-xi*ai, xr*ai)
+  const __m256 ai = _mm256_setr_ps(-a.imag(), a.imag(), -a.imag(), a.imag(),
+                                   -a.imag(), a.imag(), -a.imag(), a.imag());
+  int idx = 0;
+  for (; idx + 4 <= len; idx += 4) {
+    const __m256 xv = _mm256_loadu_ps(&xf[2*idx]);
+    const __m256 yv = _mm256_fmadd_ps(_mm256_permute_ps(xv, 0xB1), ai,
+                                      _mm256_mul_ps(xv, ar));
+    _mm256_storeu_ps(&xf[2*idx], yv);
+  }
+  cscal_scalar(&x[idx], a, len - idx);
+}
+
+// Window taps of 4 complex, each duplicated for I and Q, times scale
+__attribute__((target("avx2,fma")))
+static inline __m256 cvt_gain_avx2(const float* win, int idx, __m256 scale)
+{
+  if (win == NULL) {
+    return scale;
+  }
+  const __m256i dup = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+  const __m256 w = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&win[idx]));
+  return _mm256_mul_ps(_mm256_permutevar8x32_ps(w, dup), scale);
+}
+
+__attribute__((target("avx2,fma")))
+static void cvt_ci16_avx2(const int16_t* x, const float* win, float scale,
+                          std::complex<float>* y, int len)
+{
+  float* yf = reinterpret_cast<float*>(y);
+  const __m256 sv = _mm256_set1_ps(scale);
+  int idx = 0;
+  for (; idx + 4 <= len; idx += 4) {
+    const __m128i xi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&x[2*idx]));
+    const __m256 xv = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(xi));
+    _mm256_storeu_ps(&yf[2*idx], _mm256_mul_ps(xv, cvt_gain_avx2(win, idx, sv)));
+  }
+  cvt_scalar(&x[2*idx], win != NULL ? &win[idx] : NULL, scale, &y[idx], len - idx);
+}
+
+__attribute__((target("avx2,fma")))
+static void cvt_ci8_avx2(const int8_t* x, const float* win, float scale,
+                         std::complex<float>* y, int len)
+{
+  float* yf = reinterpret_cast<float*>(y);
+  const __m256 sv = _mm256_set1_ps(scale);
+  int idx = 0;
+  for (; idx + 4 <= len; idx += 4) {
+    const __m128i xi = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&x[2*idx]));
+    const __m256 xv = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(xi));
+    _mm256_storeu_ps(&yf[2*idx], _mm256_mul_ps(xv, cvt_gain_avx2(win, idx, sv)));
+  }
+  cvt_scalar(&x[2*idx], win != NULL ? &win[idx] : NULL, scale, &y[idx], len - idx);
+}
+
+//---------------------------------------------------------------------------
+// AVX-512 kernels (8 complex per vector, masked tails)
+//   Zero-masked permutes/shuffles with a full mask are used in place of the
+//   plain intrinsics, which trip -Wuninitialized in some GCC headers.
+//---------------------------------------------------------------------------
+static const __mmask16 ALL16 = 0xFFFF;
+
+__attribute__((target("avx512f")))
+static inline __m512 swap_avx512(__m512 v)
+{
+  return _mm512_maskz_permute_ps(ALL16, v, 0xB1);
+}
+
+// Sum of the 16 lanes down to 4 (lane i: sum of lanes i, i+4, i+8, i+12)
+__attribute__((target("avx512f")))
+static inline __m128 fold_avx512(__m512 v)
+{
+  v = _mm512_add_ps(v, _mm512_maskz_shuffle_f32x4(ALL16, v, v, 0x4E));
+  v = _mm512_add_ps(v, _mm512_maskz_shuffle_f32x4(ALL16, v, v, 0xB1));
+  return _mm512_maskz_extractf32x4_ps(0xF, v, 0);
+}
+
+__attribute__((target("avx512f")))
+static std::complex<float> cdotc_avx512(const std::complex<float>* x,
+                                        const std::complex<float>* y, int len)
+{
+  const float* xf = reinterpret_cast<const float*>(x);
+  const float* yf = reinterpret_cast<const float*>(y);
+  __m512 acc_p0 = _mm512_setzero_ps();
+  __m512 acc_q0 = _mm512_setzero_ps();
+  __m512 acc_p1 = _mm512_setzero_ps();
+  __m512 acc_q1 = _mm512_setzero_ps();
+  int idx = 0;
+  for (; idx + 16 <= len; idx += 16) {
+    const __m512 x0 = _mm512_loadu_ps(&xf[2*idx]);
+    const __m512 y0 = _mm512_loadu_ps(&yf[2*idx]);
+    const __m512 x1 = _mm512_loadu_ps(&xf[2*idx+16]);
+    const __m512 y1 = _mm512_loadu_ps(&yf[2*idx+16]);
+    acc_p0 = _mm512_fmadd_ps(x0, y0, acc_p0);
+    acc_q0 = _mm512_fmadd_ps(x0, swap_avx512(y0), acc_q0);
+    acc_p1 = _mm512_fmadd_ps(x1, y1, acc_p1);
+    acc_q1 = _mm512_fmadd_ps(x1, swap_avx512(y1), acc_q1);
+  }
+  for (; idx < len; idx += 8) {
+    const int num = len - idx < 8 ? len - idx : 8;
+    const __mmask16 mask = static_cast<__mmask16>((1u << (2*num)) - 1);
+    const __m512 x0 = _mm512_maskz_loadu_ps(mask, &xf[2*idx]);
+    const __m512 y0 = _mm512_maskz_loadu_ps(mask, &yf[2*idx]);
+    acc_p0 = _mm512_fmadd_ps(x0, y0, acc_p0);
+    acc_q0 = _mm512_fmadd_ps(x0, swap_avx512(y0), acc_q0);
+  }
+  const __m512 sign = _mm512_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f,
+                                     -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
+  const __m128 acc_p = fold_avx512(_mm512_add_ps(acc_p0, acc_p1));
+  const __m128 acc_q = fold_avx512(_mm512_mul_ps(_mm512_add_ps(acc_q0, acc_q1), sign));
+  // Lane 0 gets re, lane 1 gets im
+  __m128 sum = _mm_hadd_ps(acc_p, acc_q);
+  sum = _mm_hadd_ps(sum, sum);
+  float part[4];
+  _mm_storeu_ps(part, sum);
+  return std::complex<float>(part[0], part[1]);
+}
+
+// Sum of the 8 lanes down to 2 (lane i: sum of lanes i, i+2, i+4, i+6)
+__attribute__((target("avx512f")))
+static inline __m128d fold_d_avx512(__m512d v)
+{
+  v = _mm512_add_pd(v, _mm512_maskz_shuffle_f64x2(0xFF, v, v, 0x4E));
+  v = _mm512_add_pd(v, _mm512_maskz_shuffle_f64x2(0xFF, v, v, 0xB1));
+  return _mm_castps_pd(_mm512_maskz_extractf32x4_ps(0xF, _mm512_castpd_ps(v), 0));
+}
+
+// cdotc_avx512 on 4 complex (8 doubles) per vector, widened from float
+__attribute__((target("avx512f")))
+static std::complex<double> cdotc_d_avx512(const std::complex<float>* x,
+                                           const std::complex<float>* y, int len)
+{
+  const float* xf = reinterpret_cast<const float*>(x);
+  const float* yf = reinterpret_cast<const float*>(y);
+  __m512d acc_p0 = _mm512_setzero_pd();
+  __m512d acc_q0 = _mm512_setzero_pd();
+  __m512d acc_p1 = _mm512_setzero_pd();
+  __m512d acc_q1 = _mm512_setzero_pd();
+  int idx = 0;
+  for (; idx + 8 <= len; idx += 8) {
+    const __m512d x0 = _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(&xf[2*idx]));
+    const __m512d y0 = _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(&yf[2*idx]));
+    const __m512d x1 = _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(&xf[2*idx+8]));
+    const __m512d y1 = _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(&yf[2*idx+8]));
+    acc_p0 = _mm512_fmadd_pd(x0, y0, acc_p0);
+    acc_q0 = _mm512_fmadd_pd(x0, _mm512_maskz_permute_pd(0xFF, y0, 0x55), acc_q0);
+    acc_p1 = _mm512_fmadd_pd(x1, y1, acc_p1);
+    acc_q1 = _mm512_fmadd_pd(x1, _mm512_maskz_permute_pd(0xFF, y1, 0x55), acc_q1);
+  }
+  const __m512d sign = _mm512_setr_pd(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0, -1.0, 1.0);
+  // Lane 0 gets re, lane 1 gets im
+  const __m128d sum = _mm_hadd_pd(fold_d_avx512(_mm512_add_pd(acc_p0, acc_p1)),
+                                  fold_d_avx512(_mm512_mul_pd(_mm512_add_pd(acc_q0, acc_q1),
+                                                              sign)));
+  double part[2];
+  _mm_storeu_pd(part, sum);
+  return std::complex<double>(part[0], part[1]) +
+    cdotc_d_scalar(&x[idx], &y[idx], len - idx);
+}
+
+__attribute__((target("avx512f")))
+static void cscal_avx512(std::complex<float>* x, std::complex<float> a, int len)
+{
+  float* xf = reinterpret_cast<float*>(x);
+  const __m512 ar = _mm512_set1_ps(a.real());
+  const __m512 ai = _mm512_setr_ps(-a.imag(), a.imag(), -a.imag(), a.imag(),
+                                   -a.imag(), a.imag(), -a.imag(), a.imag(),
+                                   -a.imag(), a.imag(), -a.imag(), a.imag(),
+                                   -a.imag(), a.imag(), -a.imag(), a.imag());
+  for (int idx=0; idx < len; idx += 8) {
+    const int num = len - idx < 8 ? len - idx : 8;
+    const __mmask16 mask = static_cast<__mmask16>((1u << (2*num)) - 1);
+    const __m512 xv = _mm512_maskz_loadu_ps(mask, &xf[2*idx]);
+    const __m512 yv = _mm512_fmadd_ps(swap_avx512(xv), ai,
+                                      _mm512_mul_ps(xv, ar));
+    _mm512_mask_storeu_ps(&xf[2*idx], mask, yv);
+  }
+}
+
+// Window taps of 8 complex, each duplicated for I and Q, times scale.  The
+// integer loads would need AVX512BW to be masked, so the conversions finish
+// their tails with the scalar kernel instead.
+__attribute__((target("avx512f")))
+static inline __m512 cvt_gain_avx512(const float* win, int idx, __m512 scale)
+{
+  if (win == NULL) {
+    return scale;
+  }
+  const __m512i dup = _mm512_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7);
+  const __m512 w = _mm512_maskz_loadu_ps(0x00FF, &win[idx]);
+  return _mm512_mul_ps(_mm512_maskz_permutexvar_ps(ALL16, dup, w), scale);
+}
+
+__attribute__((target("avx512f")))
+static void cvt_ci16_avx512(const int16_t* x, const float* win, float scale,
+                            std::complex<float>* y, int len)
+{
+  float* yf = reinterpret_cast<float*>(y);
+  const __m512 sv = _mm512_set1_ps(scale);
+  int idx = 0;
+  for (; idx + 8 <= len; idx += 8) {
+    const __m256i xi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&x[2*idx]));
+    const __m512 xv = _mm512_maskz_cvtepi32_ps(ALL16, _mm512_maskz_cvtepi16_epi32(ALL16, xi));
+    _mm512_storeu_ps(&yf[2*idx], _mm512_mul_ps(xv, cvt_gain_avx512(win, idx, sv)));
+  }
+  cvt_scalar(&x[2*idx], win != NULL ? &win[idx] : NULL, scale, &y[idx], len - idx);
+}
+
+__attribute__((target("avx512f")))
+static void cvt_ci8_avx512(const int8_t* x, const float* win, float scale,
+                           std::complex<float>* y, int len)
+{
+  float* yf = reinterpret_cast<float*>(y);
+  const __m512 sv = _mm512_set1_ps(scale);
+  int idx = 0;
+  for (; idx + 8 <= len; idx += 8) {
+    const __m128i xi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&x[2*idx]));
+    const __m512 xv = _mm512_maskz_cvtepi32_ps(ALL16, _mm512_maskz_cvtepi8_epi32(ALL16, xi));
+    _mm512_storeu_ps(&yf[2*idx], _mm512_mul_ps(xv, cvt_gain_avx512(win, idx, sv)));
+  }
+  cvt_scalar(&x[2*idx], win != NULL ? &win[idx] : NULL, scale, &y[idx], len - idx);
+}
+#endif // KLT_SIMD_X86
+
+//---------------------------------------------------------------------------
+// Dispatch table, selected once (thread-safe static init)
+//---------------------------------------------------------------------------
+struct KLTSimdKernels {
+  KLTSimdIsa isa;
+  std::complex<float> (*cdotc)(const std::complex<float>*, const std::complex<float>*, int);
+  std::complex<double> (*cdotc_d)(const std::complex<float>*, const std::complex<float>*, int);
+  void (*cscal)(std::complex<float>*, std::complex<float>, int);
+  void (*cvt_ci16)(const int16_t*, const float*, float, std::complex<float>*, int);
+  void (*cvt_ci8)(const int8_t*, const float*, float, std::complex<float>*, int);
+};
+
+static KLTSimdKernels select_kernels()
+{
+  KLTSimdKernels kern = {KLT_SIMD_SCALAR, cdotc_scalar, cdotc_d_scalar, cscal_scalar,
+                          cvt_ci16_scalar, cvt_ci8_scalar};
+#if KLT_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    kern.isa = KLT_SIMD_AVX512;
+    kern.cdotc = cdotc_avx512;
+    kern.cdotc_d = cdotc_d_avx512;
+    kern.cscal = cscal_avx512;
+    kern.cvt_ci16 = cvt_ci16_avx512;
+    kern.cvt_ci8 = cvt_ci8_avx512;
+  } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    kern.isa = KLT_SIMD_AVX2;
+    kern.cdotc = cdotc_avx2;
+    kern.cdotc_d = cdotc_d_avx2;
+    kern.cscal = cscal_avx2;
+    kern.cvt_ci16 = cvt_ci16_avx2;
+    kern.cvt_ci8 = cvt_ci8_avx2;
+  }
+#endif
+  return kern;
+}
+
+static const KLTSimdKernels& kernels()
+{
+  static const KLTSimdKernels kern = select_kernels();
+  return kern;
+}
+
+
+//---------------------------------------------------------------------------
+// Public entry points
+//---------------------------------------------------------------------------
+KLTSimdIsa klt_simd_isa()
+{
+  return kernels().isa;
+}
+
+std::complex<float> klt_cdotc(const std::complex<float>* x,
+                              const std::complex<float>* y, int len)
+{
+  return kernels().cdotc(x, y, len);
+}
+
+std::complex<double> klt_cdotc_d(const std::complex<float>* x,
+                                 const std::complex<float>* y, int len)
+{
+  return kernels().cdotc_d(x, y, len);
+}
+
+void klt_cscal(std::complex<float>* x, std::complex<float> a, int len)
+{
+  kernels().cscal(x, a, len);
+}
+
+void klt_cvt_ci16(const int16_t* x, const float* win, float scale,
+                  std::complex<float>* y, int len)
+{
+  kernels().cvt_ci16(x, win, scale, y, len);
+}
+
+void klt_cvt_ci8(const int8_t* x, const float* win, float scale,
+                 std::complex<float>* y, int len)
+{
+  kernels().cvt_ci8(x, win, scale, y, len);
+}
@@ -0,0 +1,59 @@
+// Karhunen-Loève Transform Library
+// Complex float vector kernels (runtime CPU dispatch)
+
+#ifndef __KLT_SIMD_HH__
+#define __KLT_SIMD_HH__
+
+#include <complex>
+#include <cstdint>
+
+//---------------------------------------------------------------------------
+// Instruction sets the kernels are compiled for, best first.  The best one
+// the CPU supports is picked on first use.
+//---------------------------------------------------------------------------
+enum KLTSimdIsa {
+  KLT_SIMD_AVX512,
+  KLT_SIMD_AVX2,
+  KLT_SIMD_SCALAR
+};
+
+//---------------------------------------------------------------------------
+// Instruction set in use
+//---------------------------------------------------------------------------
+KLTSimdIsa klt_simd_isa();
+
+//---------------------------------------------------------------------------
+// Conjugated dot product: sum x[i] * conj(y[i]), i < len
+//   Real and imaginary partial sums are kept interleaved in the vector
+//   accumulators (x*y and x*swap(y)) and only separated once at the end.
+//---------------------------------------------------------------------------
+std::complex<float> klt_cdotc(const std::complex<float>* x,
+                              const std::complex<float>* y, int len);
+
+//---------------------------------------------------------------------------
+// klt_cdotc() accumulated in double: sum x[i] * conj(y[i]), i < len
+//   The float products are formed in double (exact), so the sum is good to
+//   double rounding however long len is.
+//---------------------------------------------------------------------------
+std::complex<double> klt_cdotc_d(const std::complex<float>* x,
+                                 const std::complex<float>* y, int len);
+
+//---------------------------------------------------------------------------
+// Scale in-place: x[i] *= a, i < len
+//---------------------------------------------------------------------------
+void klt_cscal(std::complex<float>* x, std::complex<float> a, int len);
+
+//---------------------------------------------------------------------------
+// Complex integer to complex float, scaled and windowed:
+//   y[i] = scale * win[i] * x[i], i < len
+//   x: len interleaved I/Q pairs (BLUE "CI" int16 or "CB" int8).
+//   win: window (size len), or NULL to only scale.
+//   Sign extension, conversion and the multiply are done in-register, so the
+//   integers are the only thing read.
+//---------------------------------------------------------------------------
+void klt_cvt_ci16(const int16_t* x, const float* win, float scale,
+                  std::complex<float>* y, int len);
+void klt_cvt_ci8(const int8_t* x, const float* win, float scale,
+                 std::complex<float>* y, int len);
+
+#endif // __KLT_SIMD_HH__
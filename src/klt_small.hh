@@ -0,0 +1,396 @@
+// Karhunen-Loève Transform Library
+// Compile-time specialized small-order kernels
+
+#ifndef __KLT_SMALL_HH__
+#define __KLT_SMALL_HH__
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+
+//---------------------------------------------------------------------------
+// Whole-frame kernel: lags, top NumEig eigenpairs, coeffs and basis
+// functions, same outputs as KLT::transform().  The basis functions are
+// weighted by the coeffs only if weight is set.  With kltb NULL only the
+// eigenvalues are computed (kltc is left untouched).  Returns false on
+// failure (non-finite input).
+//---------------------------------------------------------------------------
+typedef bool (*KLTSmallFn)(const std::complex<float>* in, int in_len,
+                           float* eval, std::complex<float>* kltc,
+                           std::complex<float>* kltb, bool weight);
+
+//---------------------------------------------------------------------------
+// KLT for a fixed acm_order (Order) and num_eig (NumEig)
+//   All storage is fixed-size and on the stack, and every loop over the
+//   matrix order has a compile-time trip count.  The eigensolver is the
+//   LAPACK path (Householder tridiagonalization, Sturm bisection, inverse
+//   iteration, back-transform) inlined, without the call and packed-storage
+//   overhead that dominates at these sizes, and it only solves the top
+//   NumEig eigenpairs.
+//---------------------------------------------------------------------------
+template <int Order, int NumEig>
+struct KLTSmall
+{
+  static bool transform(const std::complex<float>* in, int in_len,
+                        float* eval, std::complex<float>* kltc,
+                        std::complex<float>* kltb, bool weight)
+  {
+    float lag_re[Order];
+    float lag_im[Order];
+    acorr(in, in_len, lag_re, lag_im);
+    if (!eigen(lag_re, lag_im, eval, kltb)) {
+      return false;
+    }
+    if (kltb == NULL) {
+      return true;
+    }
+    // Coeffs and (weighted) basis functions
+    for (int cidx=0; cidx < NumEig; cidx++) {
+      std::complex<float>* v = &kltb[cidx*Order];
+      float c_re = 0.0f;
+      float c_im = 0.0f;
+      for (int tidx=0; tidx < Order; tidx++) {
+        const float x_re = in[tidx].real();
+        const float x_im = in[tidx].imag();
+        const float v_re = v[tidx].real();
+        const float v_im = v[tidx].imag();
+        c_re += x_re * v_re + x_im * v_im;
+        c_im += x_im * v_re - x_re * v_im;
+      }
+      kltc[cidx] = std::complex<float>(c_re, c_im);
+      if (weight) {
+        for (int tidx=0; tidx < Order; tidx++) {
+          v[tidx] *= kltc[cidx];
+        }
+      }
+    }
+    return true;
+  }
+
+  //-------------------------------------------------------------------------
+  // Lags r[k] = sum_n x[n+k] conj(x[n]), k < Order
+  //   Sample-outer order keeps the Order accumulators in registers; the lag
+  //   loop has a constant trip count and unrolls.
+  //-------------------------------------------------------------------------
+  static void acorr(const std::complex<float>* in, int in_len,
+                    float* lag_re, float* lag_im)
+  {
+    for (int aidx=0; aidx < Order; aidx++) {
+      lag_re[aidx] = 0.0f;
+      lag_im[aidx] = 0.0f;
+    }
+    const int num_full = in_len - Order + 1;
+    int nidx = 0;
+    for (; nidx < num_full; nidx++) {
+      const float c_re = in[nidx].real();
+      const float c_im = in[nidx].imag();
+      const std::complex<float>* x = &in[nidx];
+      for (int aidx=0; aidx < Order; aidx++) {
+        lag_re[aidx] += x[aidx].real() * c_re + x[aidx].imag() * c_im;
+        lag_im[aidx] += x[aidx].imag() * c_re - x[aidx].real() * c_im;
+      }
+    }
+    // Tail: samples with fewer than Order partners left
+    for (; nidx < in_len; nidx++) {
+      const float c_re = in[nidx].real();
+      const float c_im = in[nidx].imag();
+      const std::complex<float>* x = &in[nidx];
+      for (int aidx=0; aidx < in_len - nidx; aidx++) {
+        lag_re[aidx] += x[aidx].real() * c_re + x[aidx].imag() * c_im;
+        lag_im[aidx] += x[aidx].imag() * c_re - x[aidx].real() * c_im;
+      }
+    }
+  }
+
+  //-------------------------------------------------------------------------
+  // Top NumEig eigenpairs of the Hermitian Toeplitz matrix of the lags,
+  // eigenvalues ascending (as from sstebz), eigenvectors as columns of evec
+  // (col major, size Order x NumEig, NULL for eigenvalues only).
+  //-------------------------------------------------------------------------
+  static bool eigen(const float* lag_re, const float* lag_im,
+                    float* eval, std::complex<float>* evec)
+  {
+    // Full Hermitian matrix, a[col*Order+row]
+    std::complex<float> a[Order*Order];
+    for (int cidx=0; cidx < Order; cidx++) {
+      for (int ridx=0; ridx < Order; ridx++) {
+        const int aidx = ridx >= cidx ? ridx - cidx : cidx - ridx;
+        const float sgn = ridx >= cidx ? 1.0f : -1.0f;
+        a[cidx*Order+ridx] = std::complex<float>(lag_re[aidx], sgn * lag_im[aidx]);
+      }
+    }
+
+    // Householder tridiagonalization, reflector k (I - tau v v^H) acts on
+    // rows/cols k+1..Order-1 and is kept in a's column k below the diagonal
+    float d[Order];
+    std::complex<float> e[Order];
+    float tau[Order];
+    for (int kidx=0; kidx < Order-1; kidx++) {
+      d[kidx] = a[kidx*Order+kidx].real();
+      std::complex<float>* v = &a[kidx*Order];
+      float rest = 0.0f;
+      for (int ridx=kidx+2; ridx < Order; ridx++) {
+        rest += std::norm(v[ridx]);
+      }
+      const std::complex<float> x0 = v[kidx+1];
+      const float x0_abs = std::abs(x0);
+      const float xnrm = std::sqrt(rest + x0_abs * x0_abs);
+      if (!(rest > 0.0f)) {
+        // Already tridiagonal in this column
+        e[kidx] = x0;
+        tau[kidx] = 0.0f;
+        continue;
+      }
+      const std::complex<float> phase = x0_abs > 0.0f ? x0 / x0_abs :
+        std::complex<float>(1.0f, 0.0f);
+      const std::complex<float> alpha = -phase * xnrm;
+      v[kidx+1] -= alpha;
+      float vnrm = 0.0f;
+      for (int ridx=kidx+1; ridx < Order; ridx++) {
+        vnrm += std::norm(v[ridx]);
+      }
+      const float t = 2.0f / vnrm;
+      tau[kidx] = t;
+      e[kidx] = alpha;
+      // w = t A v, w -= (t/2 v^H w) v, A -= v w^H + w v^H
+      std::complex<float> w[Order];
+      std::complex<float> vhw(0.0f, 0.0f);
+      for (int ridx=kidx+1; ridx < Order; ridx++) {
+        std::complex<float> acc(0.0f, 0.0f);
+        for (int cidx=kidx+1; cidx < Order; cidx++) {
+          acc += a[cidx*Order+ridx] * v[cidx];
+        }
+        w[ridx] = t * acc;
+        vhw += std::conj(v[ridx]) * w[ridx];
+      }
+      const std::complex<float> kk = 0.5f * t * vhw;
+      for (int ridx=kidx+1; ridx < Order; ridx++) {
+        w[ridx] -= kk * v[ridx];
+      }
+      for (int cidx=kidx+1; cidx < Order; cidx++) {
+        const std::complex<float> vc = std::conj(v[cidx]);
+        const std::complex<float> wc = std::conj(w[cidx]);
+        for (int ridx=kidx+1; ridx < Order; ridx++) {
+          a[cidx*Order+ridx] -= v[ridx] * wc + w[ridx] * vc;
+        }
+      }
+    }
+    d[Order-1] = a[(Order-1)*Order+(Order-1)].real();
+
+    // Make the off-diagonal real: T = D T' D^H, D = diag(ph)
+    std::complex<float> ph[Order];
+    float ee[Order];
+    ph[0] = std::complex<float>(1.0f, 0.0f);
+    for (int kidx=0; kidx < Order-1; kidx++) {
+      const float e_abs = std::abs(e[kidx]);
+      ee[kidx] = e_abs;
+      ph[kidx+1] = e_abs > 0.0f ? ph[kidx] * (e[kidx] / e_abs) : ph[kidx];
+    }
+    ee[Order-1] = 0.0f;
+
+    // Gershgorin bounds
+    float lo = d[0];
+    float hi = d[0];
+    float tnrm = 0.0f;
+    for (int kidx=0; kidx < Order; kidx++) {
+      const float rad = (kidx > 0 ? ee[kidx-1] : 0.0f) + ee[kidx];
+      lo = std::min(lo, d[kidx] - rad);
+      hi = std::max(hi, d[kidx] + rad);
+      tnrm = std::max(tnrm, std::abs(d[kidx]) + rad);
+    }
+    if (!(tnrm == tnrm) || !(tnrm <= 3.0e38f)) {
+      return false;
+    }
+    const float pivmin = std::max(tnrm * 1.0e-30f, 1.0e-30f);
+    const float eps = 6.0e-8f;
+
+    // Eigenvalues Order-NumEig..Order-1 by bisection (Sturm counts)
+    for (int eidx=0; eidx < NumEig; eidx++) {
+      const int target = Order - NumEig + eidx;
+      float l = lo;
+      float h = hi;
+      for (int iter=0; iter < 64 && h - l > 2.0f * eps * std::max(std::abs(l), std::abs(h)) + pivmin; iter++) {
+        const float mid = 0.5f * (l + h);
+        if (sturm_count(d, ee, mid, pivmin) <= target) {
+          l = mid;
+        } else {
+          h = mid;
+        }
+      }
+      eval[eidx] = 0.5f * (l + h);
+    }
+    if (evec == NULL) {
+      return true;
+    }
+
+    // Eigenvectors by inverse iteration on T', orthogonalized against
+    // already found vectors of (nearly) equal eigenvalues.  The right-hand
+    // side is scaled by tiny before each solve so that the result stays O(1)
+    // even when a pivot had to be replaced by tiny (e.g. an all-zero frame).
+    const float tiny = std::max(tnrm * eps, pivmin);
+    float y[NumEig][Order];
+    for (int eidx=0; eidx < NumEig; eidx++) {
+      float* yv = y[eidx];
+      const float lambda = eval[eidx];
+      for (int kidx=0; kidx < Order; kidx++) {
+        // Deterministic start with components in all directions
+        yv[kidx] = 1.0f + 0.1f * static_cast<float>((kidx * 7 + eidx * 3) % 11) / 11.0f;
+      }
+      for (int iter=0; iter < 3; iter++) {
+        for (int kidx=0; kidx < Order; kidx++) {
+          yv[kidx] *= tiny;
+        }
+        tridiag_solve(d, ee, lambda, tiny, yv);
+        for (int pidx=0; pidx < eidx; pidx++) {
+          if (std::abs(eval[pidx] - lambda) <= 1.0e-3f * tnrm) {
+            float dot = 0.0f;
+            for (int kidx=0; kidx < Order; kidx++) {
+              dot += y[pidx][kidx] * yv[kidx];
+            }
+            for (int kidx=0; kidx < Order; kidx++) {
+              yv[kidx] -= dot * y[pidx][kidx];
+            }
+          }
+        }
+        float nrm = 0.0f;
+        for (int kidx=0; kidx < Order; kidx++) {
+          nrm += yv[kidx] * yv[kidx];
+        }
+        if (!(nrm > 0.0f) || !(nrm <= 3.0e38f)) {
+          return false;
+        }
+        const float scale = 1.0f / std::sqrt(nrm);
+        for (int kidx=0; kidx < Order; kidx++) {
+          yv[kidx] *= scale;
+        }
+      }
+    }
+
+    // Back-transform: evec = H_0 ... H_{Order-3} D y
+    for (int eidx=0; eidx < NumEig; eidx++) {
+      std::complex<float>* x = &evec[eidx*Order];
+      for (int kidx=0; kidx < Order; kidx++) {
+        x[kidx] = ph[kidx] * y[eidx][kidx];
+      }
+      for (int kidx=Order-2; kidx >= 0; kidx--) {
+        if (tau[kidx] == 0.0f) {
+          continue;
+        }
+        const std::complex<float>* v = &a[kidx*Order];
+        std::complex<float> vhx(0.0f, 0.0f);
+        for (int ridx=kidx+1; ridx < Order; ridx++) {
+          vhx += std::conj(v[ridx]) * x[ridx];
+        }
+        vhx *= tau[kidx];
+        for (int ridx=kidx+1; ridx < Order; ridx++) {
+          x[ridx] -= vhx * v[ridx];
+        }
+      }
+    }
+    return true;
+  }
+
+  //-------------------------------------------------------------------------
+  // Number of eigenvalues of the real symmetric tridiagonal (d, e) < x
+  //-------------------------------------------------------------------------
+  static int sturm_count(const float* d, const float* e, float x, float pivmin)
+  {
+    int count = 0;
+    float q = d[0] - x;
+    if (std::abs(q) < pivmin) {
+      q = -pivmin;
+    }
+    count += q < 0.0f;
+    for (int kidx=1; kidx < Order; kidx++) {
+      q = d[kidx] - x - e[kidx-1] * e[kidx-1] / q;
+      if (std::abs(q) < pivmin) {
+        q = -pivmin;
+      }
+      count += q < 0.0f;
+    }
+    return count;
+  }
+
+  //-------------------------------------------------------------------------
+  // Solve (T - lambda I) y = b in-place, Gaussian elimination with partial
+  // pivoting (as sgtsv); zero pivots are replaced by tiny, as inverse
+  // iteration expects a nearly singular system.
+  //-------------------------------------------------------------------------
+  static void tridiag_solve(const float* d, const float* e, float lambda,
+                            float tiny, float* b)
+  {
+    float dl[Order];
+    float dd[Order];
+    float du[Order];
+    for (int kidx=0; kidx < Order; kidx++) {
+      dl[kidx] = e[kidx];
+      dd[kidx] = d[kidx] - lambda;
+      du[kidx] = e[kidx];
+    }
+    for (int kidx=0; kidx < Order-1; kidx++) {
+      if (std::abs(dd[kidx]) >= std::abs(dl[kidx])) {
+        if (dd[kidx] == 0.0f) {
+          dd[kidx] = tiny;
+        }
+        const float fact = dl[kidx] / dd[kidx];
+        dd[kidx+1] -= fact * du[kidx];
+        b[kidx+1] -= fact * b[kidx];
+        dl[kidx] = 0.0f;
+      } else {
+        const float fact = dd[kidx] / dl[kidx];
+        dd[kidx] = dl[kidx];
+        const float tmp = dd[kidx+1];
+        dd[kidx+1] = du[kidx] - fact * tmp;
+        if (kidx < Order-2) {
+          dl[kidx] = du[kidx+1];
+          du[kidx+1] = -fact * dl[kidx];
+        } else {
+          dl[kidx] = 0.0f;
+        }
+        du[kidx] = tmp;
+        const float bt = b[kidx];
+        b[kidx] = b[kidx+1];
+        b[kidx+1] = bt - fact * b[kidx+1];
+      }
+    }
+    if (dd[Order-1] == 0.0f) {
+      dd[Order-1] = tiny;
+    }
+    b[Order-1] /= dd[Order-1];
+    if (Order > 1) {
+      b[Order-2] = (b[Order-2] - du[Order-2] * b[Order-1]) / dd[Order-2];
+    }
+    for (int kidx=Order-3; kidx >= 0; kidx--) {
+      b[kidx] = (b[kidx] - du[kidx] * b[kidx+1] - dl[kidx] * b[kidx+2]) / dd[kidx];
+    }
+  }
+};
+
+//---------------------------------------------------------------------------
+// Specialized kernel for (acm_order, num_eig), or NULL if there is none
+//---------------------------------------------------------------------------
+template <int Order>
+inline KLTSmallFn klt_small_kernel_order(int num_eig)
+{
+  switch (num_eig) {
+  case 1: return &KLTSmall<Order, 1>::transform;
+  case 2: return &KLTSmall<Order, 2>::transform;
+  case 3: return &KLTSmall<Order, 3>::transform;
+  case 4: return &KLTSmall<Order, 4>::transform;
+  default: return NULL;
+  }
+}
+
+inline KLTSmallFn klt_small_kernel(int acm_order, int num_eig)
+{
+  switch (acm_order) {
+  case 8: return klt_small_kernel_order<8>(num_eig);
+  case 16: return klt_small_kernel_order<16>(num_eig);
+  case 32: return klt_small_kernel_order<32>(num_eig);
+  case 64: return klt_small_kernel_order<64>(num_eig);
+  default: return NULL;
+  }
+}
+
+#endif // __KLT_SMALL_HH__
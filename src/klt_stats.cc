@@ -0,0 +1,165 @@
+// Karhunen-Loève Transform Library
+// Per-stage timers, counters and latency histograms (KLT_SUPPORT_STATS)
+
+#include "klt_stats.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+static const char* const STAGE_NAMES[KLT_NUM_STAGES] = {
+  "window",
+  "acorr",
+  "chptrd",
+  "stebz",
+  "stein",
+  "upmtr",
+  "lanczos",
+  "track",
+  "refine",
+  "small",
+  "project",
+  "recon",
+  "total"
+};
+
+static const char* const COUNTER_NAMES[KLT_NUM_COUNTERS] = {
+  "frames",
+  "failures",
+  "nsplit",
+  "eig_missing",
+  "track_hits",
+  "lapack_fallbacks"
+};
+
+const char* klt_stage_name(KLTStage stage)
+{
+  return STAGE_NAMES[stage];
+}
+
+const char* klt_counter_name(KLTCounter counter)
+{
+  return COUNTER_NAMES[counter];
+}
+
+
+//---------------------------------------------------------------------------
+// Snapshot
+//---------------------------------------------------------------------------
+KLTStats::KLTStats()
+{
+  memset(counts, 0, sizeof(counts));
+  memset(stage_calls, 0, sizeof(stage_calls));
+  memset(stage_ns, 0, sizeof(stage_ns));
+  memset(stage_hist, 0, sizeof(stage_hist));
+}
+
+KLTStats& KLTStats::operator+=(const KLTStats& other)
+{
+  for (int cidx=0; cidx < KLT_NUM_COUNTERS; cidx++) {
+    counts[cidx] += other.counts[cidx];
+  }
+  for (int sidx=0; sidx < KLT_NUM_STAGES; sidx++) {
+    stage_calls[sidx] += other.stage_calls[sidx];
+    stage_ns[sidx] += other.stage_ns[sidx];
+    for (int bidx=0; bidx < KLT_HIST_BINS; bidx++) {
+      stage_hist[sidx][bidx] += other.stage_hist[sidx][bidx];
+    }
+  }
+  return *this;
+}
+
+uint64_t KLTStats::quantile_ns(KLTStage stage, double q) const
+{
+  const uint64_t num_calls = stage_calls[stage];
+  if (num_calls == 0) {
+    return 0;
+  }
+  // Rank of the quantile (1-based), then the bin holding it
+  uint64_t rank = static_cast<uint64_t>(q * num_calls + 0.5);
+  rank = std::min(std::max<uint64_t>(rank, 1), num_calls);
+  uint64_t seen = 0;
+  int bidx = 0;
+  for (; bidx < KLT_HIST_BINS - 1; bidx++) {
+    seen += stage_hist[stage][bidx];
+    if (seen >= rank) {
+      break;
+    }
+  }
+  return uint64_t(1) << bidx;
+}
+
+std::string KLTStats::json() const
+{
+  std::ostringstream oss;
+  oss << "{";
+  for (int cidx=0; cidx < KLT_NUM_COUNTERS; cidx++) {
+    oss << "\"" << COUNTER_NAMES[cidx] << "\": " << counts[cidx] << ", ";
+  }
+  oss << "\"stages\": {";
+  bool first = true;
+  for (int sidx=0; sidx < KLT_NUM_STAGES; sidx++) {
+    if (stage_calls[sidx] == 0) {
+      continue;
+    }
+    const KLTStage stage = static_cast<KLTStage>(sidx);
+    oss << (first ? "" : ", ") << "\"" << STAGE_NAMES[sidx] << "\": {" <<
+      "\"calls\": " << stage_calls[sidx] <<
+      ", \"total_ns\": " << stage_ns[sidx] <<
+      ", \"mean_ns\": " << stage_ns[sidx] / stage_calls[sidx] <<
+      ", \"p50_ns\": " << quantile_ns(stage, 0.5) <<
+      ", \"p99_ns\": " << quantile_ns(stage, 0.99) <<
+      ", \"hist_log2_ns\": [";
+    // Trailing empty bins are left out
+    int num_bins = KLT_HIST_BINS;
+    while (num_bins > 1 && stage_hist[sidx][num_bins - 1] == 0) {
+      num_bins--;
+    }
+    for (int bidx=0; bidx < num_bins; bidx++) {
+      oss << (bidx ? ", " : "") << stage_hist[sidx][bidx];
+    }
+    oss << "]}";
+    first = false;
+  }
+  oss << "}}";
+  return oss.str();
+}
+
+
+//---------------------------------------------------------------------------
+// Live counters
+//---------------------------------------------------------------------------
+KLTStatsCounters::KLTStatsCounters()
+{
+  reset();
+}
+
+KLTStats KLTStatsCounters::snapshot() const
+{
+  KLTStats stats;
+  for (int cidx=0; cidx < KLT_NUM_COUNTERS; cidx++) {
+    stats.counts[cidx] = counts[cidx].load(std::memory_order_relaxed);
+  }
+  for (int sidx=0; sidx < KLT_NUM_STAGES; sidx++) {
+    stats.stage_calls[sidx] = stage_calls[sidx].load(std::memory_order_relaxed);
+    stats.stage_ns[sidx] = stage_ns[sidx].load(std::memory_order_relaxed);
+    for (int bidx=0; bidx < KLT_HIST_BINS; bidx++) {
+      stats.stage_hist[sidx][bidx] = stage_hist[sidx][bidx].load(std::memory_order_relaxed);
+    }
+  }
+  return stats;
+}
+
+void KLTStatsCounters::reset()
+{
+  for (int cidx=0; cidx < KLT_NUM_COUNTERS; cidx++) {
+    counts[cidx].store(0, std::memory_order_relaxed);
+  }
+  for (int sidx=0; sidx < KLT_NUM_STAGES; sidx++) {
+    stage_calls[sidx].store(0, std::memory_order_relaxed);
+    stage_ns[sidx].store(0, std::memory_order_relaxed);
+    for (int bidx=0; bidx < KLT_HIST_BINS; bidx++) {
+      stage_hist[sidx][bidx].store(0, std::memory_order_relaxed);
+    }
+  }
+}
@@ -0,0 +1,160 @@
+// Karhunen-Loève Transform Library
+// Per-stage timers, counters and latency histograms (KLT_SUPPORT_STATS)
+
+#ifndef __KLT_STATS_HH__
+#define __KLT_STATS_HH__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+//---------------------------------------------------------------------------
+// Timed stages of KLT::transform()
+//   KLT_STAGE_REFINE: PREC_MIXED Rayleigh quotient eigenvalue refinement.
+//   KLT_STAGE_SMALL: whole specialized small-order kernel (klt_small.hh).
+//   KLT_STAGE_PROJECT: KLT coeffs and basis function weighting.
+//   KLT_STAGE_RECON: overlap-add reconstruction (klt_recon.hh).
+//   KLT_STAGE_TOTAL: whole transform() call.
+//---------------------------------------------------------------------------
+enum KLTStage {
+  KLT_STAGE_WINDOW,
+  KLT_STAGE_ACORR,
+  KLT_STAGE_CHPTRD,
+  KLT_STAGE_STEBZ,
+  KLT_STAGE_STEIN,
+  KLT_STAGE_UPMTR,
+  KLT_STAGE_LANCZOS,
+  KLT_STAGE_TRACK,
+  KLT_STAGE_REFINE,
+  KLT_STAGE_SMALL,
+  KLT_STAGE_PROJECT,
+  KLT_STAGE_RECON,
+  KLT_STAGE_TOTAL,
+  KLT_NUM_STAGES
+};
+
+//---------------------------------------------------------------------------
+// Event counters
+//   KLT_COUNT_FRAMES: transform() calls.
+//   KLT_COUNT_FAILURES: transform() calls that threw.
+//   KLT_COUNT_NSPLIT: sstebz split the tridiagonal matrix (nsplit != 1).
+//   KLT_COUNT_EIG_MISSING: sstebz found fewer than num_eig eigenvalues.
+//   KLT_COUNT_TRACK_HITS: frames solved by subspace tracking.
+//   KLT_COUNT_LAPACK_FALLBACKS: Lanczos solves that fell back to LAPACK.
+//---------------------------------------------------------------------------
+enum KLTCounter {
+  KLT_COUNT_FRAMES,
+  KLT_COUNT_FAILURES,
+  KLT_COUNT_NSPLIT,
+  KLT_COUNT_EIG_MISSING,
+  KLT_COUNT_TRACK_HITS,
+  KLT_COUNT_LAPACK_FALLBACKS,
+  KLT_NUM_COUNTERS
+};
+
+// Latency histogram bins: bin b counts durations in [2^(b-1), 2^b) ns
+// (bin 0: < 1 ns, last bin: everything longer)
+static const int KLT_HIST_BINS = 40;
+
+//---------------------------------------------------------------------------
+// Snapshot of the counters (plain values, can be summed across instances)
+//---------------------------------------------------------------------------
+struct KLTStats
+{
+  uint64_t counts[KLT_NUM_COUNTERS];
+  uint64_t stage_calls[KLT_NUM_STAGES];
+  uint64_t stage_ns[KLT_NUM_STAGES];
+  uint64_t stage_hist[KLT_NUM_STAGES][KLT_HIST_BINS];
+
+  KLTStats();
+  KLTStats& operator+=(const KLTStats& other);
+
+  //---------------------------------------------------------------------------
+  // Approximate latency quantile q (0..1) of stage, from the histogram (upper
+  // edge of the bin holding it, ns), 0 if the stage never ran.
+  //---------------------------------------------------------------------------
+  uint64_t quantile_ns(KLTStage stage, double q) const;
+
+  //---------------------------------------------------------------------------
+  // JSON object: counters, then per stage calls, total/mean/p50/p99 ns and
+  // the histogram (stages that never ran are left out).
+  //---------------------------------------------------------------------------
+  std::string json() const;
+};
+
+//---------------------------------------------------------------------------
+// Live counters owned by a KLT
+//   Written by the transforming thread only, with relaxed atomics so that
+//   snapshot() may be taken from any thread without locking.
+//---------------------------------------------------------------------------
+class KLTStatsCounters
+{
+public:
+  KLTStatsCounters();
+
+  void count(KLTCounter counter)
+  {
+    counts[counter].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void time(KLTStage stage, uint64_t ns)
+  {
+    int bin = 0;
+    if (ns > 0) {
+      bin = std::min(64 - __builtin_clzll(ns), KLT_HIST_BINS - 1);
+    }
+    stage_calls[stage].fetch_add(1, std::memory_order_relaxed);
+    stage_ns[stage].fetch_add(ns, std::memory_order_relaxed);
+    stage_hist[stage][bin].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  KLTStats snapshot() const;
+  void reset();
+
+private:
+  KLTStatsCounters(const KLTStatsCounters&);
+  KLTStatsCounters& operator=(const KLTStatsCounters&);
+
+  std::atomic<uint64_t> counts[KLT_NUM_COUNTERS];
+  std::atomic<uint64_t> stage_calls[KLT_NUM_STAGES];
+  std::atomic<uint64_t> stage_ns[KLT_NUM_STAGES];
+  std::atomic<uint64_t> stage_hist[KLT_NUM_STAGES][KLT_HIST_BINS];
+};
+
+//---------------------------------------------------------------------------
+// Times its scope into a stage
+//---------------------------------------------------------------------------
+class KLTStatsScope
+{
+public:
+  KLTStatsScope(KLTStatsCounters& ctr, KLTStage stage) :
+    ctr(ctr),
+    stage(stage),
+    start(std::chrono::steady_clock::now())
+  {
+  }
+
+  ~KLTStatsScope()
+  {
+    const std::chrono::steady_clock::duration dur = std::chrono::steady_clock::now() - start;
+    ctr.time(stage, std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count());
+  }
+
+private:
+  KLTStatsScope(const KLTStatsScope&);
+  KLTStatsScope& operator=(const KLTStatsScope&);
+
+  KLTStatsCounters& ctr;
+  const KLTStage stage;
+  const std::chrono::steady_clock::time_point start;
+};
+
+//---------------------------------------------------------------------------
+// Stage/counter names (as in json())
+//---------------------------------------------------------------------------
+const char* klt_stage_name(KLTStage stage);
+const char* klt_counter_name(KLTCounter counter);
+
+#endif // __KLT_STATS_HH__
@@ -0,0 +1,495 @@
+// Karhunen-Loève Transform Library
+// Multi-stream scheduling of many independent channels on a few workers
+
+#include "klt_streams.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <mkl_service.h> // MKL
+
+static const size_t ALIGN = 128;
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds(Clock::time_point t0, Clock::time_point t1)
+{
+  return std::chrono::duration<double>(t1 - t0).count();
+}
+
+// Elements of T per ALIGN-rounded slot of len elements
+template <typename T>
+static size_t slot_stride(size_t len)
+{
+  const size_t per_align = ALIGN / sizeof(T);
+  return ((len + per_align - 1) / per_align) * per_align;
+}
+
+// Heap object on an ALIGN boundary (the rings' cache-line aligned members
+// are beyond operator new's alignment before C++17)
+template <typename T, typename A>
+static T* new_aligned(A arg)
+{
+  void* buf;
+  if (posix_memalign(&buf, ALIGN, sizeof(T))) {
+    std::ostringstream oss;
+    oss << "Failed to allocate " << sizeof(T) << " bytes";
+    throw std::runtime_error(oss.str());
+  }
+  try {
+    return new (buf) T(arg);
+  } catch (...) {
+    free(buf);
+    throw;
+  }
+}
+
+template <typename T>
+static void delete_aligned(T* obj)
+{
+  if (obj != NULL) {
+    obj->~T();
+    free(obj);
+  }
+}
+
+// Spin briefly, then yield; idle workers then sleep, so a quiet stream set
+// does not hold the cores
+static void backoff(int& spins)
+{
+  ++spins;
+  if (spins > 1024) {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  } else if (spins > 64) {
+    std::this_thread::yield();
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Config
+//---------------------------------------------------------------------------
+KLTStreams::Config::Config() :
+  window(KLT::WIN_NONE),
+  window_param(0.0f),
+  acorr_engine(KLT::ACORR_AUTO),
+  eig_engine(KLT::EIG_AUTO),
+  covariance(KLT::COV_TOEPLITZ),
+  fwd_bwd(false),
+  precision(KLT::PREC_SINGLE),
+  refine(false),
+  order_rule(KLT::ORDER_FIXED),
+  energy_frac(1.0f),
+  outputs(KLT::OUT_ALL)
+{
+}
+
+bool KLTStreams::Config::operator==(const Config& rhs) const
+{
+  return window == rhs.window && window_param == rhs.window_param &&
+    acorr_engine == rhs.acorr_engine && eig_engine == rhs.eig_engine &&
+    covariance == rhs.covariance && fwd_bwd == rhs.fwd_bwd &&
+    precision == rhs.precision && refine == rhs.refine &&
+    order_rule == rhs.order_rule && energy_frac == rhs.energy_frac &&
+    outputs == rhs.outputs;
+}
+
+bool KLTStreams::Shape::operator==(const Shape& rhs) const
+{
+  return in_len == rhs.in_len &&
+#if KLT_SUPPORT_EVALN
+    eval_normalized == rhs.eval_normalized &&
+#endif
+    acm_order == rhs.acm_order && num_eig == rhs.num_eig;
+}
+
+KLTStreams::Stream::Stream(int queue_len) :
+  shape(0),
+  home(0),
+  in_buf(NULL),
+  free_ring(queue_len),
+  full_ring(queue_len),
+  pending(0),
+  next_seq(0)
+{
+  for (int slot=0; slot < queue_len; slot++) {
+    free_ring.push(slot);
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------------
+KLTStreams::KLTStreams(int num_workers, int queue_len) :
+  num_workers(std::max(num_workers, 1)),
+  queue_len(queue_len > 0 ? queue_len : 2 * QUANTUM),
+  pools(this->num_workers),
+  ready(this->num_workers, static_cast<KLTRing*>(NULL)),
+  stats(this->num_workers),
+  steals(this->num_workers, 0),
+  running(false),
+  abort(false)
+{
+}
+
+
+//---------------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------------
+KLTStreams::~KLTStreams()
+{
+  stop();
+  for (size_t widx=0; widx < pools.size(); widx++) {
+    for (size_t pidx=0; pidx < pools[widx].size(); pidx++) {
+      delete pools[widx][pidx].klt;
+    }
+    delete_aligned(ready[widx]);
+  }
+  for (size_t sidx=0; sidx < streams.size(); sidx++) {
+    free(streams[sidx]->in_buf);
+    delete_aligned(streams[sidx]);
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Register a stream
+//---------------------------------------------------------------------------
+int KLTStreams::add_stream(int in_len,
+#if KLT_SUPPORT_EVALN
+                           int eval_normalized,
+#endif
+                           int acm_order,
+                           int num_eig,
+                           const Config& config,
+                           const WriteFn& write)
+{
+  if (running.load()) {
+    throw std::runtime_error("Streams must be added before start()");
+  }
+  if (in_len < 1 || acm_order < 1 || acm_order > in_len || num_eig < 1 || num_eig > acm_order) {
+    std::ostringstream oss;
+    oss << "Invalid stream shape (in_len " << in_len << ", acm_order " << acm_order
+        << ", num_eig " << num_eig << ")";
+    throw std::runtime_error(oss.str());
+  }
+  const Shape shape = {in_len,
+#if KLT_SUPPORT_EVALN
+                       eval_normalized,
+#endif
+                       acm_order, num_eig};
+  const size_t shape_idx = std::find(shapes.begin(), shapes.end(), shape) - shapes.begin();
+  if (shape_idx == shapes.size()) {
+    shapes.push_back(shape);
+  }
+
+  Stream* st = new_aligned<Stream>(queue_len);
+  const size_t in_size = queue_len * slot_stride<std::complex<float> >(in_len);
+  if (posix_memalign(reinterpret_cast<void**>(&st->in_buf),
+                     ALIGN, in_size*sizeof(std::complex<float>))) {
+    delete_aligned(st);
+    std::ostringstream oss;
+    oss << "Failed to allocate stream in_buf (size " << in_size << ")";
+    throw std::runtime_error(oss.str());
+  }
+  const int sid = static_cast<int>(streams.size());
+  st->shape = static_cast<int>(shape_idx);
+  st->home = sid % num_workers;
+  st->config = config;
+  st->write = write;
+  streams.push_back(st);
+  return sid;
+}
+
+
+//---------------------------------------------------------------------------
+// Start the workers
+//---------------------------------------------------------------------------
+void KLTStreams::start()
+{
+  if (running.load()) {
+    throw std::runtime_error("Streams already started");
+  }
+  // One KLT per shape per worker (shapes added since the last start() only)
+  for (int widx=0; widx < num_workers; widx++) {
+    for (size_t pidx=pools[widx].size(); pidx < shapes.size(); pidx++) {
+      const Shape& shape = shapes[pidx];
+      Pooled pooled;
+      pooled.klt = new KLT(shape.in_len,
+#if KLT_SUPPORT_EVALN
+                           shape.eval_normalized,
+#endif
+                           shape.acm_order, shape.num_eig);
+      pooled.configured = false;
+      pools[widx].push_back(pooled);
+    }
+  }
+  // Settings are only applied on the workers, so check them all up front
+  for (size_t sidx=0; sidx < streams.size(); sidx++) {
+    try {
+      apply(pools[0][streams[sidx]->shape], streams[sidx]->config);
+    } catch (std::runtime_error& err) {
+      std::ostringstream oss;
+      oss << "Stream " << sidx << ": " << err.what();
+      throw std::runtime_error(oss.str());
+    }
+  }
+  // A stream is in at most one ready ring at a time, so pushes never fail
+  for (int widx=0; widx < num_workers; widx++) {
+    delete_aligned(ready[widx]);
+    ready[widx] = NULL;
+    ready[widx] = new_aligned<KLTRing>(std::max<size_t>(streams.size(), 1));
+    memset(&stats[widx], 0, sizeof(KLTStageStats));
+    steals[widx] = 0;
+  }
+  // Frames a failed run left queued
+  for (size_t sidx=0; sidx < streams.size(); sidx++) {
+    Stream& st = *streams[sidx];
+    int slot;
+    while (st.full_ring.pop(slot)) {
+      st.free_ring.push(slot);
+    }
+    st.pending.store(0);
+  }
+  abort.store(false);
+  abort_msg.clear();
+  running.store(true);
+  for (int widx=0; widx < num_workers; widx++) {
+    threads.push_back(std::thread(&KLTStreams::worker, this, widx));
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Queue a frame
+//---------------------------------------------------------------------------
+bool KLTStreams::push(int sid, const std::complex<float>* in)
+{
+  if (abort.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(abort_mtx);
+    throw std::runtime_error(abort_msg);
+  }
+  if (!running.load(std::memory_order_relaxed) || sid < 0 ||
+      sid >= static_cast<int>(streams.size())) {
+    std::ostringstream oss;
+    oss << "Cannot push to stream " << sid << (running.load() ? "" : " (not started)");
+    throw std::runtime_error(oss.str());
+  }
+  Stream& st = *streams[sid];
+  int slot;
+  if (!st.free_ring.pop(slot)) {
+    return false;
+  }
+  const int in_len = shapes[st.shape].in_len;
+  memcpy(&st.in_buf[slot * slot_stride<std::complex<float> >(in_len)], in,
+         in_len*sizeof(std::complex<float>));
+  st.full_ring.push(slot);
+  // Idle stream: hand it to its home worker
+  if (st.pending.fetch_add(1, std::memory_order_acq_rel) == 0) {
+    schedule(*ready[st.home], sid);
+  }
+  return true;
+}
+
+
+//---------------------------------------------------------------------------
+// Drain and stop
+//---------------------------------------------------------------------------
+void KLTStreams::finish()
+{
+  if (!running.load()) {
+    return;
+  }
+  int spins = 0;
+  for (size_t sidx=0; sidx < streams.size() && !abort.load(); ) {
+    if (streams[sidx]->pending.load(std::memory_order_acquire) == 0) {
+      sidx++;
+    } else {
+      backoff(spins);
+    }
+  }
+  stop();
+  for (int widx=0; widx < num_workers; widx++) {
+    if (stats[widx].frames > 0) {
+      stats[widx].depth /= stats[widx].frames;
+    }
+  }
+  if (abort.load()) {
+    throw std::runtime_error(abort_msg);
+  }
+}
+
+void KLTStreams::stop()
+{
+  running.store(false, std::memory_order_release);
+  for (size_t tidx=0; tidx < threads.size(); tidx++) {
+    threads[tidx].join();
+  }
+  threads.clear();
+}
+
+
+//---------------------------------------------------------------------------
+// KLTs held by the workers
+//---------------------------------------------------------------------------
+int KLTStreams::pooled() const
+{
+  size_t num = 0;
+  for (size_t widx=0; widx < pools.size(); widx++) {
+    num += pools[widx].size();
+  }
+  return static_cast<int>(num);
+}
+
+
+//---------------------------------------------------------------------------
+// Stop all workers (first message wins)
+//---------------------------------------------------------------------------
+void KLTStreams::fail(const std::string& msg)
+{
+  std::lock_guard<std::mutex> lock(abort_mtx);
+  if (!abort.load()) {
+    abort_msg = msg;
+    abort.store(true);
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Apply a stream's settings to a pooled KLT
+//   Every setting is applied, so nothing of the previous stream's is left.
+//   Single precision goes first, as mixed precision and snapshot covariance
+//   exclude each other.
+//---------------------------------------------------------------------------
+void KLTStreams::apply(Pooled& pooled, const Config& config)
+{
+  KLT& klt = *pooled.klt;
+  pooled.configured = false;
+  klt.set_precision(KLT::PREC_SINGLE, false);
+  klt.set_covariance(config.covariance, config.fwd_bwd, 0.0f);
+  klt.set_precision(config.precision, config.refine);
+  klt.set_acorr_engine(config.acorr_engine);
+  klt.set_eig_engine(config.eig_engine);
+  klt.set_window(config.window, config.window_param);
+  klt.set_outputs(config.outputs);
+  klt.set_model_order(config.order_rule, config.energy_frac);
+  pooled.config = config;
+  pooled.configured = true;
+}
+
+
+//---------------------------------------------------------------------------
+// Ready a stream on a ring
+//---------------------------------------------------------------------------
+void KLTStreams::schedule(KLTRing& ring, int sid)
+{
+  for (int spins=0; !ring.push(sid); backoff(spins)) {
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Next ready stream: own ring first, else steal
+//---------------------------------------------------------------------------
+bool KLTStreams::take(int widx, int& sid)
+{
+  if (ready[widx]->pop(sid)) {
+    return true;
+  }
+  for (int vidx=1; vidx < num_workers; vidx++) {
+    if (ready[(widx + vidx) % num_workers]->pop(sid)) {
+      steals[widx]++;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+//---------------------------------------------------------------------------
+// Worker: serve ready streams until finish()
+//   running only drops once every frame has been written, so an empty take()
+//   then means there is nothing left.
+//---------------------------------------------------------------------------
+void KLTStreams::worker(int widx)
+{
+  KLTStageStats& ws = stats[widx];
+  // One MKL thread per worker, the workers already fill the cores
+  const int mkl_threads = mkl_set_num_threads_local(1);
+  Clock::time_point t0 = Clock::now();
+  int spins = 0;
+  while (!abort.load(std::memory_order_relaxed)) {
+    int sid;
+    if (!take(widx, sid)) {
+      if (!running.load(std::memory_order_acquire)) {
+        break;
+      }
+      backoff(spins);
+      continue;
+    }
+    spins = 0;
+    Clock::time_point t1 = Clock::now();
+    ws.wait_s += seconds(t0, t1);
+    serve(widx, sid);
+    t0 = Clock::now();
+    ws.busy_s += seconds(t1, t0);
+  }
+  ws.wait_s += seconds(t0, Clock::now());
+  mkl_set_num_threads_local(mkl_threads);
+}
+
+
+//---------------------------------------------------------------------------
+// Transform and write up to QUANTUM of a stream's queued frames, in order
+//---------------------------------------------------------------------------
+void KLTStreams::serve(int widx, int sid)
+{
+  Stream& st = *streams[sid];
+  Pooled& pooled = pools[widx][st.shape];
+  KLTStageStats& ws = stats[widx];
+  if (!pooled.configured || !(pooled.config == st.config)) {
+    // Checked by start(), so only an allocation can fail here
+    try {
+      apply(pooled, st.config);
+    } catch (std::runtime_error& err) {
+      fail(err.what());
+      return;
+    }
+  }
+  KLT& klt = *pooled.klt;
+  const size_t in_stride = slot_stride<std::complex<float> >(shapes[st.shape].in_len);
+  const int todo = std::min(st.pending.load(std::memory_order_acquire), QUANTUM);
+  for (int fidx=0; fidx < todo; fidx++) {
+    // Queued before pending counted it
+    int slot;
+    for (int spins=0; !st.full_ring.pop(slot); backoff(spins)) {
+    }
+    ws.depth += ready[widx]->size();
+    std::string err;
+    try {
+      klt.transform(&st.in_buf[slot * in_stride]);
+    } catch (std::runtime_error& e) {
+      err = e.what();
+    }
+    try {
+      st.write(st.next_seq, klt.eval_buf, klt.kltc_buf, klt.kltb_buf,
+               err.empty() ? NULL : err.c_str());
+    } catch (std::runtime_error& e) {
+      fail(e.what());
+      return;
+    }
+    st.free_ring.push(slot);
+    st.next_seq++;
+    ws.frames++;
+  }
+  // Frames left (or queued meanwhile): keep the stream here
+  if (st.pending.fetch_sub(todo, std::memory_order_acq_rel) > todo) {
+    schedule(*ready[widx], sid);
+  }
+}
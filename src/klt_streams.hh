@@ -0,0 +1,240 @@
+// Karhunen-Loève Transform Library
+// Multi-stream scheduling of many independent channels on a few workers
+
+#ifndef __KLT_STREAMS_HH__
+#define __KLT_STREAMS_HH__
+
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "klt.hh"
+#include "klt_pipeline.hh"
+
+//---------------------------------------------------------------------------
+// Many streams (channels), each with its own shape, settings and frame
+// order, transformed by a fixed set of worker threads
+//   A stream with queued frames is ready; ready streams wait in the
+//   workers' ready rings (a stream is in at most one, so only one worker
+//   ever transforms it at a time and its frames stay in order).  A worker
+//   takes streams from its own ring first and steals from the others' when
+//   it runs dry; a stream it has transformed goes back on its own ring, so
+//   busy streams stay where their KLT is warm.
+//   Workers do not own a KLT per stream: each keeps one per shape (in_len,
+//   eval_normalized, acm_order, num_eig) and applies a stream's Config to it
+//   when the last stream it served had another.  Memory is then
+//   num_workers x shapes KLTs plus each stream's frame queue, however many
+//   streams share a shape.  The price is that no state is carried from a
+//   stream's frame to the next, so the stream, track, recon and covariance
+//   forget modes are not offered (see KLTPipeline for those).
+//---------------------------------------------------------------------------
+class KLTStreams
+{
+public:
+  //---------------------------------------------------------------------------
+  // Writer: outputs of a stream's frame seq, called in seq order by the
+  // worker that transformed it (never concurrently for one stream), laid
+  // out as KLT's eval_buf, kltc_buf and kltb_buf (those not selected in
+  // Config::outputs are undefined, kltb may be NULL).  err is the
+  // transform's error message (outputs are 0.0f) or NULL.  Buffers are only
+  // valid during the call.
+  //---------------------------------------------------------------------------
+  typedef KLTPipeline::WriteFn WriteFn;
+
+  //---------------------------------------------------------------------------
+  // Per-stream KLT settings (see KLT's set_* methods), defaults as KLT's
+  //   window: family window (not WIN_USER), window_param its parameter.
+  //   covariance, fwd_bwd: estimator (no forget factor).
+  //---------------------------------------------------------------------------
+  struct Config
+  {
+    Config();
+    bool operator==(const Config& rhs) const;
+
+    KLT::WindowType window;
+    float window_param;
+    KLT::AcorrEngine acorr_engine;
+    KLT::EigEngine eig_engine;
+    KLT::CovEstimator covariance;
+    bool fwd_bwd;
+    KLT::Precision precision;
+    bool refine;
+    KLT::OrderRule order_rule;
+    float energy_frac;
+    int outputs;
+  };
+
+  //---------------------------------------------------------------------------
+  // Constructor
+  //   num_workers: worker threads (each transforms with one MKL thread).
+  //   queue_len: frames queued per stream (preallocated aligned slots,
+  //              0: default).
+  //---------------------------------------------------------------------------
+  KLTStreams(int num_workers, int queue_len);
+
+  //---------------------------------------------------------------------------
+  // Destructor (finishes first if running)
+  //---------------------------------------------------------------------------
+  ~KLTStreams();
+
+  //---------------------------------------------------------------------------
+  // Register a stream before start(); returns its id (0, 1, ...)
+  //   in_len, eval_normalized, acm_order, num_eig: see KLT.
+  //   config: its settings, checked by start().
+  //   write: its writer.
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  int add_stream(int in_len,
+#if KLT_SUPPORT_EVALN
+                 int eval_normalized,
+#endif
+                 int acm_order,
+                 int num_eig,
+                 const Config& config,
+                 const WriteFn& write);
+
+  //---------------------------------------------------------------------------
+  // Build the workers' KLTs (one per shape each), check every stream's
+  // Config on them and start the workers
+  //   If an error occurrs, throws std::runtime_error.
+  //---------------------------------------------------------------------------
+  void start();
+
+  //---------------------------------------------------------------------------
+  // Queue a copy of stream sid's next frame in (size its in_len)
+  //   Non-blocking: false if the stream's queue is full (retry once its
+  //   writer has caught up).  Frames of one stream must be pushed from one
+  //   thread at a time; different streams may be pushed concurrently.
+  //   If a writer has thrown std::runtime_error, throws it.
+  //---------------------------------------------------------------------------
+  bool push(int sid, const std::complex<float>* in);
+
+  //---------------------------------------------------------------------------
+  // Wait until every queued frame has been written, then stop the workers.
+  // Streams keep their frame count, start() may be called again.
+  //   If a writer threw std::runtime_error, the workers stopped at once and
+  //   finish() rethrows it (the next start() drops the frames left queued).
+  //---------------------------------------------------------------------------
+  void finish();
+
+  //---------------------------------------------------------------------------
+  // Frames of stream sid written (up to date after finish())
+  //---------------------------------------------------------------------------
+  long frames(int sid) const { return streams[sid]->next_seq; }
+
+  //---------------------------------------------------------------------------
+  // Counters of the last start() .. finish()
+  //   worker_stats: busy_s transforming and writing, wait_s idle, depth the
+  //                 mean ready streams in the worker's own ring.
+  //   worker_steals: streams taken from other workers' rings.
+  //---------------------------------------------------------------------------
+  KLTStageStats worker_stats(int widx) const { return stats[widx]; }
+  long worker_steals(int widx) const { return steals[widx]; }
+  int workers() const { return num_workers; }
+  int num_streams() const { return static_cast<int>(streams.size()); }
+
+  //---------------------------------------------------------------------------
+  // KLTs held by the workers (num_workers x distinct stream shapes)
+  //---------------------------------------------------------------------------
+  int pooled() const;
+
+  //---------------------------------------------------------------------------
+  // Frames a worker transforms from one stream before rescheduling it
+  //---------------------------------------------------------------------------
+  static const int QUANTUM = 4;
+
+private:
+  KLTStreams(const KLTStreams&);
+  KLTStreams& operator=(const KLTStreams&);
+
+  //---------------------------------------------------------------------------
+  // Stream
+  //   shape: index into shapes (and each worker's pool).
+  //   home: worker whose ready ring push() schedules the stream on.
+  //   in_buf: frame queue (size queue_len x in_len).
+  //   free_ring: empty slots (workers -> push()).
+  //   full_ring: queued slots in frame order (push() -> workers).
+  //   pending: frames queued and not yet written; the push() taking it from
+  //            0 schedules the stream, the worker taking it to 0 retires it.
+  //   next_seq: next frame number (only touched by the worker holding the
+  //             stream, handed over through the ready rings).
+  //---------------------------------------------------------------------------
+  struct Stream
+  {
+    explicit Stream(int queue_len);
+
+    int shape;
+    int home;
+    Config config;
+    WriteFn write;
+    std::complex<float>* in_buf;
+    KLTRing free_ring;
+    KLTRing full_ring;
+    alignas(64) std::atomic<int> pending;
+    long next_seq;
+  };
+
+  //---------------------------------------------------------------------------
+  // Distinct stream shape
+  //---------------------------------------------------------------------------
+  struct Shape
+  {
+    int in_len;
+#if KLT_SUPPORT_EVALN
+    int eval_normalized;
+#endif
+    int acm_order;
+    int num_eig;
+
+    bool operator==(const Shape& rhs) const;
+  };
+
+  //---------------------------------------------------------------------------
+  // Worker's KLT of a shape, and the Config last applied to it
+  //---------------------------------------------------------------------------
+  struct Pooled
+  {
+    KLT* klt;
+    Config config;
+    bool configured;
+  };
+
+  void worker(int widx);
+  bool take(int widx, int& sid);
+  void serve(int widx, int sid);
+  void schedule(KLTRing& ring, int sid);
+  static void apply(Pooled& pooled, const Config& config);
+  void fail(const std::string& msg);
+  void stop();
+
+  //---------------------------------------------------------------------------
+  // Config
+  //---------------------------------------------------------------------------
+  const int num_workers;
+  const int queue_len;
+
+  //---------------------------------------------------------------------------
+  // Streams, shapes, and per worker: KLT pool (index shape), ready ring,
+  // counters
+  //---------------------------------------------------------------------------
+  std::vector<Stream*> streams;
+  std::vector<Shape> shapes;
+  std::vector<std::vector<Pooled> > pools;
+  std::vector<KLTRing*> ready;
+  std::vector<KLTStageStats> stats;
+  std::vector<long> steals;
+
+  //---------------------------------------------------------------------------
+  // Run state
+  //---------------------------------------------------------------------------
+  std::vector<std::thread> threads;
+  std::atomic<bool> running;
+  std::atomic<bool> abort;
+  std::mutex abort_mtx;
+  std::string abort_msg;
+};
+
+#endif // __KLT_STREAMS_HH__
@@ -0,0 +1,167 @@
+// Karhunen-Loève Transform Library
+// Window tables, shared across instances
+
+#include "klt_window.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+static const size_t ALIGN = 128;
+
+namespace {
+
+//---------------------------------------------------------------------------
+// Process-wide table cache (weak, so tables go with their last user)
+//---------------------------------------------------------------------------
+struct WindowKey {
+  int type;
+  int len;
+  float param;
+
+  bool operator<(const WindowKey& rhs) const
+  {
+    if (type != rhs.type) {
+      return type < rhs.type;
+    }
+    if (len != rhs.len) {
+      return len < rhs.len;
+    }
+    return param < rhs.param;
+  }
+};
+
+struct WindowCache {
+  std::mutex mtx;
+  std::map<WindowKey, std::weak_ptr<const float> > tables;
+};
+
+WindowCache& cache()
+{
+  static WindowCache the_cache;
+  return the_cache;
+}
+
+//---------------------------------------------------------------------------
+// Aligned table (size len), freed by the last shared_ptr
+//---------------------------------------------------------------------------
+float* new_table(int len)
+{
+  void* buf;
+  if (len < 1 || posix_memalign(&buf, ALIGN, len*sizeof(float))) {
+    std::ostringstream oss;
+    oss << "Failed to allocate window table (size " << len << ")";
+    throw std::runtime_error(oss.str());
+  }
+  return static_cast<float*>(buf);
+}
+
+void free_table(const float* buf)
+{
+  free(const_cast<float*>(buf));
+}
+
+//---------------------------------------------------------------------------
+// Zeroth-order modified Bessel function of the first kind (power series)
+//---------------------------------------------------------------------------
+double bessel_i0(double x)
+{
+  const double q = 0.25 * x * x;
+  double term = 1.0;
+  double sum = 1.0;
+  for (int kidx=1; kidx < 64 && term > 1.0e-12 * sum; kidx++) {
+    term *= q / (static_cast<double>(kidx) * kidx);
+    sum += term;
+  }
+  return sum;
+}
+
+//---------------------------------------------------------------------------
+// Fill a table (DFT-even: period len, so w[0] is the only edge sample)
+//---------------------------------------------------------------------------
+void fill_table(KLT::WindowType type, int len, float param, float* win)
+{
+  static const double TWO_PI = 2.0 * M_PI;
+  const double z1 = TWO_PI / len;
+  const double inv_i0_beta = 1.0 / bessel_i0(param);
+  for (int widx=0; widx < len; widx++) {
+    const double z = z1 * widx;
+    double w;
+    switch (type) {
+    case KLT::WIN_HANN:
+      w = 0.5 - 0.5 * cos(z);
+      break;
+    case KLT::WIN_BLACKMAN_HARRIS:
+      // 4-term, -92 dB sidelobes
+      w = 0.35875 -
+        0.48829 * cos(z) +
+        0.14128 * cos(2.0 * z) -
+        0.01168 * cos(3.0 * z);
+      break;
+    case KLT::WIN_FLATTOP:
+      // HFT90D
+      w = 1.0 -
+        1.942604 * cos(z) +
+        1.340318 * cos(2.0 * z) -
+        0.440811 * cos(3.0 * z) +
+        0.043097 * cos(4.0 * z);
+      break;
+    default:
+      {
+        // Kaiser, centered on len/2
+        const double r = (2.0 * widx - len) / len;
+        w = bessel_i0(param * sqrt(std::max(1.0 - r * r, 0.0))) * inv_i0_beta;
+      }
+      break;
+    }
+    win[widx] = static_cast<float>(w);
+  }
+}
+
+} // namespace
+
+
+//---------------------------------------------------------------------------
+// Shared window table
+//---------------------------------------------------------------------------
+std::shared_ptr<const float> klt_window_table(KLT::WindowType type, int len, float param)
+{
+  if (type != KLT::WIN_HANN && type != KLT::WIN_BLACKMAN_HARRIS &&
+      type != KLT::WIN_FLATTOP && type != KLT::WIN_KAISER) {
+    std::ostringstream oss;
+    oss << "No window table for window type " << type;
+    throw std::runtime_error(oss.str());
+  }
+  if (type == KLT::WIN_KAISER && !(param >= 0.0f)) {
+    std::ostringstream oss;
+    oss << "Invalid Kaiser window beta " << param;
+    throw std::runtime_error(oss.str());
+  }
+  const WindowKey key = {type, len, type == KLT::WIN_KAISER ? param : 0.0f};
+  WindowCache& c = cache();
+  std::lock_guard<std::mutex> lock(c.mtx);
+  std::shared_ptr<const float> table = c.tables[key].lock();
+  if (!table) {
+    float* win = new_table(len);
+    fill_table(type, len, key.param, win);
+    table.reset(win, free_table);
+    c.tables[key] = table;
+  }
+  return table;
+}
+
+
+//---------------------------------------------------------------------------
+// Private copy of user taps
+//---------------------------------------------------------------------------
+std::shared_ptr<const float> klt_window_copy(const float* taps, int len)
+{
+  float* win = new_table(len);
+  memcpy(win, taps, len*sizeof(float));
+  return std::shared_ptr<const float>(win, free_table);
+}
@@ -0,0 +1,27 @@
+// Karhunen-Loève Transform Library
+// Window tables, shared across instances
+
+#ifndef __KLT_WINDOW_HH__
+#define __KLT_WINDOW_HH__
+
+#include <memory>
+#include "klt.hh"
+
+//---------------------------------------------------------------------------
+// Window table of a family (KLT::WindowType other than WIN_NONE/WIN_USER)
+//   len: table length (the frame length).
+//   param: WIN_KAISER beta, ignored by the other families.
+//   Tables are computed on first use and cached process-wide by (type, len,
+//   param): every instance asking for the same window shares one table, which
+//   is freed with its last user.
+//   If an error occurrs, throws std::runtime_error.
+//---------------------------------------------------------------------------
+std::shared_ptr<const float> klt_window_table(KLT::WindowType type, int len, float param);
+
+//---------------------------------------------------------------------------
+// Aligned private copy of user-supplied taps (size len), not cached
+//   If an error occurrs, throws std::runtime_error.
+//---------------------------------------------------------------------------
+std::shared_ptr<const float> klt_window_copy(const float* taps, int len);
+
+#endif // __KLT_WINDOW_HH__
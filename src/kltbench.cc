@@ -0,0 +1,419 @@
+// Karhunen-Loève Transform
+// Benchmark sweep over frame shapes and engines (JSON lines output)
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "klt.hh"
+#include "klt_batch.hh"
+#include "klt_siggen.hh"
+#include "klt_simd.hh"
+
+typedef std::chrono::steady_clock Clock;
+
+// Distinct frames cycled through per case (consecutive, overlapped)
+static const int BENCH_FRAMES = 64;
+// Frames per KLTBatch::transform() call
+static const int BENCH_BATCH = 16;
+
+static void usage()
+{
+  std::cerr <<
+    "Usage: kltbench [options]\n"
+    "  Times KLT::transform() on a synthetic signal for every engine over a sweep\n"
+    "  of in_len, acm_order, num_eig and overlap, one JSON object per line.\n"
+    "Options:\n"
+    "  --quick=N         smaller sweep (default 0)\n"
+    "  --min_time=S      seconds timed per case (default 0.25)\n"
+    "  --signal=NAME     tone, chirp, noise, interferer or mix (default mix)\n"
+    "  --seed=N          signal seed (default 1)\n"
+    "  --outputs=N       KLT::OutputMask bits to compute (default 7: all)\n"
+    "  --engines=A,B     engines to run (default all: auto, direct_lapack,\n"
+    "                    fft_lapack, direct_lanczos, fft_lanczos, stream, track,\n"
+    "                    batch)\n"
+    "  --out=FILE        results file (default stdout)\n"
+    "  --compare=FILE    earlier results; report cases whose frames_per_s fell\n"
+    "                    by more than the tolerance and exit 1 if any did\n"
+    "  --tolerance=PCT   allowed frames_per_s drop (default 10)\n";
+}
+
+static const char* isa_name(KLTSimdIsa isa)
+{
+  switch (isa) {
+  case KLT_SIMD_AVX512: return "avx512";
+  case KLT_SIMD_AVX2: return "avx2";
+  default: return "scalar";
+  }
+}
+
+static std::vector<std::string> split(const std::string& str, char sep)
+{
+  std::vector<std::string> parts;
+  std::istringstream iss(str);
+  std::string part;
+  while (std::getline(iss, part, sep)) {
+    if (!part.empty()) {
+      parts.push_back(part);
+    }
+  }
+  return parts;
+}
+
+//---------------------------------------------------------------------------
+// One benchmark case
+//---------------------------------------------------------------------------
+struct BenchCase
+{
+  std::string engine;
+  int in_len;
+  int acm_order;
+  int num_eig;
+  double overlap;
+  int outputs;
+
+  std::string id() const
+  {
+    std::ostringstream oss;
+    oss << engine << "/in" << in_len << "/acm" << acm_order << "/eig" << num_eig <<
+      "/olap" << overlap;
+    if (outputs != KLT::OUT_ALL) {
+      oss << "/out" << outputs;
+    }
+    return oss.str();
+  }
+};
+
+//---------------------------------------------------------------------------
+// Timed frames, transform() calls that threw, and stage breakdown
+//---------------------------------------------------------------------------
+struct BenchResult
+{
+  long frames;
+  long failures;
+  double seconds;
+#if KLT_SUPPORT_STATS
+  KLTStats stats;
+#endif
+};
+
+//---------------------------------------------------------------------------
+// Time one engine on frames (BENCH_FRAMES frames, in_clen apart)
+//   Returns false if the engine does not apply to the case.
+//---------------------------------------------------------------------------
+static bool run_case(const BenchCase& bc, const std::complex<float>* sig, int in_clen,
+                     double min_time, BenchResult& res)
+{
+  const bool stream = bc.engine == "stream";
+  if (stream && in_clen >= bc.in_len) {
+    return false;
+  }
+  res.frames = 0;
+  res.failures = 0;
+  res.seconds = 0.0;
+
+  if (bc.engine == "batch") {
+    // Independent frames, gathered contiguously
+    std::vector<std::complex<float> > in(static_cast<size_t>(BENCH_FRAMES) * bc.in_len);
+    for (int fidx=0; fidx < BENCH_FRAMES; fidx++) {
+      std::copy(&sig[static_cast<size_t>(fidx) * in_clen],
+                &sig[static_cast<size_t>(fidx) * in_clen + bc.in_len],
+                &in[static_cast<size_t>(fidx) * bc.in_len]);
+    }
+    std::vector<float> eval(static_cast<size_t>(BENCH_BATCH) * bc.num_eig);
+    std::vector<std::complex<float> > kltc(static_cast<size_t>(BENCH_BATCH) * bc.num_eig);
+    std::vector<std::complex<float> > kltb(static_cast<size_t>(BENCH_BATCH) * bc.acm_order *
+                                           bc.num_eig);
+    KLTBatch klt(bc.in_len,
+#if KLT_SUPPORT_EVALN
+                 0,
+#endif
+                 bc.acm_order, bc.num_eig, 0);
+    klt.set_outputs(bc.outputs);
+    // Warm up (first touch, plans)
+    klt.transform(&in[0], BENCH_BATCH, &eval[0], &kltc[0], &kltb[0]);
+#if KLT_SUPPORT_STATS
+    klt.reset_stats();
+#endif
+    const Clock::time_point t0 = Clock::now();
+    do {
+      const int fidx = res.frames % BENCH_FRAMES;
+      try {
+        klt.transform(&in[static_cast<size_t>(fidx) * bc.in_len], BENCH_BATCH,
+                      &eval[0], &kltc[0], &kltb[0]);
+      } catch (std::runtime_error&) {
+        res.failures++;
+      }
+      res.frames += BENCH_BATCH;
+      res.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    } while (res.seconds < min_time);
+#if KLT_SUPPORT_STATS
+    res.stats = klt.stats();
+#endif
+    return true;
+  }
+
+  KLT klt(bc.in_len,
+#if KLT_SUPPORT_EVALN
+          0,
+#endif
+          bc.acm_order, bc.num_eig);
+  klt.set_outputs(bc.outputs);
+  if (bc.engine == "direct_lapack" || bc.engine == "direct_lanczos") {
+    klt.set_acorr_engine(KLT::ACORR_DIRECT);
+  } else if (bc.engine == "fft_lapack" || bc.engine == "fft_lanczos") {
+    klt.set_acorr_engine(KLT::ACORR_FFT);
+  }
+  if (bc.engine == "direct_lapack" || bc.engine == "fft_lapack") {
+    klt.set_eig_engine(KLT::EIG_LAPACK);
+  } else if (bc.engine == "direct_lanczos" || bc.engine == "fft_lanczos") {
+    klt.set_eig_engine(KLT::EIG_LANCZOS);
+  } else if (bc.engine == "track") {
+    klt.set_track(1, 1.0e-4f, 4);
+  }
+  // Warm up (first touch, plans, packed matrix)
+  try {
+    klt.transform(sig);
+  } catch (std::runtime_error&) {
+  }
+#if KLT_SUPPORT_STATS
+  klt.reset_stats();
+#endif
+  const Clock::time_point t0 = Clock::now();
+  do {
+    const int fidx = res.frames % BENCH_FRAMES;
+    // Restart frame-to-frame state at the wrap (a discontinuity)
+    if (stream && fidx == 0) {
+      klt.set_stream(in_clen, 64);
+    }
+    try {
+      klt.transform(&sig[static_cast<size_t>(fidx) * in_clen]);
+    } catch (std::runtime_error&) {
+      res.failures++;
+    }
+    res.frames++;
+    res.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+  } while (res.seconds < min_time);
+#if KLT_SUPPORT_STATS
+  res.stats = klt.stats();
+#endif
+  return true;
+}
+
+//---------------------------------------------------------------------------
+// Result as one JSON line
+//---------------------------------------------------------------------------
+static std::string result_json(const BenchCase& bc, int in_clen, const BenchResult& res)
+{
+  const double frames_per_s = res.frames / res.seconds;
+  const double ns_per_sample = 1.0e9 * res.seconds / (static_cast<double>(res.frames) * in_clen);
+  std::ostringstream oss;
+  oss << "{\"case\": \"" << bc.id() << "\", \"engine\": \"" << bc.engine << "\"" <<
+    ", \"in_len\": " << bc.in_len << ", \"acm_order\": " << bc.acm_order <<
+    ", \"num_eig\": " << bc.num_eig << ", \"overlap\": " << bc.overlap <<
+    ", \"outputs\": " << bc.outputs <<
+    ", \"frames\": " << res.frames << ", \"failures\": " << res.failures <<
+    ", \"seconds\": " << res.seconds << ", \"frames_per_s\": " << frames_per_s <<
+    ", \"ns_per_sample\": " << ns_per_sample;
+#if KLT_SUPPORT_STATS
+  // Mean time per frame of each stage that ran
+  oss << ", \"stage_ns_per_frame\": {";
+  bool first = true;
+  for (int sidx=0; sidx < KLT_NUM_STAGES; sidx++) {
+    if (res.stats.stage_calls[sidx] == 0) {
+      continue;
+    }
+    oss << (first ? "" : ", ") << "\"" << klt_stage_name(static_cast<KLTStage>(sidx)) <<
+      "\": " << static_cast<double>(res.stats.stage_ns[sidx]) / res.frames;
+    first = false;
+  }
+  oss << "}";
+#endif
+  oss << "}";
+  return oss.str();
+}
+
+//---------------------------------------------------------------------------
+// String and number fields of one of our JSON lines
+//---------------------------------------------------------------------------
+static std::string json_field(const std::string& line, const std::string& name)
+{
+  const std::string key = "\"" + name + "\": ";
+  const size_t pos = line.find(key);
+  if (pos == std::string::npos) {
+    return "";
+  }
+  size_t beg = pos + key.size();
+  size_t end;
+  if (line[beg] == '"') {
+    end = line.find('"', ++beg);
+  } else {
+    end = line.find_first_of(",}", beg);
+  }
+  return line.substr(beg, end == std::string::npos ? std::string::npos : end - beg);
+}
+
+//==============================================================================
+// MAIN
+//==============================================================================
+int main(int argc, char** argv)
+{
+  // Switches
+  int quick = 0;
+  double min_time = 0.25;
+  std::string signal = "mix";
+  unsigned seed = 1;
+  std::vector<std::string> engines = split("auto,direct_lapack,fft_lapack,direct_lanczos,"
+                                           "fft_lanczos,stream,track,batch", ',');
+  std::string out_fname;
+  std::string compare_fname;
+  double tolerance = 10.0;
+  int outputs = KLT::OUT_ALL;
+  for (int aidx=1; aidx < argc; aidx++) {
+    const std::string arg = argv[aidx];
+    const size_t eq = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+      usage();
+      return 2;
+    }
+    const std::string name = arg.substr(2, eq - 2);
+    const std::string val = arg.substr(eq + 1);
+    if (name == "quick") {
+      quick = atoi(val.c_str());
+    } else if (name == "min_time") {
+      min_time = std::max(atof(val.c_str()), 0.0);
+    } else if (name == "signal") {
+      signal = val;
+    } else if (name == "seed") {
+      seed = strtoul(val.c_str(), NULL, 0);
+    } else if (name == "outputs") {
+      outputs = atoi(val.c_str());
+    } else if (name == "engines") {
+      engines = split(val, ',');
+    } else if (name == "out") {
+      out_fname = val;
+    } else if (name == "compare") {
+      compare_fname = val;
+    } else if (name == "tolerance") {
+      tolerance = std::max(atof(val.c_str()), 0.0);
+    } else {
+      std::cerr << "kltbench: unknown option " << arg << std::endl;
+      usage();
+      return 2;
+    }
+  }
+
+  // Sweep
+  std::vector<int> in_lens;
+  std::vector<int> acm_orders;
+  std::vector<int> num_eigs;
+  std::vector<double> overlaps;
+  if (quick) {
+    in_lens = {256, 1024};
+    acm_orders = {16, 64};
+    num_eigs = {1, 4};
+    overlaps = {0.0, 0.5};
+  } else {
+    in_lens = {256, 1024, 4096};
+    acm_orders = {16, 32, 64, 256};
+    num_eigs = {1, 4};
+    overlaps = {0.0, 0.5, 0.75};
+  }
+
+  try {
+    // Signal (long enough for BENCH_FRAMES non-overlapped frames of the
+    // longest in_len)
+    KLTSigGen gen(seed);
+    if (!gen.add_preset(signal)) {
+      throw std::runtime_error("Unknown signal " + signal);
+    }
+    const int max_in_len = *std::max_element(in_lens.begin(), in_lens.end());
+    std::vector<std::complex<float> > sig(static_cast<size_t>(BENCH_FRAMES + 1) * max_in_len);
+    gen.generate(&sig[0], sig.size());
+
+    // Earlier results
+    std::map<std::string, double> baseline;
+    if (!compare_fname.empty()) {
+      std::ifstream cmp_file(compare_fname.c_str());
+      if (!cmp_file) {
+        throw std::runtime_error("Failed to open " + compare_fname);
+      }
+      std::string line;
+      while (std::getline(cmp_file, line)) {
+        const std::string id = json_field(line, "case");
+        if (!id.empty()) {
+          baseline[id] = atof(json_field(line, "frames_per_s").c_str());
+        }
+      }
+    }
+
+    std::ofstream out_file;
+    if (!out_fname.empty()) {
+      out_file.open(out_fname.c_str());
+      if (!out_file) {
+        throw std::runtime_error("Failed to create " + out_fname);
+      }
+    }
+    std::ostream& out = out_fname.empty() ? std::cout : out_file;
+    out << "{\"bench\": \"klt\", \"isa\": \"" << isa_name(klt_simd_isa()) <<
+      "\", \"signal\": \"" << signal << "\", \"seed\": " << seed <<
+      ", \"min_time\": " << min_time << ", \"stats\": " << KLT_SUPPORT_STATS << "}" << std::endl;
+
+    int num_regressed = 0;
+    for (size_t iidx=0; iidx < in_lens.size(); iidx++) {
+      for (size_t aidx=0; aidx < acm_orders.size(); aidx++) {
+        if (acm_orders[aidx] > in_lens[iidx]) {
+          continue;
+        }
+        for (size_t nidx=0; nidx < num_eigs.size(); nidx++) {
+          for (size_t oidx=0; oidx < overlaps.size(); oidx++) {
+            for (size_t eidx=0; eidx < engines.size(); eidx++) {
+              BenchCase bc;
+              bc.engine = engines[eidx];
+              bc.in_len = in_lens[iidx];
+              bc.acm_order = acm_orders[aidx];
+              bc.num_eig = std::min(num_eigs[nidx], bc.acm_order);
+              bc.overlap = overlaps[oidx];
+              bc.outputs = outputs;
+              const int in_clen = std::max(static_cast<int>(bc.in_len * (1.0 - bc.overlap)), 1);
+              BenchResult res;
+              if (!run_case(bc, &sig[0], in_clen, min_time, res)) {
+                continue;
+              }
+              out << result_json(bc, in_clen, res) << std::endl;
+
+              // Regression against the earlier results
+              std::map<std::string, double>::const_iterator old = baseline.find(bc.id());
+              const double frames_per_s = res.frames / res.seconds;
+              if (old != baseline.end() &&
+                  frames_per_s < old->second * (1.0 - 0.01 * tolerance)) {
+                std::cerr << "kltbench: regression: " << bc.id() << ": " << frames_per_s <<
+                  " frames/s (was " << old->second << ")" << std::endl;
+                num_regressed++;
+              }
+            }
+          }
+        }
+      }
+    }
+    if (num_regressed > 0) {
+      std::cerr << "kltbench: " << num_regressed << " case(s) regressed by more than " <<
+        tolerance << "%" << std::endl;
+      return 1;
+    }
+  }
+  catch (std::runtime_error& err) {
+    std::cerr << "kltbench: error: " << err.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,818 @@
+// Karhunen-Loève Transform
+// Standalone driver (memory mapped raw/BLUE files)
+
+#include <algorithm>
+#include <atomic>
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "klt.hh"
+#include "klt_arena.hh"
+#include "klt_array.hh"
+#include "klt_batch.hh"
+#include "klt_compact.hh"
+#include "klt_io.hh"
+#include "klt_pipeline.hh"
+#include "klt_recon.hh"
+#include "klt_simd.hh"
+#include "klt_streams.hh"
+
+static void usage()
+{
+  std::cerr <<
+    "Usage: kltrun [options] in kltb kltc eval in_len in_olap_factor acm_order num_eig\n"
+    "              out_olap_factor\n"
+    "  in: complex input, BLUE (format CF, CI or CB) or raw (see --format).\n"
+    "  kltb, kltc, eval: outputs (\"\" for none), BLUE if in is BLUE, else raw.\n"
+    "  Arguments and outputs are those of the X-Midas KLT primitive.\n"
+    "Options:\n"
+    "  --format=F   raw in samples: CF float, CI int16 or CB int8 (default CF)\n"
+    "  --scale=F    CI/CB input scale (default 1)\n"
+    "  --win=N      window: 0 none, 1 Hann, 2 Blackman-Harris, 3 flat-top,\n"
+    "               4 Kaiser (default 0; turns --stream off)\n"
+    "  --beta=F     Kaiser window beta (default 8.6)\n"
+    "  --win_taps=FILE  user window, in_len float32 taps (as --win)\n"
+#if KLT_SUPPORT_EVALN
+    "  --evaln=N    normalize eigenvalues (default 1)\n"
+#endif
+    "  --stream=N   streaming auto-correlation for overlapped frames (default 0)\n"
+    "  --resync=N   streaming resync interval in frames (default 64)\n"
+    "  --track=N    subspace tracking across frames (default 0)\n"
+    "  --recon=N    kltb is the overlap-add reconstruction (type 1000, out_len\n"
+    "               samples per frame; the frames are zero padded past the end of\n"
+    "               in so it covers all of it) instead of the basis functions\n"
+    "               (default 0)\n"
+    "  --klts=FILE  sliding KLT coeffs over each whole frame (num_eig records of\n"
+    "               in_len - acm_order + 1 per frame; not with --batch/--pipeline)\n"
+    "  --cov=N      covariance: 0 Toeplitz lags, 1 snapshot, 2 snapshot with\n"
+    "               forward-backward averaging (default 0)\n"
+    "  --forget=F   snapshot covariance weight of the previous frames, [0..1)\n"
+    "               (default 0; single KLT or --pipeline=1)\n"
+    "  --mixed=N    lag precision: 0 single, 1 mixed (double lags, float solve),\n"
+    "               2 mixed with Rayleigh quotient eigenvalue refinement (default 0;\n"
+    "               Toeplitz covariance only)\n"
+    "  --order=N    model order: 0 fixed num_eig, 1 MDL, 2 AIC, 3 energy (default 0)\n"
+    "  --energy=F   energy fraction for --order=3 (default 0.9)\n"
+    "  --compact=FILE  compact stream of eigenvalues, coeffs and delta-coded\n"
+    "               canonical-phase eigenvectors (see klt_compact.hh; single KLT\n"
+    "               mode, not with --recon)\n"
+    "  --quant=N    --compact eigenvector quantization step 2^-N (default 0:\n"
+    "               lossless)\n"
+    "  --key=N      --compact key frame interval (default 64)\n"
+    "  --order_out=FILE  per-frame model order (int32, type 1000 SL; not with\n"
+    "               --pipeline)\n"
+    "  --channels=N in holds N interleaved channels: joint space-time KLT with\n"
+    "               acm_order lags per channel (in_len, in_olap_factor per channel;\n"
+    "               num_eig records of N x acm_order per frame, eigenvalues not\n"
+    "               normalized; default 1)\n"
+    "  --streams=N  in holds N interleaved channels, each its own KLT stream\n"
+    "               (in_len, in_olap_factor per channel; N records of each output\n"
+    "               per frame, channel-major; no frame-to-frame state; default 1)\n"
+    "  --batch=N    independent frames per batch-parallel transform (default 1)\n"
+    "  --threads=N  batch or stream worker threads (default 0: OpenMP default,\n"
+    "               hardware threads for --streams)\n"
+    "  --pipeline=N reader/N compute/writer threads (default 0: off)\n"
+    "  --hugepages=N  carve KLT buffers from 2 MB hugepages (default 0)\n"
+    "  --stats=N    print pipeline stage or stream worker counters to stderr\n"
+    "               (default 0)\n"
+#if KLT_SUPPORT_STATS
+    "  --stats_json=FILE  write KLT stage timers and counters as JSON at exit\n"
+#endif
+    ;
+}
+
+//---------------------------------------------------------------------------
+// Frame of in_len samples from pos as complex float (integer input times
+// scale), zero padded past the end of in
+//---------------------------------------------------------------------------
+static void read_frame(const KLTInFile& in_file, size_t pos, int in_len, float scale,
+                       std::complex<float>* buf)
+{
+  const int ngot = std::min<size_t>(in_len, in_file.samples() - pos);
+  if (in_file.hdr.format == "CI") {
+    klt_cvt_ci16(&in_file.ci_data()[2*pos], NULL, scale, buf, ngot);
+  } else if (in_file.hdr.format == "CB") {
+    klt_cvt_ci8(&in_file.cb_data()[2*pos], NULL, scale, buf, ngot);
+  } else {
+    memcpy(buf, &in_file.cf_data()[pos], ngot*sizeof(std::complex<float>));
+  }
+  memset(&buf[ngot], 0, (in_len - ngot)*sizeof(std::complex<float>));
+}
+
+static void print_stats(const char* name, const KLTStageStats& st)
+{
+  std::cerr << "kltrun: " << name << ": frames " << st.frames << " busy " << st.busy_s <<
+    " s wait " << st.wait_s << " s depth " << st.depth << std::endl;
+}
+
+//==============================================================================
+// MAIN
+//==============================================================================
+int main(int argc, char** argv)
+{
+  // Switches
+  std::string format;
+  float scale = 1.0f;
+  int window = 0;
+  float beta = 8.6f;
+  std::string taps_fname;
+#if KLT_SUPPORT_EVALN
+  int eval_normalized = 1;
+#endif
+  int stream = 0;
+  int resync = 64;
+  int track = 0;
+  int recon = 0;
+  std::string klts_fname;
+  int cov = 0;
+  float forget = 0.0f;
+  int mixed = 0;
+  int order = 0;
+  float energy = 0.9f;
+  std::string order_fname;
+  std::string compact_fname;
+  int quant = 0;
+  int key = 64;
+  int channels = 1;
+  int streams = 1;
+  int batch = 1;
+  int threads = 0;
+  int pipeline = 0;
+  int stats = 0;
+  int hugepages = 0;
+#if KLT_SUPPORT_STATS
+  std::string stats_json;
+#endif
+  std::vector<std::string> args;
+  for (int aidx=1; aidx < argc; aidx++) {
+    const std::string arg = argv[aidx];
+    const size_t eq = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+      args.push_back(arg);
+      continue;
+    }
+    const std::string name = arg.substr(2, eq - 2);
+    const int val = atoi(arg.c_str() + eq + 1);
+    if (name == "format") {
+      format = arg.substr(eq + 1);
+    } else if (name == "scale") {
+      scale = atof(arg.c_str() + eq + 1);
+    } else if (name == "stream") {
+      stream = val;
+    } else if (name == "resync") {
+      resync = std::max(val, 1);
+    } else if (name == "track") {
+      track = val;
+    } else if (name == "recon") {
+      recon = val;
+    } else if (name == "cov") {
+      cov = val;
+    } else if (name == "forget") {
+      forget = atof(arg.c_str() + eq + 1);
+    } else if (name == "mixed") {
+      mixed = val;
+    } else if (name == "order") {
+      order = val;
+    } else if (name == "energy") {
+      energy = atof(arg.c_str() + eq + 1);
+    } else if (name == "order_out") {
+      order_fname = arg.substr(eq + 1);
+    } else if (name == "compact") {
+      compact_fname = arg.substr(eq + 1);
+    } else if (name == "quant") {
+      quant = val;
+    } else if (name == "key") {
+      key = val;
+    } else if (name == "klts") {
+      klts_fname = arg.substr(eq + 1);
+    } else if (name == "channels") {
+      channels = std::max(val, 1);
+    } else if (name == "streams") {
+      streams = std::max(val, 1);
+    } else if (name == "batch") {
+      batch = std::max(val, 1);
+    } else if (name == "threads") {
+      threads = std::max(val, 0);
+    } else if (name == "pipeline") {
+      pipeline = std::max(val, 0);
+    } else if (name == "hugepages") {
+      hugepages = val;
+    } else if (name == "stats") {
+      stats = val;
+#if KLT_SUPPORT_STATS
+    } else if (name == "stats_json") {
+      stats_json = arg.substr(eq + 1);
+#endif
+    } else if (name == "win") {
+      window = val;
+    } else if (name == "beta") {
+      beta = atof(arg.c_str() + eq + 1);
+    } else if (name == "win_taps") {
+      taps_fname = arg.substr(eq + 1);
+#if KLT_SUPPORT_EVALN
+    } else if (name == "evaln") {
+      eval_normalized = val;
+#endif
+    } else {
+      std::cerr << "kltrun: unknown option " << arg << std::endl;
+      usage();
+      return 2;
+    }
+  }
+  if (args.size() != 9) {
+    usage();
+    return 2;
+  }
+  if (!klts_fname.empty() && (pipeline > 0 || batch > 1)) {
+    std::cerr << "kltrun: --klts needs the single KLT mode" << std::endl;
+    return 2;
+  }
+  if (!compact_fname.empty() && (pipeline > 0 || batch > 1 || channels > 1 || streams > 1 ||
+                                 recon)) {
+    std::cerr << "kltrun: --compact needs the single KLT mode, without --recon" << std::endl;
+    return 2;
+  }
+  if (!order_fname.empty() && pipeline > 0) {
+    std::cerr << "kltrun: --order_out does not apply to --pipeline" << std::endl;
+    return 2;
+  }
+  if (channels > 1 && (pipeline > 0 || batch > 1 || recon || order || cov || forget != 0.0f ||
+                        mixed ||
+                        window || !taps_fname.empty() ||
+                        !klts_fname.empty() || !order_fname.empty())) {
+    std::cerr << "kltrun: --channels only supports eval, kltc and kltb outputs, and its own\n"
+      "        (snapshot) covariance" << std::endl;
+    return 2;
+  }
+  if (streams > 1 && (channels > 1 || pipeline > 0 || batch > 1 || recon || track ||
+                      forget != 0.0f || !taps_fname.empty() ||
+                      !klts_fname.empty() || !order_fname.empty())) {
+    std::cerr << "kltrun: --streams only supports eval, kltc and kltb outputs, and no\n"
+      "        frame-to-frame state or user window" << std::endl;
+    return 2;
+  }
+  if (cov < 0 || cov > 2) {
+    std::cerr << "kltrun: invalid --cov=" << cov << std::endl;
+    return 2;
+  }
+  if (forget != 0.0f && (pipeline > 1 || batch > 1)) {
+    std::cerr << "kltrun: --forget needs the single KLT mode or --pipeline=1" << std::endl;
+    return 2;
+  }
+  if (mixed < 0 || mixed > 2 || (mixed && cov)) {
+    std::cerr << "kltrun: invalid --mixed=" << mixed << " (Toeplitz covariance only)" << std::endl;
+    return 2;
+  }
+  if (order < KLT::ORDER_FIXED || order > KLT::ORDER_ENERGY) {
+    std::cerr << "kltrun: invalid --order=" << order << std::endl;
+    return 2;
+  }
+  const KLT::OrderRule order_rule = static_cast<KLT::OrderRule>(order);
+  const KLT::CovEstimator cov_est = cov ? KLT::COV_SNAPSHOT : KLT::COV_TOEPLITZ;
+  const KLT::Precision prec = mixed ? KLT::PREC_MIXED : KLT::PREC_SINGLE;
+  KLTArena::set_hugepages(hugepages != 0);
+  if (window < KLT::WIN_NONE || window > KLT::WIN_KAISER) {
+    std::cerr << "kltrun: invalid --win=" << window << std::endl;
+    return 2;
+  }
+  if (window || !taps_fname.empty()) {
+    stream = 0;
+  }
+
+  // Args
+  int arg = 0;
+  const std::string in_fname = args[arg++];
+  const std::string kltb_fname = args[arg++];
+  const std::string kltc_fname = args[arg++];
+  const std::string eval_fname = args[arg++];
+  const int in_len = std::max(atoi(args[arg++].c_str()), 2);
+  const double in_olap_factor = std::max(std::min(atof(args[arg++].c_str()), 0.999999), 0.0);
+  const int acm_order = std::max(std::min(atoi(args[arg++].c_str()), in_len), 2);
+  const int num_eig = std::max(std::min(atoi(args[arg++].c_str()), acm_order * channels), 1);
+  const double out_olap_factor = std::max(std::min(atof(args[arg++].c_str()), 0.999999), 0.0);
+
+  // Compute xfer/cons lens
+  const int in_clen = std::max(static_cast<int>(in_len * (1.0 - in_olap_factor)), 1);
+  const int out_len = acm_order * (1.0 - out_olap_factor);
+
+  try {
+    // Input file
+    KLTInFile in_file(in_fname);
+    if (!format.empty()) {
+      if (in_file.blue && format != in_file.hdr.format) {
+        throw std::runtime_error("--format=" + format + " does not match BLUE input format " +
+                                 in_file.hdr.format);
+      }
+      in_file.hdr.format = format;
+    }
+    const KLTBlueHeader& in_hdr = in_file.hdr;
+    const size_t num_samp = in_file.samples();
+    // Float input is read in place, integer input converted as it is read
+    // (by the single KLT's window stage, else into the frame buffers)
+    const std::complex<float>* in = in_hdr.format == "CF" ? in_file.cf_data() : NULL;
+    const int16_t* in_ci = in_hdr.format == "CI" ? in_file.ci_data() : NULL;
+    const int8_t* in_cb = in_hdr.format == "CB" ? in_file.cb_data() : NULL;
+    if (channels > 1 && in == NULL) {
+      throw std::runtime_error("--channels needs CF input");
+    }
+    if (streams > 1 && in == NULL) {
+      throw std::runtime_error("--streams needs CF input");
+    }
+
+    // User window taps
+    std::vector<float> taps;
+    if (!taps_fname.empty()) {
+      taps.resize(in_len);
+      std::ifstream taps_file(taps_fname.c_str(), std::ios::binary);
+      if (!taps_file.read(reinterpret_cast<char*>(&taps[0]), in_len*sizeof(float))) {
+        throw std::runtime_error("Failed to read in_len window taps from " + taps_fname);
+      }
+    }
+    const KLT::WindowType win_type = static_cast<KLT::WindowType>(window);
+
+    // KLT basis functions (or reconstruction) output file
+    KLTBlueHeader kltb_hdr;
+    if (recon) {
+      // out_len samples per in_clen input samples
+      kltb_hdr.type = 1000;
+      kltb_hdr.format = "CF";
+      kltb_hdr.xstart = in_hdr.xstart;
+      kltb_hdr.xdelta = (in_hdr.xdelta * in_clen) / std::max(out_len, 1);
+      kltb_hdr.xunits = in_hdr.xunits;
+    } else {
+      kltb_hdr.type = 2000;
+      kltb_hdr.format = "CF";
+      kltb_hdr.xstart = in_hdr.xstart;
+      kltb_hdr.xdelta = in_hdr.xdelta;
+      kltb_hdr.xunits = in_hdr.xunits;
+      kltb_hdr.subsize = channels > 1 ? channels * acm_order : out_len;
+      kltb_hdr.ystart = in_hdr.xstart;
+      kltb_hdr.ydelta = (in_hdr.xdelta * in_clen) / num_eig;
+      kltb_hdr.yunits = in_hdr.xunits;
+    }
+    KLTOutFile kltb_file(kltb_fname, in_file.blue, kltb_hdr);
+
+    // KLT coeffs output file
+    KLTBlueHeader kltc_hdr;
+    kltc_hdr.type = 2000;
+    kltc_hdr.format = "CF";
+    kltc_hdr.xstart = 0;
+    kltc_hdr.xdelta = 1;
+    kltc_hdr.xunits = 0;
+    kltc_hdr.subsize = num_eig;
+    kltc_hdr.ystart = in_hdr.xstart;
+    kltc_hdr.ydelta = in_hdr.xdelta * in_clen;
+    kltc_hdr.yunits = 1;
+    KLTOutFile kltc_file(kltc_fname, in_file.blue, kltc_hdr);
+
+    // Eigenvalues output file
+    KLTBlueHeader eval_hdr = kltc_hdr;
+    eval_hdr.format = "SF";
+    KLTOutFile eval_file(eval_fname, in_file.blue, eval_hdr);
+
+    // Sliding KLT coeffs output file
+    const int proj_len = in_len - acm_order + 1;
+    KLTBlueHeader klts_hdr;
+    klts_hdr.type = 2000;
+    klts_hdr.format = "CF";
+    klts_hdr.xstart = in_hdr.xstart;
+    klts_hdr.xdelta = in_hdr.xdelta;
+    klts_hdr.xunits = in_hdr.xunits;
+    klts_hdr.subsize = proj_len;
+    klts_hdr.ystart = in_hdr.xstart;
+    klts_hdr.ydelta = (in_hdr.xdelta * in_clen) / num_eig;
+    klts_hdr.yunits = in_hdr.xunits;
+    KLTOutFile klts_file(klts_fname, in_file.blue, klts_hdr);
+
+    // Model order output file
+    KLTBlueHeader order_hdr;
+    order_hdr.type = 1000;
+    order_hdr.format = "SL";
+    order_hdr.xstart = in_hdr.xstart;
+    order_hdr.xdelta = in_hdr.xdelta * in_clen;
+    order_hdr.xunits = in_hdr.xunits;
+    KLTOutFile order_file(order_fname, in_file.blue, order_hdr);
+
+    // Compact stream output file (always raw, the stream has its own header)
+    KLTOutFile compact_file(compact_fname, false, KLTBlueHeader());
+    std::unique_ptr<KLTCompactWriter> compact;
+    if (compact_file.open()) {
+      compact.reset(new KLTCompactWriter(acm_order, num_eig, quant, key));
+    }
+
+    // Only compute what is written (eigenvalues at the least)
+    const bool recon_out = recon && kltb_file.open();
+    int outputs = (eval_file.open() ? KLT::OUT_EVAL : 0) |
+      (kltc_file.open() ? KLT::OUT_KLTC : 0) | (kltb_file.open() && !recon ? KLT::OUT_KLTB : 0) |
+      (klts_file.open() ? KLT::OUT_KLTS : 0);
+    if (outputs == 0) {
+      outputs = KLT::OUT_EVAL;
+    }
+    // The compact stream takes the unweighted eigenvectors (kltb is weighted
+    // from them)
+    if (compact) {
+      outputs = (outputs & ~KLT::OUT_KLTB) | KLT::OUT_EVAL | KLT::OUT_KLTC;
+    }
+    // Reconstruction from the batch/pipeline frames, in order (the single
+    // KLT does its own)
+    std::unique_ptr<KLTRecon> ola;
+    if (recon_out && (pipeline > 0 || batch > 1)) {
+      ola.reset(new KLTRecon(acm_order, num_eig, out_len));
+      outputs |= KLT::OUT_KLTB;
+    }
+
+    // Frames start every in_clen samples; the last ones are zero padded
+    const size_t num_frames = (num_samp + in_clen - 1) / in_clen;
+    const size_t kltb_size = static_cast<size_t>(acm_order) * num_eig;
+    // Each frame writes num_eig records of out_len elements, taken
+    // contiguously from the basis functions (as the X-Midas primitive)
+    const size_t kltb_out_size = static_cast<size_t>(out_len) * num_eig;
+    auto write_kltb = [&](const std::complex<float>* kltb) {
+      if (ola) {
+        ola->add(kltb);
+        kltb = ola->out_buf;
+      }
+      kltb_file.write(kltb, (recon ? out_len : kltb_out_size)*sizeof(std::complex<float>));
+    };
+#if KLT_SUPPORT_STATS
+    KLTStats klt_stats;
+#endif
+
+    if (channels > 1) {
+      // Joint space-time KLT; frames start every in_clen samples per channel
+      KLTArray klt(in_len, channels, acm_order, num_eig);
+      const size_t chan_samp = num_samp / channels;
+      const size_t chan_frames = (chan_samp + in_clen - 1) / in_clen;
+      const size_t frame_size = static_cast<size_t>(in_len) * channels;
+      const size_t kltb_chan_size = static_cast<size_t>(klt.dim()) * num_eig;
+
+      // Main loop...
+      for (size_t fidx=0; fidx < chan_frames; fidx++) {
+        const size_t pos = fidx * in_clen * channels;
+        const std::complex<float>* frame = &in[pos];
+        if (pos + frame_size > chan_samp * channels) {
+          const size_t ngot = chan_samp * channels - pos;
+          memcpy(klt.in_buf, frame, ngot*sizeof(std::complex<float>));
+          memset(&(klt.in_buf[ngot]), 0, (frame_size - ngot)*sizeof(std::complex<float>));
+          frame = klt.in_buf;
+        }
+
+        // KLT
+        try {
+          klt.transform(frame);
+        } catch (std::runtime_error& err) {
+          std::cerr << "kltrun: warning: " << err.what() << std::endl;
+        }
+
+        // Write output files...
+        eval_file.write(klt.eval_buf, num_eig*sizeof(float));
+        kltc_file.write(klt.kltc_buf, num_eig*sizeof(std::complex<float>));
+        kltb_file.write(klt.kltb_buf, kltb_chan_size*sizeof(std::complex<float>));
+      } // end for (main loop)
+    } else if (streams > 1) {
+      // Independent channels on a shared set of workers; frames start every
+      // in_clen samples per channel
+      const size_t chan_samp = num_samp / streams;
+      const size_t chan_frames = (chan_samp + in_clen - 1) / in_clen;
+      // Channels finish frames out of step, so up to num_rows frames are
+      // collected into rows and written once every channel is in
+      const size_t num_rows = 4 * KLTStreams::QUANTUM;
+      const size_t eval_row = static_cast<size_t>(streams) * num_eig;
+      const size_t kltb_row = static_cast<size_t>(streams) * kltb_out_size;
+      std::vector<float> eval_rows(num_rows * eval_row);
+      std::vector<std::complex<float> > kltc_rows(num_rows * eval_row);
+      std::vector<std::complex<float> > kltb_rows(kltb_file.open() ? num_rows * kltb_row : 0);
+      std::vector<std::atomic<int> > row_done(num_rows);
+      // After the rows, so its workers stop before they go
+      KLTStreams engine(threads > 0 ? threads :
+                        std::max<int>(std::thread::hardware_concurrency(), 1), 0);
+
+      KLTStreams::Config config;
+      config.window = win_type;
+      config.window_param = beta;
+      config.covariance = cov_est;
+      config.fwd_bwd = cov == 2;
+      config.precision = prec;
+      config.refine = mixed == 2;
+      config.order_rule = order_rule;
+      config.energy_frac = energy;
+      config.outputs = outputs;
+      for (int cidx=0; cidx < streams; cidx++) {
+        KLTStreams::WriteFn write = [&, cidx](long fidx, const float* eval,
+                                               const std::complex<float>* kltc,
+                                               const std::complex<float>* kltb,
+                                               const char* err) {
+          if (err != NULL) {
+            std::cerr << "kltrun: warning: channel " << cidx << ": " << err << std::endl;
+          }
+          const size_t row = fidx % num_rows;
+          memcpy(&eval_rows[row * eval_row + cidx * num_eig], eval, num_eig*sizeof(float));
+          memcpy(&kltc_rows[row * eval_row + cidx * num_eig], kltc,
+                 num_eig*sizeof(std::complex<float>));
+          if (!kltb_rows.empty()) {
+            memcpy(&kltb_rows[row * kltb_row + cidx * kltb_out_size], kltb,
+                   kltb_out_size*sizeof(std::complex<float>));
+          }
+          row_done[row].fetch_add(1, std::memory_order_release);
+        };
+        engine.add_stream(in_len,
+#if KLT_SUPPORT_EVALN
+                          eval_normalized,
+#endif
+                          acm_order, num_eig, config, write);
+      }
+      engine.start();
+
+      // Write completed rows in frame order
+      size_t num_written = 0;
+      auto write_rows = [&]() {
+        while (row_done[num_written % num_rows].load(std::memory_order_acquire) == streams) {
+          const size_t row = num_written % num_rows;
+          eval_file.write(&eval_rows[row * eval_row], eval_row*sizeof(float));
+          kltc_file.write(&kltc_rows[row * eval_row], eval_row*sizeof(std::complex<float>));
+          if (!kltb_rows.empty()) {
+            kltb_file.write(&kltb_rows[row * kltb_row], kltb_row*sizeof(std::complex<float>));
+          }
+          row_done[row].store(0, std::memory_order_relaxed);
+          num_written++;
+        }
+      };
+
+      // Main loop...
+      std::vector<std::complex<float> > frame(in_len);
+      for (size_t fidx=0; fidx < chan_frames; fidx++) {
+        while (fidx >= num_written + num_rows) {
+          write_rows();
+          std::this_thread::yield();
+        }
+        const size_t pos = fidx * in_clen;
+        const size_t ngot = std::min<size_t>(in_len, chan_samp - pos);
+        for (int cidx=0; cidx < streams; cidx++) {
+          for (size_t sidx=0; sidx < ngot; sidx++) {
+            frame[sidx] = in[(pos + sidx) * streams + cidx];
+          }
+          std::fill(frame.begin() + ngot, frame.end(), std::complex<float>(0.0f, 0.0f));
+          while (!engine.push(cidx, &frame[0])) {
+            write_rows();
+            std::this_thread::yield();
+          }
+        }
+        write_rows();
+      } // end for (main loop)
+      engine.finish();
+      write_rows();
+
+      if (stats) {
+        for (int widx=0; widx < engine.workers(); widx++) {
+          print_stats("worker", engine.worker_stats(widx));
+          std::cerr << "kltrun: worker: steals " << engine.worker_steals(widx) << std::endl;
+        }
+        std::cerr << "kltrun: streams " << engine.num_streams() << " pooled KLTs " <<
+          engine.pooled() << std::endl;
+      }
+    } else if (pipeline > 0) {
+      // Reader, compute and writer stages overlapped
+      KLTPipeline pipe(in_len,
+#if KLT_SUPPORT_EVALN
+                       eval_normalized,
+#endif
+                       acm_order, num_eig, pipeline, 0);
+      for (int widx=0; widx < pipe.workers(); widx++) {
+        pipe.klt(widx).set_outputs(outputs);
+        pipe.klt(widx).set_model_order(order_rule, energy);
+        pipe.klt(widx).set_covariance(cov_est, cov == 2, 0.0f);
+        pipe.klt(widx).set_precision(prec, mixed == 2);
+        if (taps.empty()) {
+          pipe.klt(widx).set_window(win_type, beta);
+        } else {
+          pipe.klt(widx).set_window(&taps[0]);
+        }
+      }
+      // Frame-to-frame state needs every frame on the same KLT
+      if (pipeline == 1) {
+        if (stream && in_clen < in_len) {
+          pipe.klt(0).set_stream(in_clen, resync);
+        }
+        if (track) {
+          pipe.klt(0).set_track(track, 1.0e-4f, 4);
+        }
+        pipe.klt(0).set_covariance(cov_est, cov == 2, forget);
+      }
+
+      // Frames fully inside the mapping go straight to the transform
+      KLTPipeline::ReadFn read = [&](long fidx, std::complex<float>* buf)
+        -> const std::complex<float>* {
+        if (static_cast<size_t>(fidx) >= num_frames) {
+          return NULL;
+        }
+        const size_t pos = fidx * in_clen;
+        if (in != NULL && pos + in_len <= num_samp) {
+          return &in[pos];
+        }
+        read_frame(in_file, pos, in_len, scale, buf);
+        return buf;
+      };
+      KLTPipeline::WriteFn write = [&](long, const float* eval, const std::complex<float>* kltc,
+                                       const std::complex<float>* kltb, const char* err) {
+        if (err != NULL) {
+          std::cerr << "kltrun: warning: " << err << std::endl;
+        }
+        eval_file.write(eval, num_eig*sizeof(float));
+        kltc_file.write(kltc, num_eig*sizeof(std::complex<float>));
+        write_kltb(kltb);
+      };
+      pipe.run(read, write);
+
+      if (stats) {
+        print_stats("reader", pipe.reader_stats());
+        for (int widx=0; widx < pipe.workers(); widx++) {
+          print_stats("worker", pipe.worker_stats(widx));
+        }
+        print_stats("writer", pipe.writer_stats());
+      }
+#if KLT_SUPPORT_STATS
+      for (int widx=0; widx < pipe.workers(); widx++) {
+        klt_stats += pipe.klt(widx).stats();
+      }
+#endif
+    } else if (batch > 1) {
+      // Independent frames, batch-parallel
+      KLTBatch klt(in_len,
+#if KLT_SUPPORT_EVALN
+                   eval_normalized,
+#endif
+                   acm_order, num_eig, threads);
+      klt.set_outputs(outputs);
+      klt.set_model_order(order_rule, energy);
+      klt.set_covariance(cov_est, cov == 2);
+      klt.set_precision(prec, mixed == 2);
+      if (taps.empty()) {
+        klt.set_window(win_type, beta);
+      } else {
+        klt.set_window(&taps[0]);
+      }
+      // Non-overlapped full float frames are already laid out as a batch
+      const bool direct = in_clen == in_len && in != NULL;
+      std::vector<std::complex<float> > in_buf(direct ? 0 : static_cast<size_t>(batch) * in_len);
+      std::vector<std::complex<float> > pad_buf(in_len);
+      std::vector<float> eval_buf(static_cast<size_t>(batch) * num_eig);
+      std::vector<std::complex<float> > kltc_buf(static_cast<size_t>(batch) * num_eig);
+      std::vector<std::complex<float> > kltb_buf(static_cast<size_t>(batch) * kltb_size);
+      std::vector<int> order_buf(batch);
+
+      // Main loop...
+      for (size_t fidx=0; fidx < num_frames; ) {
+        int batch_frames = std::min<size_t>(batch, num_frames - fidx);
+        const std::complex<float>* batch_in;
+        const size_t pos = fidx * in_clen;
+        if (direct && pos + static_cast<size_t>(batch_frames) * in_len <= num_samp) {
+          batch_in = &in[pos];
+        } else if (direct) {
+          // Last partial frame on its own
+          if (pos + in_len <= num_samp) {
+            batch_frames = (num_samp - pos) / in_len;
+            batch_in = &in[pos];
+          } else {
+            batch_frames = 1;
+            read_frame(in_file, pos, in_len, scale, &pad_buf[0]);
+            batch_in = &pad_buf[0];
+          }
+        } else {
+          for (int bidx=0; bidx < batch_frames; bidx++) {
+            read_frame(in_file, (fidx + bidx) * in_clen, in_len, scale,
+                       &in_buf[static_cast<size_t>(bidx) * in_len]);
+          }
+          batch_in = &in_buf[0];
+        }
+
+        // KLT
+        try {
+          klt.transform(batch_in, batch_frames, &eval_buf[0], &kltc_buf[0], &kltb_buf[0],
+                        &order_buf[0]);
+        } catch (std::runtime_error& err) {
+          std::cerr << "kltrun: warning: " << err.what() << std::endl;
+        }
+
+        // Write output files...
+        eval_file.write(&eval_buf[0], static_cast<size_t>(batch_frames) * num_eig * sizeof(float));
+        kltc_file.write(&kltc_buf[0], static_cast<size_t>(batch_frames) * num_eig *
+                        sizeof(std::complex<float>));
+        for (int bidx=0; bidx < batch_frames; bidx++) {
+          write_kltb(&kltb_buf[bidx * kltb_size]);
+        }
+        order_file.write(&order_buf[0], batch_frames*sizeof(int));
+        fidx += batch_frames;
+      } // end for (main loop)
+#if KLT_SUPPORT_STATS
+      klt_stats = klt.stats();
+#endif
+    } else {
+      // Create KLT object
+      KLT klt(in_len,
+#if KLT_SUPPORT_EVALN
+              eval_normalized,
+#endif
+              acm_order, num_eig);
+      klt.set_outputs(outputs);
+      klt.set_model_order(order_rule, energy);
+      if (recon_out) {
+        klt.set_recon(out_len);
+      }
+      // Reuse overlapped lag sums across frames
+      if (stream && in_clen < in_len) {
+        klt.set_stream(in_clen, resync);
+      }
+      // Warm start each eigensolve from the previous frame
+      if (track) {
+        klt.set_track(track, 1.0e-4f, 4);
+      }
+      klt.set_covariance(cov_est, cov == 2, forget);
+      klt.set_precision(prec, mixed == 2);
+      if (taps.empty()) {
+        klt.set_window(win_type, beta);
+      } else {
+        klt.set_window(&taps[0]);
+      }
+      // Stable eigenvector phase, so the compact stream's deltas stay small
+      klt.set_canonical_phase(compact != NULL);
+      std::vector<std::complex<float> > weight_buf(compact && kltb_file.open() ? kltb_size : 0);
+
+      // Main loop...
+      for (size_t fidx=0; fidx < num_frames; fidx++) {
+        // Frames fully inside the mapping go straight to the transform
+        const size_t pos = fidx * in_clen;
+        const bool pad = pos + in_len > num_samp;
+        if (pad) {
+          read_frame(in_file, pos, in_len, scale, klt.in_buf);
+        }
+
+        // KLT
+        try {
+          if (pad) {
+            klt.transform(klt.in_buf);
+          } else if (in_ci != NULL) {
+            klt.transform(&in_ci[2*pos], scale);
+          } else if (in_cb != NULL) {
+            klt.transform(&in_cb[2*pos], scale);
+          } else {
+            klt.transform(&in[pos]);
+          }
+        } catch (std::runtime_error& err) {
+          std::cerr << "kltrun: warning: " << err.what() << std::endl;
+        }
+
+        // Write output files...
+        eval_file.write(klt.eval_buf, num_eig*sizeof(float));
+        kltc_file.write(klt.kltc_buf, num_eig*sizeof(std::complex<float>));
+        if (recon_out) {
+          kltb_file.write(klt.recon_buf, out_len*sizeof(std::complex<float>));
+        } else if (!weight_buf.empty()) {
+          klt_weight_basis(klt.kltb_buf, klt.kltc_buf, acm_order, num_eig, &weight_buf[0]);
+          kltb_file.write(&weight_buf[0], kltb_out_size*sizeof(std::complex<float>));
+        } else {
+          kltb_file.write(klt.kltb_buf, kltb_out_size*sizeof(std::complex<float>));
+        }
+        if (compact) {
+          compact->encode(klt.eval_buf, klt.kltc_buf, klt.kltb_buf);
+          compact_file.write(compact->data(), compact->size());
+        }
+        klts_file.write(klt.klts_buf, static_cast<size_t>(num_eig) * proj_len *
+                        sizeof(std::complex<float>));
+        const int frame_order = klt.model_order();
+        order_file.write(&frame_order, sizeof(int));
+      } // end for (main loop)
+#if KLT_SUPPORT_STATS
+      klt_stats = klt.stats();
+#endif
+    }
+
+    // Done
+    compact_file.close();
+    order_file.close();
+    klts_file.close();
+    kltb_file.close();
+    kltc_file.close();
+    eval_file.close();
+#if KLT_SUPPORT_STATS
+    if (!stats_json.empty()) {
+      std::ofstream json_file(stats_json.c_str());
+      json_file << klt_stats.json() << std::endl;
+      if (!json_file) {
+        throw std::runtime_error("Failed to write " + stats_json);
+      }
+    }
+#endif
+  }
+  catch (std::runtime_error& err) {
+    std::cerr << "kltrun: error: " << err.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
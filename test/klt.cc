@@ -3,11 +3,19 @@
 
 #include <algorithm>
 #include <complex>
+#include <cstdint>
 #include <cstring>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <vector>
 #include <primitive.h> // XM
 #include "klt.hh"
+#include "klt_arena.hh"
+#include "klt_batch.hh"
+#include "klt_compact.hh"
+#include "klt_recon.hh"
+#include "klt_simd.hh"
 
 //==============================================================================
 // MAIN
@@ -27,33 +35,84 @@ void mainroutine()
   const double out_olap_factor = std::max(std::min(m_dpick(arg++), 0.999999), 0.0);
 
   // Switches
-#if KLT_SUPPORT_WIN
-  const int window = m_get_switch_def("WIN", 0);
-#endif
+  // Window (KLT::WindowType, no user taps here), Kaiser beta in tenths
+  const int window = std::max(std::min(m_get_switch_def("WIN", 0),
+                                       static_cast<int>(KLT::WIN_KAISER)), 0);
+  const float beta = 0.1f * m_get_switch_def("BETA", 86);
 #if KLT_SUPPORT_EVALN
   const int eval_normalized = m_get_switch_def("EVALN", 1);
 #endif
+  const int stream = window ? 0 : m_get_switch_def("STREAM", 0);
+  const int resync = std::max(m_get_switch_def("RESYNC", 64), 1);
+  const int track = m_get_switch_def("TRACK", 0);
+  const int recon = m_get_switch_def("RECON", 0);
+  // Model order rule (KLT::OrderRule), energy fraction in percent
+  const int order = std::max(std::min(m_get_switch_def("ORDER", 0),
+                                      static_cast<int>(KLT::ORDER_ENERGY)), 0);
+  const float energy = 0.01f * m_get_switch_def("ENERGY", 90);
+  // Covariance: 0 Toeplitz, 1 snapshot, 2 snapshot forward-backward; forget
+  // factor in percent
+  const int cov = std::max(std::min(m_get_switch_def("COV", 0), 2), 0);
+  const float forget = 0.01f * std::max(std::min(m_get_switch_def("FORGET", 0), 99), 0);
+  const KLT::CovEstimator cov_est = cov ? KLT::COV_SNAPSHOT : KLT::COV_TOEPLITZ;
+  // Lag precision: 0 single, 1 mixed, 2 mixed with eigenvalue refinement
+  // (Toeplitz covariance only)
+  const int mixed = cov ? 0 : std::max(std::min(m_get_switch_def("MIXED", 0), 2), 0);
+  const KLT::Precision prec = mixed ? KLT::PREC_MIXED : KLT::PREC_SINGLE;
+  // Compact kltb output: the stream of klt_compact.hh (eigenvalues, coeffs,
+  // canonical-phase eigenvectors delta-coded, quantized to 2^-QBITS unless 0)
+  // as bytes, in place of the weighted basis functions (not with /RECON or
+  // /BATCH)
+  const int compact = m_get_switch_def("COMPACT", 0);
+  const int qbits = std::max(m_get_switch_def("QBITS", 0), 0);
+  const int key = std::max(m_get_switch_def("KEY", 64), 0);
+  const int batch = std::max(m_get_switch_def("BATCH", 1), 1);
+  const int threads = std::max(m_get_switch_def("THREADS", 0), 0);
+  KLTArena::set_hugepages(m_get_switch_def("HUGEPAGES", 0) != 0);
 
   // Compute xfer/cons lens
   const int in_clen = in_len * (1.0 - in_olap_factor);
   const int in_olen = in_len - in_clen;
   const int out_len = acm_order * (1.0 - out_olap_factor);;
 
-  // Input file
+  // Input file: complex float, or complex int16/int8 grabbed as is and
+  // converted (in counts, scale 1) by the KLT's window stage
   CPHEADER in_hcb;
-  m_init(in_hcb, in_fname, "1000", "CF", 0);
+  m_init(in_hcb, in_fname, "1000", "", 0);
   m_open(in_hcb, HCBF_INPUT);
+  const bool in_ci = in_hcb.format == "CI";
+  const bool in_cb = in_hcb.format == "CB";
+  if (in_hcb.format != "CF" && !in_ci && !in_cb) {
+    m_close(in_hcb);
+    m_error("Input format must be CF, CI or CB");
+  }
+  std::vector<char> raw_buf(in_ci || in_cb ? static_cast<size_t>(in_len) * in_hcb.bpa : 0);
 
-  // KLT basis functions output file
+  // KLT basis functions output file (or, with /RECON, their overlap-add
+  // reconstruction: out_len samples per in_clen input samples; with
+  // /COMPACT, the compact stream)
   CPHEADER kltb_hcb;
-  m_init(kltb_hcb, kltb_fname, "2000", "CF", 0);
-  kltb_hcb.xstart = in_hcb.xstart;
-  kltb_hcb.xdelta = in_hcb.xdelta;
-  kltb_hcb.xunits = in_hcb.xunits;
-  kltb_hcb.subsize = out_len;
-  kltb_hcb.ystart = in_hcb.xstart;
-  kltb_hcb.ydelta = (in_hcb.xdelta * in_clen) / num_eig;
-  kltb_hcb.yunits = in_hcb.xunits;
+  if (compact && (recon || batch > 1)) {
+    m_close(in_hcb);
+    m_error("/COMPACT needs the single KLT mode, without /RECON");
+  }
+  if (compact) {
+    m_init(kltb_hcb, kltb_fname, "1000", "SB", 0);
+  } else if (recon) {
+    m_init(kltb_hcb, kltb_fname, "1000", "CF", 0);
+    kltb_hcb.xstart = in_hcb.xstart;
+    kltb_hcb.xdelta = (in_hcb.xdelta * in_clen) / std::max(out_len, 1);
+    kltb_hcb.xunits = in_hcb.xunits;
+  } else {
+    m_init(kltb_hcb, kltb_fname, "2000", "CF", 0);
+    kltb_hcb.xstart = in_hcb.xstart;
+    kltb_hcb.xdelta = in_hcb.xdelta;
+    kltb_hcb.xunits = in_hcb.xunits;
+    kltb_hcb.subsize = out_len;
+    kltb_hcb.ystart = in_hcb.xstart;
+    kltb_hcb.ydelta = (in_hcb.xdelta * in_clen) / num_eig;
+    kltb_hcb.yunits = in_hcb.xunits;
+  }
   m_open(kltb_hcb, HCBF_OUTPUT + HCBF_OPTIONAL);
 
   // KLT coeffs output file
@@ -80,48 +139,167 @@ void mainroutine()
   eval_hcb.yunits = 1;
   m_open(eval_hcb, HCBF_OUTPUT + HCBF_OPTIONAL);
 
+  // Only compute what is written (eigenvalues at the least)
+  const bool recon_out = recon && kltb_hcb.open;
+  int outputs = (eval_hcb.open ? KLT::OUT_EVAL : 0) |
+    (kltc_hcb.open ? KLT::OUT_KLTC : 0) | (kltb_hcb.open && !recon ? KLT::OUT_KLTB : 0);
+  if (outputs == 0) {
+    outputs = KLT::OUT_EVAL;
+  }
+  // The compact stream takes the unweighted eigenvectors
+  if (compact && kltb_hcb.open) {
+    outputs = (outputs & ~KLT::OUT_KLTB) | KLT::OUT_EVAL | KLT::OUT_KLTC;
+  }
+
   try {
-    // Create KLT object
-    KLT klt(in_len,
-#if KLT_SUPPORT_WIN
-            window,
+    if (batch > 1) {
+      // Independent frames, batch-parallel (stream/track modes and the
+      // covariance forget factor need the previous frame so they do not apply)
+      KLTBatch klt(in_len,
+#if KLT_SUPPORT_EVALN
+                   eval_normalized,
 #endif
+                   acm_order, num_eig, threads);
+      // Reconstruction from the batch frames, in order
+      KLTRecon ola(acm_order, num_eig, recon_out ? out_len : acm_order);
+      klt.set_outputs(recon_out ? outputs | KLT::OUT_KLTB : outputs);
+      klt.set_model_order(static_cast<KLT::OrderRule>(order), energy);
+      klt.set_covariance(cov_est, cov == 2);
+      klt.set_precision(prec, mixed == 2);
+      klt.set_window(static_cast<KLT::WindowType>(window), beta);
+      std::vector<std::complex<float> > in_buf(static_cast<size_t>(batch) * in_len);
+      std::vector<float> eval_buf(static_cast<size_t>(batch) * num_eig);
+      std::vector<std::complex<float> > kltc_buf(static_cast<size_t>(batch) * num_eig);
+      std::vector<std::complex<float> > kltb_buf(static_cast<size_t>(batch) * acm_order * num_eig);
+
+      // Begin pipe section
+      m_sync();
+
+      // Main loop...
+      bool eof = false;
+      while (!eof && m_do(in_len, in_hcb.xfer_len)) {
+        // Read up to batch frames...
+        int num_frames = 0;
+        while (num_frames < batch) {
+          std::complex<float>* frame = &in_buf[static_cast<size_t>(num_frames) * in_len];
+          char* grab = raw_buf.empty() ? reinterpret_cast<char*>(frame) : &raw_buf[0];
+          in_hcb.cons_len = in_clen;
+          int ngot = 0;
+          m_grabx(in_hcb, grab, ngot);
+          if (ngot < 1) {
+            eof = true;
+            break;
+          } else if (ngot < in_len) {
+            memset(&grab[ngot * in_hcb.bpa], 0, (in_len - ngot) * in_hcb.bpa);
+          }
+          if (in_ci) {
+            klt_cvt_ci16(reinterpret_cast<const int16_t*>(grab), NULL, 1.0f, frame, in_len);
+          } else if (in_cb) {
+            klt_cvt_ci8(reinterpret_cast<const int8_t*>(grab), NULL, 1.0f, frame, in_len);
+          }
+          num_frames++;
+        }
+        if (num_frames < 1) {
+          break;
+        }
+
+        // KLT
+        try {
+          klt.transform(&in_buf[0], num_frames, &eval_buf[0], &kltc_buf[0], &kltb_buf[0]);
+        } catch (const std::exception& err) {
+          m_warning(err.what());
+        }
+
+        // Write output files...
+        if (eval_hcb.open)
+          m_filad(eval_hcb, &eval_buf[0], num_frames);
+        if (kltc_hcb.open)
+          m_filad(kltc_hcb, &kltc_buf[0], num_frames);
+        if (kltb_hcb.open) {
+          for (int fidx=0; fidx < num_frames; fidx++) {
+            const std::complex<float>* kltb = &kltb_buf[static_cast<size_t>(fidx) * acm_order * num_eig];
+            if (recon_out) {
+              ola.add(kltb);
+              m_filad(kltb_hcb, ola.out_buf, out_len);
+            } else {
+              m_filad(kltb_hcb, kltb, num_eig);
+            }
+          }
+        }
+      } // end while (main loop)
+    } else {
+      // Create KLT object
+      KLT klt(in_len,
 #if KLT_SUPPORT_EVALN
-            eval_normalized
+              eval_normalized
 #endif
-            acm_order, num_eig);
-
-    // Begin pipe section
-    m_sync();
-
-    // Main loop...
-    while (m_do(in_len, in_hcb.xfer_len)) {
-      // Read input file...
-      in_hcb.cons_len = in_clen;
-      int ngot = 0;
-      m_grabx(in_hcb, klt.in_buf, ngot);
-      if (ngot < 1) {
-        break;
-      } else if (ngot < in_len) {
-        memset(&(klt.in_buf[ngot]), 0, (in_len - ngot) * in_hcb.bpa);
+              acm_order, num_eig);
+      klt.set_outputs(outputs);
+      klt.set_model_order(static_cast<KLT::OrderRule>(order), energy);
+      if (recon_out) {
+        klt.set_recon(out_len);
       }
-
-      // KLT
-      try {
-        klt.transform();
-      } catch (std::runtime_error err) {
-        m_warning(err.what());
+      // Reuse overlapped lag sums across frames
+      if (stream && in_clen > 0) {
+        klt.set_stream(in_clen, resync);
       }
-
-      // Write output files...
-      if (eval_hcb.open) {
-        m_filad(eval_hcb, klt.eval_buf, 1);
+      // Warm start each eigensolve from the previous frame
+      if (track) {
+        klt.set_track(track, 1.0e-4f, 4);
       }
-      if (kltc_hcb.open)
-        m_filad(kltc_hcb, klt.kltc_buf, 1);
-      if (kltb_hcb.open)
-        m_filad(kltb_hcb, klt.kltb_buf, num_eig);
-    } // end while (main loop)
+      klt.set_covariance(cov_est, cov == 2, forget);
+      klt.set_precision(prec, mixed == 2);
+      klt.set_window(static_cast<KLT::WindowType>(window), beta);
+      std::unique_ptr<KLTCompactWriter> compact_out;
+      if (compact && kltb_hcb.open) {
+        compact_out.reset(new KLTCompactWriter(acm_order, num_eig, qbits, key));
+        klt.set_canonical_phase(true);
+      }
+
+      // Begin pipe section
+      m_sync();
+
+      // Main loop...
+      while (m_do(in_len, in_hcb.xfer_len)) {
+        // Read input file...
+        char* grab = raw_buf.empty() ? reinterpret_cast<char*>(klt.in_buf) : &raw_buf[0];
+        in_hcb.cons_len = in_clen;
+        int ngot = 0;
+        m_grabx(in_hcb, grab, ngot);
+        if (ngot < 1) {
+          break;
+        } else if (ngot < in_len) {
+          memset(&grab[ngot * in_hcb.bpa], 0, (in_len - ngot) * in_hcb.bpa);
+        }
+
+        // KLT
+        try {
+          if (in_ci) {
+            klt.transform(reinterpret_cast<const int16_t*>(grab), 1.0f);
+          } else if (in_cb) {
+            klt.transform(reinterpret_cast<const int8_t*>(grab), 1.0f);
+          } else {
+            klt.transform();
+          }
+        } catch (const std::exception& err) {
+          m_warning(err.what());
+        }
+
+        // Write output files...
+        if (eval_hcb.open) {
+          m_filad(eval_hcb, klt.eval_buf, 1);
+        }
+        if (kltc_hcb.open)
+          m_filad(kltc_hcb, klt.kltc_buf, 1);
+        if (recon_out)
+          m_filad(kltb_hcb, klt.recon_buf, out_len);
+        else if (compact_out) {
+          compact_out->encode(klt.eval_buf, klt.kltc_buf, klt.kltb_buf);
+          m_filad(kltb_hcb, const_cast<uint8_t*>(compact_out->data()), compact_out->size());
+        } else if (kltb_hcb.open)
+          m_filad(kltb_hcb, klt.kltb_buf, num_eig);
+      } // end while (main loop)
+    }
 
     // Done
     m_close(in_hcb);
@@ -132,7 +310,7 @@ void mainroutine()
     if (eval_hcb.open)
       m_close(eval_hcb);
   }
-  catch (std::runtime_error err) {
+  catch (const std::exception& err) {
     m_close(in_hcb);
     if (kltb_hcb.open)
       m_close(kltb_hcb);
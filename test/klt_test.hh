@@ -0,0 +1,180 @@
+// Karhunen-Loève Transform Library
+// Unit test harness (make test): test case registration, checks, and the
+// reference comparisons shared by the test_*.cc files
+
+#ifndef __KLT_TEST_HH__
+#define __KLT_TEST_HH__
+
+#include <complex>
+#include <exception>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class KLT;
+
+//---------------------------------------------------------------------------
+// Test cases
+//   TEST_CASE("name") { ... } defines and registers a case; bin/test runs
+//   every case (or those whose name contains its first argument).  CHECK
+//   records a failure and carries on, REQUIRE ends the case.  Any exception
+//   escaping a case fails it.
+//---------------------------------------------------------------------------
+int klt_test_register(const char* name, void (*fn)());
+void klt_test_fail(const char* file, int line, const std::string& what, bool fatal);
+
+#define KLT_TEST_CAT2(a, b) a##b
+#define KLT_TEST_CAT(a, b) KLT_TEST_CAT2(a, b)
+#define TEST_CASE(name)                                                 \
+  static void KLT_TEST_CAT(klt_test_fn_, __LINE__)();                   \
+  static const int KLT_TEST_CAT(klt_test_reg_, __LINE__) =              \
+    klt_test_register(name, &KLT_TEST_CAT(klt_test_fn_, __LINE__));     \
+  static void KLT_TEST_CAT(klt_test_fn_, __LINE__)()
+
+#define CHECK(cond)                                                     \
+  do {                                                                  \
+    if (!(cond)) {                                                      \
+      klt_test_fail(__FILE__, __LINE__, #cond, false);                  \
+    }                                                                   \
+  } while (0)
+
+#define REQUIRE(cond)                                                   \
+  do {                                                                  \
+    if (!(cond)) {                                                      \
+      klt_test_fail(__FILE__, __LINE__, #cond, true);                   \
+    }                                                                   \
+  } while (0)
+
+// |a - b| <= tol, printing both values on failure
+#define CHECK_NEAR(a, b, tol)                                           \
+  do {                                                                  \
+    const double klt_test_a = (a);                                      \
+    const double klt_test_b = (b);                                      \
+    if (!(std::abs(klt_test_a - klt_test_b) <= (tol))) {                \
+      std::ostringstream klt_test_oss;                                  \
+      klt_test_oss << #a << " = " << klt_test_a << ", " << #b << " = " <<  \
+        klt_test_b << " (tol " << (tol) << ")";                         \
+      klt_test_fail(__FILE__, __LINE__, klt_test_oss.str(), false);     \
+    }                                                                   \
+  } while (0)
+
+#define CHECK_THROWS(expr)                                              \
+  do {                                                                  \
+    bool klt_test_thrown = false;                                       \
+    try {                                                               \
+      expr;                                                             \
+    } catch (const std::exception&) {                                   \
+      klt_test_thrown = true;                                           \
+    }                                                                   \
+    if (!klt_test_thrown) {                                             \
+      klt_test_fail(__FILE__, __LINE__, "CHECK_THROWS(" #expr ")", false); \
+    }                                                                   \
+  } while (0)
+
+//---------------------------------------------------------------------------
+// Test frames
+//   FRAME_TONES: three tones plus noise (well separated eigenvalues).
+//   FRAME_NOISE: white noise.
+//   FRAME_ZERO: all zero.
+//   FRAME_CONST: constant (rank one).
+//   FRAME_IMPULSE: single impulse mid-frame (all eigenvalues equal).
+//   FRAME_PAIRS: impulse pair 7 samples apart (the Toeplitz matrix falls
+//                apart into interleaved chains: repeated eigenvalues, and
+//                sstebz splits).
+//---------------------------------------------------------------------------
+enum TestFrame {
+  FRAME_TONES,
+  FRAME_NOISE,
+  FRAME_ZERO,
+  FRAME_CONST,
+  FRAME_IMPULSE,
+  FRAME_PAIRS
+};
+
+static const TestFrame ALL_FRAMES[] = {
+  FRAME_TONES, FRAME_NOISE, FRAME_ZERO, FRAME_CONST, FRAME_IMPULSE, FRAME_PAIRS
+};
+
+const char* test_frame_name(TestFrame kind);
+
+//---------------------------------------------------------------------------
+// len samples of kind (seed picks the noise and tone phases)
+//---------------------------------------------------------------------------
+std::vector<std::complex<float> > test_frame(TestFrame kind, int len, unsigned seed);
+
+//---------------------------------------------------------------------------
+// Contiguous test signal: tones plus noise, len samples
+//---------------------------------------------------------------------------
+std::vector<std::complex<float> > test_signal(int len, unsigned seed);
+
+//---------------------------------------------------------------------------
+// All eigenvalues of the Hermitian matrix herm (size order x order, row
+// major), from a double-precision Jacobi sweep, ascending
+//---------------------------------------------------------------------------
+std::vector<double> test_hermitian_eigenvalues(const std::vector<std::complex<double> >& herm,
+                                               int order);
+
+//---------------------------------------------------------------------------
+// Reference eigenvalues: all acm_order eigenvalues of the biased Toeplitz
+// auto-correlation matrix of in (in_len samples), from double lags and a
+// double-precision Jacobi sweep, ascending
+//---------------------------------------------------------------------------
+std::vector<double> test_eigenvalues(const std::complex<float>* in, int in_len, int acm_order);
+
+//---------------------------------------------------------------------------
+// New KLT with the default settings (eigenvalues not normalized)
+//---------------------------------------------------------------------------
+KLT* make_klt(int in_len, int acm_order, int num_eig);
+
+//---------------------------------------------------------------------------
+// Transform outputs as copies (so two instances can be compared)
+//   kltb empty if the transform has no eigenvectors.
+//---------------------------------------------------------------------------
+struct TestOutputs
+{
+  std::vector<float> eval;
+  std::vector<std::complex<float> > kltc;
+  std::vector<std::complex<float> > kltb;
+};
+
+TestOutputs test_outputs(const KLT& klt, int acm_order, int num_eig);
+
+//---------------------------------------------------------------------------
+// Check a transform's outputs against in (in_len samples) itself:
+//   eval: the top num_eig reference eigenvalues (any order, see
+//         test_eigenvalues()), to tol relative to the largest.
+//   kltb: each column an eigenvector of the Toeplitz matrix for its
+//         eigenvalue (residual within tol), unit norm and orthogonal to the
+//         others if unweighted, else its eigenvector times its coeff.
+//   kltc: coeff of the frame head (the first acm_order samples) on its
+//         eigenvector.
+//   Components past order (adaptive model order) must be zero in kltc and
+//   kltb.  kltc/kltb are skipped if empty.
+//---------------------------------------------------------------------------
+void check_transform(const std::complex<float>* in, int in_len, int acm_order, int num_eig,
+                     const TestOutputs& out, bool weighted, double tol, int order = -1);
+
+//---------------------------------------------------------------------------
+// Check eval, kltc and weighted kltb (size order x num_eig) against the
+// Hermitian matrix herm (size order x order, row major): the top num_eig
+// eigenvalues (any order) to tol relative to the largest, each column an
+// eigenvector times its coeff of head (size order).
+//---------------------------------------------------------------------------
+void check_hermitian(const std::vector<std::complex<double> >& herm, int order,
+                     const std::complex<float>* head, int num_eig, const float* eval,
+                     const std::complex<float>* kltc, const std::complex<float>* kltb,
+                     double tol);
+
+//---------------------------------------------------------------------------
+// Check two transforms of in (in_len samples) agree: eigenvalues (sorted)
+// to tol relative to the largest, and the weighted basis functions summed
+// over each group of equal (within tol) eigenvalues, which do not depend on the
+// eigenvector phase or on the basis chosen within a repeated eigenvalue.
+// Both must hold weighted basis functions.  Groups at the cut (tied with an
+// eigenvalue left out) are not unique and are skipped.
+//---------------------------------------------------------------------------
+void check_same(const std::complex<float>* in, int in_len, int acm_order, int num_eig,
+                const TestOutputs& out, const TestOutputs& ref, double tol);
+
+#endif
@@ -0,0 +1,72 @@
+// Karhunen-Loève Transform Library
+// Auto-correlation engines against the baseline direct + LAPACK path
+
+#include "klt_test.hh"
+#include "klt.hh"
+
+namespace {
+
+struct Shape
+{
+  int in_len;
+  int acm_order;
+  int num_eig;
+};
+
+const Shape SHAPES[] = {
+  {64, 16, 6},
+  {256, 32, 4},
+  {256, 48, 4},
+  {1000, 24, 3}
+};
+
+KLT* make_klt(const Shape& shape, KLT::AcorrEngine engine)
+{
+  KLT* klt = ::make_klt(shape.in_len, shape.acm_order, shape.num_eig);
+  klt->set_acorr_engine(engine);
+  klt->set_eig_engine(KLT::EIG_LAPACK);
+  return klt;
+}
+
+}
+
+
+TEST_CASE("acorr: direct + LAPACK baseline against the reference")
+{
+  for (const Shape& shape : SHAPES) {
+    for (TestFrame kind : ALL_FRAMES) {
+      const std::vector<std::complex<float> > in = test_frame(kind, shape.in_len, 1);
+      std::unique_ptr<KLT> ref(make_klt(shape, KLT::ACORR_DIRECT));
+      ref->transform(&in[0]);
+      check_transform(&in[0], shape.in_len, shape.acm_order, shape.num_eig,
+                      test_outputs(*ref, shape.acm_order, shape.num_eig), true, 1.0e-3);
+    }
+  }
+}
+
+TEST_CASE("acorr: FFT engine matches direct")
+{
+  for (const Shape& shape : SHAPES) {
+    for (TestFrame kind : ALL_FRAMES) {
+      const std::vector<std::complex<float> > in = test_frame(kind, shape.in_len, 2);
+      std::unique_ptr<KLT> ref(make_klt(shape, KLT::ACORR_DIRECT));
+      std::unique_ptr<KLT> fft(make_klt(shape, KLT::ACORR_FFT));
+      CHECK(fft->acorr_fft());
+      CHECK(!ref->acorr_fft());
+      ref->transform(&in[0]);
+      fft->transform(&in[0]);
+      const TestOutputs out = test_outputs(*fft, shape.acm_order, shape.num_eig);
+      check_transform(&in[0], shape.in_len, shape.acm_order, shape.num_eig, out, true, 1.0e-3);
+      check_same(&in[0], shape.in_len, shape.acm_order, shape.num_eig, out,
+                 test_outputs(*ref, shape.acm_order, shape.num_eig), 1.0e-3);
+    }
+  }
+}
+
+TEST_CASE("acorr: auto selection picks FFT for long frames only")
+{
+  std::unique_ptr<KLT> small(make_klt(64, 8, 1));
+  std::unique_ptr<KLT> large(make_klt(1 << 16, 512, 4));
+  CHECK(!small->acorr_fft());
+  CHECK(large->acorr_fft());
+}
@@ -0,0 +1,172 @@
+// Karhunen-Loève Transform Library
+// Buffer arena layout and block pool
+
+#include "klt_test.hh"
+#include "klt.hh"
+#include "klt_arena.hh"
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// Process-wide settings back to their defaults
+struct ArenaDefaults
+{
+  ~ArenaDefaults()
+  {
+    KLTArena::set_hugepages(false);
+    KLTArena::set_pool_limit(static_cast<size_t>(64) << 20);
+  }
+};
+
+bool aligned(const void* ptr)
+{
+  return reinterpret_cast<uintptr_t>(ptr) % KLTArena::ALIGN == 0;
+}
+
+// Adopted resources released
+int num_released = 0;
+
+void count_release(void*)
+{
+  num_released++;
+}
+
+}
+
+
+TEST_CASE("arena: buffers on their own aligned lines")
+{
+  KLTArena arena;
+  const size_t sizes[] = {1, 128, 129, 7, 4000};
+  size_t offs[5];
+  for (int bidx=0; bidx < 5; bidx++) {
+    offs[bidx] = arena.reserve(sizes[bidx]);
+  }
+  CHECK(arena.size() == 128 + 128 + 256 + 128 + 4096);
+  arena.commit();
+  for (int bidx=0; bidx < 5; bidx++) {
+    char* buf = arena.ptr<char>(offs[bidx]);
+    CHECK(aligned(buf));
+    if (bidx > 0) {
+      CHECK(offs[bidx] >= offs[bidx-1] + sizes[bidx-1]);
+    }
+    memset(buf, bidx + 1, sizes[bidx]);
+  }
+  // No buffer overwrote another
+  for (int bidx=0; bidx < 5; bidx++) {
+    const char* buf = arena.ptr<char>(offs[bidx]);
+    for (size_t idx=0; idx < sizes[bidx]; idx++) {
+      REQUIRE(buf[idx] == bidx + 1);
+    }
+  }
+}
+
+TEST_CASE("arena: released blocks are reused by shape")
+{
+  ArenaDefaults defaults;
+  // A size no KLT in this process uses
+  const size_t bytes = 3 * KLTArena::ALIGN * 1001;
+  const size_t before = KLTArena::pool_bytes();
+  char* first;
+  {
+    KLTArena arena;
+    arena.reserve(bytes);
+    arena.commit();
+    first = arena.ptr<char>(0);
+  }
+  CHECK(KLTArena::pool_bytes() == before + bytes);
+  {
+    KLTArena arena;
+    arena.reserve(bytes);
+    arena.commit();
+    CHECK(arena.ptr<char>(0) == first);
+    CHECK(KLTArena::pool_bytes() == before);
+  }
+  // Over the limit, released blocks go back to the system
+  KLTArena::set_pool_limit(0);
+  CHECK(KLTArena::pool_bytes() == 0);
+  {
+    KLTArena arena;
+    arena.reserve(bytes);
+    arena.commit();
+  }
+  CHECK(KLTArena::pool_bytes() == 0);
+}
+
+TEST_CASE("arena: hugepage slabs")
+{
+  ArenaDefaults defaults;
+  KLTArena::set_hugepages(true);
+  const size_t before = KLTArena::pool_bytes();
+  {
+    KLTArena small_a;
+    KLTArena small_b;
+    small_a.reserve(5 * KLTArena::ALIGN + 1);
+    small_b.reserve(5 * KLTArena::ALIGN + 1);
+    small_a.commit();
+    small_b.commit();
+    CHECK(aligned(small_a.ptr<char>(0)));
+    CHECK(aligned(small_b.ptr<char>(0)));
+    // Carved one after the other from the same slab
+    CHECK(small_b.ptr<char>(0) == small_a.ptr<char>(0) + small_a.size());
+    memset(small_a.ptr<char>(0), 1, small_a.size());
+    memset(small_b.ptr<char>(0), 2, small_b.size());
+  }
+  // Slab blocks are kept, and count to the limit
+  CHECK(KLTArena::pool_bytes() == before + 2 * 6 * KLTArena::ALIGN);
+  // Over it, new blocks come from the system allocator (and go back to it)
+  KLTArena::set_pool_limit(0);
+  const size_t kept = KLTArena::pool_bytes();
+  {
+    KLTArena arena;
+    arena.reserve(7 * KLTArena::ALIGN);
+    arena.commit();
+    CHECK(aligned(arena.ptr<char>(0)));
+  }
+  CHECK(KLTArena::pool_bytes() == kept);
+  KLTArena::set_pool_limit(static_cast<size_t>(64) << 20);
+
+  // KLTs on slab memory
+  const std::vector<std::complex<float> > in = test_frame(FRAME_NOISE, 256, 120);
+  for (int kidx=0; kidx < 3; kidx++) {
+    KLT klt(256,
+#if KLT_SUPPORT_EVALN
+            0,
+#endif
+            48, 3);
+    klt.transform(&in[0]);
+    check_transform(&in[0], 256, 48, 3, test_outputs(klt, 48, 3), true, 1.0e-3);
+  }
+}
+
+TEST_CASE("arena: separate buffers go with their owner")
+{
+  static int tokens[3];
+  num_released = 0;
+  {
+    KLTBuffers bufs;
+    std::complex<float>* buf = NULL;
+    bufs.alloc(buf, 1000, "buf");
+    CHECK(aligned(buf));
+    memset(buf, 0, 1000 * sizeof(std::complex<float>));
+    // Reallocation replaces the buffer
+    bufs.alloc(buf, 2000, "buf");
+    CHECK(aligned(buf));
+    memset(buf, 0, 2000 * sizeof(std::complex<float>));
+    int* first = &tokens[0];
+    int* second = &tokens[1];
+    int* third = NULL;
+    bufs.adopt(first, count_release);
+    bufs.adopt(second, count_release);
+    bufs.adopt(third, count_release);
+    bufs.release(first);
+    CHECK(first == NULL);
+    CHECK(num_released == 1);
+    bufs.release(first);
+    CHECK(num_released == 1);
+  }
+  // The rest on destruction (NULL never held)
+  CHECK(num_released == 2);
+}
@@ -0,0 +1,86 @@
+// Karhunen-Loève Transform Library
+// Multi-channel transform against an explicit block covariance
+
+#include "klt_test.hh"
+#include "klt_array.hh"
+
+namespace {
+
+// Explicit block covariance (row major), snapshots every step-th sample
+std::vector<std::complex<double> > ref_cov(const std::vector<std::complex<float> >& in,
+                                           int in_len, int num_chan, int num_lags, int step)
+{
+  const int dim = num_chan * num_lags;
+  std::vector<std::complex<double> > cov(static_cast<size_t>(dim) * dim);
+  for (int sidx=0; sidx + num_lags <= in_len; sidx += step) {
+    const std::complex<float>* x = &in[static_cast<size_t>(sidx) * num_chan];
+    for (int row=0; row < dim; row++) {
+      for (int col=0; col < dim; col++) {
+        cov[static_cast<size_t>(row)*dim + col] +=
+          std::complex<double>(x[row]) * std::conj(std::complex<double>(x[col]));
+      }
+    }
+  }
+  return cov;
+}
+
+void check_array(const std::vector<std::complex<float> >& in, int in_len, int num_chan,
+                 int num_lags, int num_eig, int step)
+{
+  const int dim = num_chan * num_lags;
+  KLTArray klt(in_len, num_chan, num_lags, num_eig);
+  CHECK(klt.dim() == dim);
+  if (step != 1) {
+    klt.set_snapshot_step(step);
+  }
+  klt.transform(&in[0]);
+  const std::vector<std::complex<double> > cov = ref_cov(in, in_len, num_chan, num_lags, step);
+  check_hermitian(cov, dim, &in[0], num_eig, klt.eval_buf, klt.kltc_buf, klt.kltb_buf, 1.0e-3);
+}
+
+// Channels of a common source with per-channel delays, plus noise
+std::vector<std::complex<float> > array_input(int in_len, int num_chan, unsigned seed)
+{
+  const std::vector<std::complex<float> > src = test_frame(FRAME_TONES, in_len + num_chan, seed);
+  const std::vector<std::complex<float> > noise =
+    test_frame(FRAME_NOISE, in_len * num_chan, seed + 1);
+  std::vector<std::complex<float> > in(static_cast<size_t>(in_len) * num_chan);
+  for (int tidx=0; tidx < in_len; tidx++) {
+    for (int cidx=0; cidx < num_chan; cidx++) {
+      in[tidx*num_chan + cidx] = src[tidx + cidx] + 0.1f * noise[tidx*num_chan + cidx];
+    }
+  }
+  return in;
+}
+
+}
+
+
+TEST_CASE("array: eigenpairs of the block covariance")
+{
+  // More snapshots than one SNAP_BLOCK, and a partial last block
+  check_array(array_input(300, 4, 130), 300, 4, 5, 3, 1);
+  check_array(array_input(64, 3, 131), 64, 3, 8, 4, 1);
+  // One channel: the (non-Toeplitz) sample covariance of one signal
+  check_array(array_input(200, 1, 132), 200, 1, 16, 2, 1);
+}
+
+TEST_CASE("array: snapshot step")
+{
+  check_array(array_input(1000, 2, 133), 1000, 2, 6, 2, 3);
+  check_array(array_input(1000, 2, 133), 1000, 2, 6, 2, 7);
+}
+
+TEST_CASE("array: zero input and invalid step")
+{
+  const int in_len = 50;
+  std::vector<std::complex<float> > in(static_cast<size_t>(in_len) * 2);
+  KLTArray klt(in_len, 2, 4, 2);
+  klt.transform(&in[0]);
+  for (int eidx=0; eidx < 2; eidx++) {
+    CHECK(klt.eval_buf[eidx] == 0.0f);
+    CHECK(klt.kltc_buf[eidx] == std::complex<float>(0.0f, 0.0f));
+  }
+  CHECK_THROWS(klt.set_snapshot_step(0));
+  CHECK_THROWS(klt.set_snapshot_step(in_len));
+}
@@ -0,0 +1,201 @@
+// Karhunen-Loève Transform Library
+// Batched transform against single-frame transforms
+
+#include "klt_test.hh"
+#include "klt.hh"
+#include "klt_batch.hh"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+const int IN_LEN = 256;
+const int ACM_ORDER = 48;
+const int NUM_EIG = 4;
+const int NUM_FRAMES = 37;
+
+const int LANES_ORDER = 16;
+const int LANES_EIG = 3;
+
+// Every test frame kind in turn, different seeds
+std::vector<std::complex<float> > batch_frames(int in_len = IN_LEN)
+{
+  const int num_kinds = sizeof(ALL_FRAMES) / sizeof(ALL_FRAMES[0]);
+  std::vector<std::complex<float> > in(static_cast<size_t>(NUM_FRAMES) * in_len);
+  for (int fidx=0; fidx < NUM_FRAMES; fidx++) {
+    const std::vector<std::complex<float> > frame =
+      test_frame(ALL_FRAMES[fidx % num_kinds], in_len, 100 + fidx);
+    std::copy(frame.begin(), frame.end(), in.begin() + static_cast<size_t>(fidx) * in_len);
+  }
+  return in;
+}
+
+}
+
+
+TEST_CASE("batch: frames match single transforms")
+{
+  const std::vector<std::complex<float> > in = batch_frames();
+  KLTBatch batch(IN_LEN,
+#if KLT_SUPPORT_EVALN
+                 0,
+#endif
+                 ACM_ORDER, NUM_EIG, 3);
+  CHECK(!batch.lanes());
+  std::vector<float> eval(NUM_FRAMES * NUM_EIG);
+  std::vector<std::complex<float> > kltc(NUM_FRAMES * NUM_EIG);
+  std::vector<std::complex<float> > kltb(NUM_FRAMES * ACM_ORDER * NUM_EIG);
+  std::vector<int> order(NUM_FRAMES, -1);
+  batch.transform(&in[0], NUM_FRAMES, &eval[0], &kltc[0], &kltb[0], &order[0]);
+
+  KLT klt(IN_LEN,
+#if KLT_SUPPORT_EVALN
+          0,
+#endif
+          ACM_ORDER, NUM_EIG);
+  for (int fidx=0; fidx < NUM_FRAMES; fidx++) {
+    const std::complex<float>* frame = &in[static_cast<size_t>(fidx) * IN_LEN];
+    klt.transform(frame);
+    TestOutputs out;
+    out.eval.assign(&eval[fidx * NUM_EIG], &eval[(fidx + 1) * NUM_EIG]);
+    out.kltc.assign(&kltc[fidx * NUM_EIG], &kltc[(fidx + 1) * NUM_EIG]);
+    out.kltb.assign(&kltb[fidx * ACM_ORDER * NUM_EIG], &kltb[(fidx + 1) * ACM_ORDER * NUM_EIG]);
+    check_transform(frame, IN_LEN, ACM_ORDER, NUM_EIG, out, true, 1.0e-3);
+    check_same(frame, IN_LEN, ACM_ORDER, NUM_EIG, out, test_outputs(klt, ACM_ORDER, NUM_EIG),
+               1.0e-3);
+    CHECK(order[fidx] == NUM_EIG);
+  }
+}
+
+TEST_CASE("batch: selected outputs and model order")
+{
+  const std::vector<std::complex<float> > in = batch_frames();
+  KLTBatch batch(IN_LEN,
+#if KLT_SUPPORT_EVALN
+                 0,
+#endif
+                 ACM_ORDER, NUM_EIG, 2);
+  batch.set_outputs(KLT::OUT_EVAL);
+  batch.set_model_order(KLT::ORDER_ENERGY, 0.5f);
+  std::vector<float> eval(NUM_FRAMES * NUM_EIG);
+  std::vector<int> order(NUM_FRAMES, -1);
+  // Outputs not selected may be NULL
+  batch.transform(&in[0], NUM_FRAMES, &eval[0], NULL, NULL, &order[0]);
+
+  KLT klt(IN_LEN,
+#if KLT_SUPPORT_EVALN
+          0,
+#endif
+          ACM_ORDER, NUM_EIG);
+  klt.set_outputs(KLT::OUT_EVAL);
+  klt.set_model_order(KLT::ORDER_ENERGY, 0.5f);
+  for (int fidx=0; fidx < NUM_FRAMES; fidx++) {
+    klt.transform(&in[static_cast<size_t>(fidx) * IN_LEN]);
+    for (int eidx=0; eidx < NUM_EIG; eidx++) {
+      CHECK(eval[fidx * NUM_EIG + eidx] == klt.eval_buf[eidx]);
+    }
+    CHECK(order[fidx] == klt.model_order());
+  }
+  CHECK_THROWS(batch.set_outputs(KLT::OUT_KLTS));
+}
+
+TEST_CASE("batch: lane-parallel frames match single transforms")
+{
+  const std::vector<std::complex<float> > in = batch_frames(IN_LEN);
+  KLTBatch batch(IN_LEN,
+#if KLT_SUPPORT_EVALN
+                 0,
+#endif
+                 LANES_ORDER, LANES_EIG, 2);
+  REQUIRE(batch.lanes());
+  std::vector<float> eval(NUM_FRAMES * LANES_EIG);
+  std::vector<std::complex<float> > kltc(NUM_FRAMES * LANES_EIG);
+  std::vector<std::complex<float> > kltb(NUM_FRAMES * LANES_ORDER * LANES_EIG);
+  std::vector<int> order(NUM_FRAMES, -1);
+  batch.transform(&in[0], NUM_FRAMES, &eval[0], &kltc[0], &kltb[0], &order[0]);
+
+  KLT klt(IN_LEN,
+#if KLT_SUPPORT_EVALN
+          0,
+#endif
+          LANES_ORDER, LANES_EIG);
+  const int kltb_size = LANES_ORDER * LANES_EIG;
+  for (int fidx=0; fidx < NUM_FRAMES; fidx++) {
+    const std::complex<float>* frame = &in[static_cast<size_t>(fidx) * IN_LEN];
+    klt.transform(frame);
+    TestOutputs out;
+    out.eval.assign(&eval[fidx * LANES_EIG], &eval[(fidx + 1) * LANES_EIG]);
+    out.kltc.assign(&kltc[fidx * LANES_EIG], &kltc[(fidx + 1) * LANES_EIG]);
+    out.kltb.assign(&kltb[fidx * kltb_size], &kltb[(fidx + 1) * kltb_size]);
+    check_transform(frame, IN_LEN, LANES_ORDER, LANES_EIG, out, true, 1.0e-3);
+    check_same(frame, IN_LEN, LANES_ORDER, LANES_EIG, out,
+               test_outputs(klt, LANES_ORDER, LANES_EIG), 1.0e-3);
+    CHECK(order[fidx] == LANES_EIG);
+  }
+}
+
+TEST_CASE("batch: lane-parallel failed frames get order 0")
+{
+  std::vector<std::complex<float> > in = batch_frames(IN_LEN);
+  const int bad[] = {3, 20, NUM_FRAMES - 1};
+  for (int fidx : bad) {
+    in[static_cast<size_t>(fidx) * IN_LEN + 5] =
+      std::complex<float>(std::numeric_limits<float>::quiet_NaN(), 0.0f);
+  }
+  KLTBatch batch(IN_LEN,
+#if KLT_SUPPORT_EVALN
+                 0,
+#endif
+                 LANES_ORDER, LANES_EIG, 2);
+  REQUIRE(batch.lanes());
+  std::vector<float> eval(NUM_FRAMES * LANES_EIG);
+  std::vector<std::complex<float> > kltc(NUM_FRAMES * LANES_EIG);
+  std::vector<std::complex<float> > kltb(NUM_FRAMES * LANES_ORDER * LANES_EIG);
+  std::vector<int> order(NUM_FRAMES, -1);
+  CHECK_THROWS(batch.transform(&in[0], NUM_FRAMES, &eval[0], &kltc[0], &kltb[0], &order[0]));
+  for (int fidx=0; fidx < NUM_FRAMES; fidx++) {
+    const bool failed = std::find(bad, bad + 3, fidx) != bad + 3;
+    CHECK(order[fidx] == (failed ? 0 : LANES_EIG));
+    if (failed) {
+      CHECK(eval[fidx * LANES_EIG] == 0.0f);
+      CHECK(kltc[fidx * LANES_EIG] == std::complex<float>(0.0f, 0.0f));
+    }
+  }
+}
+
+TEST_CASE("batch: refined eigenvalues bypass the lanes")
+{
+  KLTBatch batch(IN_LEN,
+#if KLT_SUPPORT_EVALN
+                 0,
+#endif
+                 LANES_ORDER, LANES_EIG, 2);
+  REQUIRE(batch.lanes());
+  batch.set_precision(KLT::PREC_SINGLE, true);
+  CHECK(!batch.lanes());
+  batch.set_precision(KLT::PREC_MIXED, true);
+  CHECK(!batch.lanes());
+  batch.set_precision(KLT::PREC_SINGLE, false);
+  CHECK(batch.lanes());
+}
+
+#if KLT_SUPPORT_EVALN
+TEST_CASE("batch: normalized eigenvalues bypass the lanes")
+{
+  const std::vector<std::complex<float> > in = batch_frames(IN_LEN);
+  KLTBatch batch(IN_LEN, 1, LANES_ORDER, LANES_EIG, 2);
+  CHECK(!batch.lanes());
+  std::vector<float> eval(NUM_FRAMES * LANES_EIG);
+  std::vector<std::complex<float> > kltc(NUM_FRAMES * LANES_EIG);
+  std::vector<std::complex<float> > kltb(NUM_FRAMES * LANES_ORDER * LANES_EIG);
+  batch.transform(&in[0], NUM_FRAMES, &eval[0], &kltc[0], &kltb[0]);
+  KLT klt(IN_LEN, 1, LANES_ORDER, LANES_EIG);
+  for (int fidx=0; fidx < NUM_FRAMES; fidx++) {
+    klt.transform(&in[static_cast<size_t>(fidx) * IN_LEN]);
+    for (int eidx=0; eidx < LANES_EIG; eidx++) {
+      CHECK(eval[fidx * LANES_EIG + eidx] == klt.eval_buf[eidx]);
+    }
+  }
+}
+#endif
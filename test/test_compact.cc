@@ -0,0 +1,233 @@
+// Karhunen-Loève Transform Library
+// Canonical eigenvector phase and the compact stream round trip
+
+#include "klt_test.hh"
+#include "klt.hh"
+#include "klt_compact.hh"
+#include "klt_siggen.hh"
+
+#include <cmath>
+
+namespace {
+
+const int IN_LEN = 256;
+const int ACM_ORDER = 24;
+const int NUM_EIG = 3;
+const int NUM_FRAMES = 40;
+
+KLT* make_klt(int outputs, bool canonical)
+{
+  KLT* klt = ::make_klt(IN_LEN, ACM_ORDER, NUM_EIG);
+  klt->set_outputs(outputs);
+  klt->set_canonical_phase(canonical);
+  return klt;
+}
+
+// Consecutive frames of two slowly drifting tones in noise, so the subspace
+// changes little from frame to frame
+std::vector<std::complex<float> > compact_signal()
+{
+  KLTSigGen gen(25);
+  gen.add_chirp(0.05, 0.07, NUM_FRAMES * IN_LEN, 1.0f);
+  gen.add_tone(-0.2, 0.6f);
+  gen.add_noise(0.05f);
+  std::vector<std::complex<float> > in(static_cast<size_t>(NUM_FRAMES) * IN_LEN);
+  gen.generate(&in[0], in.size());
+  return in;
+}
+
+// Per-frame outputs of a canonical-phase KLT without OUT_KLTB
+struct CompactFrames
+{
+  std::vector<TestOutputs> frames;
+
+  CompactFrames()
+  {
+    const std::vector<std::complex<float> > in = compact_signal();
+    std::unique_ptr<KLT> klt(make_klt(KLT::OUT_EVAL | KLT::OUT_KLTC, true));
+    for (int fidx=0; fidx < NUM_FRAMES; fidx++) {
+      klt->transform(&in[static_cast<size_t>(fidx) * IN_LEN]);
+      frames.push_back(test_outputs(*klt, ACM_ORDER, NUM_EIG));
+    }
+  }
+};
+
+std::vector<uint8_t> encode_all(const CompactFrames& ref, int quant_bits, int key_interval)
+{
+  KLTCompactWriter writer(ACM_ORDER, NUM_EIG, quant_bits, key_interval);
+  std::vector<uint8_t> stream;
+  for (const TestOutputs& out : ref.frames) {
+    writer.encode(&out.eval[0], &out.kltc[0], &out.kltb[0]);
+    stream.insert(stream.end(), writer.data(), writer.data() + writer.size());
+  }
+  CHECK(writer.frames() == NUM_FRAMES);
+  return stream;
+}
+
+// Decoded frame against the encoded one: eigenvalues and coeffs exact,
+// basis within tol, kltb its weighting
+void check_frame(KLTCompactReader& reader, const TestOutputs& ref, double tol)
+{
+  for (int eidx=0; eidx < NUM_EIG; eidx++) {
+    CHECK(reader.eval_buf[eidx] == ref.eval[eidx]);
+    CHECK(reader.kltc_buf[eidx] == ref.kltc[eidx]);
+  }
+  for (int bidx=0; bidx < ACM_ORDER * NUM_EIG; bidx++) {
+    if (tol == 0.0) {
+      CHECK(reader.basis_buf[bidx] == ref.kltb[bidx]);
+    } else {
+      CHECK_NEAR(reader.basis_buf[bidx].real(), ref.kltb[bidx].real(), tol);
+      CHECK_NEAR(reader.basis_buf[bidx].imag(), ref.kltb[bidx].imag(), tol);
+    }
+  }
+  std::vector<std::complex<float> > kltb(ACM_ORDER * NUM_EIG);
+  klt_weight_basis(&reader.basis_buf[0], &reader.kltc_buf[0], ACM_ORDER, NUM_EIG, &kltb[0]);
+  const std::complex<float>* out = reader.kltb();
+  for (int bidx=0; bidx < ACM_ORDER * NUM_EIG; bidx++) {
+    CHECK(out[bidx] == kltb[bidx]);
+  }
+}
+
+}
+
+
+TEST_CASE("compact: canonical phase keeps the weighted basis")
+{
+  for (TestFrame kind : ALL_FRAMES) {
+    const std::vector<std::complex<float> > frame = test_frame(kind, IN_LEN, 50);
+    std::unique_ptr<KLT> plain(make_klt(KLT::OUT_ALL, false));
+    std::unique_ptr<KLT> canon(make_klt(KLT::OUT_ALL, true));
+    std::unique_ptr<KLT> basis(make_klt(KLT::OUT_EVAL | KLT::OUT_KLTC, true));
+    CHECK(canon->canonical_phase());
+    CHECK(!canon->small_kernel());
+    plain->transform(&frame[0]);
+    canon->transform(&frame[0]);
+    basis->transform(&frame[0]);
+    check_transform(&frame[0], IN_LEN, ACM_ORDER, NUM_EIG,
+                    test_outputs(*basis, ACM_ORDER, NUM_EIG), false, 1.0e-3);
+    check_same(&frame[0], IN_LEN, ACM_ORDER, NUM_EIG, test_outputs(*canon, ACM_ORDER, NUM_EIG),
+               test_outputs(*plain, ACM_ORDER, NUM_EIG), 1.0e-3);
+    // Pivot real and positive: the first component, the largest if the
+    // first is negligible
+    for (int eidx=0; eidx < NUM_EIG; eidx++) {
+      const std::complex<float>* vec = &basis->kltb_buf[eidx * ACM_ORDER];
+      int pivot = 0;
+      if (std::abs(vec[0]) < 1.0e-3f) {
+        for (int vidx=1; vidx < ACM_ORDER; vidx++) {
+          if (std::norm(vec[vidx]) > std::norm(vec[pivot])) {
+            pivot = vidx;
+          }
+        }
+      }
+      CHECK(vec[pivot].imag() == 0.0f);
+      CHECK(vec[pivot].real() > 0.0f);
+    }
+    // The basis weighted again is the weighted output
+    std::vector<std::complex<float> > kltb(ACM_ORDER * NUM_EIG);
+    klt_weight_basis(basis->kltb_buf, basis->kltc_buf, ACM_ORDER, NUM_EIG, &kltb[0]);
+    for (int bidx=0; bidx < ACM_ORDER * NUM_EIG; bidx++) {
+      CHECK_NEAR(std::abs(kltb[bidx] - canon->kltb_buf[bidx]), 0.0,
+                 1.0e-5 * std::abs(canon->kltc_buf[bidx / ACM_ORDER]));
+    }
+  }
+}
+
+TEST_CASE("compact: lossless round trip")
+{
+  const CompactFrames ref;
+  for (int key_interval : {0, 1, 7}) {
+    const std::vector<uint8_t> stream = encode_all(ref, 0, key_interval);
+    KLTCompactReader reader(&stream[0], stream.size());
+    CHECK(reader.acm_order() == ACM_ORDER);
+    CHECK(reader.num_eig() == NUM_EIG);
+    CHECK(reader.quant_bits() == 0);
+    CHECK(reader.frames() == NUM_FRAMES);
+    CHECK(reader.frame() == -1);
+    for (int fidx=0; fidx < NUM_FRAMES; fidx++) {
+      REQUIRE(reader.next());
+      CHECK(reader.frame() == fidx);
+      check_frame(reader, ref.frames[fidx], 0.0);
+    }
+    CHECK(!reader.next());
+  }
+}
+
+TEST_CASE("compact: quantized round trip")
+{
+  const CompactFrames ref;
+  const size_t raw_len = static_cast<size_t>(NUM_FRAMES) * ACM_ORDER * NUM_EIG *
+    sizeof(std::complex<float>);
+  for (int quant_bits : {8, 16, 24}) {
+    const std::vector<uint8_t> stream = encode_all(ref, quant_bits, 0);
+    // Delta coded basis well below the raw floats
+    CHECK(stream.size() < raw_len);
+    KLTCompactReader reader(&stream[0], stream.size());
+    CHECK(reader.quant_bits() == quant_bits);
+    // Half a step, and float rounding
+    const double tol = std::ldexp(1.0, -quant_bits - 1) + 1.0e-7;
+    for (int fidx=0; fidx < NUM_FRAMES; fidx++) {
+      REQUIRE(reader.next());
+      check_frame(reader, ref.frames[fidx], tol);
+    }
+    CHECK(!reader.next());
+  }
+}
+
+TEST_CASE("compact: seek matches sequential decoding")
+{
+  const CompactFrames ref;
+  for (int quant_bits : {0, 12}) {
+    for (int key_interval : {0, 5}) {
+      const std::vector<uint8_t> stream = encode_all(ref, quant_bits, key_interval);
+      KLTCompactReader seq(&stream[0], stream.size());
+      KLTCompactReader reader(&stream[0], stream.size());
+      std::vector<TestOutputs> decoded;
+      while (seq.next()) {
+        TestOutputs out;
+        out.eval = seq.eval_buf;
+        out.kltc = seq.kltc_buf;
+        out.kltb = seq.basis_buf;
+        decoded.push_back(out);
+      }
+      REQUIRE(static_cast<int>(decoded.size()) == NUM_FRAMES);
+      // Backwards, forwards and in jumps
+      const int seeks[] = {NUM_FRAMES - 1, 0, 13, 12, 6, 5, 4, 31, NUM_FRAMES - 1, 1};
+      for (int fidx : seeks) {
+        reader.seek(fidx);
+        REQUIRE(reader.next());
+        CHECK(reader.frame() == fidx);
+        check_frame(reader, decoded[fidx], 0.0);
+      }
+      reader.seek(NUM_FRAMES - 1);
+      CHECK(reader.next());
+      CHECK(!reader.next());
+      // To the end, then past it
+      reader.seek(NUM_FRAMES);
+      CHECK(!reader.next());
+      CHECK_THROWS(reader.seek(NUM_FRAMES + 1));
+      CHECK_THROWS(reader.seek(-1));
+    }
+  }
+}
+
+TEST_CASE("compact: invalid streams throw")
+{
+  CHECK_THROWS(KLTCompactWriter(ACM_ORDER, ACM_ORDER + 1, 0, 0));
+  CHECK_THROWS(KLTCompactWriter(ACM_ORDER, NUM_EIG, 25, 0));
+  CHECK_THROWS(KLTCompactWriter(ACM_ORDER, NUM_EIG, 0, -1));
+
+  const CompactFrames ref;
+  const std::vector<uint8_t> stream = encode_all(ref, 0, 0);
+  // Header only: no frames
+  KLTCompactReader empty(&stream[0], KLT_COMPACT_HDR_LEN);
+  CHECK(empty.frames() == 0);
+  CHECK(!empty.next());
+  CHECK_THROWS(KLTCompactReader(&stream[0], KLT_COMPACT_HDR_LEN - 1));
+  CHECK_THROWS(KLTCompactReader(&stream[0], stream.size() - 1));
+  std::vector<uint8_t> bad(stream);
+  bad[0] = 'X';
+  CHECK_THROWS(KLTCompactReader(&bad[0], bad.size()));
+  bad = stream;
+  bad[4] = KLT_COMPACT_VERSION + 1;
+  CHECK_THROWS(KLTCompactReader(&bad[0], bad.size()));
+}
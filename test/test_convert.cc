@@ -0,0 +1,110 @@
+// Karhunen-Loève Transform Library
+// Complex integer (CI/CB) input against float input
+
+#include "klt_test.hh"
+#include "klt.hh"
+#include "klt_simd.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+// Integer I/Q of a test frame at the given full scale, and the same samples
+// as floats times scale
+template <typename T>
+void int_frame(TestFrame kind, int in_len, unsigned seed, float full, float scale,
+               std::vector<T>& ints, std::vector<std::complex<float> >& floats)
+{
+  const std::vector<std::complex<float> > in = test_frame(kind, in_len, seed);
+  float peak = 0.0f;
+  for (const std::complex<float>& val : in) {
+    peak = std::max(peak, std::max(std::abs(val.real()), std::abs(val.imag())));
+  }
+  const float gain = peak > 0.0f ? full / peak : 0.0f;
+  ints.resize(2 * in_len);
+  floats.resize(in_len);
+  for (int sidx=0; sidx < in_len; sidx++) {
+    ints[2*sidx] = static_cast<T>(std::floor(in[sidx].real() * gain + 0.5f));
+    ints[2*sidx + 1] = static_cast<T>(std::floor(in[sidx].imag() * gain + 0.5f));
+    floats[sidx] = scale * std::complex<float>(ints[2*sidx], ints[2*sidx + 1]);
+  }
+}
+
+template <typename T>
+void check_convert(float full, int in_len, int acm_order, int num_eig, bool window)
+{
+  const float scale = 1.0f / full;
+  for (TestFrame kind : ALL_FRAMES) {
+    std::vector<T> ints;
+    std::vector<std::complex<float> > floats;
+    int_frame(kind, in_len, 160, full, scale, ints, floats);
+    std::unique_ptr<KLT> klt(make_klt(in_len, acm_order, num_eig));
+    std::unique_ptr<KLT> ref(make_klt(in_len, acm_order, num_eig));
+    if (window) {
+      klt->set_window(KLT::WIN_HANN);
+      ref->set_window(KLT::WIN_HANN);
+    }
+    klt->transform(&ints[0], scale);
+    ref->transform(&floats[0]);
+    const TestOutputs out = test_outputs(*klt, acm_order, num_eig);
+    check_same(&floats[0], in_len, acm_order, num_eig, out,
+               test_outputs(*ref, acm_order, num_eig), 1.0e-4);
+    if (!window) {
+      check_transform(&floats[0], in_len, acm_order, num_eig, out, true, 1.0e-3);
+    }
+  }
+}
+
+}
+
+
+TEST_CASE("convert: kernels for every tail length")
+{
+  std::vector<int16_t> ci(2 * 70);
+  std::vector<int8_t> cb(2 * 70);
+  std::vector<float> win(70);
+  const float* const wins[] = {NULL, &win[0]};
+  for (int idx=0; idx < 140; idx++) {
+    ci[idx] = static_cast<int16_t>(idx % 2 ? -32768 + 467 * idx : 32767 - 311 * idx);
+    cb[idx] = static_cast<int8_t>(idx % 2 ? -128 + 3 * idx : 127 - 5 * idx);
+  }
+  for (int idx=0; idx < 70; idx++) {
+    win[idx] = 0.25f + 0.01f * idx;
+  }
+  const float scale = 0.5f;
+  for (int len=0; len <= 70; len++) {
+    std::vector<std::complex<float> > out16(len + 1, std::complex<float>(7.0f, 7.0f));
+    std::vector<std::complex<float> > out8(len + 1, std::complex<float>(7.0f, 7.0f));
+    for (const float* w : wins) {
+      klt_cvt_ci16(&ci[0], w, scale, &out16[0], len);
+      klt_cvt_ci8(&cb[0], w, scale, &out8[0], len);
+      for (int idx=0; idx < len; idx++) {
+        const float g = scale * (w ? w[idx] : 1.0f);
+        CHECK_NEAR(out16[idx].real(), g * ci[2*idx], 1.0e-6 * std::abs(g * 32768.0f));
+        CHECK_NEAR(out16[idx].imag(), g * ci[2*idx + 1], 1.0e-6 * std::abs(g * 32768.0f));
+        CHECK_NEAR(out8[idx].real(), g * cb[2*idx], 1.0e-6 * std::abs(g * 128.0f));
+        CHECK_NEAR(out8[idx].imag(), g * cb[2*idx + 1], 1.0e-6 * std::abs(g * 128.0f));
+      }
+      // Nothing past len
+      CHECK(out16[len] == std::complex<float>(7.0f, 7.0f));
+      CHECK(out8[len] == std::complex<float>(7.0f, 7.0f));
+    }
+  }
+}
+
+TEST_CASE("convert: int16 frames match float frames")
+{
+  check_convert<int16_t>(30000.0f, 256, 48, 4, false);
+  check_convert<int16_t>(30000.0f, 256, 48, 4, true);
+  // Small kernel
+  check_convert<int16_t>(30000.0f, 100, 16, 2, false);
+}
+
+TEST_CASE("convert: int8 frames match float frames")
+{
+  check_convert<int8_t>(120.0f, 256, 48, 4, false);
+  check_convert<int8_t>(120.0f, 256, 48, 4, true);
+  check_convert<int8_t>(120.0f, 100, 16, 2, false);
+}
@@ -0,0 +1,148 @@
+// Karhunen-Loève Transform Library
+// Raw and BLUE file round trips
+
+#include "klt_test.hh"
+#include "klt_io.hh"
+
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+// Unique temp file, removed on scope exit
+struct TempFile
+{
+  std::string name;
+
+  TempFile()
+  {
+    char buf[] = "/tmp/klt_test_io_XXXXXX";
+    const int fd = mkstemp(buf);
+    REQUIRE(fd >= 0);
+    ::close(fd);
+    name = buf;
+  }
+
+  ~TempFile() { unlink(name.c_str()); }
+};
+
+}
+
+
+TEST_CASE("io: BLUE complex float round trip")
+{
+  const std::vector<std::complex<float> > data = test_frame(FRAME_NOISE, 1001, 70);
+  KLTBlueHeader hdr;
+  hdr.type = 2000;
+  hdr.subsize = 7;
+  hdr.xstart = 1.5;
+  hdr.xdelta = 0.25;
+  hdr.xunits = 1;
+  hdr.ystart = -3.0;
+  hdr.ydelta = 2.0;
+  hdr.yunits = 2;
+  TempFile tmp;
+  {
+    KLTOutFile out(tmp.name, true, hdr);
+    CHECK(out.open());
+    // Two writes, data_size must cover both
+    out.write(&data[0], 500 * sizeof(data[0]));
+    out.write(&data[500], 501 * sizeof(data[0]));
+    out.close();
+    CHECK(!out.open());
+  }
+  KLTInFile in(tmp.name);
+  CHECK(in.blue);
+  CHECK(in.hdr.type == 2000);
+  CHECK(in.hdr.format == "CF");
+  CHECK(in.hdr.subsize == 7);
+  CHECK(in.hdr.xstart == 1.5);
+  CHECK(in.hdr.xdelta == 0.25);
+  CHECK(in.hdr.xunits == 1);
+  CHECK(in.hdr.ystart == -3.0);
+  CHECK(in.hdr.ydelta == 2.0);
+  CHECK(in.hdr.yunits == 2);
+  REQUIRE(in.samples() == data.size());
+  CHECK(memcmp(in.cf_data(), &data[0], data.size() * sizeof(data[0])) == 0);
+  CHECK_THROWS(in.ci_data());
+  CHECK_THROWS(in.cb_data());
+}
+
+TEST_CASE("io: BLUE integer formats")
+{
+  std::vector<int16_t> ci(2 * 300);
+  std::vector<int8_t> cb(2 * 300);
+  for (size_t idx=0; idx < ci.size(); idx++) {
+    ci[idx] = static_cast<int16_t>(idx * 97 - 20000);
+    cb[idx] = static_cast<int8_t>(idx * 13 - 100);
+  }
+  TempFile ci_tmp;
+  TempFile cb_tmp;
+  {
+    KLTBlueHeader hdr;
+    hdr.format = "CI";
+    KLTOutFile out(ci_tmp.name, true, hdr);
+    out.write(&ci[0], ci.size() * sizeof(ci[0]));
+    out.close();
+    hdr.format = "CB";
+    KLTOutFile out_cb(cb_tmp.name, true, hdr);
+    out_cb.write(&cb[0], cb.size() * sizeof(cb[0]));
+    // Destructor closes and patches the header
+  }
+  KLTInFile in_ci(ci_tmp.name);
+  CHECK(in_ci.hdr.format == "CI");
+  REQUIRE(in_ci.samples() == 300);
+  CHECK(memcmp(in_ci.ci_data(), &ci[0], ci.size() * sizeof(ci[0])) == 0);
+  CHECK_THROWS(in_ci.cf_data());
+  KLTInFile in_cb(cb_tmp.name);
+  CHECK(in_cb.hdr.format == "CB");
+  REQUIRE(in_cb.samples() == 300);
+  CHECK(memcmp(in_cb.cb_data(), &cb[0], cb.size() * sizeof(cb[0])) == 0);
+}
+
+TEST_CASE("io: raw files")
+{
+  const std::vector<std::complex<float> > data = test_frame(FRAME_TONES, 257, 71);
+  TempFile tmp;
+  {
+    KLTOutFile out(tmp.name, false, KLTBlueHeader());
+    out.write(&data[0], data.size() * sizeof(data[0]));
+  }
+  KLTInFile in(tmp.name);
+  CHECK(!in.blue);
+  CHECK(in.data_len == data.size() * sizeof(data[0]));
+  REQUIRE(in.samples() == data.size());
+  CHECK(memcmp(in.cf_data(), &data[0], in.data_len) == 0);
+  // The same bytes as int16 I/Q once the format is set
+  in.hdr.format = "CI";
+  CHECK(in.samples() == data.size() * 2);
+  CHECK(static_cast<const void*>(in.ci_data()) == in.data);
+}
+
+TEST_CASE("io: unsupported BLUE format")
+{
+  KLTBlueHeader hdr;
+  hdr.format = "SD";
+  TempFile tmp;
+  {
+    KLTOutFile out(tmp.name, true, hdr);
+    const double data[4] = {1.0, 2.0, 3.0, 4.0};
+    out.write(data, sizeof(data));
+  }
+  const KLTInFile in(tmp.name);
+  CHECK(in.blue);
+  CHECK(in.hdr.format == "SD");
+  CHECK(in.data_len == 4 * sizeof(double));
+  CHECK_THROWS(in.cf_data());
+  CHECK_THROWS(in.samples());
+}
+
+TEST_CASE("io: unused and missing files")
+{
+  KLTOutFile none("", true, KLTBlueHeader());
+  CHECK(!none.open());
+  none.close();
+  CHECK_THROWS(KLTInFile("/nonexistent/klt_test_io"));
+  CHECK_THROWS(KLTOutFile("/nonexistent/klt_test_io", false, KLTBlueHeader()));
+}
@@ -0,0 +1,61 @@
+// Karhunen-Loève Transform Library
+// Lags-only storage: engine switches growing the packed matrix
+
+#include "klt_test.hh"
+#include "klt.hh"
+
+namespace {
+
+KLT* make_klt(int in_len, int acm_order, int num_eig, KLT::EigEngine engine)
+{
+  KLT* klt = ::make_klt(in_len, acm_order, num_eig);
+  klt->set_acorr_engine(KLT::ACORR_DIRECT);
+  klt->set_eig_engine(engine);
+  return klt;
+}
+
+}
+
+
+TEST_CASE("lags: engine switches between frames")
+{
+  // Lanczos keeps the lags only; switching to LAPACK grows ac_buf to the
+  // packed matrix, and switching back must still find the lags
+  const int in_len = 512;
+  const int acm_order = 64;
+  const int num_eig = 4;
+  const KLT::EigEngine engines[] = {KLT::EIG_LANCZOS, KLT::EIG_LAPACK, KLT::EIG_LANCZOS,
+                                    KLT::EIG_LAPACK};
+  std::unique_ptr<KLT> klt(make_klt(in_len, acm_order, num_eig, KLT::EIG_LANCZOS));
+  std::unique_ptr<KLT> ref(make_klt(in_len, acm_order, num_eig, KLT::EIG_LAPACK));
+  int seed = 50;
+  for (KLT::EigEngine engine : engines) {
+    klt->set_eig_engine(engine);
+    CHECK(klt->eig_lanczos() == (engine == KLT::EIG_LANCZOS));
+    for (TestFrame kind : ALL_FRAMES) {
+      const std::vector<std::complex<float> > in = test_frame(kind, in_len, seed++);
+      klt->transform(&in[0]);
+      ref->transform(&in[0]);
+      const TestOutputs out = test_outputs(*klt, acm_order, num_eig);
+      check_transform(&in[0], in_len, acm_order, num_eig, out, true, 1.0e-3);
+      check_same(&in[0], in_len, acm_order, num_eig, out,
+                 test_outputs(*ref, acm_order, num_eig), 1.0e-3);
+    }
+  }
+}
+
+TEST_CASE("lags: LAPACK from construction")
+{
+  // Packed matrix allocated up front, before any lags were computed
+  for (int acm_order : {1, 2, 7, 33}) {
+    const int in_len = 4 * acm_order + 5;
+    const int num_eig = std::min(acm_order, 3);
+    for (TestFrame kind : ALL_FRAMES) {
+      const std::vector<std::complex<float> > in = test_frame(kind, in_len, 60 + acm_order);
+      std::unique_ptr<KLT> klt(make_klt(in_len, acm_order, num_eig, KLT::EIG_LAPACK));
+      klt->transform(&in[0]);
+      check_transform(&in[0], in_len, acm_order, num_eig,
+                      test_outputs(*klt, acm_order, num_eig), true, 1.0e-3);
+    }
+  }
+}
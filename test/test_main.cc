@@ -0,0 +1,488 @@
+// Karhunen-Loève Transform Library
+// Unit test runner and shared reference comparisons (see klt_test.hh)
+
+#include "klt_test.hh"
+#include "klt.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+namespace {
+
+struct TestCase
+{
+  const char* name;
+  void (*fn)();
+};
+
+// Function-local, so registration from other translation units' static
+// initializers does not depend on their order
+std::vector<TestCase>& test_cases()
+{
+  static std::vector<TestCase> cases;
+  return cases;
+}
+
+int num_failed_checks = 0;
+
+// Thrown by REQUIRE to end the case
+struct TestAbort
+{
+};
+
+const double TWO_PI = 6.283185307179586;
+
+}
+
+
+int klt_test_register(const char* name, void (*fn)())
+{
+  TestCase tc = {name, fn};
+  test_cases().push_back(tc);
+  return static_cast<int>(test_cases().size());
+}
+
+void klt_test_fail(const char* file, int line, const std::string& what, bool fatal)
+{
+  std::cout << "   " << file << ":" << line << ": " << (fatal ? "REQUIRE" : "CHECK") <<
+    " failed: " << what << std::endl;
+  num_failed_checks++;
+  if (fatal) {
+    throw TestAbort();
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Test frames
+//---------------------------------------------------------------------------
+const char* test_frame_name(TestFrame kind)
+{
+  switch (kind) {
+  case FRAME_TONES: return "tones";
+  case FRAME_NOISE: return "noise";
+  case FRAME_ZERO: return "zero";
+  case FRAME_CONST: return "const";
+  case FRAME_IMPULSE: return "impulse";
+  case FRAME_PAIRS: return "pairs";
+  }
+  return "?";
+}
+
+std::vector<std::complex<float> > test_frame(TestFrame kind, int len, unsigned seed)
+{
+  std::vector<std::complex<float> > frame(len);
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> normal(0.0f, 1.0f);
+  switch (kind) {
+  case FRAME_TONES:
+    {
+      std::uniform_real_distribution<double> phase(0.0, TWO_PI);
+      const double freq[3] = {0.0625, -0.171875, 0.3};
+      const float amp[3] = {2.0f, 1.0f, 0.5f};
+      double ph[3];
+      for (int tidx=0; tidx < 3; tidx++) {
+        ph[tidx] = phase(rng);
+      }
+      for (int sidx=0; sidx < len; sidx++) {
+        std::complex<double> sum(0.1 * normal(rng), 0.1 * normal(rng));
+        for (int tidx=0; tidx < 3; tidx++) {
+          sum += static_cast<double>(amp[tidx]) * std::polar(1.0, TWO_PI * freq[tidx] * sidx + ph[tidx]);
+        }
+        frame[sidx] = std::complex<float>(sum);
+      }
+    }
+    break;
+  case FRAME_NOISE:
+    for (int sidx=0; sidx < len; sidx++) {
+      frame[sidx] = std::complex<float>(normal(rng), normal(rng));
+    }
+    break;
+  case FRAME_ZERO:
+    break;
+  case FRAME_CONST:
+    std::fill(frame.begin(), frame.end(), std::complex<float>(0.75f, -0.5f));
+    break;
+  case FRAME_IMPULSE:
+    frame[len/2] = std::complex<float>(3.0f, 1.0f);
+    break;
+  case FRAME_PAIRS:
+    frame[0] = std::complex<float>(2.0f, 0.0f);
+    frame[7] = std::complex<float>(1.0f, 1.0f);
+    break;
+  }
+  return frame;
+}
+
+std::vector<std::complex<float> > test_signal(int len, unsigned seed)
+{
+  return test_frame(FRAME_TONES, len, seed);
+}
+
+
+//---------------------------------------------------------------------------
+// Reference solution
+//---------------------------------------------------------------------------
+namespace {
+
+// Biased lags in double, r[k] = sum in[n+k] conj(in[n])
+std::vector<std::complex<double> > ref_lags(const std::complex<float>* in, int in_len,
+                                            int acm_order)
+{
+  std::vector<std::complex<double> > lags(acm_order);
+  for (int lidx=0; lidx < acm_order; lidx++) {
+    for (int sidx=0; sidx + lidx < in_len; sidx++) {
+      lags[lidx] += std::complex<double>(in[sidx + lidx]) * std::conj(std::complex<double>(in[sidx]));
+    }
+  }
+  return lags;
+}
+
+// Toeplitz matrix element T[row][col] (lags down the first column)
+std::complex<double> toeplitz(const std::vector<std::complex<double> >& lags, int row, int col)
+{
+  return row >= col ? lags[row - col] : std::conj(lags[col - row]);
+}
+
+// ||T x - lambda x||
+double residual(const std::vector<std::complex<double> >& lags, int acm_order,
+                const std::complex<float>* x, double lambda)
+{
+  double sum = 0.0;
+  for (int row=0; row < acm_order; row++) {
+    std::complex<double> y = -lambda * std::complex<double>(x[row]);
+    for (int col=0; col < acm_order; col++) {
+      y += toeplitz(lags, row, col) * std::complex<double>(x[col]);
+    }
+    sum += std::norm(y);
+  }
+  return std::sqrt(sum);
+}
+
+// sum x[i] conj(y[i]) in double
+std::complex<double> dotc(const std::complex<float>* x, const std::complex<float>* y, int len)
+{
+  std::complex<double> sum(0.0, 0.0);
+  for (int idx=0; idx < len; idx++) {
+    sum += std::complex<double>(x[idx]) * std::conj(std::complex<double>(y[idx]));
+  }
+  return sum;
+}
+
+double norm2(const std::complex<float>* x, int len)
+{
+  return std::sqrt(std::real(dotc(x, x, len)));
+}
+
+// Component indices by ascending eigenvalue
+std::vector<int> eval_order(const std::vector<float>& eval)
+{
+  std::vector<int> perm(eval.size());
+  for (size_t idx=0; idx < perm.size(); idx++) {
+    perm[idx] = static_cast<int>(idx);
+  }
+  std::stable_sort(perm.begin(), perm.end(), [&eval](int a, int b) { return eval[a] < eval[b]; });
+  return perm;
+}
+
+}
+
+std::vector<double> test_hermitian_eigenvalues(const std::vector<std::complex<double> >& herm,
+                                               int order)
+{
+  // Hermitian A = B + iC as the real symmetric [B -C; C B], whose spectrum
+  // is A's with every eigenvalue doubled; cyclic Jacobi on that
+  const int dim = 2*order;
+  std::vector<double> mat(static_cast<size_t>(dim) * dim);
+  for (int row=0; row < order; row++) {
+    for (int col=0; col < order; col++) {
+      const std::complex<double> elem = herm[static_cast<size_t>(row)*order + col];
+      mat[row*dim + col] = elem.real();
+      mat[(row + order)*dim + col + order] = elem.real();
+      mat[row*dim + col + order] = -elem.imag();
+      mat[(row + order)*dim + col] = elem.imag();
+    }
+  }
+  for (int sweep=0; sweep < 100; sweep++) {
+    double off = 0.0;
+    double diag = 0.0;
+    for (int row=0; row < dim; row++) {
+      diag += mat[row*dim + row] * mat[row*dim + row];
+      for (int col=row + 1; col < dim; col++) {
+        off += mat[row*dim + col] * mat[row*dim + col];
+      }
+    }
+    if (off <= 1.0e-30 * diag || off == 0.0) {
+      break;
+    }
+    for (int p=0; p < dim - 1; p++) {
+      for (int q=p + 1; q < dim; q++) {
+        const double apq = mat[p*dim + q];
+        if (apq == 0.0) {
+          continue;
+        }
+        const double theta = (mat[q*dim + q] - mat[p*dim + p]) / (2.0 * apq);
+        const double t = (theta >= 0.0 ? 1.0 : -1.0) /
+          (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+        const double c = 1.0 / std::sqrt(t * t + 1.0);
+        const double s = t * c;
+        for (int k=0; k < dim; k++) {
+          const double akp = mat[k*dim + p];
+          const double akq = mat[k*dim + q];
+          mat[k*dim + p] = c * akp - s * akq;
+          mat[k*dim + q] = s * akp + c * akq;
+        }
+        for (int k=0; k < dim; k++) {
+          const double apk = mat[p*dim + k];
+          const double aqk = mat[q*dim + k];
+          mat[p*dim + k] = c * apk - s * aqk;
+          mat[q*dim + k] = s * apk + c * aqk;
+        }
+      }
+    }
+  }
+  std::vector<double> doubled(dim);
+  for (int idx=0; idx < dim; idx++) {
+    doubled[idx] = mat[idx*dim + idx];
+  }
+  std::sort(doubled.begin(), doubled.end());
+  std::vector<double> eval(order);
+  for (int idx=0; idx < order; idx++) {
+    eval[idx] = 0.5 * (doubled[2*idx] + doubled[2*idx + 1]);
+  }
+  return eval;
+}
+
+std::vector<double> test_eigenvalues(const std::complex<float>* in, int in_len, int acm_order)
+{
+  const std::vector<std::complex<double> > lags = ref_lags(in, in_len, acm_order);
+  std::vector<std::complex<double> > mat(static_cast<size_t>(acm_order) * acm_order);
+  for (int row=0; row < acm_order; row++) {
+    for (int col=0; col < acm_order; col++) {
+      mat[static_cast<size_t>(row)*acm_order + col] = toeplitz(lags, row, col);
+    }
+  }
+  return test_hermitian_eigenvalues(mat, acm_order);
+}
+
+
+//---------------------------------------------------------------------------
+// Instances, output copies and comparisons
+//---------------------------------------------------------------------------
+KLT* make_klt(int in_len, int acm_order, int num_eig)
+{
+  return new KLT(in_len,
+#if KLT_SUPPORT_EVALN
+                 0,
+#endif
+                 acm_order, num_eig);
+}
+
+TestOutputs test_outputs(const KLT& klt, int acm_order, int num_eig)
+{
+  TestOutputs out;
+  out.eval.assign(klt.eval_buf, klt.eval_buf + num_eig);
+  if (klt.outputs() & KLT::OUT_KLTC) {
+    out.kltc.assign(klt.kltc_buf, klt.kltc_buf + num_eig);
+  }
+  if (klt.kltb_buf != NULL) {
+    out.kltb.assign(klt.kltb_buf, klt.kltb_buf + acm_order*num_eig);
+  }
+  return out;
+}
+
+void check_transform(const std::complex<float>* in, int in_len, int acm_order, int num_eig,
+                     const TestOutputs& out, bool weighted, double tol, int order)
+{
+  if (order < 0) {
+    order = num_eig;
+  }
+  REQUIRE(static_cast<int>(out.eval.size()) == num_eig);
+  const std::vector<double> ref = test_eigenvalues(in, in_len, acm_order);
+  const double scale = std::max(ref.back(), 1.0e-20);
+  const double head_norm = norm2(in, acm_order);
+  const std::vector<std::complex<double> > lags = ref_lags(in, in_len, acm_order);
+
+  // Eigenvalues: the top num_eig
+  const std::vector<int> perm = eval_order(out.eval);
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    CHECK_NEAR(out.eval[perm[eidx]], ref[acm_order - num_eig + eidx], tol * scale);
+  }
+
+  // Components solved: order of them, holding the largest eigenvalues
+  std::vector<bool> solved(num_eig, true);
+  if (!out.kltb.empty() && order < num_eig) {
+    int num_solved = 0;
+    for (int eidx=0; eidx < num_eig; eidx++) {
+      solved[eidx] = norm2(&out.kltb[eidx*acm_order], acm_order) > 0.0 ||
+        (!out.kltc.empty() && out.kltc[eidx] != std::complex<float>(0.0f, 0.0f));
+      num_solved += solved[eidx];
+    }
+    CHECK(num_solved <= order);
+    for (int eidx=0; eidx < num_eig; eidx++) {
+      for (int oidx=0; oidx < num_eig; oidx++) {
+        if (solved[eidx] && !solved[oidx]) {
+          CHECK(out.eval[eidx] >= out.eval[oidx] - tol * scale);
+        }
+      }
+    }
+  }
+
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    if (!solved[eidx]) {
+      if (!out.kltc.empty()) {
+        CHECK(out.kltc[eidx] == std::complex<float>(0.0f, 0.0f));
+      }
+      continue;
+    }
+    if (out.kltb.empty()) {
+      continue;
+    }
+    const std::complex<float>* vec = &out.kltb[eidx*acm_order];
+    const double vec_norm = norm2(vec, acm_order);
+    const double res = residual(lags, acm_order, vec, out.eval[eidx]);
+    if (weighted) {
+      // Eigenvector times its coeff c: head . conj(c v) = |c|^2.  The bounds
+      // are absolute (|c| <= |head|): a component the head barely projects
+      // onto has c at rounding level, and c v with it
+      CHECK_NEAR(res, 0.0, tol * scale * std::max(head_norm, 1.0e-20));
+      const std::complex<double> proj = dotc(in, vec, acm_order);
+      CHECK_NEAR(proj.real(), vec_norm * vec_norm, tol * head_norm * head_norm);
+      CHECK_NEAR(proj.imag(), 0.0, tol * head_norm * head_norm);
+      if (!out.kltc.empty()) {
+        CHECK_NEAR(std::abs(out.kltc[eidx]), vec_norm, tol * head_norm);
+      }
+    } else {
+      CHECK_NEAR(vec_norm, 1.0, tol);
+      CHECK_NEAR(res, 0.0, tol * scale);
+      if (!out.kltc.empty()) {
+        const std::complex<double> coeff = dotc(in, vec, acm_order);
+        CHECK_NEAR(std::abs(std::complex<double>(out.kltc[eidx]) - coeff), 0.0, tol * head_norm);
+      }
+    }
+    for (int oidx=0; oidx < eidx; oidx++) {
+      if (!solved[oidx]) {
+        continue;
+      }
+      const std::complex<float>* other = &out.kltb[oidx*acm_order];
+      const double bound = weighted ? head_norm * head_norm : 1.0;
+      CHECK_NEAR(std::abs(dotc(vec, other, acm_order)), 0.0, tol * bound);
+    }
+  }
+}
+
+void check_hermitian(const std::vector<std::complex<double> >& herm, int order,
+                     const std::complex<float>* head, int num_eig, const float* eval,
+                     const std::complex<float>* kltc, const std::complex<float>* kltb,
+                     double tol)
+{
+  const std::vector<double> ref = test_hermitian_eigenvalues(herm, order);
+  const double scale = std::max(ref.back(), 1.0e-20);
+  const double head_norm = norm2(head, order);
+  // The top num_eig, in any order
+  std::vector<float> sorted(eval, eval + num_eig);
+  std::sort(sorted.begin(), sorted.end());
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    CHECK_NEAR(sorted[eidx], ref[order - num_eig + eidx], tol * scale);
+  }
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    // Eigenvector times its coeff c: head . conj(c v) = |c|^2
+    const std::complex<float>* vec = &kltb[static_cast<size_t>(eidx) * order];
+    const double vec_norm = norm2(vec, order);
+    double res = 0.0;
+    for (int row=0; row < order; row++) {
+      std::complex<double> acc(0.0, 0.0);
+      for (int col=0; col < order; col++) {
+        acc += herm[static_cast<size_t>(row)*order + col] * std::complex<double>(vec[col]);
+      }
+      res += std::norm(acc - static_cast<double>(eval[eidx]) * std::complex<double>(vec[row]));
+    }
+    CHECK_NEAR(std::sqrt(res), 0.0, tol * scale * std::max(vec_norm, 1.0e-20));
+    const std::complex<double> proj = dotc(head, vec, order);
+    CHECK_NEAR(proj.real(), vec_norm * vec_norm, tol * head_norm * head_norm);
+    CHECK_NEAR(proj.imag(), 0.0, tol * head_norm * head_norm);
+    CHECK_NEAR(std::abs(kltc[eidx]), vec_norm, tol * head_norm);
+  }
+}
+
+void check_same(const std::complex<float>* in, int in_len, int acm_order, int num_eig,
+                const TestOutputs& out, const TestOutputs& ref, double tol)
+{
+  REQUIRE(static_cast<int>(out.eval.size()) == num_eig);
+  REQUIRE(static_cast<int>(ref.eval.size()) == num_eig);
+  const std::vector<double> full = test_eigenvalues(in, in_len, acm_order);
+  const double scale = std::max(full.back(), 1.0e-20);
+  const double head_norm = norm2(in, acm_order);
+  const std::vector<int> out_perm = eval_order(out.eval);
+  const std::vector<int> ref_perm = eval_order(ref.eval);
+  for (int eidx=0; eidx < num_eig; eidx++) {
+    CHECK_NEAR(out.eval[out_perm[eidx]], ref.eval[ref_perm[eidx]], tol * scale);
+  }
+  if (out.kltb.empty() || ref.kltb.empty()) {
+    return;
+  }
+
+  // Groups of (reference) eigenvalues equal to within tol
+  const double cut = acm_order > num_eig ? full[acm_order - num_eig - 1] : -1.0e30;
+  int first = 0;
+  while (first < num_eig) {
+    int last = first + 1;
+    while (last < num_eig &&
+           ref.eval[ref_perm[last]] - ref.eval[ref_perm[last - 1]] <= tol * scale) {
+      last++;
+    }
+    if (ref.eval[ref_perm[first]] - cut > tol * scale) {
+      std::vector<std::complex<float> > out_sum(acm_order);
+      std::vector<std::complex<float> > ref_sum(acm_order);
+      for (int gidx=first; gidx < last; gidx++) {
+        for (int tidx=0; tidx < acm_order; tidx++) {
+          out_sum[tidx] += out.kltb[out_perm[gidx]*acm_order + tidx];
+          ref_sum[tidx] += ref.kltb[ref_perm[gidx]*acm_order + tidx];
+        }
+      }
+      for (int tidx=0; tidx < acm_order; tidx++) {
+        out_sum[tidx] -= ref_sum[tidx];
+      }
+      CHECK_NEAR(norm2(&out_sum[0], acm_order), 0.0, tol * head_norm);
+    }
+    first = last;
+  }
+}
+
+
+//---------------------------------------------------------------------------
+// Run every case (or those whose name contains argv[1])
+//---------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  const char* filter = argc > 1 ? argv[1] : "";
+  int num_run = 0;
+  int num_failed = 0;
+  for (size_t cidx=0; cidx < test_cases().size(); cidx++) {
+    const TestCase& tc = test_cases()[cidx];
+    if (strstr(tc.name, filter) == NULL) {
+      continue;
+    }
+    const int failed_before = num_failed_checks;
+    try {
+      tc.fn();
+    } catch (const TestAbort&) {
+    } catch (const std::exception& err) {
+      std::cout << "   unexpected exception: " << err.what() << std::endl;
+      num_failed_checks++;
+    }
+    num_run++;
+    if (num_failed_checks != failed_before) {
+      std::cout << " ✗ " << tc.name << std::endl;
+      num_failed++;
+    } else {
+      std::cout << " ✓ " << tc.name << std::endl;
+    }
+  }
+  std::cout << std::endl << num_run - num_failed << "/" << num_run << " test cases passed" <<
+    std::endl;
+  return num_failed == 0 ? 0 : 1;
+}
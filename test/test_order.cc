@@ -0,0 +1,113 @@
+// Karhunen-Loève Transform Library
+// Adaptive model order and eigenvalue ordering
+
+#include "klt_test.hh"
+#include "klt.hh"
+#include "klt_siggen.hh"
+
+namespace {
+
+KLT* make_direct_klt(int in_len, int acm_order, int num_eig)
+{
+  KLT* klt = make_klt(in_len, acm_order, num_eig);
+  // Exact lags (the FFT's rounding would blur the splits below)
+  klt->set_acorr_engine(KLT::ACORR_DIRECT);
+  return klt;
+}
+
+}
+
+
+TEST_CASE("order: eigenvalues ascending when sstebz splits")
+{
+  // The impulse pair's tridiagonal form splits into blocks, each sorted on
+  // its own by sstebz
+  const std::vector<std::complex<float> > in = test_frame(FRAME_PAIRS, 64, 0);
+  std::unique_ptr<KLT> klt(make_direct_klt(64, 16, 6));
+  klt->set_eig_engine(KLT::EIG_LAPACK);
+  klt->transform(&in[0]);
+  for (int eidx=1; eidx < 6; eidx++) {
+    CHECK(klt->eval_buf[eidx-1] <= klt->eval_buf[eidx]);
+  }
+  check_transform(&in[0], 64, 16, 6, test_outputs(*klt, 16, 6), true, 1.0e-3);
+}
+
+TEST_CASE("order: energy rule keeps the top eigenvalues across splits")
+{
+  // Top six eigenvalues 10, 10, 8.83 x 4 of a trace of 96: 20% of it takes
+  // the two 10s
+  const std::vector<std::complex<float> > in = test_frame(FRAME_PAIRS, 64, 0);
+  for (int outputs : {static_cast<int>(KLT::OUT_ALL), KLT::OUT_EVAL | KLT::OUT_KLTC}) {
+    std::unique_ptr<KLT> klt(make_direct_klt(64, 16, 6));
+    klt->set_outputs(outputs);
+    klt->set_model_order(KLT::ORDER_ENERGY, 0.2f);
+    klt->transform(&in[0]);
+    CHECK(klt->model_order() == 2);
+    check_transform(&in[0], 64, 16, 6, test_outputs(*klt, 16, 6), outputs & KLT::OUT_KLTB,
+                    1.0e-3, klt->model_order());
+  }
+}
+
+TEST_CASE("order: MDL and AIC find the tones")
+{
+  // Two tones in noise, long frame
+  KLTSigGen gen(13);
+  gen.add_tone(0.1, 1.0f);
+  gen.add_tone(-0.23, 0.7f);
+  gen.add_noise(0.5f);
+  std::vector<std::complex<float> > in(4096);
+  gen.generate(&in[0], in.size());
+  for (KLT::OrderRule rule : {KLT::ORDER_MDL, KLT::ORDER_AIC}) {
+    std::unique_ptr<KLT> klt(make_direct_klt(4096, 16, 6));
+    klt->set_model_order(rule, 0.0f);
+    klt->transform(&in[0]);
+    // AIC is not consistent, it may overestimate
+    if (rule == KLT::ORDER_MDL) {
+      CHECK(klt->model_order() == 2);
+    } else {
+      CHECK(klt->model_order() >= 2);
+    }
+    check_transform(&in[0], 4096, 16, 6, test_outputs(*klt, 16, 6), true, 1.0e-3,
+                    klt->model_order());
+  }
+}
+
+TEST_CASE("order: energy rule on all test frames")
+{
+  for (TestFrame kind : ALL_FRAMES) {
+    const std::vector<std::complex<float> > in = test_frame(kind, 256, 12);
+    std::unique_ptr<KLT> klt(make_direct_klt(256, 32, 5));
+    klt->set_model_order(KLT::ORDER_ENERGY, 0.6f);
+    klt->transform(&in[0]);
+    CHECK(klt->model_order() >= 0);
+    CHECK(klt->model_order() <= 5);
+    check_transform(&in[0], 256, 32, 5, test_outputs(*klt, 32, 5), true, 1.0e-3,
+                    klt->model_order());
+  }
+}
+
+TEST_CASE("order: invalid energy fraction")
+{
+  std::unique_ptr<KLT> klt(make_direct_klt(64, 16, 2));
+  CHECK_THROWS(klt->set_model_order(KLT::ORDER_ENERGY, 0.0f));
+  CHECK_THROWS(klt->set_model_order(KLT::ORDER_ENERGY, 1.5f));
+}
+
+TEST_CASE("order: MDL counts the snapshots under COV_SNAPSHOT")
+{
+  // Short frame, long snapshots: the covariance averages 17 of them, and
+  // weighing it as 64 makes MDL take noise for signal
+  for (int seed : {1, 2, 3}) {
+    KLTSigGen gen(seed);
+    gen.add_tone(0.1, 1.0f);
+    gen.add_tone(-0.23, 0.7f);
+    gen.add_noise(0.5f);
+    std::vector<std::complex<float> > in(64);
+    gen.generate(&in[0], in.size());
+    std::unique_ptr<KLT> klt(make_direct_klt(64, 48, 6));
+    klt->set_covariance(KLT::COV_SNAPSHOT, false, 0.0f);
+    klt->set_model_order(KLT::ORDER_MDL, 0.0f);
+    klt->transform(&in[0]);
+    CHECK(klt->model_order() == 2);
+  }
+}
@@ -0,0 +1,122 @@
+// Karhunen-Loève Transform Library
+// Pipelined execution against sequential transforms
+
+#include "klt_test.hh"
+#include "klt.hh"
+#include "klt_pipeline.hh"
+
+#include <stdexcept>
+
+namespace {
+
+const int IN_LEN = 200;
+const int ACM_ORDER = 24;
+const int NUM_EIG = 3;
+const long NUM_FRAMES = 61;
+
+std::vector<std::complex<float> > pipeline_frames()
+{
+  const int num_kinds = sizeof(ALL_FRAMES) / sizeof(ALL_FRAMES[0]);
+  std::vector<std::complex<float> > in(static_cast<size_t>(NUM_FRAMES) * IN_LEN);
+  for (long fidx=0; fidx < NUM_FRAMES; fidx++) {
+    const std::vector<std::complex<float> > frame =
+      test_frame(ALL_FRAMES[fidx % num_kinds], IN_LEN, 200 + static_cast<int>(fidx));
+    std::copy(frame.begin(), frame.end(), in.begin() + fidx * IN_LEN);
+  }
+  return in;
+}
+
+}
+
+
+TEST_CASE("pipeline: outputs in order and equal to sequential transforms")
+{
+  const std::vector<std::complex<float> > in = pipeline_frames();
+  KLT ref(IN_LEN,
+#if KLT_SUPPORT_EVALN
+          0,
+#endif
+          ACM_ORDER, NUM_EIG);
+  for (int num_workers : {1, 3}) {
+    for (bool copy : {false, true}) {
+      KLTPipeline pipe(IN_LEN,
+#if KLT_SUPPORT_EVALN
+                       0,
+#endif
+                       ACM_ORDER, NUM_EIG, num_workers, 0);
+      CHECK(pipe.workers() == num_workers);
+      // Zero-copy pointers into the input, or copies into the slot buffer
+      const KLTPipeline::ReadFn read =
+        [&](long seq, std::complex<float>* buf) -> const std::complex<float>* {
+          if (seq >= NUM_FRAMES) {
+            return NULL;
+          }
+          const std::complex<float>* frame = &in[seq * IN_LEN];
+          if (!copy) {
+            return frame;
+          }
+          std::copy(frame, frame + IN_LEN, buf);
+          return buf;
+        };
+      long next = 0;
+      const KLTPipeline::WriteFn write =
+        [&](long seq, const float* eval, const std::complex<float>* kltc,
+            const std::complex<float>* kltb, const char* err) {
+          CHECK(seq == next);
+          CHECK(err == NULL);
+          next++;
+          ref.transform(&in[seq * IN_LEN]);
+          for (int eidx=0; eidx < NUM_EIG; eidx++) {
+            CHECK(eval[eidx] == ref.eval_buf[eidx]);
+            CHECK(kltc[eidx] == ref.kltc_buf[eidx]);
+          }
+          for (int bidx=0; bidx < ACM_ORDER * NUM_EIG; bidx++) {
+            CHECK(kltb[bidx] == ref.kltb_buf[bidx]);
+          }
+        };
+      pipe.run(read, write);
+      CHECK(next == NUM_FRAMES);
+      CHECK(pipe.reader_stats().frames == NUM_FRAMES);
+      CHECK(pipe.writer_stats().frames == NUM_FRAMES);
+      long worked = 0;
+      for (int widx=0; widx < num_workers; widx++) {
+        worked += pipe.worker_stats(widx).frames;
+      }
+      CHECK(worked == NUM_FRAMES);
+    }
+  }
+}
+
+TEST_CASE("pipeline: reader error stops the run")
+{
+  const std::vector<std::complex<float> > in = pipeline_frames();
+  KLTPipeline pipe(IN_LEN,
+#if KLT_SUPPORT_EVALN
+                   0,
+#endif
+                   ACM_ORDER, NUM_EIG, 2, 4);
+  long written = 0;
+  CHECK_THROWS(pipe.run(
+    [&](long seq, std::complex<float>*) -> const std::complex<float>* {
+      if (seq == 10) {
+        throw std::runtime_error("read failed");
+      }
+      return &in[seq * IN_LEN];
+    },
+    [&](long, const float*, const std::complex<float>*, const std::complex<float>*,
+        const char*) {
+      written++;
+    }));
+  CHECK(written <= 10);
+}
+
+TEST_CASE("pipeline: allocation failure throws")
+{
+  // The output slots cannot be allocated after the input slots were; they
+  // must be released (run under a leak checker to see it)
+  CHECK_THROWS(KLTPipeline(64,
+#if KLT_SUPPORT_EVALN
+                           0,
+#endif
+                           1 << 24, 4096, 1, 4096));
+}
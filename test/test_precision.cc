@@ -0,0 +1,102 @@
+// Karhunen-Loève Transform Library
+// Mixed-precision lags and eigenvalue refinement
+
+#include "klt_test.hh"
+#include "klt.hh"
+
+namespace {
+
+KLT* make_klt(int in_len, int acm_order, int num_eig, KLT::AcorrEngine engine)
+{
+  KLT* klt = ::make_klt(in_len, acm_order, num_eig);
+  klt->set_acorr_engine(engine);
+  return klt;
+}
+
+}
+
+
+TEST_CASE("precision: mixed matches single on the test frames")
+{
+  const int in_len = 256;
+  const int acm_order = 32;
+  const int num_eig = 4;
+  for (KLT::AcorrEngine engine : {KLT::ACORR_DIRECT, KLT::ACORR_FFT}) {
+    for (bool refine : {false, true}) {
+      for (TestFrame kind : ALL_FRAMES) {
+        const std::vector<std::complex<float> > in = test_frame(kind, in_len, 170);
+        std::unique_ptr<KLT> mixed(make_klt(in_len, acm_order, num_eig, engine));
+        std::unique_ptr<KLT> single(make_klt(in_len, acm_order, num_eig, engine));
+        mixed->set_precision(KLT::PREC_MIXED, refine);
+        CHECK(mixed->precision() == KLT::PREC_MIXED);
+        CHECK(!mixed->small_kernel());
+        mixed->transform(&in[0]);
+        single->transform(&in[0]);
+        const TestOutputs out = test_outputs(*mixed, acm_order, num_eig);
+        check_transform(&in[0], in_len, acm_order, num_eig, out, true, 1.0e-3);
+        check_same(&in[0], in_len, acm_order, num_eig, out,
+                   test_outputs(*single, acm_order, num_eig), 1.0e-3);
+      }
+    }
+  }
+}
+
+TEST_CASE("precision: long frame with a large offset")
+{
+  // Direct lag sums of 2^16 terms around 1e4: float accumulation rounds
+  // them, double lags round once, refinement gets the top eigenvalue to
+  // float rounding
+  const int in_len = 1 << 16;
+  const int acm_order = 16;
+  const int num_eig = 2;
+  std::vector<std::complex<float> > in = test_frame(FRAME_NOISE, in_len, 171);
+  for (std::complex<float>& val : in) {
+    val = std::complex<float>(100.0f, -50.0f) + 0.01f * val;
+  }
+  const std::vector<double> ref = test_eigenvalues(&in[0], in_len, acm_order);
+  std::unique_ptr<KLT> mixed(make_klt(in_len, acm_order, num_eig, KLT::ACORR_DIRECT));
+  std::unique_ptr<KLT> refined(make_klt(in_len, acm_order, num_eig, KLT::ACORR_DIRECT));
+  mixed->set_precision(KLT::PREC_MIXED, false);
+  refined->set_precision(KLT::PREC_MIXED, true);
+  mixed->transform(&in[0]);
+  refined->transform(&in[0]);
+  const double top = ref[acm_order - 1];
+  CHECK_NEAR(mixed->eval_buf[num_eig - 1], top, 1.0e-6 * top);
+  CHECK_NEAR(refined->eval_buf[num_eig - 1], top, 2.0e-7 * top);
+}
+
+TEST_CASE("precision: streaming double running sums")
+{
+  const int in_len = 512;
+  const int in_clen = 64;
+  const int acm_order = 24;
+  const int num_eig = 3;
+  const int num_frames = 40;
+  const std::vector<std::complex<float> > sig =
+    test_signal((num_frames - 1) * in_clen + in_len, 172);
+  std::unique_ptr<KLT> stream(make_klt(in_len, acm_order, num_eig, KLT::ACORR_DIRECT));
+  stream->set_precision(KLT::PREC_MIXED, false);
+  stream->set_stream(in_clen, 1000);
+  std::unique_ptr<KLT> scratch(make_klt(in_len, acm_order, num_eig, KLT::ACORR_DIRECT));
+  scratch->set_precision(KLT::PREC_MIXED, false);
+  for (int fidx=0; fidx < num_frames; fidx++) {
+    const std::complex<float>* frame = &sig[fidx * in_clen];
+    stream->transform(frame);
+    scratch->transform(frame);
+    check_same(frame, in_len, acm_order, num_eig, test_outputs(*stream, acm_order, num_eig),
+               test_outputs(*scratch, acm_order, num_eig), 1.0e-4);
+  }
+}
+
+TEST_CASE("precision: not with snapshot covariance")
+{
+  std::unique_ptr<KLT> klt(make_klt(128, 16, 2, KLT::ACORR_AUTO));
+  klt->set_covariance(KLT::COV_SNAPSHOT, false, 0.0f);
+  CHECK_THROWS(klt->set_precision(KLT::PREC_MIXED, false));
+  std::unique_ptr<KLT> mixed(make_klt(128, 16, 2, KLT::ACORR_AUTO));
+  mixed->set_precision(KLT::PREC_MIXED, false);
+  CHECK_THROWS(mixed->set_covariance(KLT::COV_SNAPSHOT, false, 0.0f));
+  mixed->set_precision(KLT::PREC_SINGLE, false);
+  CHECK(mixed->precision() == KLT::PREC_SINGLE);
+  CHECK(mixed->small_kernel());
+}
@@ -0,0 +1,131 @@
+// Karhunen-Loève Transform Library
+// Overlap-add reconstruction
+
+#include "klt_test.hh"
+#include "klt.hh"
+#include "klt_recon.hh"
+
+namespace {
+
+// Overlap-add output of every frame, then the flushed tail
+template <typename AddFn, typename FlushFn>
+std::vector<std::complex<float> > run_recon(int num_frames, int out_len,
+                                            const std::complex<float>* out_buf,
+                                            AddFn add, FlushFn flush)
+{
+  std::vector<std::complex<float> > out;
+  for (int fidx=0; fidx < num_frames; fidx++) {
+    add(fidx);
+    out.insert(out.end(), out_buf, out_buf + out_len);
+  }
+  const int tail_len = flush();
+  out.insert(out.end(), out_buf, out_buf + tail_len);
+  return out;
+}
+
+}
+
+
+TEST_CASE("recon: segments of one signal give the signal back")
+{
+  // Every segment an exact slice of the signal, split over two basis
+  // functions: the overlap-add must reproduce it for any advance
+  const int acm_order = 16;
+  const int num_frames = 20;
+  for (int out_len : {1, 5, 8, 16}) {
+    const int sig_len = (num_frames - 1) * out_len + acm_order;
+    const std::vector<std::complex<float> > sig = test_frame(FRAME_NOISE, sig_len, 90);
+    KLTRecon recon(acm_order, 2, out_len);
+    std::vector<std::complex<float> > kltb(2 * acm_order);
+    const std::vector<std::complex<float> > out = run_recon(
+      num_frames, out_len, recon.out_buf,
+      [&](int fidx) {
+        for (int tidx=0; tidx < acm_order; tidx++) {
+          const std::complex<float> val = sig[fidx * out_len + tidx];
+          kltb[tidx] = 0.25f * val;
+          kltb[acm_order + tidx] = 0.75f * val;
+        }
+        recon.add(&kltb[0]);
+      },
+      [&]() { return recon.flush(); });
+    REQUIRE(static_cast<int>(out.size()) == sig_len);
+    for (int sidx=0; sidx < sig_len; sidx++) {
+      CHECK_NEAR(std::abs(out[sidx] - sig[sidx]), 0.0, 1.0e-5);
+    }
+  }
+}
+
+TEST_CASE("recon: full-order KLT reconstructs the input")
+{
+  // All acm_order components: the weighted basis functions sum to the
+  // frame head, so the output is the input at the input rate
+  const int in_len = 40;
+  const int acm_order = 12;
+  const int num_frames = 30;
+  for (int out_len : {3, 6, 12}) {
+    const int sig_len = (num_frames - 1) * out_len + in_len;
+    const std::vector<std::complex<float> > sig = test_frame(FRAME_NOISE, sig_len, 91);
+    KLT klt(in_len,
+#if KLT_SUPPORT_EVALN
+            0,
+#endif
+            acm_order, acm_order);
+    klt.set_outputs(KLT::OUT_EVAL);
+    klt.set_recon(out_len);
+    CHECK(klt.recon_len() == out_len);
+    REQUIRE(klt.recon_buf != NULL);
+    const std::vector<std::complex<float> > out = run_recon(
+      num_frames, out_len, klt.recon_buf,
+      [&](int fidx) { klt.transform(&sig[fidx * out_len]); },
+      [&]() { return klt.recon_flush(); });
+    // Segments cover the frame heads only
+    REQUIRE(static_cast<int>(out.size()) == (num_frames - 1) * out_len + acm_order);
+    for (size_t sidx=0; sidx < out.size(); sidx++) {
+      CHECK_NEAR(std::abs(out[sidx] - sig[sidx]), 0.0, 1.0e-3 * std::abs(sig[sidx]) + 1.0e-4);
+    }
+  }
+}
+
+TEST_CASE("recon: rank-one tone")
+{
+  // A constant (zero-frequency tone) spans one eigenvector, up to the lags'
+  // end effects (acm_order/in_len)
+  const int in_len = 4096;
+  const int acm_order = 16;
+  const int out_len = 8;
+  const int num_frames = 10;
+  const std::vector<std::complex<float> > sig =
+    test_frame(FRAME_CONST, (num_frames - 1) * out_len + in_len, 0);
+  KLT klt(in_len,
+#if KLT_SUPPORT_EVALN
+          0,
+#endif
+          acm_order, 1);
+  klt.set_recon(out_len);
+  for (int fidx=0; fidx < num_frames; fidx++) {
+    klt.transform(&sig[fidx * out_len]);
+    for (int tidx=0; tidx < out_len; tidx++) {
+      CHECK_NEAR(std::abs(klt.recon_buf[tidx] - sig[fidx * out_len + tidx]), 0.0,
+                 1.0e-3 * std::abs(sig[0]));
+    }
+  }
+}
+
+TEST_CASE("recon: disable and invalid lengths")
+{
+  KLT klt(64,
+#if KLT_SUPPORT_EVALN
+          0,
+#endif
+          16, 2);
+  CHECK(klt.recon_len() == 0);
+  CHECK(klt.recon_buf == NULL);
+  CHECK(klt.recon_flush() == 0);
+  CHECK_THROWS(klt.set_recon(17));
+  CHECK_THROWS(klt.set_recon(-1));
+  klt.set_recon(4);
+  CHECK(klt.recon_len() == 4);
+  klt.set_recon(0);
+  CHECK(klt.recon_len() == 0);
+  CHECK(klt.recon_buf == NULL);
+}
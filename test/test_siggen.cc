@@ -0,0 +1,98 @@
+// Karhunen-Loève Transform Library
+// Synthetic signal generator
+
+#include "klt_test.hh"
+#include "klt_siggen.hh"
+
+#include <cmath>
+
+namespace {
+
+std::vector<std::complex<float> > generate(KLTSigGen& gen, size_t len)
+{
+  std::vector<std::complex<float> > out(len);
+  gen.generate(&out[0], len);
+  return out;
+}
+
+}
+
+
+TEST_CASE("siggen: deterministic in the seed and the split")
+{
+  KLTSigGen whole(5);
+  KLTSigGen split(5);
+  KLTSigGen other(6);
+  for (KLTSigGen* gen : {&whole, &split, &other}) {
+    REQUIRE(gen->add_preset("mix"));
+  }
+  const std::vector<std::complex<float> > ref = generate(whole, 10000);
+  // Same signal however it is split into generate() calls
+  std::vector<std::complex<float> > parts;
+  for (size_t len : {1, 2, 997, 3000, 6000}) {
+    const std::vector<std::complex<float> > part = generate(split, len);
+    parts.insert(parts.end(), part.begin(), part.end());
+  }
+  REQUIRE(parts.size() == ref.size());
+  CHECK(parts == ref);
+  CHECK(generate(other, 10000) != ref);
+}
+
+TEST_CASE("siggen: tone and interferer samples")
+{
+  KLTSigGen gen(1);
+  gen.add_tone(0.125, 2.0f);
+  gen.add_interferer(-0.25, 1.0f, 3, 10);
+  const std::vector<std::complex<float> > out = generate(gen, 40);
+  for (int sidx=0; sidx < 40; sidx++) {
+    std::complex<double> ref = std::polar(2.0, 2.0 * M_PI * 0.125 * sidx);
+    if (sidx % 10 < 3) {
+      ref += std::polar(1.0, -2.0 * M_PI * 0.25 * sidx);
+    }
+    CHECK_NEAR(out[sidx].real(), ref.real(), 1.0e-6);
+    CHECK_NEAR(out[sidx].imag(), ref.imag(), 1.0e-6);
+  }
+}
+
+TEST_CASE("siggen: chirp sweeps and restarts")
+{
+  KLTSigGen gen(1);
+  gen.add_chirp(-0.25, 0.25, 100, 1.0f);
+  const std::vector<std::complex<float> > out = generate(gen, 300);
+  for (int sidx=0; sidx < 300; sidx++) {
+    CHECK_NEAR(std::abs(out[sidx]), 1.0, 1.0e-6);
+    CHECK(std::abs(out[sidx] - out[sidx % 100]) < 1.0e-5f);
+  }
+  // Instantaneous frequency near the start and the end of the sweep
+  const double f_start = std::arg(out[2] * std::conj(out[1])) / (2.0 * M_PI);
+  const double f_end = std::arg(out[98] * std::conj(out[97])) / (2.0 * M_PI);
+  CHECK_NEAR(f_start, -0.25 + 1.5 * 0.005, 1.0e-4);
+  CHECK_NEAR(f_end, -0.25 + 97.5 * 0.005, 1.0e-4);
+}
+
+TEST_CASE("siggen: noise power")
+{
+  KLTSigGen gen(3);
+  gen.add_noise(4.0f);
+  const std::vector<std::complex<float> > out = generate(gen, 100000);
+  double power = 0.0;
+  std::complex<double> mean(0.0, 0.0);
+  for (const std::complex<float>& val : out) {
+    power += std::norm(val);
+    mean += std::complex<double>(val);
+  }
+  power /= out.size();
+  mean /= static_cast<double>(out.size());
+  CHECK_NEAR(power, 4.0, 0.1);
+  CHECK_NEAR(std::abs(mean), 0.0, 0.03);
+}
+
+TEST_CASE("siggen: presets")
+{
+  for (const char* name : {"tone", "chirp", "noise", "interferer", "mix"}) {
+    KLTSigGen gen(1);
+    CHECK(gen.add_preset(name));
+  }
+  KLTSigGen gen(1);
+  CHECK(!gen.add_preset("bogus"));
+}
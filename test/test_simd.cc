@@ -0,0 +1,85 @@
+// Karhunen-Loève Transform Library
+// Vector kernels against scalar double references
+
+#include "klt_test.hh"
+#include "klt_simd.hh"
+
+#include <cmath>
+
+namespace {
+
+std::complex<double> ref_cdotc(const std::complex<float>* x, const std::complex<float>* y,
+                               int len)
+{
+  std::complex<double> sum(0.0, 0.0);
+  for (int idx=0; idx < len; idx++) {
+    sum += std::complex<double>(x[idx]) * std::conj(std::complex<double>(y[idx]));
+  }
+  return sum;
+}
+
+double abs_sum(const std::complex<float>* x, const std::complex<float>* y, int len)
+{
+  double sum = 0.0;
+  for (int idx=0; idx < len; idx++) {
+    sum += std::abs(x[idx]) * std::abs(y[idx]);
+  }
+  return sum;
+}
+
+}
+
+
+TEST_CASE("simd: instruction set")
+{
+  const KLTSimdIsa isa = klt_simd_isa();
+  CHECK(isa == KLT_SIMD_AVX512 || isa == KLT_SIMD_AVX2 || isa == KLT_SIMD_SCALAR);
+}
+
+TEST_CASE("simd: cdotc for every tail length and alignment")
+{
+  const std::vector<std::complex<float> > x = test_frame(FRAME_NOISE, 200, 30);
+  const std::vector<std::complex<float> > y = test_frame(FRAME_NOISE, 200, 31);
+  for (int off=0; off < 3; off++) {
+    for (int len=0; len <= 70; len++) {
+      const std::complex<double> ref = ref_cdotc(&x[off], &y[off], len);
+      const double bound = 1.0e-6 * abs_sum(&x[off], &y[off], len);
+      const std::complex<float> out = klt_cdotc(&x[off], &y[off], len);
+      CHECK_NEAR(out.real(), ref.real(), bound);
+      CHECK_NEAR(out.imag(), ref.imag(), bound);
+      const std::complex<double> out_d = klt_cdotc_d(&x[off], &y[off], len);
+      CHECK_NEAR(out_d.real(), ref.real(), 1.0e-12 * abs_sum(&x[off], &y[off], len));
+      CHECK_NEAR(out_d.imag(), ref.imag(), 1.0e-12 * abs_sum(&x[off], &y[off], len));
+    }
+  }
+}
+
+TEST_CASE("simd: cdotc_d keeps small terms in long sums")
+{
+  // A large value cancelled at the end: float accumulation loses the small
+  // terms altogether, double only to its rounding of the large partial sums
+  std::vector<std::complex<float> > x(4097, std::complex<float>(1.0f, 0.0f));
+  std::vector<std::complex<float> > y(4097, std::complex<float>(1.0e-4f, 0.0f));
+  y[0] = std::complex<float>(1.0e8f, 0.0f);
+  y[4096] = std::complex<float>(-1.0e8f, 0.0f);
+  const std::complex<double> out = klt_cdotc_d(&x[0], &y[0], 4097);
+  CHECK_NEAR(out.real(), 4095 * static_cast<double>(1.0e-4f), 1.0e-4);
+}
+
+TEST_CASE("simd: cscal for every tail length and alignment")
+{
+  const std::vector<std::complex<float> > x = test_frame(FRAME_NOISE, 200, 32);
+  const std::complex<float> a(0.75f, -1.25f);
+  for (int off=0; off < 3; off++) {
+    for (int len=0; len <= 70; len++) {
+      std::vector<std::complex<float> > y(x);
+      klt_cscal(&y[off], a, len);
+      for (int idx=0; idx < static_cast<int>(y.size()); idx++) {
+        const bool scaled = idx >= off && idx < off + len;
+        const std::complex<double> ref = scaled ?
+          std::complex<double>(x[idx]) * std::complex<double>(a) : std::complex<double>(x[idx]);
+        CHECK_NEAR(std::abs(std::complex<double>(y[idx]) - ref), 0.0, 1.0e-6 * std::abs(ref));
+      }
+    }
+  }
+}
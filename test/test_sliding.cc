@@ -0,0 +1,88 @@
+// Karhunen-Loève Transform Library
+// Sliding KLT coeffs (full-frame projection)
+
+#include "klt_test.hh"
+#include "klt.hh"
+
+namespace {
+
+// Sliding coeffs of the unweighted eigenvectors against the direct sums
+void check_sliding(int in_len, int acm_order, int num_eig, bool fft)
+{
+  for (TestFrame kind : ALL_FRAMES) {
+    const std::vector<std::complex<float> > in = test_frame(kind, in_len, 110);
+    KLT klt(in_len,
+#if KLT_SUPPORT_EVALN
+            0,
+#endif
+            acm_order, num_eig);
+    klt.set_outputs(KLT::OUT_EVAL | KLT::OUT_KLTC | KLT::OUT_KLTS);
+    REQUIRE(klt.proj_fft() == fft);
+    REQUIRE(!klt.small_kernel());
+    klt.transform(&in[0]);
+    REQUIRE(klt.klts_buf != NULL);
+    const TestOutputs out = test_outputs(klt, acm_order, num_eig);
+    check_transform(&in[0], in_len, acm_order, num_eig, out, false, 1.0e-3);
+    const int proj_len = klt.proj_len();
+    CHECK(proj_len == in_len - acm_order + 1);
+    double in_norm = 0.0;
+    for (int sidx=0; sidx < in_len; sidx++) {
+      in_norm = std::max(in_norm, static_cast<double>(std::abs(in[sidx])));
+    }
+    // |sum| <= max|in| sqrt(acm_order) for a unit vector
+    const double bound = 1.0e-4 * in_norm * std::sqrt(static_cast<double>(acm_order));
+    for (int eidx=0; eidx < num_eig; eidx++) {
+      const std::complex<float>* vec = &klt.kltb_buf[eidx*acm_order];
+      const std::complex<float>* row = &klt.klts_buf[static_cast<size_t>(eidx) * proj_len];
+      CHECK_NEAR(std::abs(row[0] - klt.kltc_buf[eidx]), 0.0, bound);
+      for (int sidx=0; sidx < proj_len; sidx++) {
+        std::complex<double> ref(0.0, 0.0);
+        for (int tidx=0; tidx < acm_order; tidx++) {
+          ref += std::conj(std::complex<double>(vec[tidx])) * std::complex<double>(in[sidx + tidx]);
+        }
+        CHECK_NEAR(std::abs(std::complex<double>(row[sidx]) - ref), 0.0, bound);
+      }
+    }
+  }
+}
+
+}
+
+
+TEST_CASE("sliding: direct sums")
+{
+  check_sliding(100, 8, 2, false);
+  check_sliding(64, 64, 3, false);
+}
+
+TEST_CASE("sliding: FFT filter bank")
+{
+  check_sliding(1024, 128, 3, true);
+  check_sliding(1000, 96, 1, true);
+}
+
+TEST_CASE("sliding: outputs toggled between frames")
+{
+  const int in_len = 300;
+  const std::vector<std::complex<float> > in = test_frame(FRAME_TONES, in_len, 111);
+  KLT klt(in_len,
+#if KLT_SUPPORT_EVALN
+          0,
+#endif
+          32, 2);
+  CHECK(klt.small_kernel());
+  klt.set_outputs(KLT::OUT_ALL | KLT::OUT_KLTS);
+  CHECK(!klt.small_kernel());
+  REQUIRE(klt.klts_buf != NULL);
+  klt.transform(&in[0]);
+  // Weighted basis functions with OUT_KLTB, the coeffs still match
+  for (int eidx=0; eidx < 2; eidx++) {
+    CHECK_NEAR(std::abs(klt.klts_buf[eidx * klt.proj_len()] - klt.kltc_buf[eidx]), 0.0,
+               1.0e-4 * std::abs(klt.kltc_buf[eidx]) + 1.0e-6);
+  }
+  klt.set_outputs(KLT::OUT_ALL);
+  CHECK(klt.klts_buf == NULL);
+  CHECK(klt.small_kernel());
+  klt.transform(&in[0]);
+  check_transform(&in[0], in_len, 32, 2, test_outputs(klt, 32, 2), true, 1.0e-3);
+}
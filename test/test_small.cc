@@ -0,0 +1,71 @@
+// Karhunen-Loève Transform Library
+// Specialized small-order kernels against the general path
+
+#include "klt_test.hh"
+#include "klt.hh"
+
+namespace {
+
+}
+
+
+TEST_CASE("small: kernels match the general path")
+{
+  const int orders[] = {8, 16, 32, 64};
+  for (int acm_order : orders) {
+    for (int num_eig=1; num_eig <= 4; num_eig++) {
+      for (TestFrame kind : ALL_FRAMES) {
+        const int in_len = 4 * acm_order + 3;
+        const std::vector<std::complex<float> > in = test_frame(kind, in_len, 20 + num_eig);
+        std::unique_ptr<KLT> small(make_klt(in_len, acm_order, num_eig));
+        std::unique_ptr<KLT> general(make_klt(in_len, acm_order, num_eig));
+        general->set_acorr_engine(KLT::ACORR_DIRECT);
+        general->set_eig_engine(KLT::EIG_LAPACK);
+        REQUIRE(small->small_kernel());
+        REQUIRE(!general->small_kernel());
+        small->transform(&in[0]);
+        general->transform(&in[0]);
+        const TestOutputs out = test_outputs(*small, acm_order, num_eig);
+        check_transform(&in[0], in_len, acm_order, num_eig, out, true, 1.0e-3);
+        check_same(&in[0], in_len, acm_order, num_eig, out,
+                   test_outputs(*general, acm_order, num_eig), 1.0e-3);
+      }
+    }
+  }
+}
+
+TEST_CASE("small: no kernel for other shapes or modes")
+{
+  std::unique_ptr<KLT> odd(make_klt(100, 12, 2));
+  std::unique_ptr<KLT> many(make_klt(100, 16, 5));
+  std::unique_ptr<KLT> track(make_klt(100, 16, 2));
+  track->set_track(1, 1.0e-4f, 4);
+  CHECK(!odd->small_kernel());
+  CHECK(!many->small_kernel());
+  CHECK(!track->small_kernel());
+}
+
+TEST_CASE("small: basis functions weighted only with OUT_KLTB")
+{
+  const int in_len = 131;
+  for (TestFrame kind : ALL_FRAMES) {
+    const std::vector<std::complex<float> > in = test_frame(kind, in_len, 40);
+    for (int outputs : {KLT::OUT_EVAL | KLT::OUT_KLTC, static_cast<int>(KLT::OUT_ALL)}) {
+      std::unique_ptr<KLT> small(make_klt(in_len, 32, 3));
+      std::unique_ptr<KLT> general(make_klt(in_len, 32, 3));
+      small->set_outputs(outputs);
+      general->set_outputs(outputs);
+      general->set_acorr_engine(KLT::ACORR_DIRECT);
+      general->set_eig_engine(KLT::EIG_LAPACK);
+      REQUIRE(small->small_kernel());
+      small->transform(&in[0]);
+      general->transform(&in[0]);
+      const bool weighted = outputs & KLT::OUT_KLTB;
+      const TestOutputs out = test_outputs(*small, 32, 3);
+      check_transform(&in[0], in_len, 32, 3, out, weighted, 1.0e-3);
+      if (weighted) {
+        check_same(&in[0], in_len, 32, 3, out, test_outputs(*general, 32, 3), 1.0e-3);
+      }
+    }
+  }
+}
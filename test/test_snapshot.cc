@@ -0,0 +1,133 @@
+// Karhunen-Loève Transform Library
+// Snapshot covariance against an explicit sample covariance
+
+#include "klt_test.hh"
+#include "klt.hh"
+
+namespace {
+
+// Sum of the snapshot outer products of frame[first .. in_len)
+std::vector<std::complex<double> > ref_cov(const std::complex<float>* frame, int in_len,
+                                           int acm_order, int first = 0)
+{
+  std::vector<std::complex<double> > cov(static_cast<size_t>(acm_order) * acm_order);
+  for (int sidx=first; sidx + acm_order <= in_len; sidx++) {
+    for (int row=0; row < acm_order; row++) {
+      for (int col=0; col < acm_order; col++) {
+        cov[static_cast<size_t>(row)*acm_order + col] +=
+          std::complex<double>(frame[sidx + row]) * std::conj(std::complex<double>(frame[sidx + col]));
+      }
+    }
+  }
+  return cov;
+}
+
+// (R + J conj(R) J) / 2
+std::vector<std::complex<double> > fwd_bwd(const std::vector<std::complex<double> >& cov,
+                                           int acm_order)
+{
+  std::vector<std::complex<double> > fb(cov.size());
+  const int last = acm_order - 1;
+  for (int row=0; row < acm_order; row++) {
+    for (int col=0; col < acm_order; col++) {
+      fb[static_cast<size_t>(row)*acm_order + col] =
+        0.5 * (cov[static_cast<size_t>(row)*acm_order + col] +
+               std::conj(cov[static_cast<size_t>(last - row)*acm_order + last - col]));
+    }
+  }
+  return fb;
+}
+
+KLT* make_klt(int in_len, int acm_order, int num_eig, KLT::EigEngine engine)
+{
+  KLT* klt = ::make_klt(in_len, acm_order, num_eig);
+  klt->set_eig_engine(engine);
+  return klt;
+}
+
+}
+
+
+TEST_CASE("snapshot: eigenpairs of the sample covariance")
+{
+  // 153 - 24 + 1 = 130 snapshots: one full COV_SNAP_BLOCK and a partial one
+  const int in_len = 153;
+  const int acm_order = 24;
+  const int num_eig = 4;
+  for (KLT::EigEngine engine : {KLT::EIG_LAPACK, KLT::EIG_LANCZOS}) {
+    for (bool fb : {false, true}) {
+      for (TestFrame kind : ALL_FRAMES) {
+        const std::vector<std::complex<float> > in = test_frame(kind, in_len, 140);
+        std::unique_ptr<KLT> klt(make_klt(in_len, acm_order, num_eig, engine));
+        klt->set_covariance(KLT::COV_SNAPSHOT, fb, 0.0f);
+        CHECK(klt->covariance() == KLT::COV_SNAPSHOT);
+        CHECK(!klt->small_kernel());
+        klt->transform(&in[0]);
+        std::vector<std::complex<double> > cov = ref_cov(&in[0], in_len, acm_order);
+        if (fb) {
+          cov = fwd_bwd(cov, acm_order);
+        }
+        check_hermitian(cov, acm_order, &in[0], num_eig, klt->eval_buf, klt->kltc_buf,
+                        klt->kltb_buf, 1.0e-3);
+      }
+    }
+  }
+}
+
+TEST_CASE("snapshot: forgetting across frames")
+{
+  const int in_len = 100;
+  const int acm_order = 16;
+  const int num_eig = 3;
+  const float forget = 0.5f;
+  std::unique_ptr<KLT> klt(make_klt(in_len, acm_order, num_eig, KLT::EIG_LAPACK));
+  klt->set_covariance(KLT::COV_SNAPSHOT, false, forget);
+  std::vector<std::complex<double> > cov(static_cast<size_t>(acm_order) * acm_order);
+  for (int fidx=0; fidx < 4; fidx++) {
+    const std::vector<std::complex<float> > in = test_frame(FRAME_NOISE, in_len, 141 + fidx);
+    klt->transform(&in[0]);
+    const std::vector<std::complex<double> > frame_cov = ref_cov(&in[0], in_len, acm_order);
+    for (size_t idx=0; idx < cov.size(); idx++) {
+      cov[idx] = static_cast<double>(forget) * cov[idx] + frame_cov[idx];
+    }
+    check_hermitian(cov, acm_order, &in[0], num_eig, klt->eval_buf, klt->kltc_buf,
+                    klt->kltb_buf, 1.0e-3);
+  }
+}
+
+TEST_CASE("snapshot: streaming adds only the new snapshots")
+{
+  const int in_len = 100;
+  const int in_clen = 25;
+  const int acm_order = 16;
+  const int num_eig = 3;
+  const float forget = 0.75f;
+  const int num_frames = 6;
+  const std::vector<std::complex<float> > sig =
+    test_signal((num_frames - 1) * in_clen + in_len, 142);
+  std::unique_ptr<KLT> klt(make_klt(in_len, acm_order, num_eig, KLT::EIG_LAPACK));
+  klt->set_stream(in_clen, 1000);
+  klt->set_covariance(KLT::COV_SNAPSHOT, false, forget);
+  std::vector<std::complex<double> > cov(static_cast<size_t>(acm_order) * acm_order);
+  for (int fidx=0; fidx < num_frames; fidx++) {
+    const std::complex<float>* frame = &sig[fidx * in_clen];
+    klt->transform(frame);
+    // First frame: all snapshots, then the in_clen new ones
+    const int first = fidx == 0 ? 0 : in_len - acm_order + 1 - in_clen;
+    const std::vector<std::complex<double> > new_cov = ref_cov(frame, in_len, acm_order, first);
+    for (size_t idx=0; idx < cov.size(); idx++) {
+      cov[idx] = (fidx == 0 ? 0.0 : static_cast<double>(forget)) * cov[idx] + new_cov[idx];
+    }
+    check_hermitian(cov, acm_order, frame, num_eig, klt->eval_buf, klt->kltc_buf,
+                    klt->kltb_buf, 1.0e-3);
+  }
+}
+
+TEST_CASE("snapshot: invalid settings")
+{
+  std::unique_ptr<KLT> klt(make_klt(64, 16, 2, KLT::EIG_AUTO));
+  CHECK_THROWS(klt->set_covariance(KLT::COV_SNAPSHOT, false, -0.1f));
+  CHECK_THROWS(klt->set_covariance(KLT::COV_SNAPSHOT, false, 1.0f));
+  klt->set_covariance(KLT::COV_TOEPLITZ, false, 0.0f);
+  CHECK(klt->covariance() == KLT::COV_TOEPLITZ);
+}
@@ -0,0 +1,99 @@
+// Karhunen-Loève Transform Library
+// Stage timers, counters and latency histograms
+
+#include "klt_test.hh"
+#include "klt.hh"
+#include "klt_stats.hh"
+
+#include <cstring>
+
+
+TEST_CASE("stats: histogram bins and quantiles")
+{
+  KLTStatsCounters ctr;
+  // 90 calls of 1000 ns (bin [512, 1024)), 10 of 100000 ns ([65536, 131072))
+  for (int idx=0; idx < 90; idx++) {
+    ctr.time(KLT_STAGE_ACORR, 1000);
+  }
+  for (int idx=0; idx < 10; idx++) {
+    ctr.time(KLT_STAGE_ACORR, 100000);
+  }
+  ctr.time(KLT_STAGE_TOTAL, 0);
+  ctr.count(KLT_COUNT_FRAMES);
+  ctr.count(KLT_COUNT_FRAMES);
+  const KLTStats stats = ctr.snapshot();
+  CHECK(stats.counts[KLT_COUNT_FRAMES] == 2);
+  CHECK(stats.counts[KLT_COUNT_FAILURES] == 0);
+  CHECK(stats.stage_calls[KLT_STAGE_ACORR] == 100);
+  CHECK(stats.stage_ns[KLT_STAGE_ACORR] == 90 * 1000 + 10 * 100000);
+  CHECK(stats.stage_hist[KLT_STAGE_ACORR][10] == 90);
+  CHECK(stats.stage_hist[KLT_STAGE_ACORR][17] == 10);
+  CHECK(stats.stage_hist[KLT_STAGE_TOTAL][0] == 1);
+  CHECK(stats.quantile_ns(KLT_STAGE_ACORR, 0.5) == 1024);
+  CHECK(stats.quantile_ns(KLT_STAGE_ACORR, 0.9) == 1024);
+  CHECK(stats.quantile_ns(KLT_STAGE_ACORR, 0.99) == 131072);
+  CHECK(stats.quantile_ns(KLT_STAGE_STEIN, 0.5) == 0);
+  // Longest durations land in the last bin
+  ctr.time(KLT_STAGE_STEIN, ~uint64_t(0) >> 1);
+  CHECK(ctr.snapshot().stage_hist[KLT_STAGE_STEIN][KLT_HIST_BINS - 1] == 1);
+  ctr.reset();
+  const KLTStats cleared = ctr.snapshot();
+  CHECK(cleared.stage_calls[KLT_STAGE_ACORR] == 0);
+  CHECK(cleared.counts[KLT_COUNT_FRAMES] == 0);
+}
+
+TEST_CASE("stats: sums and JSON")
+{
+  KLTStatsCounters ctr;
+  ctr.time(KLT_STAGE_CHPTRD, 300);
+  ctr.count(KLT_COUNT_NSPLIT);
+  KLTStats sum = ctr.snapshot();
+  sum += ctr.snapshot();
+  CHECK(sum.stage_calls[KLT_STAGE_CHPTRD] == 2);
+  CHECK(sum.stage_ns[KLT_STAGE_CHPTRD] == 600);
+  CHECK(sum.counts[KLT_COUNT_NSPLIT] == 2);
+  const std::string json = sum.json();
+  CHECK(json.find(std::string("\"") + klt_stage_name(KLT_STAGE_CHPTRD) + "\"") !=
+        std::string::npos);
+  CHECK(json.find(std::string("\"") + klt_counter_name(KLT_COUNT_NSPLIT) + "\": 2") !=
+        std::string::npos);
+  // Stages that never ran are left out
+  CHECK(json.find(std::string("\"") + klt_stage_name(KLT_STAGE_STEIN) + "\"") ==
+        std::string::npos);
+}
+
+TEST_CASE("stats: names")
+{
+  for (int sidx=0; sidx < KLT_NUM_STAGES; sidx++) {
+    const char* name = klt_stage_name(static_cast<KLTStage>(sidx));
+    REQUIRE(name != NULL);
+    CHECK(strlen(name) > 0);
+  }
+  for (int cidx=0; cidx < KLT_NUM_COUNTERS; cidx++) {
+    const char* name = klt_counter_name(static_cast<KLTCounter>(cidx));
+    REQUIRE(name != NULL);
+    CHECK(strlen(name) > 0);
+  }
+}
+
+#if KLT_SUPPORT_STATS
+TEST_CASE("stats: KLT counts frames and stages")
+{
+  const std::vector<std::complex<float> > in = test_frame(FRAME_NOISE, 256, 80);
+  KLT klt(256,
+#if KLT_SUPPORT_EVALN
+          0,
+#endif
+          48, 4);
+  klt.set_eig_engine(KLT::EIG_LAPACK);
+  for (int fidx=0; fidx < 5; fidx++) {
+    klt.transform(&in[0]);
+  }
+  const KLTStats stats = klt.stats();
+  CHECK(stats.counts[KLT_COUNT_FRAMES] == 5);
+  CHECK(stats.stage_calls[KLT_STAGE_TOTAL] == 5);
+  CHECK(stats.stage_calls[KLT_STAGE_CHPTRD] == 5);
+  klt.reset_stats();
+  CHECK(klt.stats().counts[KLT_COUNT_FRAMES] == 0);
+}
+#endif
@@ -0,0 +1,71 @@
+// Karhunen-Loève Transform Library
+// Streaming auto-correlation against from-scratch lags
+
+#include "klt_test.hh"
+#include "klt.hh"
+
+#include <algorithm>
+
+namespace {
+
+const int IN_LEN = 256;
+const int ACM_ORDER = 16;
+const int NUM_EIG = 3;
+
+}
+
+
+TEST_CASE("stream: off by default")
+{
+  std::unique_ptr<KLT> klt(make_klt(IN_LEN, ACM_ORDER, NUM_EIG));
+  // Default instances dispatch to the small kernels, which streaming bypasses
+  CHECK(klt->small_kernel());
+}
+
+TEST_CASE("stream: overlapped frames match from-scratch transforms")
+{
+  const int in_clen = 48;
+  const int num_frames = 40;
+  std::vector<std::complex<float> > sig = test_signal(IN_LEN + num_frames * in_clen, 3);
+  // A silent stretch (shorter than a frame: the running sums' rounding is
+  // relative to the earlier frames, not to an all-zero one)
+  std::fill(sig.begin() + 700, sig.begin() + 900, std::complex<float>(0.0f, 0.0f));
+
+  std::unique_ptr<KLT> stream(make_klt(IN_LEN, ACM_ORDER, NUM_EIG));
+  std::unique_ptr<KLT> scratch(make_klt(IN_LEN, ACM_ORDER, NUM_EIG));
+  stream->set_stream(in_clen, 8);
+  scratch->set_acorr_engine(KLT::ACORR_DIRECT);
+  scratch->set_eig_engine(KLT::EIG_LAPACK);
+  for (int fidx=0; fidx < num_frames; fidx++) {
+    const std::complex<float>* in = &sig[static_cast<size_t>(fidx) * in_clen];
+    stream->transform(in);
+    scratch->transform(in);
+    const TestOutputs out = test_outputs(*stream, ACM_ORDER, NUM_EIG);
+    check_transform(in, IN_LEN, ACM_ORDER, NUM_EIG, out, true, 1.0e-3);
+    check_same(in, IN_LEN, ACM_ORDER, NUM_EIG, out, test_outputs(*scratch, ACM_ORDER, NUM_EIG),
+               1.0e-3);
+  }
+}
+
+TEST_CASE("stream: restart after a discontinuity")
+{
+  const int in_clen = 64;
+  const std::vector<std::complex<float> > sig_a = test_signal(IN_LEN + 4 * in_clen, 4);
+  const std::vector<std::complex<float> > sig_b = test_frame(FRAME_NOISE, IN_LEN, 5);
+  std::unique_ptr<KLT> stream(make_klt(IN_LEN, ACM_ORDER, NUM_EIG));
+  stream->set_stream(in_clen, 64);
+  for (int fidx=0; fidx < 4; fidx++) {
+    stream->transform(&sig_a[static_cast<size_t>(fidx) * in_clen]);
+  }
+  stream->set_stream(in_clen, 64);
+  stream->transform(&sig_b[0]);
+  check_transform(&sig_b[0], IN_LEN, ACM_ORDER, NUM_EIG,
+                  test_outputs(*stream, ACM_ORDER, NUM_EIG), true, 1.0e-3);
+}
+
+TEST_CASE("stream: not with a window")
+{
+  std::unique_ptr<KLT> klt(make_klt(IN_LEN, ACM_ORDER, NUM_EIG));
+  klt->set_window(KLT::WIN_HANN);
+  CHECK_THROWS(klt->set_stream(64, 64));
+}
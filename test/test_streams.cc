@@ -0,0 +1,235 @@
+// Karhunen-Loève Transform Library
+// Multi-stream scheduling against per-stream sequential transforms
+
+#include "klt_test.hh"
+#include "klt.hh"
+#include "klt_streams.hh"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+const int NUM_STREAMS = 12;
+const int NUM_FRAMES = 23;
+
+struct StreamShape
+{
+  int in_len;
+  int acm_order;
+  int num_eig;
+};
+
+// Two shapes, streams alternating between them
+const StreamShape SHAPES[] = {
+  {200, 24, 3},
+  {128, 16, 2}
+};
+
+// Settings cycling over the streams, so a pooled KLT keeps switching
+KLTStreams::Config stream_config(int sid)
+{
+  KLTStreams::Config config;
+  const KLT::WindowType windows[] = {KLT::WIN_NONE, KLT::WIN_HANN, KLT::WIN_KAISER};
+  config.window = windows[sid % 3];
+  config.window_param = 6.0f;
+  config.acorr_engine = (sid / 3) % 2 ? KLT::ACORR_FFT : KLT::ACORR_DIRECT;
+  config.eig_engine = (sid / 6) % 2 ? KLT::EIG_LANCZOS : KLT::EIG_LAPACK;
+  return config;
+}
+
+KLT* make_klt(const StreamShape& shape, const KLTStreams::Config& config)
+{
+  KLT* klt = ::make_klt(shape.in_len, shape.acm_order, shape.num_eig);
+  klt->set_window(config.window, config.window_param);
+  klt->set_acorr_engine(config.acorr_engine);
+  klt->set_eig_engine(config.eig_engine);
+  return klt;
+}
+
+std::vector<std::complex<float> > stream_frame(int sid, int fidx, int in_len)
+{
+  const int num_kinds = sizeof(ALL_FRAMES) / sizeof(ALL_FRAMES[0]);
+  return test_frame(ALL_FRAMES[(sid + fidx) % num_kinds], in_len, 1000 * sid + fidx);
+}
+
+int add_stream(KLTStreams& streams, const StreamShape& shape,
+               const KLTStreams::Config& config, const KLTStreams::WriteFn& write)
+{
+  return streams.add_stream(shape.in_len,
+#if KLT_SUPPORT_EVALN
+                            0,
+#endif
+                            shape.acm_order, shape.num_eig, config, write);
+}
+
+// Push, retrying while the stream's queue is full
+void push_all(KLTStreams& streams, int sid, const std::complex<float>* in)
+{
+  while (!streams.push(sid, in)) {
+    std::this_thread::yield();
+  }
+}
+
+}
+
+
+TEST_CASE("streams: frames in order and equal to sequential transforms")
+{
+  for (int num_workers : {1, 4}) {
+    KLTStreams streams(num_workers, 3);
+    CHECK(streams.workers() == num_workers);
+    // A stream's writer only runs on one worker at a time, handed over
+    // through the ready rings, so its outputs need no lock
+    std::vector<std::vector<TestOutputs> > outs(NUM_STREAMS);
+    std::vector<long> bad_seq(NUM_STREAMS, 0);
+    for (int sid=0; sid < NUM_STREAMS; sid++) {
+      const StreamShape& shape = SHAPES[sid % 2];
+      const int kltb_size = shape.acm_order * shape.num_eig;
+      const KLTStreams::WriteFn write =
+        [&outs, &bad_seq, sid, shape, kltb_size](long seq, const float* eval,
+                                                 const std::complex<float>* kltc,
+                                                 const std::complex<float>* kltb,
+                                                 const char* err) {
+          if (seq != static_cast<long>(outs[sid].size()) || err != NULL) {
+            bad_seq[sid]++;
+          }
+          TestOutputs out;
+          out.eval.assign(eval, eval + shape.num_eig);
+          out.kltc.assign(kltc, kltc + shape.num_eig);
+          out.kltb.assign(kltb, kltb + kltb_size);
+          outs[sid].push_back(out);
+        };
+      CHECK(add_stream(streams, shape, stream_config(sid), write) == sid);
+    }
+    CHECK(streams.num_streams() == NUM_STREAMS);
+    streams.start();
+    // One KLT per shape per worker, however many streams
+    CHECK(streams.pooled() == 2 * num_workers);
+    // Frames of all streams interleaved
+    for (int fidx=0; fidx < NUM_FRAMES; fidx++) {
+      for (int sid=0; sid < NUM_STREAMS; sid++) {
+        const std::vector<std::complex<float> > in =
+          stream_frame(sid, fidx, SHAPES[sid % 2].in_len);
+        push_all(streams, sid, &in[0]);
+      }
+    }
+    streams.finish();
+
+    long worked = 0;
+    for (int widx=0; widx < num_workers; widx++) {
+      worked += streams.worker_stats(widx).frames;
+    }
+    CHECK(worked == static_cast<long>(NUM_STREAMS) * NUM_FRAMES);
+    for (int sid=0; sid < NUM_STREAMS; sid++) {
+      const StreamShape& shape = SHAPES[sid % 2];
+      CHECK(streams.frames(sid) == NUM_FRAMES);
+      CHECK(bad_seq[sid] == 0);
+      REQUIRE(static_cast<int>(outs[sid].size()) == NUM_FRAMES);
+      std::unique_ptr<KLT> ref(make_klt(shape, stream_config(sid)));
+      for (int fidx=0; fidx < NUM_FRAMES; fidx++) {
+        const std::vector<std::complex<float> > in = stream_frame(sid, fidx, shape.in_len);
+        ref->transform(&in[0]);
+        check_same(&in[0], shape.in_len, shape.acm_order, shape.num_eig, outs[sid][fidx],
+                   test_outputs(*ref, shape.acm_order, shape.num_eig), 1.0e-3);
+      }
+    }
+  }
+}
+
+TEST_CASE("streams: full queue and restart")
+{
+  const StreamShape& shape = SHAPES[1];
+  KLTStreams streams(2, 2);
+  std::atomic<bool> hold(true);
+  std::atomic<long> written(0);
+  add_stream(streams, shape, KLTStreams::Config(),
+             [&](long, const float*, const std::complex<float>*,
+                 const std::complex<float>*, const char*) {
+               while (hold.load()) {
+                 std::this_thread::yield();
+               }
+               written++;
+             });
+  streams.start();
+  const std::vector<std::complex<float> > in = stream_frame(0, 0, shape.in_len);
+  // The first frame's slot is held by its writer, the second queued
+  CHECK(streams.push(0, &in[0]));
+  CHECK(streams.push(0, &in[0]));
+  CHECK(!streams.push(0, &in[0]));
+  hold.store(false);
+  push_all(streams, 0, &in[0]);
+  streams.finish();
+  CHECK(written.load() == 3);
+  CHECK(streams.frames(0) == 3);
+
+  // Frame numbers carry on
+  streams.start();
+  push_all(streams, 0, &in[0]);
+  streams.finish();
+  CHECK(streams.frames(0) == 4);
+  CHECK(streams.pooled() == 2);
+}
+
+TEST_CASE("streams: writer error stops the workers")
+{
+  const StreamShape& shape = SHAPES[1];
+  KLTStreams streams(2, 4);
+  bool fail = true;
+  std::atomic<long> written(0);
+  add_stream(streams, shape, KLTStreams::Config(),
+             [&](long seq, const float*, const std::complex<float>*,
+                 const std::complex<float>*, const char*) {
+               if (fail && seq == 5) {
+                 throw std::runtime_error("write failed");
+               }
+               written++;
+             });
+  streams.start();
+  const std::vector<std::complex<float> > in = stream_frame(0, 0, shape.in_len);
+  // Pushes rethrow the error once the workers have stopped
+  try {
+    for (int fidx=0; fidx < 40; fidx++) {
+      push_all(streams, 0, &in[0]);
+    }
+  } catch (std::runtime_error&) {
+  }
+  CHECK_THROWS(streams.finish());
+  CHECK(written.load() == 5);
+
+  // The next run drops the frames left queued
+  fail = false;
+  streams.start();
+  push_all(streams, 0, &in[0]);
+  streams.finish();
+  CHECK(written.load() == 6);
+}
+
+TEST_CASE("streams: invalid use throws")
+{
+  KLTStreams streams(2, 0);
+  const KLTStreams::WriteFn write =
+    [](long, const float*, const std::complex<float>*, const std::complex<float>*,
+       const char*) {
+    };
+  const StreamShape bad_shape = {64, 128, 2};
+  CHECK_THROWS(add_stream(streams, bad_shape, KLTStreams::Config(), write));
+  add_stream(streams, SHAPES[0], KLTStreams::Config(), write);
+  const std::vector<std::complex<float> > in = stream_frame(0, 0, SHAPES[0].in_len);
+  CHECK_THROWS(streams.push(0, &in[0]));
+
+  // Settings are checked up front
+  KLTStreams::Config user;
+  user.window = KLT::WIN_USER;
+  add_stream(streams, SHAPES[0], user, write);
+  CHECK_THROWS(streams.start());
+
+  KLTStreams good(1, 0);
+  add_stream(good, SHAPES[0], KLTStreams::Config(), write);
+  good.start();
+  CHECK_THROWS(good.start());
+  CHECK_THROWS(add_stream(good, SHAPES[0], KLTStreams::Config(), write));
+  CHECK_THROWS(good.push(1, &in[0]));
+  good.finish();
+}
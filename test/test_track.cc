@@ -0,0 +1,91 @@
+// Karhunen-Loève Transform Library
+// Subspace tracking against cold solves
+
+#include "klt_test.hh"
+#include "klt.hh"
+
+#include <cmath>
+
+namespace {
+
+const int IN_LEN = 512;
+const int ACM_ORDER = 32;
+const int NUM_EIG = 3;
+
+}
+
+
+TEST_CASE("track: overlapped frames match cold solves")
+{
+  const int in_clen = 32;
+  const int num_frames = 30;
+  const std::vector<std::complex<float> > sig = test_signal(IN_LEN + num_frames * in_clen, 8);
+  std::unique_ptr<KLT> track(make_klt(IN_LEN, ACM_ORDER, NUM_EIG));
+  std::unique_ptr<KLT> cold(make_klt(IN_LEN, ACM_ORDER, NUM_EIG));
+  track->set_track(1, 1.0e-4f, 4);
+  cold->set_acorr_engine(KLT::ACORR_DIRECT);
+  cold->set_eig_engine(KLT::EIG_LAPACK);
+  int num_tracked = 0;
+  for (int fidx=0; fidx < num_frames; fidx++) {
+    const std::complex<float>* in = &sig[static_cast<size_t>(fidx) * in_clen];
+    track->transform(in);
+    cold->transform(in);
+    num_tracked += track->tracked();
+    const TestOutputs out = test_outputs(*track, ACM_ORDER, NUM_EIG);
+    check_transform(in, IN_LEN, ACM_ORDER, NUM_EIG, out, true, 1.0e-3);
+    check_same(in, IN_LEN, ACM_ORDER, NUM_EIG, out, test_outputs(*cold, ACM_ORDER, NUM_EIG),
+               1.0e-3);
+  }
+  // The first frame is always cold; the slowly moving subspace after it
+  // should mostly be tracked
+  CHECK(num_tracked > num_frames / 2);
+}
+
+TEST_CASE("track: falls back to the cold solve on a jump")
+{
+  const std::vector<std::complex<float> > sig_a = test_signal(IN_LEN, 9);
+  std::unique_ptr<KLT> track(make_klt(IN_LEN, ACM_ORDER, NUM_EIG));
+  track->set_track(1, 1.0e-4f, 2);
+  track->transform(&sig_a[0]);
+  for (TestFrame kind : ALL_FRAMES) {
+    const std::vector<std::complex<float> > in = test_frame(kind, IN_LEN, 10);
+    track->transform(&in[0]);
+    check_transform(&in[0], IN_LEN, ACM_ORDER, NUM_EIG, test_outputs(*track, ACM_ORDER, NUM_EIG),
+                    true, 1.0e-3);
+  }
+}
+
+TEST_CASE("track: a stronger component outside the subspace is not missed")
+{
+  // Tones on the acm_order-point DFT grid, proj_len() a multiple of
+  // acm_order: the snapshot covariance's eigenvectors are exactly the two
+  // (orthogonal) tone vectors.  The first frame's one tracked vector stays
+  // invariant when a stronger tone joins, with zero residual.
+  const int in_len = 2 * ACM_ORDER + ACM_ORDER - 1;
+  std::vector<std::complex<float> > weak(in_len);
+  std::vector<std::complex<float> > both(in_len);
+  for (int sidx=0; sidx < in_len; sidx++) {
+    const double phase = 2.0 * M_PI * sidx / ACM_ORDER;
+    weak[sidx] = std::polar(1.0f, static_cast<float>(3.0 * phase));
+    both[sidx] = weak[sidx] + std::polar(3.0f, static_cast<float>(10.0 * phase));
+  }
+  std::unique_ptr<KLT> track(make_klt(in_len, ACM_ORDER, 1));
+  std::unique_ptr<KLT> cold(make_klt(in_len, ACM_ORDER, 1));
+  for (KLT* klt : {track.get(), cold.get()}) {
+    klt->set_covariance(KLT::COV_SNAPSHOT, false, 0.0f);
+  }
+  track->set_track(1, 1.0e-4f, 4);
+  track->transform(&weak[0]);
+  track->transform(&both[0]);
+  cold->transform(&both[0]);
+  CHECK(!track->tracked());
+  check_same(&both[0], in_len, ACM_ORDER, 1, test_outputs(*track, ACM_ORDER, 1),
+             test_outputs(*cold, ACM_ORDER, 1), 1.0e-3);
+}
+
+TEST_CASE("track: invalid config")
+{
+  std::unique_ptr<KLT> klt(make_klt(IN_LEN, ACM_ORDER, NUM_EIG));
+  CHECK_THROWS(klt->set_track(1, 0.0f, 4));
+  CHECK_THROWS(klt->set_track(1, 1.0e-4f, 0));
+}
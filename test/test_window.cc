@@ -0,0 +1,122 @@
+// Karhunen-Loève Transform Library
+// Fused windowing against prewindowed input
+
+#include "klt_test.hh"
+#include "klt.hh"
+#include "klt_window.hh"
+
+#include <cmath>
+
+namespace {
+
+}
+
+
+TEST_CASE("window: tables")
+{
+  const int len = 64;
+  std::shared_ptr<const float> hann = klt_window_table(KLT::WIN_HANN, len, 0.0f);
+  std::shared_ptr<const float> bh = klt_window_table(KLT::WIN_BLACKMAN_HARRIS, len, 0.0f);
+  std::shared_ptr<const float> kaiser = klt_window_table(KLT::WIN_KAISER, len, 6.0f);
+  for (int widx=0; widx < len; widx++) {
+    CHECK_NEAR(hann.get()[widx], 0.5 - 0.5 * std::cos(2.0 * M_PI * widx / len), 1.0e-6);
+  }
+  // DFT-even: only w[0] is an edge sample, symmetric about len/2
+  CHECK_NEAR(hann.get()[0], 0.0, 1.0e-7);
+  CHECK_NEAR(hann.get()[len/2], 1.0, 1.0e-7);
+  CHECK_NEAR(bh.get()[len/2], 1.0, 1.0e-5);
+  CHECK_NEAR(kaiser.get()[len/2], 1.0, 1.0e-6);
+  for (int widx=1; widx < len/2; widx++) {
+    CHECK_NEAR(bh.get()[widx], bh.get()[len - widx], 1.0e-6);
+    CHECK_NEAR(kaiser.get()[widx], kaiser.get()[len - widx], 1.0e-6);
+    CHECK(kaiser.get()[widx] < kaiser.get()[widx + 1]);
+  }
+  // Shared by (type, len, param)
+  CHECK(klt_window_table(KLT::WIN_HANN, len, 0.0f).get() == hann.get());
+  CHECK(klt_window_table(KLT::WIN_KAISER, len, 6.0f).get() == kaiser.get());
+  CHECK(klt_window_table(KLT::WIN_KAISER, len, 7.0f).get() != kaiser.get());
+  CHECK(klt_window_table(KLT::WIN_HANN, len + 1, 0.0f).get() != hann.get());
+}
+
+TEST_CASE("window: fused and scratch paths match prewindowed input")
+{
+  const int in_len = 512;
+  const int acm_order = 48;
+  const int num_eig = 4;
+  const std::shared_ptr<const float> taps = klt_window_table(KLT::WIN_HANN, in_len, 0.0f);
+  for (KLT::AcorrEngine engine : {KLT::ACORR_DIRECT, KLT::ACORR_FFT}) {
+    for (bool snapshot : {false, true}) {
+      for (TestFrame kind : ALL_FRAMES) {
+        const std::vector<std::complex<float> > in = test_frame(kind, in_len, 150);
+        const std::vector<std::complex<float> > orig(in);
+        std::vector<std::complex<float> > pre(in);
+        for (int sidx=0; sidx < in_len; sidx++) {
+          pre[sidx] *= taps.get()[sidx];
+        }
+        std::unique_ptr<KLT> klt(make_klt(in_len, acm_order, num_eig));
+        std::unique_ptr<KLT> ref(make_klt(in_len, acm_order, num_eig));
+        for (KLT* k : {klt.get(), ref.get()}) {
+          k->set_acorr_engine(engine);
+          if (snapshot) {
+            k->set_covariance(KLT::COV_SNAPSHOT, false, 0.0f);
+          }
+        }
+        klt->set_window(KLT::WIN_HANN);
+        CHECK(klt->window() == KLT::WIN_HANN);
+        klt->transform(&in[0]);
+        ref->transform(&pre[0]);
+        // The caller's input is left alone
+        CHECK(in == orig);
+        const TestOutputs out = test_outputs(*klt, acm_order, num_eig);
+        if (!snapshot) {
+          check_transform(&pre[0], in_len, acm_order, num_eig, out, true, 1.0e-3);
+          check_same(&pre[0], in_len, acm_order, num_eig, out,
+                     test_outputs(*ref, acm_order, num_eig), 1.0e-3);
+        }
+        for (int eidx=0; eidx < num_eig; eidx++) {
+          CHECK_NEAR(klt->eval_buf[eidx], ref->eval_buf[eidx],
+                     1.0e-4 * std::max(ref->eval_buf[num_eig-1], 1.0e-20f));
+          CHECK_NEAR(std::abs(klt->kltc_buf[eidx]), std::abs(ref->kltc_buf[eidx]),
+                     1.0e-3 * (std::abs(ref->kltc_buf[eidx]) + 1.0e-6));
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("window: small kernel and user taps")
+{
+  // Small kernels window into scratch; user taps equal to the Hann table
+  // give the same transform as WIN_HANN
+  const int in_len = 130;
+  const std::vector<std::complex<float> > in = test_frame(FRAME_TONES, in_len, 151);
+  const std::shared_ptr<const float> taps = klt_window_table(KLT::WIN_HANN, in_len, 0.0f);
+  std::vector<std::complex<float> > pre(in);
+  for (int sidx=0; sidx < in_len; sidx++) {
+    pre[sidx] *= taps.get()[sidx];
+  }
+  std::unique_ptr<KLT> family(make_klt(in_len, 16, 2));
+  std::unique_ptr<KLT> user(make_klt(in_len, 16, 2));
+  family->set_window(KLT::WIN_HANN);
+  user->set_window(taps.get());
+  CHECK(user->window() == KLT::WIN_USER);
+  CHECK(family->small_kernel());
+  family->transform(&in[0]);
+  user->transform(&in[0]);
+  for (int eidx=0; eidx < 2; eidx++) {
+    CHECK(family->eval_buf[eidx] == user->eval_buf[eidx]);
+    CHECK(family->kltc_buf[eidx] == user->kltc_buf[eidx]);
+  }
+  check_transform(&pre[0], in_len, 16, 2, test_outputs(*family, 16, 2), true, 1.0e-3);
+}
+
+TEST_CASE("window: not with streaming")
+{
+  std::unique_ptr<KLT> stream(make_klt(1024, 64, 3));
+  stream->set_stream(256, 8);
+  CHECK_THROWS(stream->set_window(KLT::WIN_HANN));
+  std::unique_ptr<KLT> windowed(make_klt(1024, 64, 3));
+  windowed->set_window(KLT::WIN_HANN);
+  CHECK_THROWS(windowed->set_stream(256, 8));
+  CHECK_THROWS(windowed->set_window(static_cast<const float*>(NULL)));
+}